@@ -0,0 +1,118 @@
+#ifndef NEXTPLAYER_BENCHMARK_STATS_H
+#define NEXTPLAYER_BENCHMARK_STATS_H
+
+/*
+ * Allocation and memory statistics for the host benchmarks of the native cores.
+ *
+ * Include this from exactly one translation unit of a benchmark executable: with glibc it
+ * replaces malloc and its siblings to count calls, and FFmpeg's shared libraries pick the
+ * replacements up like any other symbol of the executable. Elsewhere the count reads -1.
+ */
+
+#include <sys/resource.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static std::atomic<int64_t> benchmarkAllocations(0);
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size) {
+    benchmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    benchmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    benchmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+// av_malloc allocates with posix_memalign.
+int posix_memalign(void **pointer, size_t alignment, size_t size) {
+    benchmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *allocated = __libc_memalign(alignment, size);
+    if (!allocated) {
+        return ENOMEM;
+    }
+    *pointer = allocated;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    benchmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    benchmarkAllocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void free(void *pointer) {
+    __libc_free(pointer);
+}
+}
+#endif
+
+/**
+ * Number of heap allocations so far, on all threads, or -1 if they are not counted.
+ */
+inline int64_t benchmark_allocations() {
+#ifdef __GLIBC__
+    return benchmarkAllocations.load(std::memory_order_relaxed);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Resets the peak resident set size to the current one, so that benchmark_peak_rss_bytes() covers
+ * what runs next. Returns false if the kernel does not support it, and the peak then covers the
+ * whole process.
+ */
+inline bool benchmark_reset_peak_rss() {
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (!file) {
+        return false;
+    }
+    bool reset = fputs("5", file) >= 0;
+    return fclose(file) == 0 && reset;
+}
+
+/**
+ * Peak resident set size since the last reset, or since the process started.
+ */
+inline int64_t benchmark_peak_rss_bytes() {
+    if (FILE *file = fopen("/proc/self/status", "r")) {
+        char line[256];
+        long long kib = -1;
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "VmHWM: %lld kB", &kib) == 1) {
+                break;
+            }
+        }
+        fclose(file);
+        if (kib >= 0) {
+            return kib * 1024;
+        }
+    }
+    struct rusage usage{};
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? static_cast<int64_t>(usage.ru_maxrss) * 1024 : -1;
+}
+
+#endif //NEXTPLAYER_BENCHMARK_STATS_H
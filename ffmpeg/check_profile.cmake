@@ -0,0 +1,46 @@
+# Checks the profile written by pgo.sh: llvm-profdata has to read it, and it has to hold counts
+# for the FFmpeg decode paths and the JNI cores that release builds optimize with it. A profile
+# that misses them was gathered on the wrong corpus or against renamed code, and only slows the
+# build down.
+#
+# Prints "Skipped" when there is no profile or no llvm-profdata to read it with.
+#
+# Usage: cmake -DPROFILE=<ffmpeg.profdata> -DLLVM_PROFDATA=<llvm-profdata> -P check_profile.cmake
+
+if (NOT EXISTS "${PROFILE}")
+    message(STATUS "Skipped: no profile at ${PROFILE}, ffmpeg/pgo.sh writes it")
+    return()
+endif ()
+if (NOT EXISTS "${LLVM_PROFDATA}")
+    message(STATUS "Skipped: no llvm-profdata to read ${PROFILE}")
+    return()
+endif ()
+
+set(profiled_functions
+        # FFmpeg
+        ff_h264_decode_mb_cabac
+        ff_hevc_hls_residual_coding
+        vp9_decode_frame
+        sws_scale
+        swr_convert
+        # media3ext core
+        copyYuvFrame
+        convertToYv12
+        decodePacket
+        # mediainfo core
+        frame_convert_to_rgba)
+
+foreach (function ${profiled_functions})
+    execute_process(COMMAND ${LLVM_PROFDATA} show --function=${function} ${PROFILE}
+            OUTPUT_VARIABLE output
+            ERROR_VARIABLE error
+            RESULT_VARIABLE result)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "${LLVM_PROFDATA} cannot read ${PROFILE}: ${error}")
+    endif ()
+    if (NOT output MATCHES "Function count: [1-9]")
+        message(FATAL_ERROR "${PROFILE} has no counts for ${function}. Regenerate it with ffmpeg/pgo.sh.")
+    endif ()
+endforeach ()
+list(JOIN profiled_functions ", " profiled_functions)
+message(STATUS "${PROFILE} covers ${profiled_functions}")
@@ -0,0 +1,105 @@
+#!/bin/bash
+
+# Compares how long the JNI libraries take to load on a device, to weigh the shared FFmpeg layout
+# against NEXTLIB_FFMPEG_STATIC.
+#
+# Builds a small dlopen timer with the NDK's clang, pushes it to the connected device together
+# with each given directory of libraries, and loads libmedia3ext.so and libmediainfo.so from
+# every directory in a fresh process per run. The directories hold one ABI's libraries each, as
+# packaged in the APK, for example the lib/<abi> directory of an unzipped release APK built once
+# with each layout. JNI_OnLoad is not called, so the times cover mapping, relocation and the
+# static constructors, which is what the layout changes.
+#
+# Usage: ANDROID_NDK_HOME=<ndk> ./load_time.sh <abi> <library dir> [<library dir> ...]
+
+set -e
+
+ABI=$1
+shift || true
+if [[ -z "$ABI" || $# -eq 0 ]]; then
+  echo "Usage: ANDROID_NDK_HOME=<ndk> $0 <abi> <library dir> [<library dir> ...]"
+  exit 1
+fi
+
+# Configuration
+RUNS=${RUNS:-20}
+LIBRARIES="libmedia3ext.so libmediainfo.so"
+DEVICE_DIR=/data/local/tmp/nextlib_load_time
+
+BASE_DIR=$(cd "$(dirname "$0")" && pwd)
+BUILD_DIR=$BASE_DIR/build/load_time
+TOOLCHAIN_PREFIX="${ANDROID_NDK_HOME}/toolchains/llvm/prebuilt/linux-x86_64"
+
+case $ABI in
+armeabi-v7a) TARGET=armv7a-linux-androideabi21 ;;
+arm64-v8a) TARGET=aarch64-linux-android21 ;;
+x86) TARGET=i686-linux-android21 ;;
+x86_64) TARGET=x86_64-linux-android21 ;;
+*)
+  echo "Error: unknown ABI $ABI"
+  exit 1
+  ;;
+esac
+
+CLANG=$TOOLCHAIN_PREFIX/bin/$TARGET-clang
+if [[ ! -x "$CLANG" ]]; then
+  echo "Error: no NDK clang at $CLANG"
+  exit 1
+fi
+if ! command -v adb &> /dev/null; then
+  echo "Error: adb is required to run on a device."
+  exit 1
+fi
+
+# Prints the microseconds dlopen took for each library given on the command line.
+mkdir -p "$BUILD_DIR"
+cat > "$BUILD_DIR/load_time.c" << 'EOF'
+#include <dlfcn.h>
+#include <stdio.h>
+#include <time.h>
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        void *library = dlopen(argv[i], RTLD_NOW | RTLD_LOCAL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (!library) {
+            fprintf(stderr, "%s\n", dlerror());
+            return 1;
+        }
+        printf("%s %ld\n", argv[i],
+               (long) ((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000));
+    }
+    return 0;
+}
+EOF
+"$CLANG" -O2 "$BUILD_DIR/load_time.c" -o "$BUILD_DIR/load_time"
+
+adb shell "rm -rf $DEVICE_DIR && mkdir -p $DEVICE_DIR"
+adb push "$BUILD_DIR/load_time" "$DEVICE_DIR/" > /dev/null
+
+printf "%-40s %-18s %10s %10s\n" "libraries" "library" "median us" "min us"
+INDEX=0
+for LIBRARY_DIR in "$@"; do
+  INDEX=$((INDEX + 1))
+  REMOTE_DIR=$DEVICE_DIR/$INDEX
+  adb shell "mkdir -p $REMOTE_DIR"
+  adb push "$LIBRARY_DIR"/*.so "$REMOTE_DIR/" > /dev/null
+
+  for LIBRARY in $LIBRARIES; do
+    if [[ ! -f "$LIBRARY_DIR/$LIBRARY" ]]; then
+      continue
+    fi
+    # One process per run, so every run loads the library and its FFmpeg dependencies anew.
+    for RUN in $(seq "$RUNS"); do
+      adb shell "cd $REMOTE_DIR && LD_LIBRARY_PATH=$REMOTE_DIR ../load_time $REMOTE_DIR/$LIBRARY" |
+        awk '{ print $2 }'
+    done | sort -n | awk -v dir="$LIBRARY_DIR" -v lib="$LIBRARY" '
+      { times[NR] = $1 }
+      END { printf "%-40s %-18s %10d %10d\n", substr(dir, length(dir) > 40 ? length(dir) - 39 : 1), lib,
+            times[int((NR + 1) / 2)], times[1] }'
+  done
+done
+
+adb shell "rm -rf $DEVICE_DIR"
@@ -0,0 +1,175 @@
+#!/bin/bash
+
+# Gathers a profile of the decode paths for setup.sh and the JNI libraries to be built with.
+#
+# Builds an instrumented x86_64 host FFmpeg with the NDK's clang and decodes every file of a
+# corpus with it the way the JNI libraries do (decode, then swscale/swresample). Builds the host
+# benchmarks of the JNI cores against that FFmpeg, instrumented too, and runs them on the clips
+# of test_clips.sh. Merges everything into pgo/ffmpeg.profdata. Then builds FFmpeg with that
+# profile and prints the decode time per codec for both builds. Commit pgo/ffmpeg.profdata to use
+# it for release builds.
+#
+# Without a corpus dir, the corpus is the clips test_clips.sh generates with the ffmpeg program
+# on the PATH.
+#
+# Usage: ANDROID_NDK_HOME=<ndk> ./pgo.sh [corpus dir]
+
+set -e
+
+# Directories
+BASE_DIR=$(cd "$(dirname "$0")" && pwd)
+ROOT_DIR=$(cd "$BASE_DIR/.." && pwd)
+FFMPEG_VERSION=$(sed -n 's/^FFMPEG_VERSION=//p' "$BASE_DIR/setup.sh")
+FFMPEG_DIR=$BASE_DIR/sources/ffmpeg-$FFMPEG_VERSION
+PGO_BUILD_DIR=$BASE_DIR/build/pgo
+PGO_PROFILE=$BASE_DIR/pgo/ffmpeg.profdata
+CLIPS_DIR=$PGO_BUILD_DIR/clips
+JOBS=$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
+
+CORPUS_DIR=$CLIPS_DIR
+if [[ -n "$1" ]]; then
+  if [[ ! -d "$1" ]]; then
+    echo "Usage: ANDROID_NDK_HOME=<ndk> $0 [corpus dir]"
+    exit 1
+  fi
+  CORPUS_DIR=$(cd "$1" && pwd)
+fi
+
+# The profile has to be read by the same LLVM that compiles the Android libraries.
+TOOLCHAIN_PREFIX="${ANDROID_NDK_HOME}/toolchains/llvm/prebuilt/linux-x86_64"
+CLANG=$TOOLCHAIN_PREFIX/bin/clang
+LLVM_PROFDATA=$TOOLCHAIN_PREFIX/bin/llvm-profdata
+if [[ ! -x "$CLANG" ]]; then
+  echo "Error: no NDK clang at $CLANG"
+  exit 1
+fi
+if ! command -v cmake &> /dev/null; then
+  echo "Error: cmake is required to build the host cores."
+  exit 1
+fi
+
+# The external decoders (libvpx, dav1d) have their own build systems and are not profiled;
+# everything else matches setup.sh.
+DECODERS=$(sed -n 's/^ENABLED_DECODERS="\(.*\)"/\1/p' "$BASE_DIR/setup.sh" | tr ' ' '\n' | grep -v '^lib' | tr '\n' ',')
+
+if [[ ! -d "$FFMPEG_DIR" ]]; then
+  mkdir -p "$BASE_DIR/sources"
+  pushd "$BASE_DIR/sources"
+  curl -L "https://ffmpeg.org/releases/ffmpeg-${FFMPEG_VERSION}.tar.gz" -o ffmpeg.tar.gz
+  tar -zxf ffmpeg.tar.gz
+  rm ffmpeg.tar.gz
+  popd
+fi
+
+# Builds the ffmpeg program into $PGO_BUILD_DIR/<name> with the given extra compiler flags, and
+# installs shared libraries for the host cores into $PGO_BUILD_DIR/<name>/install.
+function buildHostFfmpeg() {
+  local NAME=$1
+  local FLAGS=$2
+  local OUT=$PGO_BUILD_DIR/$NAME
+  rm -rf "$OUT"
+  mkdir -p "$OUT"
+  pushd "$OUT"
+  "$FFMPEG_DIR/configure" \
+    --prefix="$OUT/install" \
+    --enable-shared \
+    --disable-static \
+    --enable-rpath \
+    --cc="$CLANG" \
+    --cxx="$CLANG++" \
+    --extra-cflags="-O3 $FLAGS" \
+    --extra-ldflags="$FLAGS" \
+    --x86asmexe=nasm \
+    --disable-inline-asm \
+    --disable-doc \
+    --disable-ffplay \
+    --disable-ffprobe \
+    --disable-everything \
+    --disable-autodetect \
+    --enable-decoder="${DECODERS%,}" \
+    --enable-parsers \
+    --enable-demuxers \
+    --enable-protocol=file \
+    --enable-muxer=null \
+    --enable-encoder=wrapped_avframe,pcm_s16le \
+    --enable-filter=scale,format,aresample,aformat,null,anull \
+    --enable-swresample \
+    --disable-debug
+  make -j"$JOBS"
+  make install
+  popd
+}
+
+# Builds and runs the benchmarks of the JNI cores against the FFmpeg installed by
+# buildHostFfmpeg [name], with the given extra compiler flags.
+function runHostCores() {
+  local NAME=$1
+  local FLAGS=$2
+  local PREFIX=$PGO_BUILD_DIR/$NAME/install
+  for MODULE in media3ext mediainfo; do
+    local OUT=$PGO_BUILD_DIR/$NAME-$MODULE
+    rm -rf "$OUT"
+    PKG_CONFIG_PATH="$PREFIX/lib/pkgconfig" cmake -S "$ROOT_DIR/$MODULE/src/main/cpp" -B "$OUT" \
+      -DCMAKE_BUILD_TYPE=Release \
+      -DCMAKE_C_COMPILER="$CLANG" \
+      -DCMAKE_CXX_COMPILER="$CLANG++" \
+      -DCMAKE_CXX_FLAGS="$FLAGS" \
+      -DCMAKE_EXE_LINKER_FLAGS="$FLAGS -Wl,-rpath,$PREFIX/lib" \
+      -Dtest_clips_dir="$CLIPS_DIR"
+    cmake --build "$OUT" --target "${MODULE}_benchmark" -j"$JOBS"
+    # Clips of decoders left out of this FFmpeg, such as AV1 without dav1d, fail and are skipped.
+    "$OUT/${MODULE}_benchmark" "$CLIPS_DIR" || true
+  done
+}
+
+# Decodes [file] with the ffmpeg program at [bin] and prints "<codec> <seconds>".
+function decode() {
+  local BIN=$1
+  local FILE=$2
+  local CODEC
+  CODEC=$("$BIN" -hide_banner -i "$FILE" 2>&1 |
+    sed -n 's/.*Stream #0:[0-9]*.*: \(Video\|Audio\): \([a-z0-9_]*\).*/\2/p' | head -1)
+  # Video goes through swscale to RGBA like thumbnails, audio through swresample to S16 like
+  # FfmpegAudioDecoder.
+  local TIME
+  TIME=$("$BIN" -nostdin -hide_banner -benchmark -i "$FILE" \
+    -vf format=rgba -af aformat=sample_fmts=s16 -f null - 2>&1 |
+    sed -n 's/^bench:.*rtime=\([0-9.]*\)s.*/\1/p')
+  echo "${CODEC:-unknown} ${TIME:-0}"
+}
+
+# Prints the total decode time of the corpus per codec for the ffmpeg program at [bin].
+function timeCorpus() {
+  local BIN=$1
+  find "$CORPUS_DIR" -type f ! -name '*.stamp' | sort | while read -r FILE; do
+    decode "$BIN" "$FILE"
+  done | awk '{ time[$1] += $2 } END { for (codec in time) printf "%s %.3f\n", codec, time[codec] }' | sort
+}
+
+echo "Generating clips..."
+"$BASE_DIR/test_clips.sh" "$CLIPS_DIR"
+
+echo "Building instrumented FFmpeg..."
+PROFILE_RAW_DIR=$PGO_BUILD_DIR/profraw
+rm -rf "$PROFILE_RAW_DIR"
+buildHostFfmpeg instrumented "-fprofile-generate=$PROFILE_RAW_DIR"
+
+echo "Decoding corpus..."
+timeCorpus "$PGO_BUILD_DIR/instrumented/ffmpeg" > /dev/null
+
+echo "Running the instrumented cores..."
+runHostCores instrumented "-fprofile-generate=$PROFILE_RAW_DIR"
+
+mkdir -p "$(dirname "$PGO_PROFILE")"
+"$LLVM_PROFDATA" merge -output="$PGO_PROFILE" "$PROFILE_RAW_DIR"/*.profraw
+echo "Wrote $PGO_PROFILE"
+
+echo "Measuring..."
+buildHostFfmpeg baseline ""
+buildHostFfmpeg optimized "-fprofile-use=$PGO_PROFILE -Wno-profile-instr-unprofiled"
+timeCorpus "$PGO_BUILD_DIR/baseline/ffmpeg" > "$PGO_BUILD_DIR/baseline.txt"
+timeCorpus "$PGO_BUILD_DIR/optimized/ffmpeg" > "$PGO_BUILD_DIR/optimized.txt"
+
+printf "%-12s %10s %10s %8s\n" codec "-O3 (s)" "PGO (s)" speedup
+join "$PGO_BUILD_DIR/baseline.txt" "$PGO_BUILD_DIR/optimized.txt" |
+  awk '{ printf "%-12s %10.3f %10.3f %7.2fx\n", $1, $2, $3, ($3 > 0 ? $2 / $3 : 0) }'
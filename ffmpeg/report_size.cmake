@@ -0,0 +1,20 @@
+# Reports the size of a JNI library and, with the shared FFmpeg layout, of the FFmpeg libraries
+# it loads, as a single number to compare against the NEXTLIB_FFMPEG_STATIC layout. Sizes are
+# taken before the Android Gradle plugin strips the libraries, so compare release builds.
+#
+# Usage: cmake -DLIBRARY=<path to .so> [-DFFMPEG_LIBS=<libavcodec.so>|<libavutil.so>|...] -P report_size.cmake
+
+file(SIZE ${LIBRARY} library_size)
+set(total_size ${library_size})
+set(details "")
+
+string(REPLACE "|" ";" ffmpeg_shared_libs "${FFMPEG_LIBS}")
+foreach (ffmpeg_shared_lib ${ffmpeg_shared_libs})
+    file(SIZE ${ffmpeg_shared_lib} size)
+    math(EXPR total_size "${total_size} + ${size}")
+    get_filename_component(name ${ffmpeg_shared_lib} NAME)
+    string(APPEND details " + ${name} ${size}")
+endforeach ()
+
+get_filename_component(library_name ${LIBRARY} NAME)
+message(STATUS "${library_name}: ${total_size} bytes (${library_name} ${library_size}${details})")
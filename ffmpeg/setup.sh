@@ -4,6 +4,11 @@
 VPX_VERSION=1.13.0
 MBEDTLS_VERSION=3.4.1
 FFMPEG_VERSION=6.0
+DAV1D_VERSION=1.2.1
+FREETYPE_VERSION=2.13.2
+FRIBIDI_VERSION=1.0.13
+HARFBUZZ_VERSION=8.3.0
+LIBASS_VERSION=0.17.3
 
 # Directories
 BASE_DIR=$(cd "$(dirname "$0")" && pwd)
@@ -13,11 +18,21 @@ SOURCES_DIR=$BASE_DIR/sources
 FFMPEG_DIR=$SOURCES_DIR/ffmpeg-$FFMPEG_VERSION
 VPX_DIR=$SOURCES_DIR/libvpx-$VPX_VERSION
 MBEDTLS_DIR=$SOURCES_DIR/mbedtls-$MBEDTLS_VERSION
+DAV1D_DIR=$SOURCES_DIR/dav1d-$DAV1D_VERSION
+FREETYPE_DIR=$SOURCES_DIR/freetype-$FREETYPE_VERSION
+FRIBIDI_DIR=$SOURCES_DIR/fribidi-$FRIBIDI_VERSION
+HARFBUZZ_DIR=$SOURCES_DIR/harfbuzz-$HARFBUZZ_VERSION
+LIBASS_DIR=$SOURCES_DIR/libass-$LIBASS_VERSION
 
 # Configuration
 ANDROID_ABIS="x86 x86_64 armeabi-v7a arm64-v8a"
 ANDROID_PLATFORM=21
-ENABLED_DECODERS="vorbis opus flac alac pcm_mulaw pcm_alaw mp3 amrnb amrwb aac ac3 eac3 dca mlp truehd h264 hevc mpeg2video mpegvideo libvpx_vp8 libvpx_vp9"
+ENABLED_DECODERS="vorbis opus flac alac pcm_mulaw pcm_alaw mp3 amrnb amrwb aac ac3 eac3 dca mlp truehd h264 hevc mpeg2video mpegvideo vp8 vp9 libvpx_vp8 libvpx_vp9 libdav1d pgssub dvbsub dvdsub"
+# Set to 0 to build x86 and x86_64 without SIMD assembly, which avoids the nasm dependency.
+X86_ASM=${X86_ASM:-1}
+# Profile written by pgo.sh. FFmpeg is built with it when it exists, unless FFMPEG_PGO=0.
+PGO_PROFILE=$BASE_DIR/pgo/ffmpeg.profdata
+FFMPEG_PGO=${FFMPEG_PGO:-1}
 JOBS=$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || sysctl -n hw.pysicalcpu || echo 4)
 
 # Set up host platform variables
@@ -54,6 +69,18 @@ else
   fi
 fi
 
+if [[ "$X86_ASM" == 1 ]] && ! command -v nasm &> /dev/null; then
+  echo "Error: nasm is required for the x86 and x86_64 assembly. Install it or set X86_ASM=0."
+  exit 1
+fi
+
+for tool in meson ninja; do
+  if ! command -v $tool &> /dev/null; then
+    echo "Error: $tool is required to build dav1d and libass."
+    exit 1
+  fi
+done
+
 mkdir -p $SOURCES_DIR
 
 function downloadLibVpx() {
@@ -78,6 +105,41 @@ function downloadMbedTLS() {
   popd
 }
 
+function downloadDav1d() {
+  pushd $SOURCES_DIR
+  echo "Downloading dav1d source code of version $DAV1D_VERSION..."
+  DAV1D_FILE=dav1d-$DAV1D_VERSION.tar.gz
+  curl -L "https://code.videolan.org/videolan/dav1d/-/archive/${DAV1D_VERSION}/dav1d-${DAV1D_VERSION}.tar.gz" -o $DAV1D_FILE
+  [ -e $DAV1D_FILE ] || { echo "$DAV1D_FILE does not exist. Exiting..."; exit 1; }
+  tar -zxf $DAV1D_FILE
+  rm $DAV1D_FILE
+  popd
+}
+
+# Downloads and unpacks a .tar.xz release into the sources directory.
+function downloadTarXz() {
+  local NAME=$1
+  local URL=$2
+  pushd $SOURCES_DIR
+  echo "Downloading $NAME source code..."
+  curl -L "$URL" -o "$NAME.tar.xz"
+  [ -e "$NAME.tar.xz" ] || { echo "$NAME.tar.xz does not exist. Exiting..."; exit 1; }
+  tar -xf "$NAME.tar.xz"
+  rm "$NAME.tar.xz"
+  popd
+}
+
+function downloadLibass() {
+  [[ -d "$FREETYPE_DIR" ]] || downloadTarXz freetype-$FREETYPE_VERSION \
+    "https://download.savannah.gnu.org/releases/freetype/freetype-${FREETYPE_VERSION}.tar.xz"
+  [[ -d "$FRIBIDI_DIR" ]] || downloadTarXz fribidi-$FRIBIDI_VERSION \
+    "https://github.com/fribidi/fribidi/releases/download/v${FRIBIDI_VERSION}/fribidi-${FRIBIDI_VERSION}.tar.xz"
+  [[ -d "$HARFBUZZ_DIR" ]] || downloadTarXz harfbuzz-$HARFBUZZ_VERSION \
+    "https://github.com/harfbuzz/harfbuzz/releases/download/${HARFBUZZ_VERSION}/harfbuzz-${HARFBUZZ_VERSION}.tar.xz"
+  [[ -d "$LIBASS_DIR" ]] || downloadTarXz libass-$LIBASS_VERSION \
+    "https://github.com/libass/libass/releases/download/${LIBASS_VERSION}/libass-${LIBASS_VERSION}.tar.xz"
+}
+
 function downloadFfmpeg() {
   pushd $SOURCES_DIR
   echo "Downloading FFmpeg source code of version $FFMPEG_VERSION..."
@@ -89,29 +151,39 @@ function downloadFfmpeg() {
   popd
 }
 
+# libvpx picks the best SIMD version of each function at runtime, so one build covers every
+# x86 CPU. The assembly is position independent with --enable-pic.
+function vpxX86AsmFlags() {
+  if [[ "$X86_ASM" == 1 ]]; then
+    echo "--as=nasm --enable-runtime-cpu-detect"
+  else
+    echo "--disable-sse2 --disable-sse3 --disable-ssse3 --disable-sse4_1 --disable-avx --disable-avx2 --disable-runtime-cpu-detect"
+  fi
+}
+
 function buildLibVpx() {
   pushd $VPX_DIR
 
-  VPX_AS=${TOOLCHAIN_PREFIX}/bin/llvm-as
   for ABI in $ANDROID_ABIS; do
+    VPX_AS=${TOOLCHAIN_PREFIX}/bin/llvm-as
     # Set up environment variables
     case $ABI in
     armeabi-v7a)
-      EXTRA_BUILD_FLAGS="--force-target=armv7-android-gcc --disable-neon"
+      EXTRA_BUILD_FLAGS="--force-target=armv7-android-gcc --disable-neon --disable-runtime-cpu-detect"
       TOOLCHAIN=armv7a-linux-androideabi21-
       ;;
     arm64-v8a)
-      EXTRA_BUILD_FLAGS="--force-target=armv8-android-gcc"
+      EXTRA_BUILD_FLAGS="--force-target=armv8-android-gcc --disable-runtime-cpu-detect"
       TOOLCHAIN=aarch64-linux-android21-
       ;;
     x86)
-      EXTRA_BUILD_FLAGS="--force-target=x86-android-gcc --disable-sse2 --disable-sse3 --disable-ssse3 --disable-sse4_1 --disable-avx --disable-avx2 --enable-pic"
-      VPX_AS=${TOOLCHAIN_PREFIX}/bin/yasm
+      EXTRA_BUILD_FLAGS="--force-target=x86-android-gcc --enable-pic $(vpxX86AsmFlags)"
+      [[ "$X86_ASM" == 1 ]] && VPX_AS=nasm || VPX_AS=${TOOLCHAIN_PREFIX}/bin/yasm
       TOOLCHAIN=i686-linux-android21-
       ;;
     x86_64)
-      EXTRA_BUILD_FLAGS="--force-target=x86_64-android-gcc --disable-sse2 --disable-sse3 --disable-ssse3 --disable-sse4_1 --disable-avx --disable-avx2 --enable-pic --disable-neon --disable-neon-asm"
-      VPX_AS=${TOOLCHAIN_PREFIX}/bin/yasm
+      EXTRA_BUILD_FLAGS="--force-target=x86_64-android-gcc --enable-pic --disable-neon --disable-neon-asm $(vpxX86AsmFlags)"
+      [[ "$X86_ASM" == 1 ]] && VPX_AS=nasm || VPX_AS=${TOOLCHAIN_PREFIX}/bin/yasm
       TOOLCHAIN=x86_64-linux-android21-
       ;;
     *)
@@ -143,7 +215,6 @@ function buildLibVpx() {
       --disable-webm-io \
       --disable-libyuv \
       --enable-better-hw-compatibility \
-      --disable-runtime-cpu-detect \
       ${EXTRA_BUILD_FLAGS}
 
     make clean
@@ -178,11 +249,149 @@ function buildMbedTLS() {
     popd
 }
 
+# Cross compiles the meson project in [source dir] for every ABI into the external prefix, as a
+# static PIC library so that it can end up inside a shared library. [options function] is called
+# with the ABI and whether assembly may be used for it, and prints the project's meson options.
+function buildMesonLibrary() {
+  local SOURCE_DIR=$1
+  local OPTIONS_FUNCTION=$2
+  pushd $SOURCE_DIR
+
+  for ABI in $ANDROID_ABIS; do
+    ABI_ASM=true
+    case $ABI in
+    armeabi-v7a)
+      TOOLCHAIN=armv7a-linux-androideabi21-
+      CPU_FAMILY=arm
+      CPU=armv7
+      ;;
+    arm64-v8a)
+      TOOLCHAIN=aarch64-linux-android21-
+      CPU_FAMILY=aarch64
+      CPU=armv8
+      ;;
+    x86)
+      TOOLCHAIN=i686-linux-android21-
+      CPU_FAMILY=x86
+      CPU=i686
+      [[ "$X86_ASM" == 1 ]] || ABI_ASM=false
+      ;;
+    x86_64)
+      TOOLCHAIN=x86_64-linux-android21-
+      CPU_FAMILY=x86_64
+      CPU=x86_64
+      [[ "$X86_ASM" == 1 ]] || ABI_ASM=false
+      ;;
+    *)
+      echo "Unsupported architecture: $ABI"
+      exit 1
+      ;;
+    esac
+
+    MESON_BUILD_DIR=$SOURCE_DIR/meson_build_${ABI}
+    rm -rf ${MESON_BUILD_DIR}
+    mkdir -p ${MESON_BUILD_DIR}
+    CROSS_FILE=${MESON_BUILD_DIR}/cross.txt
+    # Dependencies built earlier are found through the external prefix only.
+    cat > ${CROSS_FILE} <<EOF
+[binaries]
+c = '${TOOLCHAIN_PREFIX}/bin/${TOOLCHAIN}clang'
+cpp = '${TOOLCHAIN_PREFIX}/bin/${TOOLCHAIN}clang++'
+ar = '${TOOLCHAIN_PREFIX}/bin/llvm-ar'
+strip = '${TOOLCHAIN_PREFIX}/bin/llvm-strip'
+nasm = 'nasm'
+pkg-config = '$(which pkg-config)'
+
+[properties]
+pkg_config_libdir = '$BUILD_DIR/external/$ABI/lib/pkgconfig'
+
+[host_machine]
+system = 'android'
+cpu_family = '${CPU_FAMILY}'
+cpu = '${CPU}'
+endian = 'little'
+EOF
+
+    meson setup ${MESON_BUILD_DIR} \
+      --cross-file=${CROSS_FILE} \
+      --prefix=$BUILD_DIR/external/$ABI \
+      --libdir=lib \
+      --buildtype=release \
+      --default-library=static \
+      -Db_staticpic=true \
+      $($OPTIONS_FUNCTION $ABI $ABI_ASM)
+
+    ninja -C ${MESON_BUILD_DIR} -j$JOBS
+    ninja -C ${MESON_BUILD_DIR} install
+  done
+  popd
+}
+
+# dav1d ends up inside libavcodec like libvpx.
+function dav1dOptions() {
+  echo "-Denable_asm=$2 -Denable_tools=false -Denable_tests=false"
+}
+
+function buildDav1d() {
+  buildMesonLibrary $DAV1D_DIR dav1dOptions
+}
+
+# FreeType without HarfBuzz, which in turn is built on top of it.
+function freetypeOptions() {
+  echo "-Dharfbuzz=disabled -Dpng=disabled -Dbzip2=disabled -Dbrotli=disabled -Dzlib=internal"
+}
+
+function fribidiOptions() {
+  echo "-Ddocs=false -Dbin=false -Dtests=false"
+}
+
+function harfbuzzOptions() {
+  echo "-Dfreetype=enabled -Dglib=disabled -Dgobject=disabled -Dcairo=disabled -Dicu=disabled" \
+    "-Dtests=disabled -Ddocs=disabled -Dutilities=disabled -Dintrospection=disabled"
+}
+
+# Android has no fontconfig; fonts come from the media, the app and /system/fonts. libass only
+# has assembly for x86 and arm64.
+function libassOptions() {
+  local ASM=enabled
+  [[ "$2" == true && "$1" != armeabi-v7a ]] || ASM=disabled
+  echo "-Dfontconfig=disabled -Drequire-system-font-provider=false -Dlibunibreak=disabled -Dasm=$ASM"
+}
+
+# libass and what it shapes and rasterizes text with, for the ASS/SSA renderer in media3ext.
+function buildLibass() {
+  buildMesonLibrary $FREETYPE_DIR freetypeOptions
+  buildMesonLibrary $FRIBIDI_DIR fribidiOptions
+  buildMesonLibrary $HARFBUZZ_DIR harfbuzzOptions
+  buildMesonLibrary $LIBASS_DIR libassOptions
+}
+
+# FFmpeg always detects the CPU at runtime. On i686 only its external nasm code is PIC-safe; the
+# inline asm would need text relocations there, which Android refuses to load. x86_64 inline asm
+# is RIP-relative and stays enabled.
+function ffmpegX86AsmFlags() {
+  local ABI=$1
+  if [[ "$X86_ASM" != 1 ]]; then
+    echo "--disable-asm"
+  elif [[ "$ABI" == x86 ]]; then
+    echo "--enable-pic --x86asmexe=nasm --disable-inline-asm"
+  else
+    echo "--enable-pic --x86asmexe=nasm"
+  fi
+}
+
 function buildFfmpeg() {
   pushd $FFMPEG_DIR
-  EXTRA_BUILD_CONFIGURATION_FLAGS=""
   COMMON_OPTIONS=""
 
+  # The profile comes from an x86_64 host build. Functions whose code differs per ABI no longer
+  # match it and are simply compiled without profile data.
+  PGO_CFLAGS=""
+  if [[ "$FFMPEG_PGO" == 1 && -f "$PGO_PROFILE" ]]; then
+    echo "Using FFmpeg profile $PGO_PROFILE"
+    PGO_CFLAGS="-fprofile-use=$PGO_PROFILE -Wno-profile-instr-out-of-date -Wno-profile-instr-unprofiled"
+  fi
+
   # Add enabled decoders to FFmpeg build configuration
   for decoder in $ENABLED_DECODERS; do
     COMMON_OPTIONS="${COMMON_OPTIONS} --enable-decoder=${decoder}"
@@ -190,6 +399,7 @@ function buildFfmpeg() {
 
   # Build FFmpeg for each architecture and platform
   for ABI in $ANDROID_ABIS; do
+    EXTRA_BUILD_CONFIGURATION_FLAGS=""
 
     # Set up environment variables
     case $ABI in
@@ -207,12 +417,13 @@ function buildFfmpeg() {
       TOOLCHAIN=i686-linux-android21-
       CPU=i686
       ARCH=i686
-      EXTRA_BUILD_CONFIGURATION_FLAGS=--disable-asm
+      EXTRA_BUILD_CONFIGURATION_FLAGS=$(ffmpegX86AsmFlags $ABI)
       ;;
     x86_64)
       TOOLCHAIN=x86_64-linux-android21-
       CPU=x86_64
       ARCH=x86_64
+      EXTRA_BUILD_CONFIGURATION_FLAGS=$(ffmpegX86AsmFlags $ABI)
       ;;
     *)
       echo "Unsupported architecture: $ABI"
@@ -224,7 +435,8 @@ function buildFfmpeg() {
     DEP_CFLAGS="-I$BUILD_DIR/external/$ABI/include"
     DEP_LD_FLAGS="-L$BUILD_DIR/external/$ABI/lib"
 
-    # Configure FFmpeg build
+    # Configure FFmpeg build. libdav1d is only found through pkg-config.
+    PKG_CONFIG_LIBDIR="$BUILD_DIR/external/$ABI/lib/pkgconfig" \
     ./configure \
       --prefix=$BUILD_DIR/$ABI \
       --enable-cross-compile \
@@ -235,12 +447,13 @@ function buildFfmpeg() {
       --ar="${TOOLCHAIN_PREFIX}/bin/llvm-ar" \
       --ranlib="${TOOLCHAIN_PREFIX}/bin/llvm-ranlib" \
       --strip="${TOOLCHAIN_PREFIX}/bin/llvm-strip" \
-      --extra-cflags="-O3 -fPIC $DEP_CFLAGS" \
+      --extra-cflags="-O3 -fPIC -ffunction-sections -fdata-sections $PGO_CFLAGS $DEP_CFLAGS" \
       --extra-ldflags="$DEP_LD_FLAGS -Wl,-z,max-page-size=16384" \
       --pkg-config="$(which pkg-config)" \
+      --pkg-config-flags="--static" \
       --target-os=android \
       --enable-shared \
-      --disable-static \
+      --enable-static \
       --disable-doc \
       --disable-programs \
       --disable-everything \
@@ -255,6 +468,7 @@ function buildFfmpeg() {
       --enable-swresample \
       --enable-avformat \
       --enable-libvpx \
+      --enable-libdav1d \
       --enable-protocol=file,http,https,mmsh,mmst,pipe,rtmp,rtmps,rtmpt,rtmpts,rtp,tls \
       --enable-version3 \
       --enable-mbedtls \
@@ -273,9 +487,15 @@ function buildFfmpeg() {
     mkdir -p "${OUTPUT_LIB}"
     cp "${BUILD_DIR}"/"${ABI}"/lib/*.so "${OUTPUT_LIB}"
 
+    # Archives for the NEXTLIB_FFMPEG_STATIC build mode, with the libraries FFmpeg depends on.
+    mkdir -p "${OUTPUT_LIB}/static"
+    cp "${BUILD_DIR}"/"${ABI}"/lib/*.a "${OUTPUT_LIB}/static"
+    cp "${BUILD_DIR}"/external/"${ABI}"/lib/*.a "${OUTPUT_LIB}/static"
+
     OUTPUT_HEADERS=${OUTPUT_DIR}/include/${ABI}
     mkdir -p "${OUTPUT_HEADERS}"
     cp -r "${BUILD_DIR}"/"${ABI}"/include/* "${OUTPUT_HEADERS}"
+    cp -r "${BUILD_DIR}"/external/"${ABI}"/include/ass "${OUTPUT_HEADERS}"
 
   done
   popd
@@ -292,6 +512,14 @@ if [[ ! -d "$OUTPUT_DIR" && ! -d "$BUILD_DIR" ]]; then
     downloadLibVpx
   fi
 
+  # Download dav1d source code if it doesn't exist
+  if [[ ! -d "$DAV1D_DIR" ]]; then
+    downloadDav1d
+  fi
+
+  # Download libass and its dependencies if they don't exist
+  downloadLibass
+
   # Download Ffmpeg source code if it doesn't exist
   if [[ ! -d "$FFMPEG_DIR" ]]; then
     downloadFfmpeg
@@ -300,5 +528,7 @@ if [[ ! -d "$OUTPUT_DIR" && ! -d "$BUILD_DIR" ]]; then
   # Building library
   buildMbedTLS
   buildLibVpx
+  buildDav1d
+  buildLibass
   buildFfmpeg
 fi
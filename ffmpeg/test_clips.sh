@@ -0,0 +1,78 @@
+#!/bin/bash
+
+# Generates the clips decoded by the host tests and benchmarks of the native cores, from FFmpeg's
+# synthetic sources, so that no media has to be checked in. A clip whose encoder the ffmpeg
+# program lacks is left out, and the tests and benchmarks that need it skip it.
+#
+# Writes clips.stamp, listing the generated clips, once all of them are done.
+#
+# Usage: ./test_clips.sh <output dir> [ffmpeg program]
+
+set -e
+
+OUT_DIR=$1
+FFMPEG=${2:-ffmpeg}
+if [[ -z "$OUT_DIR" ]]; then
+  echo "Usage: $0 <output dir> [ffmpeg program]"
+  exit 1
+fi
+mkdir -p "$OUT_DIR"
+STAMP=$OUT_DIR/clips.stamp
+
+if ! command -v "$FFMPEG" > /dev/null; then
+  echo "Warning: no ffmpeg program, the host tests and benchmarks run without clips"
+  : > "$STAMP"
+  exit 0
+fi
+ENCODERS=$("$FFMPEG" -hide_banner -encoders 2>/dev/null)
+
+# Writes [name] from [seconds] of test pattern at [size] and a sine tone, encoded with the
+# remaining arguments, unless the clip exists or one of the [encoders] (comma separated) is missing.
+function makeClip() {
+  local NAME=$1
+  local SIZE=$2
+  local SECONDS=$3
+  local REQUIRED=$4
+  shift 4
+  if [[ -s "$OUT_DIR/$NAME" ]]; then
+    echo "$NAME" >> "$STAMP.partial"
+    return
+  fi
+  for ENCODER in ${REQUIRED//,/ }; do
+    if ! grep -q " $ENCODER " <<< "$ENCODERS"; then
+      echo "Skipping $NAME: ffmpeg has no $ENCODER encoder"
+      return
+    fi
+  done
+  # The extension stays last, so the muxer is still picked from it.
+  "$FFMPEG" -nostdin -hide_banner -loglevel error -y \
+    -f lavfi -i "testsrc2=size=$SIZE:rate=30:duration=$SECONDS" \
+    -f lavfi -i "sine=frequency=440:sample_rate=48000:duration=$SECONDS" \
+    -pix_fmt yuv420p "$@" "$OUT_DIR/partial.$NAME"
+  mv "$OUT_DIR/partial.$NAME" "$OUT_DIR/$NAME"
+  echo "$NAME" >> "$STAMP.partial"
+}
+
+rm -f "$STAMP" "$STAMP.partial"
+
+# Probing and I/O: common containers, and a longer file for the read path to matter.
+makeClip h264_720p.mp4 1280x720 2 libx264,aac -c:v libx264 -preset veryfast -c:a aac
+makeClip h264_1080p.mkv 1920x1080 2 libx264,aac -c:v libx264 -preset veryfast -c:a aac
+makeClip mpeg2_720p.ts 1280x720 2 mpeg2video,mp2 -c:v mpeg2video -q:v 4 -c:a mp2
+makeClip h264_360p_long.mkv 640x360 60 libx264,aac -c:v libx264 -preset veryfast -crf 30 -c:a aac
+
+# Decoding, per codec and resolution class.
+makeClip hevc_1080p.mp4 1920x1080 2 libx265 -c:v libx265 -preset ultrafast -x265-params log-level=error -an
+makeClip vp8_720p.webm 1280x720 2 libvpx,libopus -c:v libvpx -deadline realtime -cpu-used 8 -c:a libopus
+makeClip vp9_1080p.webm 1920x1080 2 libvpx-vp9,libopus \
+  -c:v libvpx-vp9 -deadline realtime -cpu-used 8 -row-mt 1 -tile-columns 2 -c:a libopus
+makeClip vp9_2160p.webm 3840x2160 1 libvpx-vp9 \
+  -c:v libvpx-vp9 -deadline realtime -cpu-used 8 -row-mt 1 -tile-columns 2 -an
+makeClip av1_1080p.mkv 1920x1080 1 libaom-av1 \
+  -c:v libaom-av1 -usage realtime -cpu-used 8 -row-mt 1 -tiles 2x2 -an
+
+# Audio only, for decodePacket.
+makeClip aac_stereo.m4a 16x16 10 aac -vn -c:a aac
+makeClip mp3_stereo.mp3 16x16 10 libmp3lame -vn -c:a libmp3lame
+
+mv "$STAMP.partial" "$STAMP"
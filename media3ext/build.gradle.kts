@@ -18,6 +18,11 @@ android {
         externalNativeBuild {
             cmake {
                 cppFlags("")
+                arguments(
+                    "-DNEXTLIB_TRACE=${findProperty("nextlib.nativeTrace") ?: "OFF"}",
+                    "-DNEXTLIB_FFMPEG_STATIC=${findProperty("nextlib.staticFfmpeg") ?: "OFF"}",
+                    "-DNEXTLIB_PGO=${findProperty("nextlib.pgo") ?: "ON"}"
+                )
             }
         }
 
@@ -0,0 +1,524 @@
+#include <jni.h>
+#include <android/bitmap.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "ffcommon.h"
+
+extern "C" {
+#include <ass/ass.h>
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+}
+
+// Layout of the int[] assRender fills in, mirrored in FfmpegAssRenderer.java.
+static const int ASS_MAX_REGIONS = 16;
+// x, y, width, height, and the index of the identical region of the previous render or -1.
+static const int ASS_REGION_SIZE = 5;
+static const int ASS_RENDER_UNCHANGED = -1;
+
+// Images closer than this go into the same region, so that a line of karaoke syllables becomes
+// one bitmap rather than one per syllable.
+static const int REGION_MERGE_DISTANCE = 16;
+// Megabytes of rendered glyph bitmaps libass keeps between frames.
+static const int BITMAP_CACHE_SIZE_MB = 32;
+
+// Fallback for text whose font is neither attached nor added by the app.
+static const char *const DEFAULT_FONTS[] = {
+        "/system/fonts/Roboto-Regular.ttf",
+        "/system/fonts/DroidSans.ttf",
+};
+
+/**
+ * A rectangle of the rendered frame and its premultiplied RGBA pixels.
+ */
+struct AssRegion {
+    SubtitleRegion rect;
+    std::vector<uint32_t> pixels;
+};
+
+/**
+ * Native state behind an FfmpegAssRenderer handle. The library and renderer, and with them the
+ * font, glyph and bitmap caches, live as long as the handle; tracks come and go with streams.
+ */
+struct AssContext {
+    ASS_Library *library{};
+    ASS_Renderer *renderer{};
+    ASS_Track *track{};
+    bool fontsChanged = true;
+    // Size of the frame scripts are laid out on, and of the video's decoded pictures, 0 while unknown.
+    int frameWidth = 0;
+    int frameHeight = 0;
+    int storageWidth = 0;
+    int storageHeight = 0;
+    // Regions of the last render, which the Java side holds bitmaps of.
+    std::vector<AssRegion> regions;
+    // Pixel buffers of earlier regions, kept to avoid reallocating them every frame.
+    std::vector<std::vector<uint32_t>> spareBuffers;
+};
+
+static void logAssMessage(int level, const char *format, va_list args, void *data) {
+    // Levels above 2 are warnings and debug output.
+    if (level > 2) {
+        return;
+    }
+    char message[256];
+    vsnprintf(message, sizeof(message), format, args);
+    LOGE("libass: %s", message);
+}
+
+/**
+ * Tells libass how wide a pixel of the video is on the frame, so that text keeps its shape on
+ * anamorphic video. The frame is taken as the video's display size, as libass expects; pixels are
+ * square until the video's size is known.
+ */
+static void updatePixelAspect(AssContext *context) {
+    double pixelAspect = 1;
+    if (context->storageWidth > 0 && context->storageHeight > 0) {
+        pixelAspect = ((double) context->frameWidth / context->frameHeight)
+                      / ((double) context->storageWidth / context->storageHeight);
+    }
+    ass_set_pixel_aspect(context->renderer, pixelAspect);
+}
+
+static void releaseAssContext(AssContext *context) {
+    if (!context) {
+        return;
+    }
+    if (context->track) {
+        ass_free_track(context->track);
+    }
+    if (context->renderer) {
+        ass_renderer_done(context->renderer);
+    }
+    if (context->library) {
+        ass_library_done(context->library);
+    }
+    delete context;
+}
+
+static bool isNear(const SubtitleRegion &a, const SubtitleRegion &b) {
+    return a.x - REGION_MERGE_DISTANCE < b.x + b.width && b.x - REGION_MERGE_DISTANCE < a.x + a.width &&
+           a.y - REGION_MERGE_DISTANCE < b.y + b.height && b.y - REGION_MERGE_DISTANCE < a.y + a.height;
+}
+
+static SubtitleRegion unionOf(const SubtitleRegion &a, const SubtitleRegion &b) {
+    int left = std::min(a.x, b.x);
+    int top = std::min(a.y, b.y);
+    int right = std::max(a.x + a.width, b.x + b.width);
+    int bottom = std::max(a.y + a.height, b.y + b.height);
+    return {left, top, right - left, bottom - top};
+}
+
+/**
+ * Groups the images into disjoint regions, each the bounds of images that are near each other.
+ */
+static std::vector<SubtitleRegion> groupImages(const ASS_Image *images) {
+    std::vector<SubtitleRegion> rects;
+    for (const ASS_Image *image = images; image; image = image->next) {
+        if (image->w > 0 && image->h > 0) {
+            rects.push_back({image->dst_x, image->dst_y, image->w, image->h});
+        }
+    }
+    // Merging two regions can bring the result near a third one, so repeat until stable.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; i++) {
+            for (size_t j = i + 1; j < rects.size(); j++) {
+                if (isNear(rects[i], rects[j])) {
+                    rects[i] = unionOf(rects[i], rects[j]);
+                    rects.erase(rects.begin() + (long) j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+    if (rects.size() > (size_t) ASS_MAX_REGIONS) {
+        SubtitleRegion all = rects[0];
+        for (const SubtitleRegion &rect: rects) {
+            all = unionOf(all, rect);
+        }
+        rects.assign(1, all);
+    }
+    return rects;
+}
+
+/**
+ * Blends the alpha mask of the image, in its color, over the region.
+ */
+static void blendImage(const ASS_Image *image, AssRegion &region) {
+    uint32_t color = image->color;
+    // The low byte is transparency, not opacity.
+    uint32_t opacity = 255 - (color & 0xff);
+    if (!opacity) {
+        return;
+    }
+    uint32_t r = color >> 24;
+    uint32_t g = (color >> 16) & 0xff;
+    uint32_t b = (color >> 8) & 0xff;
+
+    const SubtitleRegion &rect = region.rect;
+    for (int y = 0; y < image->h; y++) {
+        const uint8_t *mask = image->bitmap + (size_t) y * image->stride;
+        uint32_t *row = &region.pixels[(size_t) (image->dst_y - rect.y + y) * rect.width +
+                                       (image->dst_x - rect.x)];
+        for (int x = 0; x < image->w; x++) {
+            uint32_t alpha = (mask[x] * opacity + 127) / 255;
+            if (!alpha) {
+                continue;
+            }
+            uint32_t inverse = 255 - alpha;
+            uint32_t pixel = row[x];
+            uint32_t dr = (r * alpha + (pixel & 0xff) * inverse + 127) / 255;
+            uint32_t dg = (g * alpha + ((pixel >> 8) & 0xff) * inverse + 127) / 255;
+            uint32_t db = (b * alpha + ((pixel >> 16) & 0xff) * inverse + 127) / 255;
+            uint32_t da = alpha + ((pixel >> 24) * inverse + 127) / 255;
+            row[x] = (da << 24) | (db << 16) | (dg << 8) | dr;
+        }
+    }
+}
+
+static bool isInside(const ASS_Image *image, const SubtitleRegion &rect) {
+    return image->dst_x >= rect.x && image->dst_y >= rect.y &&
+           image->dst_x + image->w <= rect.x + rect.width &&
+           image->dst_y + image->h <= rect.y + rect.height;
+}
+
+static void applyFonts(AssContext *context) {
+    const char *defaultFont = nullptr;
+    for (const char *font: DEFAULT_FONTS) {
+        if (access(font, R_OK) == 0) {
+            defaultFont = font;
+            break;
+        }
+    }
+    // Rebuilding the font selection is what makes fonts added since the last call visible.
+    ass_set_fonts(context->renderer, defaultFont, "sans-serif", ASS_FONTPROVIDER_NONE, nullptr, 0);
+    context->fontsChanged = false;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assInitialize(JNIEnv *env,
+                                                                             jobject thiz,
+                                                                             jint width,
+                                                                             jint height) {
+    auto *context = new AssContext();
+    context->library = ass_library_init();
+    if (!context->library) {
+        LOGE("Failed to initialize libass.");
+        releaseAssContext(context);
+        return 0L;
+    }
+    ass_set_message_cb(context->library, logAssMessage, nullptr);
+    // Fonts embedded in the [Fonts] section of a script.
+    ass_set_extract_fonts(context->library, 1);
+
+    context->renderer = ass_renderer_init(context->library);
+    if (!context->renderer) {
+        LOGE("Failed to initialize the libass renderer.");
+        releaseAssContext(context);
+        return 0L;
+    }
+    context->frameWidth = width;
+    context->frameHeight = height;
+    ass_set_frame_size(context->renderer, width, height);
+    updatePixelAspect(context);
+    ass_set_cache_limits(context->renderer, 0, BITMAP_CACHE_SIZE_MB);
+    return (jlong) context;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assAddFont(JNIEnv *env,
+                                                                          jobject thiz,
+                                                                          jlong jContext,
+                                                                          jstring name,
+                                                                          jbyteArray data) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    const char *nameChars = env->GetStringUTFChars(name, nullptr);
+    jsize size = env->GetArrayLength(data);
+    jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+    // libass keeps its own copy.
+    ass_add_font(context->library, nameChars, reinterpret_cast<char *>(bytes), size);
+    env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+    env->ReleaseStringUTFChars(name, nameChars);
+    context->fontsChanged = true;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assNewTrack(JNIEnv *env,
+                                                                           jobject thiz,
+                                                                           jlong jContext,
+                                                                           jbyteArray header) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    if (context->track) {
+        ass_free_track(context->track);
+    }
+    context->regions.clear();
+    context->track = ass_new_track(context->library);
+    if (!context->track) {
+        LOGE("Failed to create an ASS track.");
+        return false;
+    }
+    if (header) {
+        jsize size = env->GetArrayLength(header);
+        jbyte *bytes = env->GetByteArrayElements(header, nullptr);
+        ass_process_codec_private(context->track, reinterpret_cast<char *>(bytes), size);
+        env->ReleaseByteArrayElements(header, bytes, JNI_ABORT);
+    }
+    return true;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assProcessChunk(JNIEnv *env,
+                                                                               jobject thiz,
+                                                                               jlong jContext,
+                                                                               jbyteArray data,
+                                                                               jint offset,
+                                                                               jint length,
+                                                                               jlong time_ms,
+                                                                               jlong duration_ms) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+    // Events are matched by ReadOrder, so chunks read again after a seek are not duplicated.
+    ass_process_chunk(context->track, reinterpret_cast<char *>(bytes + offset), length, time_ms,
+                      duration_ms);
+    env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assProcessData(JNIEnv *env,
+                                                                              jobject thiz,
+                                                                              jlong jContext,
+                                                                              jbyteArray data,
+                                                                              jint offset,
+                                                                              jint length) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+    ass_process_data(context->track, reinterpret_cast<char *>(bytes + offset), length);
+    env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assSetFrameSize(JNIEnv *env,
+                                                                               jobject thiz,
+                                                                               jlong jContext,
+                                                                               jint width,
+                                                                               jint height) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    context->frameWidth = width;
+    context->frameHeight = height;
+    ass_set_frame_size(context->renderer, width, height);
+    updatePixelAspect(context);
+    context->regions.clear();
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assSetStorageSize(JNIEnv *env,
+                                                                                 jobject thiz,
+                                                                                 jlong jContext,
+                                                                                 jint width,
+                                                                                 jint height) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    context->storageWidth = width;
+    context->storageHeight = height;
+    // Scales blur and borders of scripts authored against the video's resolution.
+    ass_set_storage_size(context->renderer, width, height);
+    updatePixelAspect(context);
+    context->regions.clear();
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assRender(JNIEnv *env,
+                                                                         jobject thiz,
+                                                                         jlong jContext,
+                                                                         jlong time_ms,
+                                                                         jboolean force,
+                                                                         jintArray result) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    if (!context->track) {
+        return 0;
+    }
+    if (context->fontsChanged) {
+        applyFonts(context);
+        force = true;
+    }
+
+    int change = 0;
+    ASS_Image *images;
+    {
+        TraceSection trace("ass.renderFrame");
+        images = ass_render_frame(context->renderer, context->track, time_ms, &change);
+    }
+    // The glyph and composite caches make an unchanged frame cheap; skipping it here also spares
+    // the blending and every bitmap copy.
+    if (change == 0 && !force) {
+        return ASS_RENDER_UNCHANGED;
+    }
+
+    TraceSection trace("ass.composite");
+    std::vector<SubtitleRegion> rects = groupImages(images);
+    std::vector<AssRegion> regions(rects.size());
+    for (size_t i = 0; i < rects.size(); i++) {
+        regions[i].rect = rects[i];
+        if (!context->spareBuffers.empty()) {
+            regions[i].pixels = std::move(context->spareBuffers.back());
+            context->spareBuffers.pop_back();
+        }
+        regions[i].pixels.assign((size_t) rects[i].width * rects[i].height, 0);
+    }
+    for (const ASS_Image *image = images; image; image = image->next) {
+        if (image->w <= 0 || image->h <= 0) {
+            continue;
+        }
+        for (AssRegion &region: regions) {
+            if (isInside(image, region.rect)) {
+                blendImage(image, region);
+                break;
+            }
+        }
+    }
+
+    jint out[ASS_MAX_REGIONS * ASS_REGION_SIZE];
+    for (size_t i = 0; i < regions.size(); i++) {
+        const SubtitleRegion &rect = regions[i].rect;
+        jint *regionOut = out + i * ASS_REGION_SIZE;
+        regionOut[0] = rect.x;
+        regionOut[1] = rect.y;
+        regionOut[2] = rect.width;
+        regionOut[3] = rect.height;
+        regionOut[4] = -1;
+        for (size_t j = 0; j < context->regions.size(); j++) {
+            const AssRegion &previous = context->regions[j];
+            if (previous.rect.x == rect.x && previous.rect.y == rect.y &&
+                previous.rect.width == rect.width && previous.rect.height == rect.height &&
+                previous.pixels == regions[i].pixels) {
+                regionOut[4] = (jint) j;
+                break;
+            }
+        }
+    }
+    for (AssRegion &previous: context->regions) {
+        context->spareBuffers.push_back(std::move(previous.pixels));
+    }
+    if (context->spareBuffers.size() > (size_t) ASS_MAX_REGIONS) {
+        context->spareBuffers.resize(ASS_MAX_REGIONS);
+    }
+    context->regions = std::move(regions);
+
+    env->SetIntArrayRegion(result, 0, (jsize) (context->regions.size() * ASS_REGION_SIZE), out);
+    return (jint) context->regions.size();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assCopyRegion(JNIEnv *env,
+                                                                             jobject thiz,
+                                                                             jlong jContext,
+                                                                             jint index,
+                                                                             jobject bitmap) {
+    auto *const context = reinterpret_cast<AssContext *>(jContext);
+    if (index < 0 || (size_t) index >= context->regions.size()) {
+        return false;
+    }
+    const AssRegion &region = context->regions[index];
+
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS ||
+        info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 ||
+        (int) info.width < region.rect.width || (int) info.height < region.rect.height) {
+        LOGE("Unexpected subtitle bitmap.");
+        return false;
+    }
+    void *pixels;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        LOGE("Failed to lock the subtitle bitmap.");
+        return false;
+    }
+    for (int row = 0; row < region.rect.height; row++) {
+        memcpy(static_cast<uint8_t *>(pixels) + (size_t) row * info.stride,
+               &region.pixels[(size_t) row * region.rect.width],
+               region.rect.width * sizeof(uint32_t));
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return true;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assRelease(JNIEnv *env,
+                                                                          jobject thiz,
+                                                                          jlong jContext) {
+    releaseAssContext(reinterpret_cast<AssContext *>(jContext));
+}
+
+/**
+ * Returns whether the attachment stream holds a TrueType or OpenType font.
+ */
+static bool isFontAttachment(const AVStream *stream) {
+    AVCodecID codecId = stream->codecpar->codec_id;
+    if (codecId == AV_CODEC_ID_TTF || codecId == AV_CODEC_ID_OTF) {
+        return true;
+    }
+    const AVDictionaryEntry *mimeType = av_dict_get(stream->metadata, "mimetype", nullptr, 0);
+    return mimeType && (strstr(mimeType->value, "font") || strstr(mimeType->value, "truetype") ||
+                        strstr(mimeType->value, "opentype"));
+}
+
+extern "C"
+JNIEXPORT jobjectArray JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAssRenderer_assReadAttachedFonts(JNIEnv *env,
+                                                                                    jclass clazz,
+                                                                                    jint fd) {
+    // Matroska keeps attachments in its header, so opening the file is enough to read them.
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    AVFormatContext *formatContext = nullptr;
+    int result = avformat_open_input(&formatContext, path, nullptr, nullptr);
+    if (result < 0) {
+        logError("avformat_open_input", result);
+        return nullptr;
+    }
+
+    std::vector<const AVStream *> fonts;
+    for (unsigned i = 0; i < formatContext->nb_streams; i++) {
+        const AVStream *stream = formatContext->streams[i];
+        if (stream->codecpar->codec_type == AVMEDIA_TYPE_ATTACHMENT &&
+            stream->codecpar->extradata_size > 0 && isFontAttachment(stream)) {
+            fonts.push_back(stream);
+        }
+    }
+
+    // Names and data, alternating.
+    jobjectArray array = env->NewObjectArray((jsize) fonts.size() * 2, env->FindClass("java/lang/Object"), nullptr);
+    for (size_t i = 0; array && i < fonts.size(); i++) {
+        const AVStream *stream = fonts[i];
+        const AVDictionaryEntry *fileName = av_dict_get(stream->metadata, "filename", nullptr, 0);
+        jstring name = env->NewStringUTF(fileName ? fileName->value : "");
+        jbyteArray data = env->NewByteArray(stream->codecpar->extradata_size);
+        if (!name || !data) {
+            array = nullptr;
+            break;
+        }
+        env->SetByteArrayRegion(data, 0, stream->codecpar->extradata_size,
+                                reinterpret_cast<const jbyte *>(stream->codecpar->extradata));
+        env->SetObjectArrayElement(array, (jsize) (i * 2), name);
+        env->SetObjectArrayElement(array, (jsize) (i * 2 + 1), data);
+        env->DeleteLocalRef(name);
+        env->DeleteLocalRef(data);
+    }
+    avformat_close_input(&formatContext);
+    return array;
+}
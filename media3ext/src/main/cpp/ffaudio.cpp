@@ -1,5 +1,4 @@
 
-#include <android/log.h>
 #include <jni.h>
 #include <cstdlib>
 #include <android/native_window_jni.h>
@@ -21,18 +20,22 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
-# define LOGD(...)  __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-
 // Output format corresponding to AudioFormat.ENCODING_PCM_16BIT.
 static const AVSampleFormat OUTPUT_FORMAT_PCM_16BIT = AV_SAMPLE_FMT_S16;
 // Output format corresponding to AudioFormat.ENCODING_PCM_FLOAT.
 static const AVSampleFormat OUTPUT_FORMAT_PCM_FLOAT = AV_SAMPLE_FMT_FLT;
 
-static const int AUDIO_DECODER_ERROR_INVALID_DATA = -1;
-static const int AUDIO_DECODER_ERROR_OTHER = -2;
-
 static jmethodID growOutputBufferMethod;
 
+/**
+ * Native state behind an FfmpegAudioDecoder handle. It outlives codec re-creation on reset, so
+ * the stats cover the whole lifetime of the decoder.
+ */
+struct AudioContext {
+    AVCodecContext *codecContext;
+    DecoderStats stats;
+};
+
 
 /**
  * Allocates and opens a new AVCodecContext for the specified codec, passing the
@@ -43,19 +46,6 @@ AVCodecContext *createContext(JNIEnv *env, AVCodec *codec, jbyteArray extraData,
                               jboolean outputFloat, jint rawSampleRate,
                               jint rawChannelCount);
 
-/**
- * Decodes the packet into the output buffer, returning the number of bytes
- * written, or a negative AUDIO_DECODER_ERROR constant value in the case of an
- * error.
- */
-int decodePacket(AVCodecContext *context, AVPacket *packet,
-                 uint8_t *outputBuffer, int outputSize);
-
-/**
- * Transforms ffmpeg AVERROR into a negative AUDIO_DECODER_ERROR constant value.
- */
-int transformError(int errorNumber);
-
 struct GrowOutputBufferCallback {
     uint8_t *operator()(int requiredSize) const;
 
@@ -112,104 +102,6 @@ AVCodecContext *createContext(JNIEnv *env, AVCodec *codec, jbyteArray extraData,
     return context;
 }
 
-int decodePacket(AVCodecContext *context, AVPacket *packet,
-                 uint8_t *outputBuffer, int outputSize, GrowOutputBufferCallback growBuffer) {
-    int result = 0;
-    // Queue input data.
-    result = avcodec_send_packet(context, packet);
-    if (result) {
-        logError("avcodec_send_packet", result);
-        return transformError(result);
-    }
-
-    // Dequeue output data until it runs out.
-    int outSize = 0;
-    while (true) {
-        AVFrame *frame = av_frame_alloc();
-        if (!frame) {
-            LOGE("Failed to allocate output frame.");
-            return AUDIO_DECODER_ERROR_INVALID_DATA;
-        }
-        result = avcodec_receive_frame(context, frame);
-        if (result) {
-            av_frame_free(&frame);
-            if (result == AVERROR(EAGAIN)) {
-                break;
-            }
-            logError("avcodec_receive_frame", result);
-            return transformError(result);
-        }
-
-        // Resample output.
-        AVSampleFormat sampleFormat = context->sample_fmt;
-        int channelCount = context->ch_layout.nb_channels;
-        AVChannelLayout channelLayout = context->ch_layout;
-        int sampleRate = context->sample_rate;
-        int sampleCount = frame->nb_samples;
-        int dataSize = av_samples_get_buffer_size(nullptr, channelCount, sampleCount,
-                                                  sampleFormat, 1);
-        SwrContext *resampleContext;
-        if (context->opaque) {
-            resampleContext = (SwrContext *) context->opaque;
-        } else {
-            resampleContext = swr_alloc();
-            av_opt_set_chlayout(resampleContext, "in_chlayout", &channelLayout, 0);
-            av_opt_set_chlayout(resampleContext, "out_chlayout", &channelLayout, 0);
-            av_opt_set_int(resampleContext, "in_sample_rate", sampleRate, 0);
-            av_opt_set_int(resampleContext, "out_sample_rate", sampleRate, 0);
-            av_opt_set_int(resampleContext, "in_sample_fmt", sampleFormat, 0);
-            // The output format is always the requested format.
-            av_opt_set_int(resampleContext, "out_sample_fmt",
-                           context->request_sample_fmt, 0);
-            result = swr_init(resampleContext);
-            if (result < 0) {
-                logError("swr_init", result);
-                av_frame_free(&frame);
-                return transformError(result);
-            }
-            context->opaque = resampleContext;
-        }
-        int inSampleSize = av_get_bytes_per_sample(sampleFormat);
-        int outSampleSize = av_get_bytes_per_sample(context->request_sample_fmt);
-        int outSamples = swr_get_out_samples(resampleContext, sampleCount);
-        int bufferOutSize = outSampleSize * channelCount * outSamples;
-        if (outSize + bufferOutSize > outputSize) {
-            LOGD(
-                    "Output buffer size (%d) too small for output data (%d), "
-                    "reallocating buffer.",
-                    outputSize, outSize + bufferOutSize);
-            outputSize = outSize + bufferOutSize;
-            outputBuffer = growBuffer(outputSize);
-            if (!outputBuffer) {
-                LOGE("Failed to reallocate output buffer.");
-                av_frame_free(&frame);
-                return AUDIO_DECODER_ERROR_OTHER;
-            }
-        }
-        result = swr_convert(resampleContext, &outputBuffer, bufferOutSize,
-                             (const uint8_t **) frame->data, frame->nb_samples);
-        av_frame_free(&frame);
-        if (result < 0) {
-            logError("swr_convert", result);
-            return AUDIO_DECODER_ERROR_INVALID_DATA;
-        }
-        int available = swr_get_out_samples(resampleContext, 0);
-        if (available != 0) {
-            LOGE("Expected no samples remaining after resampling, but found %d.",
-                 available);
-            return AUDIO_DECODER_ERROR_INVALID_DATA;
-        }
-        outputBuffer += bufferOutSize;
-        outSize += bufferOutSize;
-    }
-    return outSize;
-}
-
-int transformError(int errorNumber) {
-    return errorNumber == AVERROR_INVALIDDATA ? AUDIO_DECODER_ERROR_INVALID_DATA
-                                              : AUDIO_DECODER_ERROR_OTHER;
-}
-
 extern "C"
 JNIEXPORT jlong JNICALL
 Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpegInitialize(JNIEnv *env,
@@ -226,8 +118,12 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpe
     }
     jclass clazz = env->FindClass("io/github/anilbeesetti/nextlib/media3ext/ffdecoder/FfmpegAudioDecoder");
     growOutputBufferMethod = env->GetMethodID(clazz, "growOutputBuffer","(Landroidx/media3/decoder/SimpleDecoderOutputBuffer;I)Ljava/nio/ByteBuffer;");
-    return (jlong) createContext(env, codec, extra_data, output_float, raw_sample_rate,
-                                 raw_channel_count);
+    AVCodecContext *codecContext = createContext(env, codec, extra_data, output_float, raw_sample_rate,
+                                                 raw_channel_count);
+    if (!codecContext) {
+        return 0L;
+    }
+    return (jlong) new AudioContext{codecContext};
 }
 
 extern "C"
@@ -268,8 +164,10 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpe
 
     packet->data = inputBuffer;
     packet->size = input_size;
-    int decodedPacket = decodePacket((AVCodecContext *) context, packet, outputBuffer,
-                                     output_size, GrowOutputBufferCallback{env, thiz, decoderOutputBuffer});
+    auto *audioContext = (AudioContext *) context;
+    int decodedPacket = decodePacket(audioContext->codecContext, packet, outputBuffer,
+                                     output_size, GrowOutputBufferCallback{env, thiz, decoderOutputBuffer},
+                                     &audioContext->stats);
     av_packet_free(&packet);
     return decodedPacket;
 }
@@ -282,7 +180,7 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpe
         LOGE("Context must be non-NULL.");
         return -1;
     }
-    return ((AVCodecContext *) context)->ch_layout.nb_channels;
+    return ((AudioContext *) context)->codecContext->ch_layout.nb_channels;
 }
 
 extern "C"
@@ -294,7 +192,7 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpe
         LOGE("Context must be non-NULL.");
         return -1;
     }
-    return ((AVCodecContext *) context)->sample_rate;
+    return ((AudioContext *) context)->codecContext->sample_rate;
 }
 
 extern "C"
@@ -303,31 +201,38 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpe
                                                                    jobject thiz,
                                                                    jlong jContext,
                                                                    jbyteArray extra_data) {
-    auto *context = (AVCodecContext *) jContext;
-    if (!context) {
+    auto *audioContext = (AudioContext *) jContext;
+    if (!audioContext) {
         LOGE("Tried to reset without a context.");
         return 0L;
     }
 
+    AVCodecContext *context = audioContext->codecContext;
     AVCodecID codecId = context->codec_id;
     if (codecId == AV_CODEC_ID_TRUEHD) {
         // Release and recreate the context if the codec is TrueHD.
         // TODO: Figure out why flushing doesn't work for this codec.
+        auto outputFloat =
+                (jboolean) (context->request_sample_fmt == OUTPUT_FORMAT_PCM_FLOAT);
         releaseContext(context);
         auto *codec = const_cast<AVCodec *>(avcodec_find_decoder(codecId));
         if (!codec) {
             LOGE("Unexpected error finding codec %d.", codecId);
+            delete audioContext;
             return 0L;
         }
-        auto outputFloat =
-                (jboolean) (context->request_sample_fmt == OUTPUT_FORMAT_PCM_FLOAT);
-        return (jlong) createContext(env, codec, extra_data, outputFloat,
+        audioContext->codecContext = createContext(env, codec, extra_data, outputFloat,
                 /* rawSampleRate= */ -1,
                 /* rawChannelCount= */ -1);
+        if (!audioContext->codecContext) {
+            delete audioContext;
+            return 0L;
+        }
+        return (jlong) audioContext;
     }
 
     avcodec_flush_buffers(context);
-    return (jlong) context;
+    return (jlong) audioContext;
 }
 
 extern "C"
@@ -336,6 +241,19 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpe
                                                                      jobject thiz,
                                                                      jlong context) {
     if (context) {
-        releaseContext((AVCodecContext *) context);
+        auto *audioContext = (AudioContext *) context;
+        releaseContext(audioContext->codecContext);
+        delete audioContext;
+    }
+}
+
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegAudioDecoder_ffmpegGetStats(JNIEnv *env,
+                                                                      jobject thiz,
+                                                                      jlong context) {
+    if (!context) {
+        return nullptr;
     }
-}
\ No newline at end of file
+    return newStatsArray(env, ((AudioContext *) context)->stats);
+}
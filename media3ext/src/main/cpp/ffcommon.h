@@ -2,23 +2,7 @@
 #define NEXTPLAYER_FFCOMMON_H
 
 #include <jni.h>
-#include <android/log.h>
-
-extern "C" {
-#include <libavcodec/avcodec.h>
-#include "libswresample/swresample.h"
-};
-
-#define LOG_TAG "ffmpeg_jni"
-#define LOGE(...) \
-  ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__))
-#define ERROR_STRING_BUFFER_LENGTH 256
-
-
-/**
- * Releases the specified context.
- */
-void releaseContext(AVCodecContext *context);
+#include "ffcore.h"
 
 /**
 * Returns the AVCodec with the specified name, or NULL if it is not available.
@@ -26,8 +10,8 @@ void releaseContext(AVCodecContext *context);
 AVCodec *getCodecByName(JNIEnv *env, jstring codecName);
 
 /**
- * Outputs a log message describing the avcodec error number.
+ * Returns a snapshot of the stats as a new long[] in the layout read by FfmpegDecoderStats.
  */
-void logError(const char *functionName, int errorNumber);
+jlongArray newStatsArray(JNIEnv *env, const DecoderStats &stats);
 
 #endif //NEXTPLAYER_FFCOMMON_H
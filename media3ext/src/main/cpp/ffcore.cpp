@@ -0,0 +1,422 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "ffcore.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/error.h>
+#include <libavutil/opt.h>
+}
+
+#define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+
+/**
+ * Releases the specified context.
+ */
+void releaseContext(AVCodecContext *context) {
+    if (!context) {
+        return;
+    }
+    SwrContext *swrContext;
+    if ((swrContext = (SwrContext *)context->opaque)) {
+        swr_free(&swrContext);
+        context->opaque = nullptr;
+    }
+    av_freep(&context->extradata);
+    avcodec_free_context(&context);
+}
+
+/**
+ * Outputs a log message describing the avcodec error number.
+ */
+void logError(const char *functionName, int errorNumber) {
+    char *buffer = (char *)malloc(ERROR_STRING_BUFFER_LENGTH * sizeof(char));
+    av_strerror(errorNumber, buffer, ERROR_STRING_BUFFER_LENGTH);
+    LOGE("Error in %s: %s", functionName, buffer);
+    free(buffer);
+}
+
+/**
+ * Transforms ffmpeg AVERROR into a negative AUDIO_DECODER_ERROR constant value.
+ */
+static int transformError(int errorNumber) {
+    return errorNumber == AVERROR_INVALIDDATA ? AUDIO_DECODER_ERROR_INVALID_DATA
+                                              : AUDIO_DECODER_ERROR_OTHER;
+}
+
+int decodePacket(AVCodecContext *context, AVPacket *packet,
+                 uint8_t *outputBuffer, int outputSize, const GrowOutputBuffer &growBuffer,
+                 DecoderStats *stats) {
+    int result = 0;
+    // Queue input data.
+    {
+        DecoderStageTimer timer(stats, DECODER_STAGE_SEND_PACKET);
+        result = avcodec_send_packet(context, packet);
+    }
+    if (result) {
+        logError("avcodec_send_packet", result);
+        return transformError(result);
+    }
+
+    // Dequeue output data until it runs out.
+    int outSize = 0;
+    while (true) {
+        AVFrame *frame = av_frame_alloc();
+        if (!frame) {
+            LOGE("Failed to allocate output frame.");
+            return AUDIO_DECODER_ERROR_INVALID_DATA;
+        }
+        {
+            DecoderStageTimer timer(stats, DECODER_STAGE_RECEIVE_FRAME);
+            result = avcodec_receive_frame(context, frame);
+            if (result == AVERROR(EAGAIN)) {
+                timer.cancel();
+            }
+        }
+        if (result) {
+            av_frame_free(&frame);
+            if (result == AVERROR(EAGAIN)) {
+                break;
+            }
+            logError("avcodec_receive_frame", result);
+            return transformError(result);
+        }
+
+        // Resample output.
+        AVSampleFormat sampleFormat = context->sample_fmt;
+        int channelCount = context->ch_layout.nb_channels;
+        AVChannelLayout channelLayout = context->ch_layout;
+        int sampleRate = context->sample_rate;
+        int sampleCount = frame->nb_samples;
+        int dataSize = av_samples_get_buffer_size(nullptr, channelCount, sampleCount,
+                                                  sampleFormat, 1);
+        SwrContext *resampleContext;
+        if (context->opaque) {
+            resampleContext = (SwrContext *) context->opaque;
+        } else {
+            resampleContext = swr_alloc();
+            av_opt_set_chlayout(resampleContext, "in_chlayout", &channelLayout, 0);
+            av_opt_set_chlayout(resampleContext, "out_chlayout", &channelLayout, 0);
+            av_opt_set_int(resampleContext, "in_sample_rate", sampleRate, 0);
+            av_opt_set_int(resampleContext, "out_sample_rate", sampleRate, 0);
+            av_opt_set_int(resampleContext, "in_sample_fmt", sampleFormat, 0);
+            // The output format is always the requested format.
+            av_opt_set_int(resampleContext, "out_sample_fmt",
+                           context->request_sample_fmt, 0);
+            result = swr_init(resampleContext);
+            if (result < 0) {
+                logError("swr_init", result);
+                av_frame_free(&frame);
+                return transformError(result);
+            }
+            context->opaque = resampleContext;
+        }
+        int inSampleSize = av_get_bytes_per_sample(sampleFormat);
+        int outSampleSize = av_get_bytes_per_sample(context->request_sample_fmt);
+        int outSamples = swr_get_out_samples(resampleContext, sampleCount);
+        int bufferOutSize = outSampleSize * channelCount * outSamples;
+        if (outSize + bufferOutSize > outputSize) {
+            LOGD(
+                    "Output buffer size (%d) too small for output data (%d), "
+                    "reallocating buffer.",
+                    outputSize, outSize + bufferOutSize);
+            outputSize = outSize + bufferOutSize;
+            if (stats) {
+                stats->countGrowOutputBuffer();
+            }
+            uint8_t *grownBuffer = growBuffer(outputSize);
+            if (!grownBuffer) {
+                LOGE("Failed to reallocate output buffer.");
+                av_frame_free(&frame);
+                return AUDIO_DECODER_ERROR_OTHER;
+            }
+            outputBuffer = grownBuffer + outSize;
+        }
+        {
+            DecoderStageTimer timer(stats, DECODER_STAGE_CONVERT);
+            result = swr_convert(resampleContext, &outputBuffer, bufferOutSize,
+                                 (const uint8_t **) frame->data, frame->nb_samples);
+        }
+        av_frame_free(&frame);
+        if (result < 0) {
+            logError("swr_convert", result);
+            return AUDIO_DECODER_ERROR_INVALID_DATA;
+        }
+        int available = swr_get_out_samples(resampleContext, 0);
+        if (available != 0) {
+            LOGE("Expected no samples remaining after resampling, but found %d.",
+                 available);
+            return AUDIO_DECODER_ERROR_INVALID_DATA;
+        }
+        outputBuffer += bufferOutSize;
+        outSize += bufferOutSize;
+    }
+    return outSize;
+}
+
+int sendVideoPacket(AVCodecContext *context, AVPacket *packet) {
+    // Queue input data.
+    int result = avcodec_send_packet(context, packet);
+    if (result) {
+        logError("avcodec_send_packet", result);
+        if (result == AVERROR_INVALIDDATA) {
+            // need more data
+            return VIDEO_DECODER_ERROR_INVALID_DATA;
+        } else if (result == AVERROR(EAGAIN)) {
+            // need read frame
+            return VIDEO_DECODER_ERROR_READ_FRAME;
+        } else {
+            return VIDEO_DECODER_ERROR_OTHER;
+        }
+    }
+    return VIDEO_DECODER_SUCCESS;
+}
+
+void copyYuvFrame(const AVFrame *frame, uint8_t *data) {
+    const int32_t uvHeight = (frame->height + 1) / 2;
+    const uint64_t yLength = frame->linesize[0] * frame->height;
+    const uint64_t uvLength = frame->linesize[1] * uvHeight;
+
+    // TODO: Support rotate YUV data
+
+    memcpy(data, frame->data[0], yLength);
+    memcpy(data + yLength, frame->data[1], uvLength);
+    memcpy(data + yLength + uvLength, frame->data[2], uvLength);
+}
+
+/**
+ * Receives and copies every frame the decoder has ready, returning false on a decode error.
+ */
+static bool drainFrames(AVCodecContext *context, AVFrame *frame, std::vector<uint8_t> &copy,
+                        int64_t &frameCount) {
+    int result;
+    while ((result = avcodec_receive_frame(context, frame)) == 0) {
+        const int32_t uvHeight = (frame->height + 1) / 2;
+        copy.resize((size_t) frame->linesize[0] * frame->height +
+                    (size_t) 2 * frame->linesize[1] * uvHeight);
+        copyYuvFrame(frame, copy.data());
+        av_frame_unref(frame);
+        frameCount++;
+    }
+    if (result != AVERROR(EAGAIN) && result != AVERROR_EOF) {
+        logError("avcodec_receive_frame", result);
+        return false;
+    }
+    return true;
+}
+
+double measureDecodeFrameRate(AVCodecContext *context, AVPacket *const *packets, int packetCount,
+                              int64_t budgetUs) {
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        return -1;
+    }
+    std::vector<uint8_t> copy;
+    int64_t frameCount = 0;
+    bool failed = false;
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::microseconds(budgetUs);
+    do {
+        // The final null packet drains the frames a threaded decoder still holds.
+        for (int i = 0; i <= packetCount && !failed; i++) {
+            AVPacket *packet = i < packetCount ? packets[i] : nullptr;
+            int result;
+            while ((result = avcodec_send_packet(context, packet)) == AVERROR(EAGAIN)) {
+                if (!drainFrames(context, frame, copy, frameCount)) {
+                    failed = true;
+                    break;
+                }
+            }
+            if (!failed && result < 0) {
+                logError("avcodec_send_packet", result);
+                failed = true;
+            }
+            if (!failed && !drainFrames(context, frame, copy, frameCount)) {
+                failed = true;
+            }
+        }
+        avcodec_flush_buffers(context);
+    } while (!failed && std::chrono::steady_clock::now() < deadline);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    av_frame_free(&frame);
+    if (failed || frameCount == 0) {
+        return -1;
+    }
+    return frameCount / std::chrono::duration<double>(elapsed).count();
+}
+
+void convertToYv12(SwsContext *swsContext,
+                   uint8_t *const src[3], const int srcStride[3], int displayedHeight,
+                   uint8_t *windowBits, int windowStride, int windowHeight) {
+    const int32_t window_uv_height = (windowHeight + 1) / 2;
+    const int window_uv_stride = ALIGN(windowStride / 2, 16);
+    const int v_plane_height = std::min(window_uv_height, displayedHeight);
+
+    const int y_plane_size = windowStride * windowHeight;
+    const int v_plane_size = v_plane_height * window_uv_stride;
+
+    // destination data with u and v swapped
+    uint8_t *dest[3] = {windowBits,
+                        windowBits + y_plane_size + v_plane_size,
+                        windowBits + y_plane_size};
+
+    // destination strides
+    int dest_stride[3] = {windowStride,
+                          window_uv_stride,
+                          window_uv_stride};
+
+    //Perform color space conversion using sws_scale.
+    //Convert the source data (src) with specified strides (src_stride) and displayed height,
+    //and store the result in the destination data (dest) with corresponding strides (dest_stride).
+    sws_scale(swsContext,
+              src, srcStride,
+              0, displayedHeight,
+              dest, dest_stride);
+}
+
+/**
+ * Grows region to include the rectangle from (x0, y0) to (x1, y1), exclusive.
+ */
+static void unionRegion(SubtitleRegion &region, int x0, int y0, int x1, int y1) {
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    if (region.isEmpty()) {
+        region = {x0, y0, x1 - x0, y1 - y0};
+        return;
+    }
+    int left = std::min(region.x, x0);
+    int top = std::min(region.y, y0);
+    int right = std::max(region.x + region.width, x1);
+    int bottom = std::max(region.y + region.height, y1);
+    region = {left, top, right - left, bottom - top};
+}
+
+static bool containsPoint(const std::vector<SubtitleRegion> &regions, int x, int y) {
+    for (const SubtitleRegion &region: regions) {
+        if (x >= region.x && x < region.x + region.width &&
+            y >= region.y && y < region.y + region.height) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Converts a PAL8 palette entry, 0xAARRGGBB, to premultiplied RGBA in memory order.
+ */
+static uint32_t toPremultipliedRgba(uint32_t argb) {
+    uint32_t a = argb >> 24;
+    uint32_t r = ((argb >> 16) & 0xff) * a / 255;
+    uint32_t g = ((argb >> 8) & 0xff) * a / 255;
+    uint32_t b = (argb & 0xff) * a / 255;
+    return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+void clearSubtitleCanvas(SubtitleCanvas &canvas) {
+    for (const SubtitleRegion &region: canvas.regions) {
+        for (int y = region.y; y < region.y + region.height; y++) {
+            memset(&canvas.pixels[(size_t) y * canvas.width + region.x], 0,
+                   region.width * sizeof(uint32_t));
+        }
+    }
+    canvas.regions.clear();
+}
+
+void compositeSubtitle(SubtitleCanvas &canvas, const AVSubtitle &subtitle, int width, int height,
+                       SubtitleRegion *dirty, SubtitleRegion *bounds) {
+    *dirty = {};
+    *bounds = {};
+    if (canvas.width != width || canvas.height != height) {
+        if (!canvas.regions.empty()) {
+            *dirty = {0, 0, width, height};
+        }
+        canvas.width = width;
+        canvas.height = height;
+        canvas.pixels.assign((size_t) width * height, 0);
+        canvas.regions.clear();
+    }
+
+    std::vector<SubtitleRegion> regions;
+    for (unsigned i = 0; i < subtitle.num_rects; i++) {
+        const AVSubtitleRect *rect = subtitle.rects[i];
+        if (rect->type != SUBTITLE_BITMAP) {
+            continue;
+        }
+        int x0 = std::max(rect->x, 0);
+        int y0 = std::max(rect->y, 0);
+        int x1 = std::min(rect->x + rect->w, width);
+        int y1 = std::min(rect->y + rect->h, height);
+        if (x0 < x1 && y0 < y1) {
+            regions.push_back({x0, y0, x1 - x0, y1 - y0});
+        }
+    }
+
+    // Erase what the last event drew outside of the new rects.
+    for (const SubtitleRegion &region: canvas.regions) {
+        for (int y = region.y; y < region.y + region.height; y++) {
+            uint32_t *row = &canvas.pixels[(size_t) y * width];
+            int changedStart = -1;
+            int changedEnd = -1;
+            for (int x = region.x; x < region.x + region.width; x++) {
+                if (row[x] && !containsPoint(regions, x, y)) {
+                    row[x] = 0;
+                    if (changedStart < 0) {
+                        changedStart = x;
+                    }
+                    changedEnd = x + 1;
+                }
+            }
+            if (changedStart >= 0) {
+                unionRegion(*dirty, changedStart, y, changedEnd, y + 1);
+            }
+        }
+    }
+
+    uint32_t palette[AVPALETTE_COUNT];
+    for (unsigned i = 0; i < subtitle.num_rects; i++) {
+        const AVSubtitleRect *rect = subtitle.rects[i];
+        if (rect->type != SUBTITLE_BITMAP) {
+            continue;
+        }
+        const auto *argb = reinterpret_cast<const uint32_t *>(rect->data[1]);
+        int colors = std::min(std::max(rect->nb_colors, 0), AVPALETTE_COUNT);
+        for (int c = 0; c < AVPALETTE_COUNT; c++) {
+            palette[c] = c < colors ? toPremultipliedRgba(argb[c]) : 0;
+        }
+
+        int x0 = std::max(rect->x, 0);
+        int y0 = std::max(rect->y, 0);
+        int x1 = std::min(rect->x + rect->w, width);
+        int y1 = std::min(rect->y + rect->h, height);
+        for (int y = y0; y < y1; y++) {
+            const uint8_t *indices = rect->data[0] + (size_t) (y - rect->y) * rect->linesize[0];
+            uint32_t *row = &canvas.pixels[(size_t) y * width];
+            int changedStart = -1;
+            int changedEnd = -1;
+            for (int x = x0; x < x1; x++) {
+                uint32_t pixel = palette[indices[x - rect->x]];
+                if (row[x] != pixel) {
+                    row[x] = pixel;
+                    if (changedStart < 0) {
+                        changedStart = x;
+                    }
+                    changedEnd = x + 1;
+                }
+            }
+            if (changedStart >= 0) {
+                unionRegion(*dirty, changedStart, y, changedEnd, y + 1);
+            }
+        }
+    }
+
+    for (const SubtitleRegion &region: regions) {
+        unionRegion(*bounds, region.x, region.y, region.x + region.width, region.y + region.height);
+    }
+    canvas.regions = std::move(regions);
+}
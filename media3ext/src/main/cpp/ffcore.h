@@ -0,0 +1,135 @@
+#ifndef NEXTPLAYER_FFCORE_H
+#define NEXTPLAYER_FFCORE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "ffstats.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswresample/swresample.h>
+#include <libswscale/swscale.h>
+};
+
+/*
+ * Decode and convert cores shared by the JNI bindings and the host build.
+ * Nothing declared here may depend on JNI or Android APIs.
+ */
+
+#define LOG_TAG "ffmpeg_jni"
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(...) \
+  ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__))
+#define LOGD(...) \
+  ((void)__android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__))
+#else
+#include <cstdio>
+#define LOGE(...) \
+  ((void)fprintf(stderr, LOG_TAG ": " __VA_ARGS__), (void)fputc('\n', stderr))
+#define LOGD(...) ((void)0)
+#endif
+#define ERROR_STRING_BUFFER_LENGTH 256
+
+static const int AUDIO_DECODER_ERROR_INVALID_DATA = -1;
+static const int AUDIO_DECODER_ERROR_OTHER = -2;
+
+static const int VIDEO_DECODER_SUCCESS = 0;
+static const int VIDEO_DECODER_ERROR_INVALID_DATA = -1;
+static const int VIDEO_DECODER_ERROR_OTHER = -2;
+static const int VIDEO_DECODER_ERROR_READ_FRAME = -3;
+
+/**
+ * Releases the specified context.
+ */
+void releaseContext(AVCodecContext *context);
+
+/**
+ * Outputs a log message describing the avcodec error number.
+ */
+void logError(const char *functionName, int errorNumber);
+
+/**
+ * Returns a buffer of at least the required size that keeps the bytes written so far, or NULL if
+ * it could not be grown.
+ */
+using GrowOutputBuffer = std::function<uint8_t *(int requiredSize)>;
+
+/**
+ * Decodes the packet into the output buffer, returning the number of bytes
+ * written, or a negative AUDIO_DECODER_ERROR constant value in the case of an
+ * error. Stage timings go to stats if it is non-NULL.
+ */
+int decodePacket(AVCodecContext *context, AVPacket *packet,
+                 uint8_t *outputBuffer, int outputSize, const GrowOutputBuffer &growBuffer,
+                 DecoderStats *stats);
+
+/**
+ * Queues the packet for decoding, returning VIDEO_DECODER_SUCCESS or a VIDEO_DECODER_ERROR
+ * constant value.
+ */
+int sendVideoPacket(AVCodecContext *context, AVPacket *packet);
+
+/**
+ * Copies the Y, U and V planes of the frame back to back into data, with the frame's strides.
+ */
+void copyYuvFrame(const AVFrame *frame, uint8_t *data);
+
+/**
+ * Decodes the packets of a clip over and over for about budgetUs, including the copy that
+ * ffmpegReceiveFrame makes of every frame, and returns the decoded frames per second. The
+ * decoder is drained and flushed after each pass. Returns a negative value if decoding fails or
+ * yields no frame.
+ */
+double measureDecodeFrameRate(AVCodecContext *context, AVPacket *const *packets, int packetCount,
+                              int64_t budgetUs);
+
+/**
+ * Converts YUV planes into a YV12 window buffer of the given stride and height, which stores the
+ * V plane before the U plane.
+ */
+void convertToYv12(SwsContext *swsContext,
+                   uint8_t *const src[3], const int srcStride[3], int displayedHeight,
+                   uint8_t *windowBits, int windowStride, int windowHeight);
+
+/**
+ * A rectangle on a subtitle canvas. It is empty if its width or height is not positive.
+ */
+struct SubtitleRegion {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+};
+
+/**
+ * Composited picture of the bitmap subtitles on screen, in premultiplied RGBA like an
+ * ARGB_8888 Bitmap. It persists across events so that an event only costs the regions it
+ * changes.
+ */
+struct SubtitleCanvas {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+    // Regions drawn by the last event.
+    std::vector<SubtitleRegion> regions;
+};
+
+/**
+ * Replaces what the canvas shows with the palette-indexed rects of subtitle, resizing it to
+ * width x height first if needed. Only pixels inside the previous or the new rects are touched.
+ * Sets dirty to the bounds of the pixels that changed, which is empty if the event repeated what
+ * was on screen, and bounds to the bounds of everything now drawn.
+ */
+void compositeSubtitle(SubtitleCanvas &canvas, const AVSubtitle &subtitle, int width, int height,
+                       SubtitleRegion *dirty, SubtitleRegion *bounds);
+
+/**
+ * Clears the canvas, e.g. after a seek.
+ */
+void clearSubtitleCanvas(SubtitleCanvas &canvas);
+
+#endif //NEXTPLAYER_FFCORE_H
@@ -0,0 +1,319 @@
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "ffdeint.h"
+#include "fftrace.h"
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+#include <libavutil/version.h>
+}
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DEINT_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DEINT_SIMD 1
+#else
+#define DEINT_SIMD 0
+#endif
+
+bool isInterlacedFrame(const AVFrame *frame) {
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(58, 7, 100)
+    return frame->flags & AV_FRAME_FLAG_INTERLACED;
+#else
+    return frame->interlaced_frame;
+#endif
+}
+
+static bool isTopFieldFirst(const AVFrame *frame) {
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(58, 7, 100)
+    return frame->flags & AV_FRAME_FLAG_TOP_FIELD_FIRST;
+#else
+    return frame->top_field_first;
+#endif
+}
+
+/**
+ * Rows around a missing line of the kept field's frame. Rows outside of the plane are replaced
+ * by the nearest row of the same field.
+ */
+struct FieldRows {
+    // The current frame's first field, above and below.
+    const uint8_t *above;
+    const uint8_t *below;
+    // The previous frame's first field, above and below.
+    const uint8_t *previousAbove;
+    const uint8_t *previousBelow;
+    // The second field of the previous and the current frame: on this line, two lines above and
+    // two lines below.
+    const uint8_t *previousLine;
+    const uint8_t *currentLine;
+    const uint8_t *previousAbove2;
+    const uint8_t *currentAbove2;
+    const uint8_t *previousBelow2;
+    const uint8_t *currentBelow2;
+};
+
+static void averageLine(uint8_t *dst, const uint8_t *above, const uint8_t *below, int width) {
+    int x = 0;
+#if defined(__ARM_NEON)
+    for (; x + 16 <= width; x += 16) {
+        vst1q_u8(dst + x, vrhaddq_u8(vld1q_u8(above + x), vld1q_u8(below + x)));
+    }
+#elif defined(__SSE2__)
+    for (; x + 16 <= width; x += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(above + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(below + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_avg_epu8(a, b));
+    }
+#endif
+    for (; x < width; x++) {
+        dst[x] = (above[x] + below[x] + 1) >> 1;
+    }
+}
+
+/**
+ * One pixel of yadif's filter. Directions are only searched where x +- 3 is inside the line.
+ */
+static inline uint8_t yadifPixel(const FieldRows &rows, int x, bool searchDirections) {
+    const uint8_t *c = rows.above;
+    const uint8_t *e = rows.below;
+    int cv = c[x];
+    int ev = e[x];
+    int d = (rows.previousLine[x] + rows.currentLine[x]) >> 1;
+    int temporalDiff0 = abs(rows.previousLine[x] - rows.currentLine[x]);
+    int temporalDiff1 = (abs(rows.previousAbove[x] - cv) + abs(rows.previousBelow[x] - ev)) >> 1;
+    int diff = std::max(temporalDiff0 >> 1, temporalDiff1);
+
+    int spatialPred = (cv + ev) >> 1;
+    if (searchDirections) {
+        int spatialScore = abs(c[x - 1] - e[x - 1]) + abs(cv - ev) + abs(c[x + 1] - e[x + 1]) - 1;
+        // Each side goes one step further only if the first step found a better match.
+        for (int side = -1; side <= 1; side += 2) {
+            for (int j = side; j == side || j == 2 * side; j += side) {
+                int score = abs(c[x - 1 + j] - e[x - 1 - j]) + abs(c[x + j] - e[x - j]) +
+                            abs(c[x + 1 + j] - e[x + 1 - j]);
+                if (score >= spatialScore) {
+                    break;
+                }
+                spatialScore = score;
+                spatialPred = (c[x + j] + e[x - j]) >> 1;
+            }
+        }
+    }
+
+    int b = (rows.previousAbove2[x] + rows.currentAbove2[x]) >> 1;
+    int f = (rows.previousBelow2[x] + rows.currentBelow2[x]) >> 1;
+    int maxDiff = std::max(std::max(d - ev, d - cv), std::min(b - cv, f - ev));
+    int minDiff = std::min(std::min(d - ev, d - cv), std::max(b - cv, f - ev));
+    diff = std::max(std::max(diff, minDiff), -maxDiff);
+
+    return (uint8_t) std::min(std::max(spatialPred, d - diff), d + diff);
+}
+
+#if DEINT_SIMD
+// Eight pixels widened to signed 16 bit lanes, with the few operations yadif needs.
+#if defined(__ARM_NEON)
+typedef int16x8_t Vec;
+typedef uint16x8_t Mask;
+
+static inline Vec load8(const uint8_t *p) { return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p))); }
+static inline void store8(uint8_t *p, Vec v) { vst1_u8(p, vqmovun_s16(v)); }
+static inline Vec add(Vec a, Vec b) { return vaddq_s16(a, b); }
+static inline Vec sub(Vec a, Vec b) { return vsubq_s16(a, b); }
+static inline Vec absDiff(Vec a, Vec b) { return vabdq_s16(a, b); }
+static inline Vec half(Vec a) { return vshrq_n_s16(a, 1); }
+static inline Vec vmin(Vec a, Vec b) { return vminq_s16(a, b); }
+static inline Vec vmax(Vec a, Vec b) { return vmaxq_s16(a, b); }
+static inline Vec splat(int16_t value) { return vdupq_n_s16(value); }
+static inline Mask lessThan(Vec a, Vec b) { return vcltq_s16(a, b); }
+static inline Mask both(Mask a, Mask b) { return vandq_u16(a, b); }
+static inline Mask allLanes() { return vdupq_n_u16(0xffff); }
+static inline Vec select(Mask mask, Vec a, Vec b) { return vbslq_s16(mask, a, b); }
+#else
+typedef __m128i Vec;
+typedef __m128i Mask;
+
+static inline Vec load8(const uint8_t *p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)),
+                             _mm_setzero_si128());
+}
+static inline void store8(uint8_t *p, Vec v) {
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(v, v));
+}
+static inline Vec add(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+static inline Vec sub(Vec a, Vec b) { return _mm_sub_epi16(a, b); }
+// SSE2 has no 16 bit abs.
+static inline Vec absDiff(Vec a, Vec b) {
+    return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+static inline Vec half(Vec a) { return _mm_srai_epi16(a, 1); }
+static inline Vec vmin(Vec a, Vec b) { return _mm_min_epi16(a, b); }
+static inline Vec vmax(Vec a, Vec b) { return _mm_max_epi16(a, b); }
+static inline Vec splat(int16_t value) { return _mm_set1_epi16(value); }
+static inline Mask lessThan(Vec a, Vec b) { return _mm_cmplt_epi16(a, b); }
+static inline Mask both(Mask a, Mask b) { return _mm_and_si128(a, b); }
+static inline Mask allLanes() { return _mm_set1_epi16(-1); }
+static inline Vec select(Mask mask, Vec a, Vec b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+/**
+ * Searches direction j for the lanes in candidates, updating the score and prediction of those
+ * where it matches better. Returns the lanes that were updated.
+ */
+static inline Mask searchDirection(const uint8_t *c, const uint8_t *e, int x, int j, Mask candidates,
+                                   Vec &spatialScore, Vec &spatialPred) {
+    Vec score = add(add(absDiff(load8(c + x - 1 + j), load8(e + x - 1 - j)),
+                        absDiff(load8(c + x + j), load8(e + x - j))),
+                    absDiff(load8(c + x + 1 + j), load8(e + x + 1 - j)));
+    Mask better = both(lessThan(score, spatialScore), candidates);
+    spatialScore = select(better, score, spatialScore);
+    spatialPred = select(better, half(add(load8(c + x + j), load8(e + x - j))), spatialPred);
+    return better;
+}
+
+/**
+ * yadifPixel() for the eight pixels from x on, which must all search directions.
+ */
+static inline void yadifPixels8(uint8_t *dst, const FieldRows &rows, int x) {
+    const uint8_t *c = rows.above;
+    const uint8_t *e = rows.below;
+    Vec cv = load8(c + x);
+    Vec ev = load8(e + x);
+    Vec previousLine = load8(rows.previousLine + x);
+    Vec currentLine = load8(rows.currentLine + x);
+    Vec d = half(add(previousLine, currentLine));
+    Vec temporalDiff0 = absDiff(previousLine, currentLine);
+    Vec temporalDiff1 = half(add(absDiff(load8(rows.previousAbove + x), cv),
+                                 absDiff(load8(rows.previousBelow + x), ev)));
+    Vec diff = vmax(half(temporalDiff0), temporalDiff1);
+
+    Vec spatialPred = half(add(cv, ev));
+    Vec spatialScore = sub(add(add(absDiff(load8(c + x - 1), load8(e + x - 1)), absDiff(cv, ev)),
+                               absDiff(load8(c + x + 1), load8(e + x + 1))),
+                           splat(1));
+    Mask left = searchDirection(c, e, x, -1, allLanes(), spatialScore, spatialPred);
+    searchDirection(c, e, x, -2, left, spatialScore, spatialPred);
+    Mask right = searchDirection(c, e, x, 1, allLanes(), spatialScore, spatialPred);
+    searchDirection(c, e, x, 2, right, spatialScore, spatialPred);
+
+    Vec b = half(add(load8(rows.previousAbove2 + x), load8(rows.currentAbove2 + x)));
+    Vec f = half(add(load8(rows.previousBelow2 + x), load8(rows.currentBelow2 + x)));
+    Vec dMinusE = sub(d, ev);
+    Vec dMinusC = sub(d, cv);
+    Vec maxDiff = vmax(vmax(dMinusE, dMinusC), vmin(sub(b, cv), sub(f, ev)));
+    Vec minDiff = vmin(vmin(dMinusE, dMinusC), vmax(sub(b, cv), sub(f, ev)));
+    diff = vmax(vmax(diff, minDiff), sub(splat(0), maxDiff));
+
+    store8(dst + x, vmin(vmax(spatialPred, sub(d, diff)), add(d, diff)));
+}
+#endif
+
+static void yadifLine(uint8_t *dst, const FieldRows &rows, int width) {
+    // The direction search reads three pixels to either side.
+    int innerStart = std::min(3, width);
+    int innerEnd = std::max(innerStart, width - 3);
+    int x = 0;
+    for (; x < innerStart; x++) {
+        dst[x] = yadifPixel(rows, x, false);
+    }
+#if DEINT_SIMD
+    for (; x + 8 <= innerEnd; x += 8) {
+        yadifPixels8(dst, rows, x);
+    }
+#endif
+    for (; x < innerEnd; x++) {
+        dst[x] = yadifPixel(rows, x, true);
+    }
+    for (; x < width; x++) {
+        dst[x] = yadifPixel(rows, x, false);
+    }
+}
+
+/**
+ * Copies the lines of the field starting at keptParity and fills in the others. previous is the
+ * same plane of the previous frame, or NULL to interpolate spatially only.
+ */
+static void deinterlacePlane(uint8_t *dst, const uint8_t *current, int currentStride,
+                             const uint8_t *previous, int previousStride, int width, int height,
+                             int keptParity, DeinterlaceMode mode) {
+    auto currentRow = [&](int y) { return current + (ptrdiff_t) y * currentStride; };
+    auto previousRow = [&](int y) { return previous + (ptrdiff_t) y * previousStride; };
+    for (int y = 0; y < height; y++) {
+        uint8_t *dstRow = dst + (ptrdiff_t) y * currentStride;
+        int above = y - 1 >= 0 ? y - 1 : y + 1;
+        int below = y + 1 < height ? y + 1 : y - 1;
+        if ((y & 1) == keptParity || above >= height || below < 0) {
+            memcpy(dstRow, currentRow(y), width);
+        } else if (mode == DEINTERLACE_LINEAR || !previous) {
+            averageLine(dstRow, currentRow(above), currentRow(below), width);
+        } else {
+            int above2 = y - 2 >= 0 ? y - 2 : y;
+            int below2 = y + 2 < height ? y + 2 : y;
+            FieldRows rows = {
+                    currentRow(above), currentRow(below),
+                    previousRow(above), previousRow(below),
+                    previousRow(y), currentRow(y),
+                    previousRow(above2), currentRow(above2),
+                    previousRow(below2), currentRow(below2),
+            };
+            yadifLine(dstRow, rows, width);
+        }
+    }
+}
+
+static bool isSupportedFormat(const AVFrame *frame) {
+    return (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P) &&
+           frame->linesize[1] == frame->linesize[2];
+}
+
+static bool isSameLayout(const AVFrame *a, const AVFrame *b) {
+    return a->format == b->format && a->width == b->width && a->height == b->height;
+}
+
+bool Deinterlacer::deinterlace(const AVFrame *frame, DeinterlaceMode mode, uint8_t *data) {
+    if (mode == DEINTERLACE_OFF || !isInterlacedFrame(frame) || !isSupportedFormat(frame)) {
+        reset();
+        return false;
+    }
+    TraceSection trace("ffmpeg.deinterlace");
+
+    const AVFrame *reference = mode == DEINTERLACE_YADIF && previous &&
+                               isSameLayout(previous, frame) ? previous : nullptr;
+    // The first field is shown; it is the top one, on even lines, unless the frame says otherwise.
+    int keptParity = isTopFieldFirst(frame) ? 0 : 1;
+    const int uvWidth = (frame->width + 1) / 2;
+    const int uvHeight = (frame->height + 1) / 2;
+    const int widths[3] = {frame->width, uvWidth, uvWidth};
+    const int heights[3] = {frame->height, uvHeight, uvHeight};
+
+    uint8_t *dst = data;
+    for (int plane = 0; plane < 3; plane++) {
+        deinterlacePlane(dst, frame->data[plane], frame->linesize[plane],
+                         reference ? reference->data[plane] : nullptr,
+                         reference ? reference->linesize[plane] : 0,
+                         widths[plane], heights[plane], keptParity, mode);
+        dst += (size_t) frame->linesize[plane] * heights[plane];
+    }
+
+    if (mode == DEINTERLACE_YADIF) {
+        if (!previous) {
+            previous = av_frame_alloc();
+        }
+        av_frame_unref(previous);
+        // A reference, not a copy: the decoder allocates a new buffer for each frame anyway.
+        if (previous && av_frame_ref(previous, frame) < 0) {
+            av_frame_free(&previous);
+        }
+    }
+    return true;
+}
+
+void Deinterlacer::reset() {
+    av_frame_free(&previous);
+}
@@ -0,0 +1,56 @@
+#ifndef NEXTPLAYER_FFDEINT_H
+#define NEXTPLAYER_FFDEINT_H
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+};
+
+// Values of FfmpegVideoRenderer.DEINTERLACE_*, which must stay equal.
+enum DeinterlaceMode {
+    DEINTERLACE_OFF = 0,
+    // The lines of the second field are interpolated from the first field.
+    DEINTERLACE_LINEAR = 1,
+    // Edge-directed interpolation from the first field, clamped to what the second fields of
+    // this and the previous frame allow, as in yadif without its one frame lookahead.
+    DEINTERLACE_YADIF = 2,
+};
+
+/**
+ * Returns whether the frame holds two fields captured at different times.
+ */
+bool isInterlacedFrame(const AVFrame *frame);
+
+/**
+ * Deinterlaces decoded frames while copying them into output buffers laid out like
+ * copyYuvFrame() does, so that it costs no pass over the frame beyond the copy itself. Each
+ * frame becomes one progressive frame showing its first field, at the frame rate.
+ */
+class Deinterlacer {
+public:
+    Deinterlacer() = default;
+
+    ~Deinterlacer() { reset(); }
+
+    Deinterlacer(const Deinterlacer &) = delete;
+    Deinterlacer &operator=(const Deinterlacer &) = delete;
+
+    /**
+     * Writes the deinterlaced frame into data and returns true, or returns false without writing
+     * anything if the frame is progressive, its pixel format is not supported or mode is
+     * DEINTERLACE_OFF. The caller copies the frame itself in that case.
+     */
+    bool deinterlace(const AVFrame *frame, DeinterlaceMode mode, uint8_t *data);
+
+    /**
+     * Forgets the previous frame, e.g. after a seek.
+     */
+    void reset();
+
+private:
+    // Reference to the previous interlaced frame, for the temporal check of DEINTERLACE_YADIF.
+    AVFrame *previous = nullptr;
+};
+
+#endif //NEXTPLAYER_FFDEINT_H
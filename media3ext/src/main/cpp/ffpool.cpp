@@ -0,0 +1,74 @@
+#include <cstring>
+#include <iterator>
+#include "ffpool.h"
+#include "ffcore.h"
+
+// One context covers a playlist of same-codec items; a second one survives an item of another
+// codec in between, such as an ad.
+static const size_t DEFAULT_VIDEO_POOL_CAPACITY = 2;
+
+static bool sameExtraData(const AVCodecContext *context, const uint8_t *extraData,
+                          int extraDataSize) {
+    if (context->extradata_size != extraDataSize) {
+        return false;
+    }
+    return extraDataSize == 0 || memcmp(context->extradata, extraData, extraDataSize) == 0;
+}
+
+AVCodecContext *CodecContextPool::acquire(const AVCodec *codec, const uint8_t *extraData,
+                                          int extraDataSize, int threads) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Newest first, as it is the most likely to belong to the same playlist.
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        AVCodecContext *context = it->context;
+        if (context->codec == codec && it->threads == threads &&
+            sameExtraData(context, extraData, extraDataSize)) {
+            entries.erase(std::next(it).base());
+            LOGD("Reusing %s context.", codec->name);
+            return context;
+        }
+    }
+    return nullptr;
+}
+
+void CodecContextPool::release(AVCodecContext *context, int threads) {
+    // Flushing waits for the frame threads, so keep it out of the lock.
+    avcodec_flush_buffers(context);
+    AVCodecContext *evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (capacity == 0) {
+            evicted = context;
+        } else {
+            if (entries.size() >= capacity) {
+                evicted = entries.front().context;
+                entries.erase(entries.begin());
+            }
+            entries.push_back({context, threads});
+        }
+    }
+    releaseContext(evicted);
+}
+
+void CodecContextPool::setCapacity(size_t newCapacity) {
+    std::vector<Entry> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = newCapacity;
+        if (entries.size() > capacity) {
+            size_t count = entries.size() - capacity;
+            evicted.assign(entries.begin(), entries.begin() + count);
+            entries.erase(entries.begin(), entries.begin() + count);
+        }
+    }
+    // Freeing joins the frame threads.
+    for (const Entry &entry: evicted) {
+        releaseContext(entry.context);
+    }
+}
+
+CodecContextPool &videoContextPool() {
+    // Never destroyed: joining decoder threads from a static destructor at exit can deadlock.
+    static auto *pool = new CodecContextPool(DEFAULT_VIDEO_POOL_CAPACITY);
+    return *pool;
+}
@@ -0,0 +1,63 @@
+#ifndef NEXTPLAYER_FFPOOL_H
+#define NEXTPLAYER_FFPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+};
+
+/**
+ * Opened codec contexts parked between decoder instances, so that the next media item of a
+ * playlist can skip avcodec_open2() and, for frame threaded decoders, the creation of their
+ * threads. A context is only handed out again for the same codec, thread count and extradata,
+ * after avcodec_flush_buffers() has dropped everything it held from the previous stream.
+ */
+class CodecContextPool {
+public:
+    explicit CodecContextPool(size_t capacity) : capacity(capacity) {}
+
+    ~CodecContextPool() { setCapacity(0); }
+
+    CodecContextPool(const CodecContextPool &) = delete;
+    CodecContextPool &operator=(const CodecContextPool &) = delete;
+
+    /**
+     * Removes and returns a parked context opened with the same parameters, or NULL if there is
+     * none.
+     */
+    AVCodecContext *acquire(const AVCodec *codec, const uint8_t *extraData, int extraDataSize,
+                            int threads);
+
+    /**
+     * Flushes [context], which was opened with [threads] threads, and parks it. The least recently
+     * parked context is freed if the pool is full; [context] itself is freed if the capacity is 0.
+     */
+    void release(AVCodecContext *context, int threads);
+
+    /**
+     * Sets how many contexts may be parked, freeing the oldest ones above it.
+     */
+    void setCapacity(size_t newCapacity);
+
+private:
+    struct Entry {
+        AVCodecContext *context;
+        int threads;
+    };
+
+    std::mutex mutex;
+    // Oldest first.
+    std::vector<Entry> entries;
+    size_t capacity;
+};
+
+/**
+ * Returns the pool shared by all video decoders.
+ */
+CodecContextPool &videoContextPool();
+
+#endif //NEXTPLAYER_FFPOOL_H
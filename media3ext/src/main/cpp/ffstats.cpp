@@ -0,0 +1,19 @@
+#include "ffstats.h"
+
+void DecoderStats::snapshot(int64_t *out) const {
+    out[0] = DECODER_STATS_VERSION;
+    out[1] = DECODER_STAGE_COUNT;
+    out[2] = DECODER_STATS_BUCKET_COUNT;
+    out[3] = static_cast<int64_t>(growOutputBufferCount.load(std::memory_order_relaxed));
+
+    int64_t *stageOut = out + DECODER_STATS_HEADER_SIZE;
+    for (const Stage &stage: stages) {
+        stageOut[0] = static_cast<int64_t>(stage.count.load(std::memory_order_relaxed));
+        stageOut[1] = static_cast<int64_t>(stage.totalNs.load(std::memory_order_relaxed));
+        stageOut[2] = static_cast<int64_t>(stage.maxNs.load(std::memory_order_relaxed));
+        for (int i = 0; i < DECODER_STATS_BUCKET_COUNT; i++) {
+            stageOut[3 + i] = static_cast<int64_t>(stage.buckets[i].load(std::memory_order_relaxed));
+        }
+        stageOut += DECODER_STATS_STAGE_SIZE;
+    }
+}
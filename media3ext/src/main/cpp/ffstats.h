@@ -0,0 +1,125 @@
+#ifndef NEXTPLAYER_FFSTATS_H
+#define NEXTPLAYER_FFSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "fftrace.h"
+
+/**
+ * Stages of the native decode path that are timed separately.
+ */
+enum DecoderStage {
+    DECODER_STAGE_SEND_PACKET = 0,
+    DECODER_STAGE_RECEIVE_FRAME = 1,
+    // Copy of the decoded planes into the output buffer.
+    DECODER_STAGE_COPY = 2,
+    // Resampling of audio or color conversion of video.
+    DECODER_STAGE_CONVERT = 3,
+    DECODER_STAGE_WINDOW_LOCK = 4,
+    DECODER_STAGE_WINDOW_POST = 5,
+    DECODER_STAGE_COUNT = 6
+};
+
+/**
+ * Returns the trace section name of [stage].
+ */
+inline const char *decoderStageName(DecoderStage stage) {
+    static const char *const names[DECODER_STAGE_COUNT] = {
+            "ffmpeg.sendPacket", "ffmpeg.receiveFrame", "ffmpeg.copy",
+            "ffmpeg.convert", "ffmpeg.windowLock", "ffmpeg.windowPost"};
+    return names[stage];
+}
+
+// Must match the layout constants in FfmpegDecoderStats.java.
+static const int DECODER_STATS_VERSION = 1;
+// Bucket 0 counts samples under 1 us, bucket i samples in [2^(i-1), 2^i) us, and the last
+// bucket everything above.
+static const int DECODER_STATS_BUCKET_COUNT = 20;
+static const int DECODER_STATS_HEADER_SIZE = 4;
+static const int DECODER_STATS_STAGE_SIZE = 3 + DECODER_STATS_BUCKET_COUNT;
+static const int DECODER_STATS_SIZE = DECODER_STATS_HEADER_SIZE + DECODER_STAGE_COUNT * DECODER_STATS_STAGE_SIZE;
+
+/**
+ * Call counts and latency histograms per decoder stage.
+ *
+ * Only the decoder thread records, so updates are plain relaxed loads and stores without
+ * read-modify-write instructions; any thread may take a snapshot at the same time.
+ */
+struct DecoderStats {
+    struct Stage {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::atomic<uint64_t> maxNs{0};
+        std::atomic<uint64_t> buckets[DECODER_STATS_BUCKET_COUNT]{};
+    };
+
+    Stage stages[DECODER_STAGE_COUNT];
+    std::atomic<uint64_t> growOutputBufferCount{0};
+
+    void record(DecoderStage stage, uint64_t ns) {
+        Stage &s = stages[stage];
+        uint64_t us = ns / 1000;
+        int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+        if (bucket >= DECODER_STATS_BUCKET_COUNT) {
+            bucket = DECODER_STATS_BUCKET_COUNT - 1;
+        }
+        increment(s.count, 1);
+        increment(s.totalNs, ns);
+        increment(s.buckets[bucket], 1);
+        if (ns > s.maxNs.load(std::memory_order_relaxed)) {
+            s.maxNs.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    void countGrowOutputBuffer() {
+        increment(growOutputBufferCount, 1);
+    }
+
+    /**
+     * Writes DECODER_STATS_SIZE values: version, stage count, bucket count and grow count, then
+     * count, total ns, max ns and the histogram of each stage.
+     */
+    void snapshot(int64_t *out) const;
+
+private:
+    static void increment(std::atomic<uint64_t> &value, uint64_t delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Records the time between its construction and destruction into one stage. Does nothing if
+ * the stats are NULL or the timer was cancelled. The stage is also traced, cancelled or not.
+ */
+class DecoderStageTimer {
+public:
+    DecoderStageTimer(DecoderStats *stats, DecoderStage stage)
+            : trace(decoderStageName(stage)), stats(stats), stage(stage),
+              start(std::chrono::steady_clock::now()) {}
+
+    ~DecoderStageTimer() {
+        if (stats) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            stats->record(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+    /**
+     * Drops the sample, e.g. when the stage turned out to have nothing to do.
+     */
+    void cancel() {
+        stats = nullptr;
+    }
+
+    DecoderStageTimer(const DecoderStageTimer &) = delete;
+    DecoderStageTimer &operator=(const DecoderStageTimer &) = delete;
+
+private:
+    TraceSection trace;
+    DecoderStats *stats;
+    DecoderStage stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif //NEXTPLAYER_FFSTATS_H
@@ -0,0 +1,219 @@
+#include <jni.h>
+#include <android/bitmap.h>
+#include <cstring>
+#include <algorithm>
+#include "ffcommon.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+static const int SUBTITLE_DECODER_NO_OUTPUT = 0;
+static const int SUBTITLE_DECODER_OUTPUT = 1;
+static const int SUBTITLE_DECODER_ERROR_INVALID_DATA = -1;
+static const int SUBTITLE_DECODER_ERROR_OTHER = -2;
+
+// Layout of the int[] ffmpegDecode fills in, mirrored in FfmpegSubtitleDecoder.java.
+static const int SUBTITLE_RESULT_START_MS = 0;
+static const int SUBTITLE_RESULT_END_MS = 1;
+static const int SUBTITLE_RESULT_WIDTH = 2;
+static const int SUBTITLE_RESULT_HEIGHT = 3;
+static const int SUBTITLE_RESULT_DIRTY = 4;
+static const int SUBTITLE_RESULT_BOUNDS = 8;
+static const int SUBTITLE_RESULT_SIZE = 12;
+
+// Plane size assumed until the stream declares one, as DVB and DVD subtitles are defined on a
+// standard definition grid by default.
+static const int DEFAULT_PLANE_WIDTH = 720;
+static const int DEFAULT_PLANE_HEIGHT = 576;
+
+/**
+ * Native state behind an FfmpegSubtitleDecoder handle.
+ */
+struct SubtitleContext {
+    AVCodecContext *codecContext{};
+    AVPacket *packet{};
+    SubtitleCanvas canvas;
+};
+
+static void releaseSubtitleContext(SubtitleContext *context) {
+    if (!context) {
+        return;
+    }
+    av_packet_free(&context->packet);
+    releaseContext(context->codecContext);
+    delete context;
+}
+
+static void putRegion(jint *out, const SubtitleRegion &region) {
+    out[0] = region.x;
+    out[1] = region.y;
+    out[2] = region.width;
+    out[3] = region.height;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegSubtitleDecoder_ffmpegInitialize(JNIEnv *env,
+                                                                                    jobject thiz,
+                                                                                    jstring codec_name,
+                                                                                    jbyteArray extra_data) {
+    AVCodec *codec = getCodecByName(env, codec_name);
+    if (!codec) {
+        LOGE("Codec not found.");
+        return 0L;
+    }
+
+    auto *context = new SubtitleContext();
+    context->codecContext = avcodec_alloc_context3(codec);
+    context->packet = av_packet_alloc();
+    if (!context->codecContext || !context->packet) {
+        LOGE("Failed to allocate context.");
+        releaseSubtitleContext(context);
+        return 0L;
+    }
+
+    AVCodecContext *codecContext = context->codecContext;
+    if (extra_data) {
+        jsize size = env->GetArrayLength(extra_data);
+        codecContext->extradata_size = size;
+        codecContext->extradata = (uint8_t *) av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!codecContext->extradata) {
+            LOGE("Failed to allocate extradata.");
+            releaseSubtitleContext(context);
+            return 0L;
+        }
+        env->GetByteArrayRegion(extra_data, 0, size, (jbyte *) codecContext->extradata);
+    }
+    codecContext->pkt_timebase = {1, 1000000};
+
+    int result = avcodec_open2(codecContext, codec, nullptr);
+    if (result < 0) {
+        logError("avcodec_open2", result);
+        releaseSubtitleContext(context);
+        return 0L;
+    }
+    return (jlong) context;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegSubtitleDecoder_ffmpegDecode(JNIEnv *env,
+                                                                                jobject thiz,
+                                                                                jlong jContext,
+                                                                                jbyteArray data,
+                                                                                jint offset,
+                                                                                jint length,
+                                                                                jlong time_us,
+                                                                                jintArray result_array) {
+    auto *const context = reinterpret_cast<SubtitleContext *>(jContext);
+    AVPacket *packet = context->packet;
+    // av_new_packet adds the input padding FFmpeg's bitstream readers expect, which the heap
+    // buffers of SubtitleInputBuffer do not have.
+    if (av_new_packet(packet, length) < 0) {
+        LOGE("Failed to allocate packet.");
+        return SUBTITLE_DECODER_ERROR_OTHER;
+    }
+    env->GetByteArrayRegion(data, offset, length, (jbyte *) packet->data);
+    packet->pts = time_us;
+
+    AVSubtitle subtitle;
+    int gotSubtitle = 0;
+    int result = avcodec_decode_subtitle2(context->codecContext, &subtitle, &gotSubtitle, packet);
+    av_packet_unref(packet);
+    if (result < 0) {
+        logError("avcodec_decode_subtitle2", result);
+        return result == AVERROR_INVALIDDATA ? SUBTITLE_DECODER_ERROR_INVALID_DATA
+                                             : SUBTITLE_DECODER_ERROR_OTHER;
+    }
+    if (!gotSubtitle) {
+        return SUBTITLE_DECODER_NO_OUTPUT;
+    }
+
+    // PGS declares its plane; DVB and DVD rects are placed on a grid of the display size, if the
+    // stream gave one.
+    AVCodecContext *codecContext = context->codecContext;
+    int width = codecContext->width > 0 ? codecContext->width : DEFAULT_PLANE_WIDTH;
+    int height = codecContext->height > 0 ? codecContext->height : DEFAULT_PLANE_HEIGHT;
+    for (unsigned i = 0; i < subtitle.num_rects; i++) {
+        const AVSubtitleRect *rect = subtitle.rects[i];
+        width = std::max(width, rect->x + rect->w);
+        height = std::max(height, rect->y + rect->h);
+    }
+
+    SubtitleRegion dirty;
+    SubtitleRegion bounds;
+    {
+        TraceSection trace("ffmpeg.subtitleComposite");
+        compositeSubtitle(context->canvas, subtitle, width, height, &dirty, &bounds);
+    }
+
+    jint out[SUBTITLE_RESULT_SIZE];
+    out[SUBTITLE_RESULT_START_MS] = (jint) subtitle.start_display_time;
+    // UINT32_MAX, as PGS always reports, means the event lasts until the next one.
+    out[SUBTITLE_RESULT_END_MS] = subtitle.end_display_time == UINT32_MAX
+                                  ? -1 : (jint) subtitle.end_display_time;
+    out[SUBTITLE_RESULT_WIDTH] = width;
+    out[SUBTITLE_RESULT_HEIGHT] = height;
+    putRegion(out + SUBTITLE_RESULT_DIRTY, dirty);
+    putRegion(out + SUBTITLE_RESULT_BOUNDS, bounds);
+    env->SetIntArrayRegion(result_array, 0, SUBTITLE_RESULT_SIZE, out);
+    avsubtitle_free(&subtitle);
+    return SUBTITLE_DECODER_OUTPUT;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegSubtitleDecoder_ffmpegCopyToBitmap(JNIEnv *env,
+                                                                                      jobject thiz,
+                                                                                      jlong jContext,
+                                                                                      jobject bitmap,
+                                                                                      jint x,
+                                                                                      jint y,
+                                                                                      jint width,
+                                                                                      jint height) {
+    auto *const context = reinterpret_cast<SubtitleContext *>(jContext);
+    const SubtitleCanvas &canvas = context->canvas;
+    if (x < 0 || y < 0 || x + width > canvas.width || y + height > canvas.height) {
+        LOGE("Region outside of the subtitle canvas.");
+        return false;
+    }
+
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS ||
+        info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 ||
+        (int) info.width < width || (int) info.height < height) {
+        LOGE("Unexpected subtitle bitmap.");
+        return false;
+    }
+    void *pixels;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        LOGE("Failed to lock the subtitle bitmap.");
+        return false;
+    }
+    for (int row = 0; row < height; row++) {
+        memcpy(static_cast<uint8_t *>(pixels) + (size_t) row * info.stride,
+               &canvas.pixels[(size_t) (y + row) * canvas.width + x],
+               width * sizeof(uint32_t));
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return true;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegSubtitleDecoder_ffmpegReset(JNIEnv *env,
+                                                                               jobject thiz,
+                                                                               jlong jContext) {
+    auto *const context = reinterpret_cast<SubtitleContext *>(jContext);
+    avcodec_flush_buffers(context->codecContext);
+    clearSubtitleCanvas(context->canvas);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegSubtitleDecoder_ffmpegRelease(JNIEnv *env,
+                                                                                 jobject thiz,
+                                                                                 jlong jContext) {
+    releaseSubtitleContext(reinterpret_cast<SubtitleContext *>(jContext));
+}
@@ -0,0 +1,58 @@
+#ifndef NEXTPLAYER_FFTRACE_H
+#define NEXTPLAYER_FFTRACE_H
+
+#include <cstdint>
+
+/*
+ * Systrace/Perfetto markers for the native decode path, compiled in only when the library is
+ * configured with -DNEXTLIB_TRACE=ON. Otherwise, and always in the host build, every helper
+ * here is an empty inline function.
+ */
+
+#if defined(NEXTLIB_TRACE) && defined(__ANDROID__)
+#define FFTRACE_ENABLED 1
+#include <android/trace.h>
+#include <dlfcn.h>
+#endif
+
+/**
+ * Emits a trace section named [name] for as long as it is in scope. [name] must outlive it.
+ */
+class TraceSection {
+public:
+    explicit TraceSection(const char *name) {
+#ifdef FFTRACE_ENABLED
+        ATrace_beginSection(name);
+#else
+        (void) name;
+#endif
+    }
+
+    ~TraceSection() {
+#ifdef FFTRACE_ENABLED
+        ATrace_endSection();
+#endif
+    }
+
+    TraceSection(const TraceSection &) = delete;
+    TraceSection &operator=(const TraceSection &) = delete;
+};
+
+/**
+ * Sets the counter track [name] to [value]. Does nothing below API 29, which added counters.
+ */
+inline void traceCounter(const char *name, int64_t value) {
+#ifdef FFTRACE_ENABLED
+    // minSdk is 23, so ATrace_setCounter has to be looked up at runtime.
+    using SetCounter = void (*)(const char *, int64_t);
+    static const auto setCounter = reinterpret_cast<SetCounter>(dlsym(RTLD_DEFAULT, "ATrace_setCounter"));
+    if (setCounter && ATrace_isEnabled()) {
+        setCounter(name, value);
+    }
+#else
+    (void) name;
+    (void) value;
+#endif
+}
+
+#endif //NEXTPLAYER_FFTRACE_H
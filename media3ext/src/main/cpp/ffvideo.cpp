@@ -1,10 +1,13 @@
 
-#include <android/log.h>
 #include <jni.h>
 #include <cstdlib>
+#include <cstring>
 #include <android/native_window_jni.h>
 #include <algorithm>
+#include <vector>
 #include "ffcommon.h"
+#include "ffdeint.h"
+#include "ffpool.h"
 
 extern "C" {
 #ifdef __cplusplus
@@ -22,8 +25,6 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
-#define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
-
 // ANativeWindow_lock() implicitly connects the Surface's BufferQueue to the CPU
 // producer API. Since this Surface is shared with ExoPlayer's
 // MediaCodecVideoRenderer, that connection must be released once we are done, or
@@ -61,12 +62,6 @@ static int native_window_api_disconnect(ANativeWindow *window, int api) {
     return w->perform(window, NATIVE_WINDOW_API_DISCONNECT, api);
 }
 
-static const int VIDEO_DECODER_SUCCESS = 0;
-static const int VIDEO_DECODER_ERROR_INVALID_DATA = -1;
-static const int VIDEO_DECODER_ERROR_OTHER = -2;
-static const int VIDEO_DECODER_ERROR_READ_FRAME = -3;
-
-
 // YUV plane indices.
 const int kPlaneY = 0;
 const int kPlaneU = 1;
@@ -117,7 +112,17 @@ struct JniContext {
     jmethodID init_method{};
 
     AVCodecContext *codecContext{};
+    // Thread count the codec context was opened with, its key in videoContextPool().
+    int threads = 0;
     SwsContext *swsContext{};
+    Deinterlacer deinterlacer;
+    // Reused for every input buffer; it only points at the caller's data.
+    AVPacket *packet{};
+    DecoderStats stats;
+    // Packets accepted by the codec that have not come out as frames yet, and the timestamp of
+    // the latest one, for the trace counters.
+    int64_t pendingPackets = 0;
+    int64_t lastInputTimeUs = 0;
 
     ANativeWindow *native_window = nullptr;
     jobject surface = nullptr;
@@ -126,30 +131,32 @@ struct JniContext {
     bool connected_as_cpu = false;
 };
 
-JniContext *createVideoContext(JNIEnv *env,
-                               AVCodec *codec,
-                               jbyteArray extraData,
-                               jint threads) {
-    auto *jniContext = new JniContext();
-
+/**
+ * Opens a new context, or returns NULL if it could not be opened.
+ */
+static AVCodecContext *openVideoContext(AVCodec *codec,
+                                        const std::vector<uint8_t> &extraData,
+                                        int threads) {
     AVCodecContext *codecContext = avcodec_alloc_context3(codec);
     if (!codecContext) {
         LOGE("Failed to allocate context.");
         return nullptr;
     }
 
-    if (extraData) {
-        jsize size = env->GetArrayLength(extraData);
+    if (!extraData.empty()) {
+        auto size = (int) extraData.size();
         codecContext->extradata_size = size;
-        codecContext->extradata = (uint8_t *) av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        codecContext->extradata = (uint8_t *) av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
         if (!codecContext->extradata) {
             LOGE("Failed to allocate extradata.");
             releaseContext(codecContext);
             return nullptr;
         }
-        env->GetByteArrayRegion(extraData, 0, size, (jbyte *) codecContext->extradata);
+        memcpy(codecContext->extradata, extraData.data(), size);
     }
 
+    // libdav1d shares these threads between frame and tile decoding, and derives its frame delay
+    // from their number.
     codecContext->thread_count = threads;
     codecContext->err_recognition = AV_EF_IGNORE_ERR;
     int result = avcodec_open2(codecContext, codec, nullptr);
@@ -158,8 +165,41 @@ JniContext *createVideoContext(JNIEnv *env,
         releaseContext(codecContext);
         return nullptr;
     }
+    return codecContext;
+}
+
+JniContext *createVideoContext(JNIEnv *env,
+                               AVCodec *codec,
+                               jbyteArray extraData,
+                               jint threads) {
+    std::vector<uint8_t> extraDataBytes;
+    if (extraData) {
+        extraDataBytes.resize(env->GetArrayLength(extraData));
+        env->GetByteArrayRegion(extraData, 0, (jsize) extraDataBytes.size(),
+                                (jbyte *) extraDataBytes.data());
+    }
 
+    // A context parked by the decoder of a previous media item skips avcodec_open2.
+    AVCodecContext *codecContext = videoContextPool().acquire(
+            codec, extraDataBytes.data(), (int) extraDataBytes.size(), threads);
+    if (!codecContext) {
+        codecContext = openVideoContext(codec, extraDataBytes, threads);
+        if (!codecContext) {
+            return nullptr;
+        }
+    }
+
+    auto *jniContext = new JniContext();
     jniContext->codecContext = codecContext;
+    jniContext->threads = threads;
+
+    jniContext->packet = av_packet_alloc();
+    if (!jniContext->packet) {
+        LOGE("Failed to allocate packet.");
+        releaseContext(codecContext);
+        delete jniContext;
+        return nullptr;
+    }
 
     // Populate JNI References.
     jclass outputBufferClass = env->FindClass("androidx/media3/decoder/VideoDecoderOutputBuffer");
@@ -172,6 +212,15 @@ JniContext *createVideoContext(JNIEnv *env,
     return jniContext;
 }
 
+void releaseVideoContext(JniContext *jniContext) {
+    AVCodecContext *context = jniContext->codecContext;
+    if (context) {
+        sws_freeContext(jniContext->swsContext);
+        av_packet_free(&jniContext->packet);
+        videoContextPool().release(context, jniContext->threads);
+        delete jniContext;
+    }
+}
 
 extern "C"
 JNIEXPORT jlong JNICALL
@@ -201,6 +250,9 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpe
     }
 
     avcodec_flush_buffers(context);
+    jniContext->deinterlacer.reset();
+    jniContext->pendingPackets = 0;
+    traceCounter("ffmpeg.pendingPackets", 0);
     return (jlong) jniContext;
 }
 
@@ -208,13 +260,7 @@ extern "C"
 JNIEXPORT void JNICALL
 Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpegRelease(JNIEnv *env, jobject thiz,
                                                                               jlong jContext) {
-    auto *const jniContext = reinterpret_cast<JniContext *>(jContext);
-    AVCodecContext *context = jniContext->codecContext;
-    if (context) {
-        sws_freeContext(jniContext->swsContext);
-        releaseContext(context);
-        delete jniContext;
-    }
+    releaseVideoContext(reinterpret_cast<JniContext *>(jContext));
 }
 
 extern "C"
@@ -262,7 +308,11 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpe
     }
 
     ANativeWindow_Buffer native_window_buffer;
-    int result = ANativeWindow_lock(jniContext->native_window, &native_window_buffer, nullptr);
+    int result;
+    {
+        DecoderStageTimer timer(&jniContext->stats, DECODER_STAGE_WINDOW_LOCK);
+        result = ANativeWindow_lock(jniContext->native_window, &native_window_buffer, nullptr);
+    }
     if (result == -19) {
         jniContext->surface = nullptr;
         return VIDEO_DECODER_SUCCESS;
@@ -294,42 +344,29 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpe
     int strideV = yuvStrides[kPlaneV];
 
 
-    const int32_t native_window_buffer_uv_height = (native_window_buffer.height + 1) / 2;
-    auto native_window_buffer_bits = reinterpret_cast<uint8_t *>(native_window_buffer.bits);
-    const int native_window_buffer_uv_stride = ALIGN(native_window_buffer.stride / 2, 16);
-    const int v_plane_height = std::min(native_window_buffer_uv_height, displayed_height);
-
-    const int y_plane_size = native_window_buffer.stride * native_window_buffer.height;
-    const int v_plane_size = v_plane_height * native_window_buffer_uv_stride;
-
     // source data
     uint8_t *src[3] = {planeY, planeU, planeV};
 
     // source strides
     int src_stride[3] = {strideY, strideU, strideV};
 
-    // destination data with u and v swapped
-    uint8_t *dest[3] = {native_window_buffer_bits,
-                        native_window_buffer_bits + y_plane_size + v_plane_size,
-                        native_window_buffer_bits + y_plane_size};
-
-    // destination strides
-    int dest_stride[3] = {native_window_buffer.stride,
-                          native_window_buffer_uv_stride,
-                          native_window_buffer_uv_stride};
-
-
-    //Perform color space conversion using sws_scale.
-    //Convert the source data (src) with specified strides (src_stride) and displayed height,
-    //and store the result in the destination data (dest) with corresponding strides (dest_stride).
-    sws_scale(jniContext->swsContext,
-              src, src_stride,
-              0, displayed_height,
-              dest, dest_stride);
+    {
+        DecoderStageTimer timer(&jniContext->stats, DECODER_STAGE_CONVERT);
+        convertToYv12(jniContext->swsContext,
+                      src, src_stride, displayed_height,
+                      reinterpret_cast<uint8_t *>(native_window_buffer.bits),
+                      native_window_buffer.stride,
+                      native_window_buffer.height);
+    }
 
     env->ReleaseIntArrayElements(*yuvStrides_array, yuvStrides, 0);
 
-    if (ANativeWindow_unlockAndPost(jniContext->native_window)) {
+    int postResult;
+    {
+        DecoderStageTimer timer(&jniContext->stats, DECODER_STAGE_WINDOW_POST);
+        postResult = ANativeWindow_unlockAndPost(jniContext->native_window);
+    }
+    if (postResult) {
         LOGE("kJniStatusANativeWindowError");
         return VIDEO_DECODER_ERROR_OTHER;
     }
@@ -348,26 +385,20 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpe
     auto *const jniContext = reinterpret_cast<JniContext *>(jContext);
     AVCodecContext *avContext = jniContext->codecContext;
 
-    auto *inputBuffer = (uint8_t *) env->GetDirectBufferAddress(encoded_data);
-    AVPacket packet = *av_packet_alloc();
-    packet.data = inputBuffer;
-    packet.size = length;
-    packet.pts = input_time;
+    AVPacket *packet = jniContext->packet;
+    packet->data = (uint8_t *) env->GetDirectBufferAddress(encoded_data);
+    packet->size = length;
+    packet->pts = input_time;
 
-    // Queue input data.
-    int result = avcodec_send_packet(avContext, &packet);
-    av_packet_unref(&packet);
-    if (result) {
-        logError("avcodec_send_packet", result);
-        if (result == AVERROR_INVALIDDATA) {
-            // need more data
-            return VIDEO_DECODER_ERROR_INVALID_DATA;
-        } else if (result == AVERROR(EAGAIN)) {
-            // need read frame
-            return VIDEO_DECODER_ERROR_READ_FRAME;
-        } else {
-            return VIDEO_DECODER_ERROR_OTHER;
-        }
+    int result;
+    {
+        DecoderStageTimer timer(&jniContext->stats, DECODER_STAGE_SEND_PACKET);
+        result = sendVideoPacket(avContext, packet);
+    }
+    av_packet_unref(packet);
+    if (result == VIDEO_DECODER_SUCCESS) {
+        jniContext->lastInputTimeUs = input_time;
+        traceCounter("ffmpeg.pendingPackets", ++jniContext->pendingPackets);
     }
     return result;
 }
@@ -378,6 +409,7 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpe
                                                                                    jobject thiz,
                                                                                    jlong jContext,
                                                                                    jint output_mode,
+                                                                                   jint deinterlace_mode,
                                                                                    jobject output_buffer,
                                                                                    jboolean decode_only) {
     auto *const jniContext = reinterpret_cast<JniContext *>(jContext);
@@ -388,7 +420,23 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpe
         LOGE("Failed to allocate output frame.");
         return VIDEO_DECODER_ERROR_OTHER;
     }
-    int result = avcodec_receive_frame(avContext, frame);
+    int result;
+    {
+        DecoderStageTimer timer(&jniContext->stats, DECODER_STAGE_RECEIVE_FRAME);
+        result = avcodec_receive_frame(avContext, frame);
+        if (result == AVERROR(EAGAIN)) {
+            // Polling without output says nothing about decode latency.
+            timer.cancel();
+        }
+    }
+
+    if (result == 0) {
+        if (jniContext->pendingPackets > 0) {
+            jniContext->pendingPackets--;
+        }
+        traceCounter("ffmpeg.pendingPackets", jniContext->pendingPackets);
+        traceCounter("ffmpeg.ptsLagUs", jniContext->lastInputTimeUs - frame->pts);
+    }
 
     // fail
     if (decode_only || result == AVERROR(EAGAIN)) {
@@ -424,17 +472,81 @@ Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpe
 
     jobject data_object = env->GetObjectField(output_buffer, jniContext->data_field);
     auto *data = reinterpret_cast<jbyte *>(env->GetDirectBufferAddress(data_object));
-    const int32_t uvHeight = (frame->height + 1) / 2;
-    const uint64_t yLength = frame->linesize[0] * frame->height;
-    const uint64_t uvLength = frame->linesize[1] * uvHeight;
-
-    // TODO: Support rotate YUV data
-
-    memcpy(data, frame->data[0], yLength);
-    memcpy(data + yLength, frame->data[1], uvLength);
-    memcpy(data + yLength + uvLength, frame->data[2], uvLength);
+    {
+        DecoderStageTimer timer(&jniContext->stats, DECODER_STAGE_COPY);
+        // Interlaced frames are deinterlaced on their way into the output buffer instead.
+        if (!jniContext->deinterlacer.deinterlace(
+                frame, static_cast<DeinterlaceMode>(deinterlace_mode),
+                reinterpret_cast<uint8_t *>(data))) {
+            copyYuvFrame(frame, reinterpret_cast<uint8_t *>(data));
+        }
+    }
 
     av_frame_free(&frame);
 
     return result;
-}
\ No newline at end of file
+}
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegVideoDecoder_ffmpegGetStats(JNIEnv *env,
+                                                                              jobject thiz,
+                                                                              jlong jContext) {
+    auto *const jniContext = reinterpret_cast<JniContext *>(jContext);
+    if (!jniContext) {
+        return nullptr;
+    }
+    return newStatsArray(env, jniContext->stats);
+}
+
+extern "C"
+JNIEXPORT jdouble JNICALL
+Java_io_github_anilbeesetti_nextlib_media3ext_ffdecoder_FfmpegDecoderBenchmark_ffmpegMeasureFrameRate(JNIEnv *env,
+                                                                                          jclass clazz,
+                                                                                          jstring codec_name,
+                                                                                          jbyteArray extra_data,
+                                                                                          jobjectArray access_units,
+                                                                                          jint threads,
+                                                                                          jlong budget_us) {
+    AVCodec *codec = getCodecByName(env, codec_name);
+    if (!codec) {
+        LOGE("Codec not found.");
+        return -1;
+    }
+    JniContext *jniContext = createVideoContext(env, codec, extra_data, threads);
+    if (!jniContext) {
+        return -1;
+    }
+
+    jsize packetCount = env->GetArrayLength(access_units);
+    std::vector<AVPacket *> packets;
+    bool allocated = true;
+    for (jsize i = 0; i < packetCount && allocated; i++) {
+        auto accessUnit = (jbyteArray) env->GetObjectArrayElement(access_units, i);
+        jsize size = env->GetArrayLength(accessUnit);
+        AVPacket *packet = av_packet_alloc();
+        // av_new_packet adds the input padding FFmpeg's bitstream readers expect.
+        allocated = packet && av_new_packet(packet, size) == 0;
+        if (allocated) {
+            env->GetByteArrayRegion(accessUnit, 0, size, (jbyte *) packet->data);
+            packet->pts = i;
+            packets.push_back(packet);
+        } else {
+            av_packet_free(&packet);
+        }
+        env->DeleteLocalRef(accessUnit);
+    }
+
+    double frameRate = -1;
+    if (allocated) {
+        frameRate = measureDecodeFrameRate(jniContext->codecContext, packets.data(),
+                                           (int) packets.size(), budget_us);
+    } else {
+        LOGE("Failed to allocate benchmark packets.");
+    }
+
+    for (AVPacket *packet: packets) {
+        av_packet_free(&packet);
+    }
+    releaseVideoContext(jniContext);
+    return frameRate;
+}
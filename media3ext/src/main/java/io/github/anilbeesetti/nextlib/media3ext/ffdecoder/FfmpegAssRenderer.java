@@ -0,0 +1,768 @@
+package io.github.anilbeesetti.nextlib.media3ext.ffdecoder;
+
+import static androidx.media3.common.util.Assertions.checkNotNull;
+
+import android.graphics.Bitmap;
+import android.os.Handler;
+import android.os.HandlerThread;
+import android.os.Looper;
+import android.os.Message;
+import android.os.ParcelFileDescriptor;
+import androidx.annotation.Nullable;
+import androidx.annotation.WorkerThread;
+import androidx.media3.common.C;
+import androidx.media3.common.Format;
+import androidx.media3.common.MimeTypes;
+import androidx.media3.common.text.Cue;
+import androidx.media3.common.text.CueGroup;
+import androidx.media3.common.util.Log;
+import androidx.media3.common.util.UnstableApi;
+import androidx.media3.common.util.Util;
+import androidx.media3.decoder.DecoderInputBuffer;
+import androidx.media3.exoplayer.BaseRenderer;
+import androidx.media3.exoplayer.FormatHolder;
+import androidx.media3.exoplayer.RendererCapabilities;
+import androidx.media3.exoplayer.source.MediaSource;
+import androidx.media3.exoplayer.text.TextOutput;
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.List;
+
+/**
+ * Renders ASS/SSA subtitles with libass, including their styling, positioning and karaoke effects.
+ *
+ * <p>libass runs on a thread of its own, so that laying out and blending a heavy frame does not
+ * hold up audio and video. The playback thread only reads samples and hands them over, and asks
+ * for the frame one render interval ahead of the one on screen, at most {@link #MAX_RENDER_RATE}
+ * times per second; it publishes each frame once playback reaches its time. libass's font, glyph
+ * and composite caches live as long as the renderer is enabled, and a frame in which nothing
+ * changed is not published at all. Of a changed frame, only regions whose pixels differ from the
+ * previous frame are copied into bitmaps. A bitmap is reused once the output has been handed the
+ * cues that replace it.
+ *
+ * <p>Scripts are laid out on a frame of the video's display aspect ratio, the shape of the
+ * subtitle view over the video, once {@link #setVideoSize(int, int, float)} has been called, which
+ * {@link NextRenderersFactory} does for the player's video.
+ *
+ * <p>Matroska samples only reach this renderer if the media source does not parse subtitles
+ * during extraction. Fonts attached to the file are not part of its samples; pass the file to
+ * {@link #addAttachedFonts(ParcelFileDescriptor)} to make them available.
+ */
+@UnstableApi
+public final class FfmpegAssRenderer extends BaseRenderer implements Handler.Callback {
+
+  private static final String TAG = "FfmpegAssRenderer";
+
+  private static final int MSG_UPDATE_OUTPUT = 1;
+
+  // Messages to the render thread.
+  private static final int MSG_INITIALIZE = 1;
+  private static final int MSG_NEW_TRACK = 2;
+  private static final int MSG_SAMPLE = 3;
+  private static final int MSG_RENDER = 4;
+  private static final int MSG_RELEASE = 5;
+
+  // Layout of the int[] assRender fills in, mirrored in ffass.cpp.
+  private static final int MAX_REGIONS = 16;
+  private static final int REGION_SIZE = 5;
+  private static final int RENDER_UNCHANGED = -1;
+
+  /**
+   * The frame scripts are laid out on fits in this size, at the video's aspect ratio, or 16:9
+   * without a video size.
+   */
+  private static final int DEFAULT_FRAME_WIDTH = 1920;
+  private static final int DEFAULT_FRAME_HEIGHT = 1080;
+
+  /** Karaoke and other animations are rendered at most this many times per second of media. */
+  private static final int MAX_RENDER_RATE = 30;
+  private static final long MIN_RENDER_INTERVAL_US = C.MICROS_PER_SECOND / MAX_RENDER_RATE;
+
+  // Replaced bitmaps kept for reuse, enough for every region of a frame.
+  private static final int MAX_POOLED_BITMAPS = MAX_REGIONS;
+
+  // Matroska samples are Dialogue lines with the start time removed and the end time relative to
+  // the start; see the Matroska extractor.
+  private static final byte[] DIALOGUE_PREFIX = "Dialogue: ".getBytes(StandardCharsets.UTF_8);
+  private static final byte[] SCRIPT_INFO = "[Script Info]".getBytes(StandardCharsets.UTF_8);
+
+  private final TextOutput output;
+  @Nullable private final Handler outputHandler;
+  private final FormatHolder formatHolder;
+  private final DecoderInputBuffer buffer;
+  // Filled on the output thread and drained on the render thread, so guarded by itself.
+  private final ArrayDeque<Bitmap> bitmapPool;
+  // Filled on the render thread and drained on the playback thread, so guarded by itself.
+  private final ArrayDeque<RenderedFrame> renderedFrames;
+
+  // Guards the fonts and the frame and video sizes, which may be set from any thread.
+  private final Object lock = new Object();
+  private final List<String> fontNames;
+  private final List<byte[]> fontData;
+  // 0 until setFrameSize is called.
+  private int requestedFrameWidth;
+  private int requestedFrameHeight;
+  // 0 until setVideoSize is called.
+  private int videoWidth;
+  private int videoHeight;
+  private float pixelWidthHeightRatio;
+
+  @Nullable private RenderThread renderThread;
+  private long streamOffsetUs;
+  private boolean inputStreamEnded;
+  // Bumped by seeks, track changes and late events; frames requested before are dropped.
+  private int generation;
+  // Whether a frame was requested and has not been published yet, and the time it is for.
+  private boolean renderPending;
+  private long requestedRenderTimeUs;
+  private boolean forceRender;
+  // Whether no frame was published since the renderer was enabled or the position reset.
+  private boolean waitingForFrame;
+  // Bitmaps replaced by frames that were not published, released with the next published cues.
+  private List<Bitmap> replacedBitmaps;
+
+  /**
+   * Creates an instance.
+   *
+   * @param output The output to send cues to.
+   * @param outputLooper The looper of the output's thread, or null to call it on the playback
+   *     thread.
+   */
+  public FfmpegAssRenderer(TextOutput output, @Nullable Looper outputLooper) {
+    super(C.TRACK_TYPE_TEXT);
+    this.output = checkNotNull(output);
+    outputHandler = outputLooper == null ? null : Util.createHandler(outputLooper, this);
+    formatHolder = new FormatHolder();
+    buffer = new DecoderInputBuffer(DecoderInputBuffer.BUFFER_REPLACEMENT_MODE_NORMAL);
+    bitmapPool = new ArrayDeque<>();
+    renderedFrames = new ArrayDeque<>();
+    fontNames = new ArrayList<>();
+    fontData = new ArrayList<>();
+    requestedRenderTimeUs = C.TIME_UNSET;
+    replacedBitmaps = new ArrayList<>();
+  }
+
+  /**
+   * Adds a font for scripts to use, e.g. one the app ships for scripts in its language. May be
+   * called from any thread.
+   *
+   * @param name The file name of the font, which scripts do not refer to.
+   * @param data The font file.
+   */
+  public void addFont(String name, byte[] data) {
+    synchronized (lock) {
+      fontNames.add(name);
+      fontData.add(data);
+    }
+  }
+
+  /**
+   * Adds the fonts attached to a Matroska file, which scripts of the file usually depend on. Reads
+   * the head of the file, so call it off the main thread, ideally before preparing the player.
+   *
+   * @param descriptor The file, which is only read during the call.
+   * @return The number of fonts added.
+   */
+  @WorkerThread
+  public int addAttachedFonts(ParcelFileDescriptor descriptor) {
+    if (!FfmpegLibrary.isAvailable()) {
+      return 0;
+    }
+    @Nullable Object[] fonts = assReadAttachedFonts(descriptor.getFd());
+    if (fonts == null) {
+      Log.w(TAG, "Failed to read attached fonts (see logcat).");
+      return 0;
+    }
+    for (int i = 0; i < fonts.length; i += 2) {
+      addFont((String) fonts[i], (byte[]) fonts[i + 1]);
+    }
+    return fonts.length / 2;
+  }
+
+  /**
+   * Sets the size scripts are laid out on, instead of one of the video's aspect ratio. Bitmaps
+   * are scaled to the subtitle view, so the size should have the view's aspect ratio; one closer
+   * to the view's size keeps text sharp and blending cheap. May be called from any thread.
+   */
+  public void setFrameSize(int width, int height) {
+    if (width <= 0 || height <= 0) {
+      return;
+    }
+    synchronized (lock) {
+      requestedFrameWidth = width;
+      requestedFrameHeight = height;
+    }
+  }
+
+  /**
+   * Sets the size of the video's decoded pictures, and the width of their pixels relative to
+   * their height, as in {@link androidx.media3.common.VideoSize}. libass scales scripts authored
+   * against the video's resolution by it, and lays them out at the video's display aspect ratio.
+   * May be called from any thread.
+   */
+  public void setVideoSize(int width, int height, float pixelWidthHeightRatio) {
+    if (width <= 0 || height <= 0 || pixelWidthHeightRatio <= 0) {
+      return;
+    }
+    synchronized (lock) {
+      videoWidth = width;
+      videoHeight = height;
+      this.pixelWidthHeightRatio = pixelWidthHeightRatio;
+    }
+  }
+
+  @Override
+  public String getName() {
+    return TAG;
+  }
+
+  @Override
+  public @Capabilities int supportsFormat(Format format) {
+    if (MimeTypes.TEXT_SSA.equals(format.sampleMimeType) && FfmpegLibrary.isAvailable()) {
+      return RendererCapabilities.create(C.FORMAT_HANDLED);
+    }
+    return RendererCapabilities.create(
+        MimeTypes.isText(format.sampleMimeType)
+            ? C.FORMAT_UNSUPPORTED_SUBTYPE
+            : C.FORMAT_UNSUPPORTED_TYPE);
+  }
+
+  @Override
+  protected void onEnabled(boolean joining, boolean mayRenderStartOfStream) {
+    renderThread = new RenderThread();
+    resetRendering();
+    waitingForFrame = true;
+  }
+
+  @Override
+  protected void onStreamChanged(
+      Format[] formats,
+      long startPositionUs,
+      long offsetUs,
+      MediaSource.MediaPeriodId mediaPeriodId) {
+    streamOffsetUs = offsetUs;
+    startTrack(formats[0]);
+  }
+
+  @Override
+  protected void onPositionReset(long positionUs, boolean joining) {
+    // Events already read stay in the track; samples read again are recognized by libass.
+    inputStreamEnded = false;
+    resetRendering();
+    waitingForFrame = true;
+  }
+
+  @Override
+  public void render(long positionUs, long elapsedRealtimeUs) {
+    // Samples are read even without libass, so that they do not pile up in the sample queue.
+    readSamples();
+    long timeUs = positionUs - streamOffsetUs;
+    publishRenderedFrames(timeUs);
+    if (!renderPending) {
+      // One interval after the frame on screen, or now if the render thread fell behind.
+      requestRender(
+          requestedRenderTimeUs == C.TIME_UNSET
+              ? timeUs
+              : Math.max(requestedRenderTimeUs + MIN_RENDER_INTERVAL_US, timeUs));
+    }
+  }
+
+  @Override
+  public boolean isReady() {
+    // Like a video renderer, ready once the frame for the position is there, so that it shows
+    // right after a seek while paused.
+    return !waitingForFrame;
+  }
+
+  @Override
+  public boolean isEnded() {
+    return inputStreamEnded;
+  }
+
+  @Override
+  protected void onDisabled() {
+    checkNotNull(renderThread).release();
+    renderThread = null;
+    resetRendering();
+    synchronized (renderedFrames) {
+      renderedFrames.clear();
+    }
+    // The render thread drops the bitmaps on screen; the pool is cleared too.
+    replacedBitmaps = new ArrayList<>();
+    updateOutput(new CueGroup(Collections.emptyList(), C.TIME_UNSET), Collections.emptyList());
+    synchronized (bitmapPool) {
+      bitmapPool.clear();
+    }
+  }
+
+  @Override
+  public boolean handleMessage(Message msg) {
+    if (msg.what == MSG_UPDATE_OUTPUT) {
+      OutputUpdate update = (OutputUpdate) msg.obj;
+      invokeOutput(update.cueGroup);
+      releaseBitmaps(update.replacedBitmaps);
+      return true;
+    }
+    throw new IllegalStateException();
+  }
+
+  private void startTrack(Format format) {
+    @Nullable byte[] header =
+        format.initializationData.size() > 1 ? format.initializationData.get(1) : null;
+    checkNotNull(renderThread).newTrack(header);
+    resetRendering();
+  }
+
+  /** Drops frames requested so far, and renders the next one in full. */
+  private void resetRendering() {
+    generation++;
+    renderPending = false;
+    requestedRenderTimeUs = C.TIME_UNSET;
+    forceRender = true;
+  }
+
+  /** Hands every sample that is available to libass, as events may start long before showing. */
+  private void readSamples() {
+    while (!inputStreamEnded) {
+      buffer.clear();
+      int result = readSource(formatHolder, buffer, /* readFlags= */ 0);
+      if (result == C.RESULT_FORMAT_READ) {
+        startTrack(checkNotNull(formatHolder.format));
+      } else if (result == C.RESULT_BUFFER_READ) {
+        if (buffer.isEndOfStream()) {
+          inputStreamEnded = true;
+        } else {
+          buffer.flip();
+          ByteBuffer data = checkNotNull(buffer.data);
+          int offset = data.arrayOffset() + data.position();
+          long timeUs = buffer.timeUs - streamOffsetUs;
+          checkNotNull(renderThread)
+              .queueSample(
+                  Arrays.copyOfRange(data.array(), offset, offset + data.remaining()), timeUs);
+          if (renderPending && timeUs <= requestedRenderTimeUs) {
+            // The frame being rendered ahead may have missed the event.
+            resetRendering();
+          }
+        }
+      } else {
+        return;
+      }
+    }
+  }
+
+  private void requestRender(long timeUs) {
+    renderPending = true;
+    requestedRenderTimeUs = timeUs;
+    checkNotNull(renderThread).render(timeUs, generation, forceRender);
+    forceRender = false;
+  }
+
+  /** Publishes the frame that was rendered ahead once playback reaches its time. */
+  private void publishRenderedFrames(long timeUs) {
+    while (true) {
+      RenderedFrame frame;
+      synchronized (renderedFrames) {
+        frame = renderedFrames.peekFirst();
+        if (frame == null || (frame.generation == generation && frame.timeUs > timeUs)) {
+          return;
+        }
+        renderedFrames.pollFirst();
+      }
+      // What a frame replaced is on screen until the next published cues, also if it is dropped.
+      replacedBitmaps.addAll(frame.replacedBitmaps);
+      if (frame.generation != generation) {
+        continue;
+      }
+      renderPending = false;
+      waitingForFrame = false;
+      if (frame.cueGroup != null) {
+        updateOutput(frame.cueGroup, replacedBitmaps);
+        replacedBitmaps = new ArrayList<>();
+      }
+    }
+  }
+
+  /** Returns a pooled bitmap reconfigured to the given size, or a new one. */
+  private Bitmap obtainBitmap(int width, int height) {
+    synchronized (bitmapPool) {
+      if (!bitmapPool.isEmpty()) {
+        Bitmap bitmap = bitmapPool.pollFirst();
+        if (bitmap.getAllocationByteCount() >= width * height * 4) {
+          bitmap.reconfigure(width, height, Bitmap.Config.ARGB_8888);
+          return bitmap;
+        }
+      }
+    }
+    return Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888);
+  }
+
+  /**
+   * Returns bitmaps to the pool. Only called on the output thread once the cues that replaced
+   * them have been delivered, as the subtitle view draws the cues it was last given.
+   */
+  private void releaseBitmaps(List<Bitmap> replacedBitmaps) {
+    synchronized (bitmapPool) {
+      for (Bitmap bitmap : replacedBitmaps) {
+        bitmapPool.addLast(bitmap);
+        if (bitmapPool.size() > MAX_POOLED_BITMAPS) {
+          bitmapPool.pollFirst();
+        }
+      }
+    }
+  }
+
+  private void updateOutput(CueGroup cueGroup, List<Bitmap> replacedBitmaps) {
+    if (outputHandler != null) {
+      outputHandler
+          .obtainMessage(MSG_UPDATE_OUTPUT, new OutputUpdate(cueGroup, replacedBitmaps))
+          .sendToTarget();
+    } else {
+      invokeOutput(cueGroup);
+      releaseBitmaps(replacedBitmaps);
+    }
+  }
+
+  @SuppressWarnings("deprecation") // Calling the deprecated method for apps that still override it.
+  private void invokeOutput(CueGroup cueGroup) {
+    output.onCues(cueGroup.cues);
+    output.onCues(cueGroup);
+  }
+
+  private static boolean startsWith(byte[] array, int offset, int length, byte[] prefix) {
+    if (length < prefix.length) {
+      return false;
+    }
+    for (int i = 0; i < prefix.length; i++) {
+      if (array[offset + i] != prefix[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  private static int indexOf(byte[] array, int start, int end, byte value) {
+    for (int i = start; i < end; i++) {
+      if (array[i] == value) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /** Parses an H:MM:SS:cc or H:MM:SS.cc timecode, returning 0 if it is malformed. */
+  private static long parseTimecodeMs(byte[] array, int start, int end) {
+    long[] fields = new long[4];
+    int field = 0;
+    for (int i = start; i < end; i++) {
+      byte c = array[i];
+      if (c >= '0' && c <= '9') {
+        fields[field] = fields[field] * 10 + (c - '0');
+      } else if ((c == ':' || c == '.') && field < fields.length - 1) {
+        field++;
+      } else if (c != ' ') {
+        return 0;
+      }
+    }
+    return ((fields[0] * 60 + fields[1]) * 60 + fields[2]) * 1000 + fields[3] * 10;
+  }
+
+  /**
+   * The thread libass runs on, which owns its context and the bitmaps of the regions of the last
+   * rendered frame.
+   */
+  private final class RenderThread implements Handler.Callback {
+
+    private final HandlerThread thread;
+    private final Handler handler;
+    private final int[] regions;
+
+    private long nativeContext;
+    // How many fonts the native context has, and the sizes it renders at.
+    private int nativeFontCount;
+    private int frameWidth;
+    private int frameHeight;
+    private int storageWidth;
+    private int storageHeight;
+    // Whether a whole script was read from a single sample, which must not be read again.
+    private boolean scriptLoaded;
+    // Bitmaps of the regions of the last rendered frame, by region index.
+    private Bitmap[] bitmaps;
+    private Cue[] cues;
+
+    private RenderThread() {
+      thread = new HandlerThread("ExoPlayer:FfmpegAssRenderer");
+      thread.start();
+      handler = Util.createHandler(thread.getLooper(), this);
+      regions = new int[MAX_REGIONS * REGION_SIZE];
+      bitmaps = new Bitmap[0];
+      cues = new Cue[0];
+      handler.sendEmptyMessage(MSG_INITIALIZE);
+    }
+
+    private void newTrack(@Nullable byte[] header) {
+      handler.obtainMessage(MSG_NEW_TRACK, header).sendToTarget();
+    }
+
+    private void queueSample(byte[] data, long timeUs) {
+      handler.obtainMessage(MSG_SAMPLE, new Sample(data, timeUs)).sendToTarget();
+    }
+
+    private void render(long timeUs, int generation, boolean force) {
+      handler.obtainMessage(MSG_RENDER, generation, force ? 1 : 0, timeUs).sendToTarget();
+    }
+
+    /** Releases libass once a frame being rendered is done, and ends the thread. */
+    private void release() {
+      handler.removeCallbacksAndMessages(null);
+      handler.sendEmptyMessage(MSG_RELEASE);
+      thread.quitSafely();
+    }
+
+    @Override
+    public boolean handleMessage(Message msg) {
+      switch (msg.what) {
+        case MSG_INITIALIZE:
+          frameWidth = DEFAULT_FRAME_WIDTH;
+          frameHeight = DEFAULT_FRAME_HEIGHT;
+          nativeContext = assInitialize(frameWidth, frameHeight);
+          if (nativeContext == 0) {
+            Log.e(TAG, "Failed to initialize libass (see logcat).");
+          }
+          return true;
+        case MSG_NEW_TRACK:
+          if (nativeContext != 0 && !assNewTrack(nativeContext, (byte[]) msg.obj)) {
+            Log.e(TAG, "Failed to create an ASS track (see logcat).");
+          }
+          scriptLoaded = false;
+          return true;
+        case MSG_SAMPLE:
+          if (nativeContext != 0) {
+            Sample sample = (Sample) msg.obj;
+            processSample(sample.data, sample.timeUs);
+          }
+          return true;
+        case MSG_RENDER:
+          renderFrame((Long) msg.obj, msg.arg1, msg.arg2 != 0);
+          return true;
+        case MSG_RELEASE:
+          if (nativeContext != 0) {
+            assRelease(nativeContext);
+            nativeContext = 0;
+          }
+          return true;
+        default:
+          throw new IllegalStateException();
+      }
+    }
+
+    private void renderFrame(long timeUs, int generation, boolean force) {
+      @Nullable CueGroup cueGroup = null;
+      List<Bitmap> replacedBitmaps = Collections.emptyList();
+      if (nativeContext != 0) {
+        force |= applyPendingSettings();
+        int count = assRender(nativeContext, timeUs / 1000, force, regions);
+        if (count != RENDER_UNCHANGED) {
+          replacedBitmaps = updateCues(count);
+          cueGroup = new CueGroup(Arrays.asList(cues), timeUs);
+        }
+      }
+      synchronized (renderedFrames) {
+        renderedFrames.addLast(new RenderedFrame(generation, timeUs, cueGroup, replacedBitmaps));
+      }
+    }
+
+    /**
+     * Hands fonts and sizes set since the last render to libass, returning whether any changed.
+     */
+    private boolean applyPendingSettings() {
+      boolean changed = false;
+      int width;
+      int height;
+      int videoWidth;
+      int videoHeight;
+      synchronized (lock) {
+        for (; nativeFontCount < fontNames.size(); nativeFontCount++) {
+          assAddFont(nativeContext, fontNames.get(nativeFontCount), fontData.get(nativeFontCount));
+          changed = true;
+        }
+        videoWidth = FfmpegAssRenderer.this.videoWidth;
+        videoHeight = FfmpegAssRenderer.this.videoHeight;
+        if (requestedFrameWidth > 0) {
+          width = requestedFrameWidth;
+          height = requestedFrameHeight;
+        } else if (videoWidth > 0) {
+          float aspectRatio = videoWidth * pixelWidthHeightRatio / videoHeight;
+          if (aspectRatio > (float) DEFAULT_FRAME_WIDTH / DEFAULT_FRAME_HEIGHT) {
+            width = DEFAULT_FRAME_WIDTH;
+            height = Math.max(1, Math.round(DEFAULT_FRAME_WIDTH / aspectRatio));
+          } else {
+            width = Math.max(1, Math.round(DEFAULT_FRAME_HEIGHT * aspectRatio));
+            height = DEFAULT_FRAME_HEIGHT;
+          }
+        } else {
+          width = DEFAULT_FRAME_WIDTH;
+          height = DEFAULT_FRAME_HEIGHT;
+        }
+      }
+      if (videoWidth != storageWidth || videoHeight != storageHeight) {
+        storageWidth = videoWidth;
+        storageHeight = videoHeight;
+        assSetStorageSize(nativeContext, storageWidth, storageHeight);
+        changed = true;
+      }
+      if (width != frameWidth || height != frameHeight) {
+        frameWidth = width;
+        frameHeight = height;
+        assSetFrameSize(nativeContext, frameWidth, frameHeight);
+        changed = true;
+      }
+      return changed;
+    }
+
+    private void processSample(byte[] data, long timeUs) {
+      if (startsWith(data, 0, data.length, DIALOGUE_PREFIX)) {
+        // Dialogue: 0:00:00:00,<duration>,ReadOrder,Layer,Style,...
+        int startComma = indexOf(data, DIALOGUE_PREFIX.length, data.length, (byte) ',');
+        int durationComma = indexOf(data, startComma + 1, data.length, (byte) ',');
+        if (startComma < 0 || durationComma < 0) {
+          Log.w(TAG, "Skipping malformed dialogue sample.");
+          return;
+        }
+        long durationMs = parseTimecodeMs(data, startComma + 1, durationComma);
+        assProcessChunk(
+            nativeContext,
+            data,
+            durationComma + 1,
+            data.length - durationComma - 1,
+            timeUs / 1000,
+            durationMs);
+      } else if (startsWith(data, 0, data.length, SCRIPT_INFO)) {
+        // A whole script, from a side-loaded file. Its events carry their own times.
+        if (!scriptLoaded) {
+          assProcessData(nativeContext, data, 0, data.length);
+          scriptLoaded = true;
+        }
+      } else {
+        Log.w(TAG, "Skipping unrecognized SSA sample.");
+      }
+    }
+
+    /** Updates the bitmaps and cues to the regions, returning the bitmaps no longer used. */
+    private List<Bitmap> updateCues(int count) {
+      Bitmap[] newBitmaps = new Bitmap[count];
+      Cue[] newCues = new Cue[count];
+      boolean[] reused = new boolean[bitmaps.length];
+      float width = frameWidth;
+      float height = frameHeight;
+      for (int i = 0; i < count; i++) {
+        int base = i * REGION_SIZE;
+        int previous = regions[base + 4];
+        if (previous >= 0 && previous < bitmaps.length) {
+          // Same pixels at the same place: keep the bitmap and the cue.
+          reused[previous] = true;
+          newBitmaps[i] = bitmaps[previous];
+          newCues[i] = cues[previous];
+          continue;
+        }
+        int regionWidth = regions[base + 2];
+        int regionHeight = regions[base + 3];
+        Bitmap bitmap = obtainBitmap(regionWidth, regionHeight);
+        if (!assCopyRegion(nativeContext, i, bitmap)) {
+          bitmap.eraseColor(0);
+        }
+        newBitmaps[i] = bitmap;
+        newCues[i] =
+            new Cue.Builder()
+                .setBitmap(bitmap)
+                .setPosition(regions[base] / width)
+                .setPositionAnchor(Cue.ANCHOR_TYPE_START)
+                .setLine(regions[base + 1] / height, Cue.LINE_TYPE_FRACTION)
+                .setLineAnchor(Cue.ANCHOR_TYPE_START)
+                .setSize(regionWidth / width)
+                .setBitmapHeight(regionHeight / height)
+                .build();
+      }
+      List<Bitmap> replacedBitmaps = new ArrayList<>();
+      for (int i = 0; i < bitmaps.length; i++) {
+        if (!reused[i]) {
+          replacedBitmaps.add(bitmaps[i]);
+        }
+      }
+      bitmaps = newBitmaps;
+      cues = newCues;
+      return replacedBitmaps;
+    }
+  }
+
+  /** A sample copied out of the input buffer for the render thread. */
+  private static final class Sample {
+
+    private final byte[] data;
+    private final long timeUs;
+
+    private Sample(byte[] data, long timeUs) {
+      this.data = data;
+      this.timeUs = timeUs;
+    }
+  }
+
+  /**
+   * A frame rendered ahead: its cues, or null if nothing changed, and the bitmaps of the cues
+   * they replace.
+   */
+  private static final class RenderedFrame {
+
+    private final int generation;
+    private final long timeUs;
+    @Nullable private final CueGroup cueGroup;
+    private final List<Bitmap> replacedBitmaps;
+
+    private RenderedFrame(
+        int generation, long timeUs, @Nullable CueGroup cueGroup, List<Bitmap> replacedBitmaps) {
+      this.generation = generation;
+      this.timeUs = timeUs;
+      this.cueGroup = cueGroup;
+      this.replacedBitmaps = replacedBitmaps;
+    }
+  }
+
+  /** Cues for the output, and the bitmaps of the cues they replace. */
+  private static final class OutputUpdate {
+
+    private final CueGroup cueGroup;
+    private final List<Bitmap> replacedBitmaps;
+
+    private OutputUpdate(CueGroup cueGroup, List<Bitmap> replacedBitmaps) {
+      this.cueGroup = cueGroup;
+      this.replacedBitmaps = replacedBitmaps;
+    }
+  }
+
+  private native long assInitialize(int width, int height);
+
+  private native void assAddFont(long context, String name, byte[] data);
+
+  private native boolean assNewTrack(long context, @Nullable byte[] header);
+
+  private native void assProcessChunk(
+      long context, byte[] data, int offset, int length, long timeMs, long durationMs);
+
+  private native void assProcessData(long context, byte[] data, int offset, int length);
+
+  private native void assSetFrameSize(long context, int width, int height);
+
+  private native void assSetStorageSize(long context, int width, int height);
+
+  private native int assRender(long context, long timeMs, boolean force, int[] regions);
+
+  private native boolean assCopyRegion(long context, int index, Bitmap bitmap);
+
+  private native void assRelease(long context);
+
+  @Nullable
+  private static native Object[] assReadAttachedFonts(int fd);
+}
@@ -37,6 +37,8 @@ final class FfmpegAudioDecoder
   private int outputBufferSize;
 
   private long nativeContext; // May be reassigned on resetting the codec.
+  // Guards nativeContext against release while another thread reads the stats.
+  private final Object statsLock = new Object();
   private boolean hasOutputFormat;
   private volatile int channelCount;
   private volatile int sampleRate;
@@ -92,7 +94,9 @@ final class FfmpegAudioDecoder
   protected FfmpegDecoderException decode(
       DecoderInputBuffer inputBuffer, SimpleDecoderOutputBuffer outputBuffer, boolean reset) {
     if (reset) {
-      nativeContext = ffmpegReset(nativeContext, extraData);
+      synchronized (statsLock) {
+        nativeContext = ffmpegReset(nativeContext, extraData);
+      }
       if (nativeContext == 0) {
         return new FfmpegDecoderException("Error resetting (see logcat).");
       }
@@ -147,8 +151,21 @@ final class FfmpegAudioDecoder
   @Override
   public void release() {
     super.release();
-    ffmpegRelease(nativeContext);
-    nativeContext = 0;
+    synchronized (statsLock) {
+      ffmpegRelease(nativeContext);
+      nativeContext = 0;
+    }
+  }
+
+  /**
+   * Returns a snapshot of the native decode counters, or null if the decoder has been released.
+   * May be called from any thread.
+   */
+  @Nullable
+  public FfmpegDecoderStats getStats() {
+    synchronized (statsLock) {
+      return nativeContext == 0 ? null : FfmpegDecoderStats.fromNative(ffmpegGetStats(nativeContext));
+    }
   }
 
   /** Returns the channel count of output audio. */
@@ -230,4 +247,6 @@ final class FfmpegAudioDecoder
   private native long ffmpegReset(long context, @Nullable byte[] extraData);
 
   private native void ffmpegRelease(long context);
+
+  private native long[] ffmpegGetStats(long context);
 }
@@ -32,6 +32,8 @@ public final class FfmpegAudioRenderer extends DecoderAudioRenderer<FfmpegAudioD
   /** The default input buffer size. */
   private static final int DEFAULT_INPUT_BUFFER_SIZE = 960 * 6;
 
+  @Nullable private volatile FfmpegAudioDecoder decoder;
+
   public FfmpegAudioRenderer() {
     this(/* eventHandler= */ null, /* eventListener= */ null);
   }
@@ -109,10 +111,21 @@ public final class FfmpegAudioRenderer extends DecoderAudioRenderer<FfmpegAudioD
     FfmpegAudioDecoder decoder =
         new FfmpegAudioDecoder(
             format, NUM_BUFFERS, NUM_BUFFERS, initialInputBufferSize, shouldOutputFloat(format));
+    this.decoder = decoder;
     TraceUtil.endSection();
     return decoder;
   }
 
+  /**
+   * Returns a snapshot of the native counters of the current decoder, or null if there is none.
+   * May be called from any thread.
+   */
+  @Nullable
+  public FfmpegDecoderStats getDecoderStats() {
+    FfmpegAudioDecoder decoder = this.decoder;
+    return decoder == null ? null : decoder.getStats();
+  }
+
   /**
    * {@inheritDoc}
    *
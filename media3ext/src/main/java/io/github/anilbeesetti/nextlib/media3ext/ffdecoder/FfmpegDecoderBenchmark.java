@@ -0,0 +1,178 @@
+package io.github.anilbeesetti.nextlib.media3ext.ffdecoder;
+
+import android.content.Context;
+import android.content.SharedPreferences;
+import android.os.Build;
+import androidx.annotation.Nullable;
+import androidx.annotation.WorkerThread;
+import androidx.media3.common.Format;
+import androidx.media3.common.util.Assertions;
+import androidx.media3.common.util.Log;
+import androidx.media3.common.util.UnstableApi;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+
+/**
+ * Measures how many frames per second the FFmpeg video decoders reach on this device, so that
+ * {@link FfmpegVideoRenderer} is only chosen for streams it can decode in real time.
+ *
+ * <p>Results are kept per codec and resolution class, and survive restarts until the device
+ * build or the FFmpeg version changes. They are read from disk once, when the instance is
+ * created, so that {@link #canDecodeInRealTime} stays a lookup in memory on the playback thread.
+ * Measuring is up to the app, typically once on a background thread with a short clip per codec
+ * and resolution it cares about.
+ */
+@UnstableApi
+public final class FfmpegDecoderBenchmark {
+
+  private static final String TAG = "FfmpegDecoderBenchmark";
+  private static final String PREFERENCES_NAME = "nextlib_decoder_benchmark";
+  private static final String KEY_FINGERPRINT = "fingerprint";
+
+  /** The default time spent decoding a clip, in milliseconds. */
+  public static final long DEFAULT_BUDGET_MS = 1000;
+
+  /** Frame rate assumed for streams that do not declare one. */
+  private static final float DEFAULT_FRAME_RATE = 30;
+
+  private final SharedPreferences preferences;
+  private final int threads;
+  // Measured frame rates by key(), mirroring the preferences.
+  private final Map<String, Float> frameRates;
+
+  /**
+   * Creates an instance that measures with as many decoder threads as {@link
+   * FfmpegVideoRenderer} uses by default. Reads the stored results, so prefer creating it once,
+   * off the main thread.
+   */
+  public FfmpegDecoderBenchmark(Context context) {
+    this(context, Runtime.getRuntime().availableProcessors());
+  }
+
+  /**
+   * Creates an instance. Reads the stored results, so prefer creating it once, off the main
+   * thread.
+   *
+   * @param context A context.
+   * @param threads Number of decoder threads, which should match the renderer's.
+   */
+  public FfmpegDecoderBenchmark(Context context, int threads) {
+    this.preferences =
+        context.getApplicationContext().getSharedPreferences(PREFERENCES_NAME, Context.MODE_PRIVATE);
+    this.threads = threads;
+    this.frameRates = new ConcurrentHashMap<>();
+    loadFrameRates();
+  }
+
+  /**
+   * Decodes {@code accessUnits} repeatedly for about {@code budgetMs} milliseconds, then stores
+   * and returns the frames per second reached.
+   *
+   * @param format The format of the clip. Its sample MIME type, width, height and initialization
+   *     data are used.
+   * @param accessUnits The samples of the clip in decode order, as an extractor returns them.
+   * @param budgetMs How long to decode for, in milliseconds.
+   * @return The decoded frames per second, or {@link Format#NO_VALUE} if the clip could not be
+   *     decoded.
+   */
+  @WorkerThread
+  public float measure(Format format, List<byte[]> accessUnits, long budgetMs) {
+    String mimeType = Assertions.checkNotNull(format.sampleMimeType);
+    Assertions.checkArgument(format.width > 0 && format.height > 0);
+    Assertions.checkArgument(!accessUnits.isEmpty());
+    if (!FfmpegLibrary.supportsFormat(mimeType)) {
+      return Format.NO_VALUE;
+    }
+    String codecName = Assertions.checkNotNull(FfmpegLibrary.getCodecName(mimeType));
+    double frameRate =
+        ffmpegMeasureFrameRate(
+            codecName,
+            FfmpegVideoDecoder.getExtraData(mimeType, format.initializationData),
+            accessUnits.toArray(new byte[0][]),
+            threads,
+            budgetMs * 1000);
+    if (frameRate <= 0) {
+      Log.w(TAG, "Could not decode the " + codecName + " benchmark clip.");
+      return Format.NO_VALUE;
+    }
+    Log.i(TAG, codecName + " " + format.width + "x" + format.height + ": " + frameRate + " fps");
+    String key = key(mimeType, format.width, format.height);
+    frameRates.put(key, (float) frameRate);
+    preferences.edit().putFloat(key, (float) frameRate).apply();
+    return (float) frameRate;
+  }
+
+  /**
+   * Returns the frames per second measured for the codec at the resolution class of {@code width}
+   * x {@code height}, or {@link Format#NO_VALUE} if it has not been measured.
+   */
+  public float getFrameRate(String mimeType, int width, int height) {
+    @Nullable Float frameRate = frameRates.get(key(mimeType, width, height));
+    return frameRate != null ? frameRate : Format.NO_VALUE;
+  }
+
+  /**
+   * Returns whether the measured throughput covers the frame rate of {@code format}, assuming 30
+   * fps if it declares none. Formats that were never measured are assumed to be decodable.
+   */
+  public boolean canDecodeInRealTime(Format format) {
+    if (format.sampleMimeType == null || format.width <= 0 || format.height <= 0) {
+      return true;
+    }
+    float measuredFrameRate = getFrameRate(format.sampleMimeType, format.width, format.height);
+    if (measuredFrameRate == Format.NO_VALUE) {
+      return true;
+    }
+    float frameRate = format.frameRate != Format.NO_VALUE ? format.frameRate : DEFAULT_FRAME_RATE;
+    return measuredFrameRate >= frameRate;
+  }
+
+  /**
+   * Copies the stored results into {@link #frameRates}, or drops them if they were measured on
+   * another build or FFmpeg version. Neither can change while the process runs, so once is enough.
+   */
+  private void loadFrameRates() {
+    String fingerprint = Build.FINGERPRINT + "/" + FfmpegLibrary.getVersion() + "/" + threads;
+    if (!fingerprint.equals(preferences.getString(KEY_FINGERPRINT, null))) {
+      preferences.edit().clear().putString(KEY_FINGERPRINT, fingerprint).apply();
+      return;
+    }
+    for (Map.Entry<String, ?> entry : preferences.getAll().entrySet()) {
+      if (entry.getValue() instanceof Float) {
+        frameRates.put(entry.getKey(), (Float) entry.getValue());
+      }
+    }
+  }
+
+  private static String key(String mimeType, int width, int height) {
+    return mimeType + "/" + getResolutionClass(width, height);
+  }
+
+  /**
+   * Groups resolutions whose decode cost is close, so that one measurement covers e.g. every 1080p
+   * variant.
+   */
+  private static String getResolutionClass(int width, int height) {
+    long pixels = (long) width * height;
+    if (pixels <= 720 * 576) {
+      return "sd";
+    } else if (pixels <= 1280 * 720) {
+      return "hd";
+    } else if (pixels <= 1920 * 1088) {
+      return "fhd";
+    } else if (pixels <= 2560 * 1600) {
+      return "qhd";
+    } else if (pixels <= 4096 * 2304) {
+      return "uhd";
+    }
+    return "8k";
+  }
+
+  private static native double ffmpegMeasureFrameRate(
+      String codecName,
+      @Nullable byte[] extraData,
+      byte[][] accessUnits,
+      int threads,
+      long budgetUs);
+}
@@ -0,0 +1,105 @@
+package io.github.anilbeesetti.nextlib.media3ext.ffdecoder;
+
+import androidx.annotation.Nullable;
+import androidx.media3.common.util.UnstableApi;
+
+/**
+ * Snapshot of the native counters of an FFmpeg decoder, for attributing dropped frames and
+ * stalls to a stage of the decode path.
+ *
+ * <p>Each stage keeps a call count, the total and maximum time spent in it, and a latency
+ * histogram. Bucket 0 counts calls under 1 µs, bucket {@code i} calls taking between {@code
+ * 2^(i-1)} and {@code 2^i} µs, and the last bucket everything slower.
+ */
+@UnstableApi
+public final class FfmpegDecoderStats {
+
+  /** {@code avcodec_send_packet}. */
+  public static final int STAGE_SEND_PACKET = 0;
+  /** {@code avcodec_receive_frame}, only counting calls that returned a frame. */
+  public static final int STAGE_RECEIVE_FRAME = 1;
+  /** Copy of the decoded YUV planes into the output buffer, deinterlacing included. */
+  public static final int STAGE_COPY = 2;
+  /** Audio resampling, or video conversion into the surface buffer. */
+  public static final int STAGE_CONVERT = 3;
+  /** Locking the output surface. */
+  public static final int STAGE_WINDOW_LOCK = 4;
+  /** Posting the output surface. */
+  public static final int STAGE_WINDOW_POST = 5;
+
+  // Must match the layout constants in ffstats.h.
+  private static final int VERSION = 1;
+  private static final int HEADER_SIZE = 4;
+  private static final int STAGE_HEADER_SIZE = 3;
+
+  private final long[] values;
+  private final int stageCount;
+  private final int bucketCount;
+
+  private FfmpegDecoderStats(long[] values) {
+    this.values = values;
+    this.stageCount = (int) values[1];
+    this.bucketCount = (int) values[2];
+  }
+
+  /** Parses the array returned by a decoder, or returns null if its layout is not understood. */
+  @Nullable
+  /* package */ static FfmpegDecoderStats fromNative(@Nullable long[] values) {
+    if (values == null || values.length < HEADER_SIZE || values[0] != VERSION) {
+      return null;
+    }
+    int expectedSize = HEADER_SIZE + (int) values[1] * (STAGE_HEADER_SIZE + (int) values[2]);
+    return values.length == expectedSize ? new FfmpegDecoderStats(values) : null;
+  }
+
+  /** Returns the number of stages, which are numbered from 0. */
+  public int getStageCount() {
+    return stageCount;
+  }
+
+  /** Returns the number of histogram buckets of every stage. */
+  public int getBucketCount() {
+    return bucketCount;
+  }
+
+  /** Returns how often the audio output buffer had to be grown while decoding. */
+  public long getGrowOutputBufferCount() {
+    return values[3];
+  }
+
+  /** Returns the number of timed calls of the stage. */
+  public long getCount(int stage) {
+    return values[stageOffset(stage)];
+  }
+
+  /** Returns the total time spent in the stage, in nanoseconds. */
+  public long getTotalNs(int stage) {
+    return values[stageOffset(stage) + 1];
+  }
+
+  /** Returns the longest single call of the stage, in nanoseconds. */
+  public long getMaxNs(int stage) {
+    return values[stageOffset(stage) + 2];
+  }
+
+  /** Returns the mean time of a call of the stage in nanoseconds, or 0 if it was never called. */
+  public long getMeanNs(int stage) {
+    long count = getCount(stage);
+    return count == 0 ? 0 : getTotalNs(stage) / count;
+  }
+
+  /** Returns the number of calls of the stage that fell into the histogram bucket. */
+  public long getBucketCount(int stage, int bucket) {
+    if (bucket < 0 || bucket >= bucketCount) {
+      throw new IndexOutOfBoundsException("bucket " + bucket);
+    }
+    return values[stageOffset(stage) + STAGE_HEADER_SIZE + bucket];
+  }
+
+  private int stageOffset(int stage) {
+    if (stage < 0 || stage >= stageCount) {
+      throw new IndexOutOfBoundsException("stage " + stage);
+    }
+    return HEADER_SIZE + stage * (STAGE_HEADER_SIZE + bucketCount);
+  }
+}
@@ -4,6 +4,7 @@ import androidx.annotation.Nullable;
 import androidx.media3.common.C;
 import androidx.media3.common.MediaLibraryInfo;
 import androidx.media3.common.MimeTypes;
+import androidx.media3.common.util.Assertions;
 import androidx.media3.common.util.LibraryLoader;
 import androidx.media3.common.util.Log;
 import androidx.media3.common.util.UnstableApi;
@@ -74,6 +75,21 @@ public final class FfmpegLibrary {
     return inputBufferPaddingSize;
   }
 
+  /**
+   * Sets how many released video decoders are kept open, to be reused by the next decoder of the
+   * same codec, initialization data and thread count. This saves opening the codec and starting its
+   * threads on every playlist item. Defaults to 2; 0 frees the kept decoders, e.g. when memory runs
+   * low.
+   *
+   * @param capacity The maximum number of kept decoders.
+   */
+  public static void setVideoDecoderPoolCapacity(int capacity) {
+    Assertions.checkArgument(capacity >= 0);
+    if (isAvailable()) {
+      ffmpegSetVideoDecoderPoolCapacity(capacity);
+    }
+  }
+
   /**
    * Returns whether the underlying library supports the specified MIME type.
    *
@@ -122,15 +138,39 @@ public final class FfmpegLibrary {
       case MimeTypes.VIDEO_H265 -> "hevc";
       case MimeTypes.VIDEO_MPEG -> "mpegvideo";
       case MimeTypes.VIDEO_MPEG2 -> "mpeg2video";
-      case MimeTypes.VIDEO_VP8 -> "libvpx";
-      case MimeTypes.VIDEO_VP9 -> "libvpx-vp9";
+      // FFmpeg's own decoders are frame threaded and have SIMD on every ABI, so they come first.
+      case MimeTypes.VIDEO_VP8 -> firstAvailableDecoder("vp8", "libvpx");
+      case MimeTypes.VIDEO_VP9 -> firstAvailableDecoder("vp9", "libvpx-vp9");
+      case MimeTypes.VIDEO_AV1 -> "libdav1d";
+
+      // Bitmap subtitle codecs
+      case MimeTypes.APPLICATION_PGS -> "pgssub";
+      case MimeTypes.APPLICATION_DVBSUBS -> "dvbsub";
+      case MimeTypes.APPLICATION_VOBSUB -> "dvdsub";
       default -> null;
     };
   }
 
+  /**
+   * Returns the first of the given decoders that the library was built with, or the last one if
+   * the library is not available, so that callers still log a meaningful name.
+   */
+  private static String firstAvailableDecoder(String... codecNames) {
+    if (isAvailable()) {
+      for (String codecName : codecNames) {
+        if (ffmpegHasDecoder(codecName)) {
+          return codecName;
+        }
+      }
+    }
+    return codecNames[codecNames.length - 1];
+  }
+
   private static native String ffmpegGetVersion();
 
   private static native int ffmpegGetInputBufferPaddingSize();
 
   private static native boolean ffmpegHasDecoder(String codecName);
+
+  private static native void ffmpegSetVideoDecoderPoolCapacity(int capacity);
 }
@@ -0,0 +1,268 @@
+package io.github.anilbeesetti.nextlib.media3ext.ffdecoder;
+
+import static androidx.media3.common.util.Assertions.checkNotNull;
+
+import android.annotation.SuppressLint;
+import android.graphics.Bitmap;
+import androidx.annotation.Nullable;
+import androidx.media3.common.C;
+import androidx.media3.common.Format;
+import androidx.media3.common.MimeTypes;
+import androidx.media3.common.text.Cue;
+import androidx.media3.decoder.SimpleDecoder;
+import androidx.media3.extractor.text.Subtitle;
+import androidx.media3.extractor.text.SubtitleDecoder;
+import androidx.media3.extractor.text.SubtitleDecoderException;
+import androidx.media3.extractor.text.SubtitleInputBuffer;
+import androidx.media3.extractor.text.SubtitleOutputBuffer;
+import java.nio.ByteBuffer;
+import java.util.Collections;
+import java.util.List;
+
+/**
+ * FFmpeg decoder for bitmap subtitles (PGS, DVB and VobSub).
+ *
+ * <p>The native side composites every event into a canvas that lives as long as the decoder and
+ * reports which region changed. Each event that changes the screen gets its cue bitmap cropped
+ * from that canvas into a new {@link Bitmap}, which is never written again: published cues may be
+ * drawn by the subtitle view at any time, with no signal when it lets go of them. An event that
+ * leaves the screen unchanged, like the periodic page refreshes of DVB, shares the bitmap of the
+ * previous one.
+ */
+/* package */
+@SuppressLint("UnsafeOptInUsageError")
+final class FfmpegSubtitleDecoder
+    extends SimpleDecoder<SubtitleInputBuffer, SubtitleOutputBuffer, SubtitleDecoderException>
+    implements SubtitleDecoder {
+
+  private static final int NUM_INPUT_BUFFERS = 2;
+  private static final int NUM_OUTPUT_BUFFERS = 2;
+
+  private static final int SUBTITLE_DECODER_NO_OUTPUT = 0;
+  private static final int SUBTITLE_DECODER_ERROR_INVALID_DATA = -1;
+  private static final int SUBTITLE_DECODER_ERROR_OTHER = -2;
+
+  // Layout of the int[] ffmpegDecode fills in, mirrored in ffsubtitle.cpp.
+  private static final int RESULT_START_MS = 0;
+  private static final int RESULT_END_MS = 1;
+  private static final int RESULT_WIDTH = 2;
+  private static final int RESULT_HEIGHT = 3;
+  private static final int RESULT_DIRTY = 4;
+  private static final int RESULT_BOUNDS = 8;
+  private static final int RESULT_SIZE = 12;
+
+  private final String codecName;
+  private final int[] result;
+
+  private long nativeContext;
+  // The bitmap of the last decoded event and where it sits on the canvas, for events that do not
+  // change anything.
+  @Nullable private Bitmap lastBitmap;
+  private int lastX;
+  private int lastY;
+
+  public FfmpegSubtitleDecoder(Format format) throws SubtitleDecoderException {
+    super(
+        new SubtitleInputBuffer[NUM_INPUT_BUFFERS], new SubtitleOutputBuffer[NUM_OUTPUT_BUFFERS]);
+    if (!FfmpegLibrary.isAvailable()) {
+      throw new SubtitleDecoderException("Failed to load decoder native libraries.");
+    }
+    String mimeType = checkNotNull(format.sampleMimeType);
+    codecName = checkNotNull(FfmpegLibrary.getCodecName(mimeType));
+    nativeContext = ffmpegInitialize(codecName, getExtraData(mimeType, format.initializationData));
+    if (nativeContext == 0) {
+      throw new SubtitleDecoderException("Initialization failed.");
+    }
+    result = new int[RESULT_SIZE];
+  }
+
+  @Override
+  public String getName() {
+    return "ffmpeg" + FfmpegLibrary.getVersion() + "-" + codecName;
+  }
+
+  @Override
+  public void setPositionUs(long positionUs) {
+    // Events are decoded in the order they arrive; their timing is carried by the output.
+  }
+
+  @Override
+  protected SubtitleInputBuffer createInputBuffer() {
+    return new SubtitleInputBuffer();
+  }
+
+  @Override
+  protected SubtitleOutputBuffer createOutputBuffer() {
+    return new SubtitleOutputBuffer() {
+      @Override
+      public void release() {
+        FfmpegSubtitleDecoder.this.releaseOutputBuffer(this);
+      }
+    };
+  }
+
+  @Override
+  protected SubtitleDecoderException createUnexpectedDecodeException(Throwable error) {
+    return new SubtitleDecoderException("Unexpected decode error", error);
+  }
+
+  @Nullable
+  @Override
+  protected SubtitleDecoderException decode(
+      SubtitleInputBuffer inputBuffer, SubtitleOutputBuffer outputBuffer, boolean reset) {
+    if (reset) {
+      ffmpegReset(nativeContext);
+      lastBitmap = null;
+    }
+    ByteBuffer inputData = checkNotNull(inputBuffer.data);
+    int status =
+        ffmpegDecode(
+            nativeContext,
+            inputData.array(),
+            inputData.arrayOffset(),
+            inputData.limit(),
+            inputBuffer.timeUs,
+            result);
+    if (status == SUBTITLE_DECODER_ERROR_OTHER) {
+      return new SubtitleDecoderException("Error decoding subtitle (see logcat).");
+    } else if (status == SUBTITLE_DECODER_ERROR_INVALID_DATA
+        || status == SUBTITLE_DECODER_NO_OUTPUT) {
+      // A PGS display set can span several samples, and a broken one only loses its own event.
+      outputBuffer.shouldBeSkipped = true;
+      return null;
+    }
+
+    @Nullable Bitmap bitmap = updateBitmap();
+    List<Cue> cues =
+        bitmap == null ? Collections.emptyList() : Collections.singletonList(buildCue(bitmap));
+    long startUs = result[RESULT_START_MS] * 1000L;
+    long endUs = result[RESULT_END_MS] > result[RESULT_START_MS]
+        ? result[RESULT_END_MS] * 1000L
+        : C.TIME_UNSET;
+    outputBuffer.setContent(
+        inputBuffer.timeUs, new BitmapSubtitle(cues, startUs, endUs), inputBuffer.subsampleOffsetUs);
+    // Events before the start position still set what is on screen when playback begins.
+    outputBuffer.shouldBeSkipped = false;
+    return null;
+  }
+
+  @Override
+  public void release() {
+    super.release();
+    ffmpegRelease(nativeContext);
+    nativeContext = 0;
+  }
+
+  /**
+   * Returns FFmpeg-compatible codec-specific initialization data ("extra data"), or {@code null} if
+   * not required.
+   */
+  @Nullable
+  private static byte[] getExtraData(String mimeType, List<byte[]> initializationData) {
+    if (initializationData.isEmpty()) {
+      return null;
+    }
+    return switch (mimeType) {
+      // The composition and ancillary page ids for DVB, the idx header with the palette and frame
+      // size for VobSub.
+      case MimeTypes.APPLICATION_DVBSUBS, MimeTypes.APPLICATION_VOBSUB -> initializationData.get(0);
+      default -> null;
+    };
+  }
+
+  /** Returns the bitmap to show for the event just decoded, or null if it clears the screen. */
+  @Nullable
+  private Bitmap updateBitmap() {
+    int x = result[RESULT_BOUNDS];
+    int y = result[RESULT_BOUNDS + 1];
+    int width = result[RESULT_BOUNDS + 2];
+    int height = result[RESULT_BOUNDS + 3];
+    if (width <= 0 || height <= 0) {
+      lastBitmap = null;
+      return null;
+    }
+    boolean dirty = result[RESULT_DIRTY + 2] > 0 && result[RESULT_DIRTY + 3] > 0;
+    if (!dirty
+        && lastBitmap != null
+        && lastX == x
+        && lastY == y
+        && lastBitmap.getWidth() == width
+        && lastBitmap.getHeight() == height) {
+      return lastBitmap;
+    }
+
+    Bitmap bitmap = Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888);
+    if (!ffmpegCopyToBitmap(nativeContext, bitmap, x, y, width, height)) {
+      bitmap.eraseColor(0);
+    }
+    lastBitmap = bitmap;
+    lastX = x;
+    lastY = y;
+    return bitmap;
+  }
+
+  private Cue buildCue(Bitmap bitmap) {
+    float planeWidth = result[RESULT_WIDTH];
+    float planeHeight = result[RESULT_HEIGHT];
+    return new Cue.Builder()
+        .setBitmap(bitmap)
+        .setPosition(lastX / planeWidth)
+        .setPositionAnchor(Cue.ANCHOR_TYPE_START)
+        .setLine(lastY / planeHeight, Cue.LINE_TYPE_FRACTION)
+        .setLineAnchor(Cue.ANCHOR_TYPE_START)
+        .setSize(bitmap.getWidth() / planeWidth)
+        .setBitmapHeight(bitmap.getHeight() / planeHeight)
+        .build();
+  }
+
+  /** The cues of one event, shown from its start time until its end time, if it has one. */
+  private static final class BitmapSubtitle implements Subtitle {
+
+    private final List<Cue> cues;
+    private final long[] eventTimesUs;
+
+    private BitmapSubtitle(List<Cue> cues, long startUs, long endUs) {
+      this.cues = cues;
+      eventTimesUs = endUs == C.TIME_UNSET ? new long[] {startUs} : new long[] {startUs, endUs};
+    }
+
+    @Override
+    public int getNextEventTimeIndex(long timeUs) {
+      for (int i = 0; i < eventTimesUs.length; i++) {
+        if (eventTimesUs[i] > timeUs) {
+          return i;
+        }
+      }
+      return C.INDEX_UNSET;
+    }
+
+    @Override
+    public int getEventTimeCount() {
+      return eventTimesUs.length;
+    }
+
+    @Override
+    public long getEventTime(int index) {
+      return eventTimesUs[index];
+    }
+
+    @Override
+    public List<Cue> getCues(long timeUs) {
+      boolean shown =
+          timeUs >= eventTimesUs[0] && (eventTimesUs.length == 1 || timeUs < eventTimesUs[1]);
+      return shown ? cues : Collections.emptyList();
+    }
+  }
+
+  private native long ffmpegInitialize(String codecName, @Nullable byte[] extraData);
+
+  private native int ffmpegDecode(
+      long context, byte[] data, int offset, int length, long timeUs, int[] result);
+
+  private native boolean ffmpegCopyToBitmap(
+      long context, Bitmap bitmap, int x, int y, int width, int height);
+
+  private native void ffmpegReset(long context);
+
+  private native void ffmpegRelease(long context);
+}
@@ -0,0 +1,62 @@
+package io.github.anilbeesetti.nextlib.media3ext.ffdecoder;
+
+import androidx.media3.common.Format;
+import androidx.media3.common.MimeTypes;
+import androidx.media3.common.util.Log;
+import androidx.media3.common.util.UnstableApi;
+import androidx.media3.exoplayer.text.SubtitleDecoderFactory;
+import androidx.media3.extractor.text.SubtitleDecoder;
+import androidx.media3.extractor.text.SubtitleDecoderException;
+
+/**
+ * A {@link SubtitleDecoderFactory} that decodes PGS, DVB and VobSub subtitles with FFmpeg and
+ * leaves every other format to a fallback factory.
+ *
+ * <p>The text renderer only receives these formats undecoded if the media source does not parse
+ * subtitles during extraction, and if legacy decoding is enabled on the renderer.
+ */
+@UnstableApi
+public final class FfmpegSubtitleDecoderFactory implements SubtitleDecoderFactory {
+
+  private static final String TAG = "FfmpegSubtitleDecoderFactory";
+
+  private final SubtitleDecoderFactory fallbackFactory;
+
+  /**
+   * Creates an instance.
+   *
+   * @param fallbackFactory The factory for formats FFmpeg does not decode.
+   */
+  public FfmpegSubtitleDecoderFactory(SubtitleDecoderFactory fallbackFactory) {
+    this.fallbackFactory = fallbackFactory;
+  }
+
+  @Override
+  public boolean supportsFormat(Format format) {
+    return isBitmapSubtitle(format) || fallbackFactory.supportsFormat(format);
+  }
+
+  @Override
+  public SubtitleDecoder createDecoder(Format format) {
+    if (isBitmapSubtitle(format)) {
+      try {
+        return new FfmpegSubtitleDecoder(format);
+      } catch (SubtitleDecoderException e) {
+        Log.w(TAG, "Falling back for " + format.sampleMimeType, e);
+      }
+    }
+    return fallbackFactory.createDecoder(format);
+  }
+
+  private static boolean isBitmapSubtitle(Format format) {
+    String mimeType = format.sampleMimeType;
+    if (mimeType == null) {
+      return false;
+    }
+    return switch (mimeType) {
+      case MimeTypes.APPLICATION_PGS, MimeTypes.APPLICATION_DVBSUBS, MimeTypes.APPLICATION_VOBSUB ->
+          FfmpegLibrary.supportsFormat(mimeType);
+      default -> false;
+    };
+  }
+}
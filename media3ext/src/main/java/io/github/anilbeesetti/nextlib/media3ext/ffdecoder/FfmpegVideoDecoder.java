@@ -35,12 +35,16 @@ final class FfmpegVideoDecoder extends
 
     private final String codecName;
     private long nativeContext;
+    // Guards nativeContext against release while another thread reads the stats.
+    private final Object statsLock = new Object();
     @Nullable
     private final byte[] extraData;
     private Format format;
 
     @C.VideoOutputMode
     private volatile int outputMode;
+    @FfmpegVideoRenderer.DeinterlaceMode
+    private volatile int deinterlaceMode;
 
     /**
      * Creates a Ffmpeg video Decoder.
@@ -74,7 +78,7 @@ final class FfmpegVideoDecoder extends
      * not required.
      */
     @Nullable
-    private static byte[] getExtraData(String mimeType, List<byte[]> initializationData) {
+    /* package */ static byte[] getExtraData(String mimeType, List<byte[]> initializationData) {
         if (initializationData.isEmpty()) return null;
         switch (mimeType) {
             case MimeTypes.VIDEO_H264 -> {
@@ -109,6 +113,15 @@ final class FfmpegVideoDecoder extends
         this.outputMode = outputMode;
     }
 
+    /**
+     * Sets how interlaced frames are deinterlaced. Progressive frames are never touched.
+     *
+     * @param deinterlaceMode The deinterlace mode.
+     */
+    public void setDeinterlaceMode(@FfmpegVideoRenderer.DeinterlaceMode int deinterlaceMode) {
+        this.deinterlaceMode = deinterlaceMode;
+    }
+
     @Override
     protected DecoderInputBuffer createInputBuffer() {
         return new DecoderInputBuffer(DecoderInputBuffer.BUFFER_REPLACEMENT_MODE_DIRECT);
@@ -128,7 +141,9 @@ final class FfmpegVideoDecoder extends
     @Override
     protected FfmpegDecoderException decode(DecoderInputBuffer inputBuffer, VideoDecoderOutputBuffer outputBuffer, boolean reset) {
         if (reset) {
-            nativeContext = ffmpegReset(nativeContext);
+            synchronized (statsLock) {
+                nativeContext = ffmpegReset(nativeContext);
+            }
             if (nativeContext == 0) {
                 return new FfmpegDecoderException("Error resetting (see logcat).");
             }
@@ -153,7 +168,7 @@ final class FfmpegVideoDecoder extends
         boolean decodeOnly = !isAtLeastOutputStartTimeUs(inputBuffer.timeUs);
         // We need to dequeue the decoded frame from the decoder even when the input data is
         // decode-only.
-        int getFrameResult = ffmpegReceiveFrame(nativeContext, outputMode, outputBuffer, decodeOnly);
+        int getFrameResult = ffmpegReceiveFrame(nativeContext, outputMode, deinterlaceMode, outputBuffer, decodeOnly);
         if (getFrameResult == VIDEO_DECODER_ERROR_OTHER) {
             return new FfmpegDecoderException("ffmpegDecode error: (see logcat)");
         }
@@ -172,8 +187,21 @@ final class FfmpegVideoDecoder extends
     @Override
     public void release() {
         super.release();
-        ffmpegRelease(nativeContext);
-        nativeContext = 0;
+        synchronized (statsLock) {
+            ffmpegRelease(nativeContext);
+            nativeContext = 0;
+        }
+    }
+
+    /**
+     * Returns a snapshot of the native decode counters, or null if the decoder has been released.
+     * May be called from any thread.
+     */
+    @Nullable
+    public FfmpegDecoderStats getStats() {
+        synchronized (statsLock) {
+            return nativeContext == 0 ? null : FfmpegDecoderStats.fromNative(ffmpegGetStats(nativeContext));
+        }
     }
 
     /**
@@ -203,6 +231,8 @@ final class FfmpegVideoDecoder extends
 
     private native void ffmpegRelease(long context);
 
+    private native long[] ffmpegGetStats(long context);
+
     private native int ffmpegRenderFrame(
             long context, Surface surface, VideoDecoderOutputBuffer outputBuffer,
             int displayedWidth,
@@ -223,13 +253,15 @@ final class FfmpegVideoDecoder extends
     /**
      * Gets the decoded frame.
      *
-     * @param context      Decoder context.
-     * @param outputBuffer Output buffer for the decoded frame.
+     * @param context         Decoder context.
+     * @param deinterlaceMode How to deinterlace the frame if it is interlaced.
+     * @param outputBuffer    Output buffer for the decoded frame.
      * @return {@link #VIDEO_DECODER_SUCCESS} if successful, {@link #VIDEO_DECODER_ERROR_INVALID_DATA}
      * if successful but the frame is decode-only, {@link #VIDEO_DECODER_ERROR_OTHER} if an error
      * occurred.
      */
     private native int ffmpegReceiveFrame(
-            long context, int outputMode, VideoDecoderOutputBuffer outputBuffer, boolean decodeOnly);
+            long context, int outputMode, int deinterlaceMode, VideoDecoderOutputBuffer outputBuffer,
+            boolean decodeOnly);
 
 }
\ No newline at end of file
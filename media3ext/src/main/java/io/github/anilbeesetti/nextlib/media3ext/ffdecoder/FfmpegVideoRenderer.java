@@ -2,8 +2,15 @@ package io.github.anilbeesetti.nextlib.media3ext.ffdecoder;
 
 import static java.lang.Runtime.getRuntime;
 
+import static java.lang.annotation.ElementType.FIELD;
+import static java.lang.annotation.ElementType.LOCAL_VARIABLE;
+import static java.lang.annotation.ElementType.METHOD;
+import static java.lang.annotation.ElementType.PARAMETER;
+import static java.lang.annotation.ElementType.TYPE_USE;
+
 import android.os.Handler;
 import android.view.Surface;
+import androidx.annotation.IntDef;
 import androidx.annotation.Nullable;
 import androidx.media3.common.C;
 import androidx.media3.common.Format;
@@ -20,6 +27,10 @@ import androidx.media3.decoder.VideoDecoderOutputBuffer;
 import androidx.media3.exoplayer.RendererCapabilities;
 import androidx.media3.exoplayer.video.DecoderVideoRenderer;
 import androidx.media3.exoplayer.video.VideoRendererEventListener;
+import java.lang.annotation.Documented;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.lang.annotation.Target;
 
 
 @UnstableApi
@@ -27,6 +38,27 @@ public final class FfmpegVideoRenderer extends DecoderVideoRenderer {
 
     private static final String TAG = "FfmpegVideoRenderer";
 
+    /**
+     * How interlaced frames, as broadcast MPEG-2 and H.264 often carry, are deinterlaced. One of
+     * {@link #DEINTERLACE_OFF}, {@link #DEINTERLACE_LINEAR} or {@link #DEINTERLACE_YADIF}.
+     */
+    @Documented
+    @Retention(RetentionPolicy.SOURCE)
+    @Target({FIELD, METHOD, PARAMETER, LOCAL_VARIABLE, TYPE_USE})
+    @IntDef({DEINTERLACE_OFF, DEINTERLACE_LINEAR, DEINTERLACE_YADIF})
+    public @interface DeinterlaceMode {}
+
+    // Values of DeinterlaceMode in ffdeint.h, which must stay equal.
+    /** Interlaced frames are output as decoded, showing combing on motion. */
+    public static final int DEINTERLACE_OFF = 0;
+    /** The second field is replaced by lines interpolated from the first. The cheapest mode. */
+    public static final int DEINTERLACE_LINEAR = 1;
+    /**
+     * The second field is replaced by an edge-directed interpolation of the first, which keeps
+     * static detail by checking it against the second fields of this and the previous frame.
+     */
+    public static final int DEINTERLACE_YADIF = 2;
+
     private static final int DEFAULT_NUM_OF_INPUT_BUFFERS = 4;
     private static final int DEFAULT_NUM_OF_OUTPUT_BUFFERS = 4;
     /* Default size based on 720p resolution video compressed by a factor of two. */
@@ -43,7 +75,9 @@ public final class FfmpegVideoRenderer extends DecoderVideoRenderer {
 
     private final int threads;
 
-    @Nullable private FfmpegVideoDecoder decoder;
+    @Nullable private volatile FfmpegVideoDecoder decoder;
+    @Nullable private FfmpegDecoderBenchmark benchmark;
+    @DeinterlaceMode private volatile int deinterlaceMode = DEINTERLACE_YADIF;
 
     /**
      * Creates a new instance.
@@ -104,6 +138,27 @@ public final class FfmpegVideoRenderer extends DecoderVideoRenderer {
         return TAG;
     }
 
+    /**
+     * Sets the benchmark whose measurements decide whether a stream can be decoded in real time.
+     * Streams it reports as too demanding are declined with {@link C#FORMAT_EXCEEDS_CAPABILITIES},
+     * so that another renderer is preferred for them.
+     */
+    public void setDecoderBenchmark(@Nullable FfmpegDecoderBenchmark benchmark) {
+        this.benchmark = benchmark;
+    }
+
+    /**
+     * Sets how interlaced frames are deinterlaced, {@link #DEINTERLACE_YADIF} by default. Only
+     * frames the decoder marks as interlaced are affected. May be called from any thread.
+     */
+    public void setDeinterlaceMode(@DeinterlaceMode int deinterlaceMode) {
+        this.deinterlaceMode = deinterlaceMode;
+        FfmpegVideoDecoder decoder = this.decoder;
+        if (decoder != null) {
+            decoder.setDeinterlaceMode(deinterlaceMode);
+        }
+    }
+
     @Override
     @RendererCapabilities.Capabilities
     public final int supportsFormat(Format format) {
@@ -114,6 +169,11 @@ public final class FfmpegVideoRenderer extends DecoderVideoRenderer {
             return RendererCapabilities.create(C.FORMAT_UNSUPPORTED_SUBTYPE);
         } else if (format.drmInitData != null) {
             return RendererCapabilities.create(C.FORMAT_UNSUPPORTED_DRM);
+        } else if (benchmark != null && !benchmark.canDecodeInRealTime(format)) {
+            return RendererCapabilities.create(
+                    C.FORMAT_EXCEEDS_CAPABILITIES,
+                    ADAPTIVE_SEAMLESS,
+                    TUNNELING_NOT_SUPPORTED);
         } else {
             return RendererCapabilities.create(
                     C.FORMAT_HANDLED,
@@ -139,11 +199,22 @@ public final class FfmpegVideoRenderer extends DecoderVideoRenderer {
         TraceUtil.beginSection("createFfmpegVideoDecoder");
         int initialInputBufferSize = format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
         FfmpegVideoDecoder decoder = new FfmpegVideoDecoder(numInputBuffers, numOutputBuffers, initialInputBufferSize, threads, format);
+        decoder.setDeinterlaceMode(deinterlaceMode);
         this.decoder = decoder;
         TraceUtil.endSection();
         return decoder;
     }
 
+    /**
+     * Returns a snapshot of the native counters of the current decoder, or null if there is none.
+     * May be called from any thread.
+     */
+    @Nullable
+    public FfmpegDecoderStats getDecoderStats() {
+        FfmpegVideoDecoder decoder = this.decoder;
+        return decoder == null ? null : decoder.getStats();
+    }
+
     @Override
     protected void setDecoderOutputMode(@C.VideoOutputMode int outputMode) {
         if (decoder != null) {
@@ -3,6 +3,7 @@ package io.github.anilbeesetti.nextlib.media3ext.ffdecoder
 import android.content.Context
 import android.os.Handler
 import android.os.Looper
+import androidx.media3.common.VideoSize
 import androidx.media3.common.util.Log
 import androidx.media3.common.util.UnstableApi
 import androidx.media3.exoplayer.DefaultRenderersFactory
@@ -10,14 +11,58 @@ import androidx.media3.exoplayer.Renderer
 import androidx.media3.exoplayer.audio.AudioRendererEventListener
 import androidx.media3.exoplayer.audio.AudioSink
 import androidx.media3.exoplayer.mediacodec.MediaCodecSelector
+import androidx.media3.exoplayer.metadata.MetadataOutput
+import androidx.media3.exoplayer.text.SubtitleDecoderFactory
 import androidx.media3.exoplayer.text.TextOutput
 import androidx.media3.exoplayer.video.VideoRendererEventListener
+import io.github.anilbeesetti.nextlib.media3ext.renderer.NextAssRenderer
 import io.github.anilbeesetti.nextlib.media3ext.renderer.NextTextRenderer
 
 
 @UnstableApi
 open class NextRenderersFactory(context: Context) : DefaultRenderersFactory(context) {
 
+    private var decoderBenchmark: FfmpegDecoderBenchmark? = null
+    private var deinterlaceMode = FfmpegVideoRenderer.DEINTERLACE_YADIF
+
+    /**
+     * Lets the FFmpeg video renderer decline streams that [benchmark] measured as too demanding
+     * for software decoding on this device, so that a hardware decoder is chosen for them instead.
+     */
+    fun setDecoderBenchmark(benchmark: FfmpegDecoderBenchmark?): NextRenderersFactory {
+        decoderBenchmark = benchmark
+        return this
+    }
+
+    /**
+     * Sets how the FFmpeg video renderer deinterlaces interlaced frames, one of the
+     * `FfmpegVideoRenderer.DEINTERLACE_*` modes.
+     */
+    fun setDeinterlaceMode(@FfmpegVideoRenderer.DeinterlaceMode mode: Int): NextRenderersFactory {
+        deinterlaceMode = mode
+        return this
+    }
+
+    override fun createRenderers(
+        eventHandler: Handler,
+        videoRendererEventListener: VideoRendererEventListener,
+        audioRendererEventListener: AudioRendererEventListener,
+        textRendererOutput: TextOutput,
+        metadataRendererOutput: MetadataOutput
+    ): Array<Renderer> {
+        // libass lays scripts out at the aspect ratio of the video the video renderers report.
+        val videoSizeListener = AssVideoSizeListener(videoRendererEventListener)
+        val renderers = super.createRenderers(
+            eventHandler,
+            videoSizeListener,
+            audioRendererEventListener,
+            textRendererOutput,
+            metadataRendererOutput
+        )
+        videoSizeListener.assRenderers = renderers.filterIsInstance<NextAssRenderer>().map { it.delegate }
+        return renderers
+    }
+
     override fun buildAudioRenderers(
         context: Context,
         extensionRendererMode: Int,
@@ -86,6 +131,8 @@ open class NextRenderersFactory(context: Context) : DefaultRenderersFactory(cont
 
         try {
             val renderer = FfmpegVideoRenderer(allowedVideoJoiningTimeMs, eventHandler, eventListener, MAX_DROPPED_VIDEO_FRAME_COUNT_TO_NOTIFY)
+            renderer.setDecoderBenchmark(decoderBenchmark)
+            renderer.setDeinterlaceMode(deinterlaceMode)
             out.add(extensionRendererIndex++, renderer)
             Log.i(TAG, "Loaded FfmpegVideoRenderer.")
         } catch (e: java.lang.Exception) {
@@ -101,10 +148,46 @@ open class NextRenderersFactory(context: Context) : DefaultRenderersFactory(cont
         extensionRendererMode: Int,
         out: java.util.ArrayList<Renderer>
     ) {
-        out.add(NextTextRenderer(output, outputLooper))
+        if (extensionRendererMode == EXTENSION_RENDERER_MODE_OFF) {
+            out.add(NextTextRenderer(output, outputLooper))
+            return
+        }
+
+        // Ahead of the generic text renderer, which would otherwise take SSA as plain text.
+        out.add(NextAssRenderer(output, outputLooper))
+
+        // PGS, DVB and VobSub reach the renderer undecoded when the media source is set not to
+        // parse subtitles during extraction; FFmpeg then composites them into a canvas per track,
+        // and every event that changes the screen allocates one bitmap cropped from it.
+        val renderer = NextTextRenderer(
+            output,
+            outputLooper,
+            FfmpegSubtitleDecoderFactory(SubtitleDecoderFactory.DEFAULT)
+        )
+        renderer.delegate.experimentalSetLegacyDecodingEnabled(true)
+        out.add(renderer)
     }
 
     companion object {
         const val TAG = "NextRenderersFactory"
     }
 }
+
+/**
+ * Passes video renderer events on to the player, and the video's size to the libass renderers.
+ */
+@UnstableApi
+private class AssVideoSizeListener(
+    private val listener: VideoRendererEventListener
+) : VideoRendererEventListener by listener {
+
+    @Volatile
+    var assRenderers: List<FfmpegAssRenderer> = emptyList()
+
+    override fun onVideoSizeChanged(videoSize: VideoSize) {
+        for (renderer in assRenderers) {
+            renderer.setVideoSize(videoSize.width, videoSize.height, videoSize.pixelWidthHeightRatio)
+        }
+        listener.onVideoSizeChanged(videoSize)
+    }
+}
@@ -0,0 +1,48 @@
+package io.github.anilbeesetti.nextlib.media3ext.renderer
+
+import android.os.Looper
+import androidx.media3.common.C
+import androidx.media3.common.util.UnstableApi
+import androidx.media3.exoplayer.ExoPlayer
+import androidx.media3.exoplayer.Renderer
+import androidx.media3.exoplayer.text.TextOutput
+import io.github.anilbeesetti.nextlib.media3ext.ffdecoder.FfmpegAssRenderer
+
+@UnstableApi
+class NextAssRenderer(
+    output: TextOutput,
+    outputLooper: Looper?,
+    val delegate: FfmpegAssRenderer = FfmpegAssRenderer(output, outputLooper)
+): Renderer by delegate, OffsetRenderer() {
+
+    override fun render(positionUs: Long, elapsedRealtimeUs: Long) {
+        val finalPositionUs = getOffsetAdjustedPositionUs(positionUs)
+        delegate.render(finalPositionUs, elapsedRealtimeUs)
+    }
+
+    override fun release() {
+        delegate.release()
+    }
+}
+
+/**
+ * The libass renderer of the player, if it was built with one, e.g. to add fonts with
+ * [FfmpegAssRenderer.addAttachedFonts] or to match its frame size to the player view.
+ *
+ * ```kotlin
+ * val assRenderer = player.assRenderer
+ * executor.execute {
+ *     contentResolver.openFileDescriptor(uri, "r")?.use { assRenderer?.addAttachedFonts(it) }
+ * }
+ * ```
+ */
+@get:UnstableApi
+val ExoPlayer.assRenderer: FfmpegAssRenderer?
+    get() {
+        for (i in 0 until rendererCount) {
+            if (getRendererType(i) == C.TRACK_TYPE_TEXT) {
+                (getRenderer(i) as? NextAssRenderer)?.let { return it.delegate }
+            }
+        }
+        return null
+    }
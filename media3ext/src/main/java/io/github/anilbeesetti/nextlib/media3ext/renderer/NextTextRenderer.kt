@@ -76,12 +76,11 @@ class NextTextRenderer(
 @set:UnstableApi
 var ExoPlayer.subtitleDelayMilliseconds: Long
     get() {
-        val textRenderer = getOffsetRenderer(C.TRACK_TYPE_TEXT) ?: return 0L
+        val textRenderer = getOffsetRenderers(C.TRACK_TYPE_TEXT).firstOrNull() ?: return 0L
         return textRenderer.syncOffsetMilliseconds
     }
     set(value) {
-        val textRenderer = getOffsetRenderer(C.TRACK_TYPE_TEXT) ?: return
-        textRenderer.syncOffsetMilliseconds = value
+        getOffsetRenderers(C.TRACK_TYPE_TEXT).forEach { it.syncOffsetMilliseconds = value }
     }
 
 /**
@@ -173,10 +172,9 @@ var ExoPlayer.subtitleDelayMilliseconds: Long
 @set:UnstableApi
 var ExoPlayer.subtitleSpeed: Float
     get() {
-        val textRenderer = getOffsetRenderer(C.TRACK_TYPE_TEXT) ?: return 1.0f
+        val textRenderer = getOffsetRenderers(C.TRACK_TYPE_TEXT).firstOrNull() ?: return 1.0f
         return textRenderer.syncSpeedMultiplier
     }
     set(value) {
-        val textRenderer = getOffsetRenderer(C.TRACK_TYPE_TEXT) ?: return
-        textRenderer.syncSpeedMultiplier = value
+        getOffsetRenderers(C.TRACK_TYPE_TEXT).forEach { it.syncSpeedMultiplier = value }
     }
\ No newline at end of file
@@ -177,21 +177,18 @@ open class OffsetRenderer {
 
 
 /**
- * Helper function to retrieve an [OffsetRenderer] for a specific track type.
+ * Helper function to retrieve the [OffsetRenderer]s for a specific track type.
  *
- * This function searches through the player's renderers to find one that implements
- * [OffsetRenderer] and handles the specified track type.
+ * A track type can have more than one, like the libass and the generic text renderer, of which
+ * only the one that handles the selected track is enabled. Adjustments go to all of them so that
+ * they survive switching tracks.
  *
  * @param trackType The type of track to find (e.g., [C.TRACK_TYPE_TEXT], [C.TRACK_TYPE_AUDIO])
- * @return The [OffsetRenderer] for the specified track type, or `null` if not found
+ * @return The [OffsetRenderer]s for the specified track type, in renderer order
  */
 @UnstableApi
-internal fun ExoPlayer.getOffsetRenderer(trackType: @C.TrackType Int): OffsetRenderer? {
-    for (i in 0 until rendererCount) {
-        val rendererType = getRendererType(i)
-        if (rendererType == trackType) {
-            return getRenderer(i) as? OffsetRenderer
-        }
-    }
-    return null
-}
\ No newline at end of file
+internal fun ExoPlayer.getOffsetRenderers(trackType: @C.TrackType Int): List<OffsetRenderer> {
+    return (0 until rendererCount)
+        .filter { getRendererType(it) == trackType }
+        .mapNotNull { getRenderer(it) as? OffsetRenderer }
+}
@@ -0,0 +1,289 @@
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "benchmark_stats.h"
+#include "ffcore.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/*
+ * Decode benchmark of the media3ext cores on the clips generated by ffmpeg/test_clips.sh.
+ *
+ * Video runs what ffmpegDecode, ffmpegReceiveFrame and ffmpegRenderFrame do per frame: the packet
+ * is sent, every frame is copied to the output buffer and converted from there into a YV12
+ * buffer laid out like a native window. Audio runs decodePacket into 16-bit PCM. Each clip is
+ * decoded over and over for the given time, after one warm-up pass that opens the decoder's
+ * buffer pools.
+ *
+ * Usage: media3ext_benchmark [clips dir] [threads] [seconds per clip]
+ */
+
+#define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+
+struct BenchmarkClip {
+    const char *name;
+    AVMediaType type;
+};
+
+static const BenchmarkClip CLIPS[] = {
+        {"h264_720p.mp4",  AVMEDIA_TYPE_VIDEO},
+        {"h264_1080p.mkv", AVMEDIA_TYPE_VIDEO},
+        {"hevc_1080p.mp4", AVMEDIA_TYPE_VIDEO},
+        {"vp8_720p.webm",  AVMEDIA_TYPE_VIDEO},
+        {"vp9_1080p.webm", AVMEDIA_TYPE_VIDEO},
+        {"vp9_2160p.webm", AVMEDIA_TYPE_VIDEO},
+        {"av1_1080p.mkv",  AVMEDIA_TYPE_VIDEO},
+        {"mpeg2_720p.ts",  AVMEDIA_TYPE_VIDEO},
+        {"aac_stereo.m4a", AVMEDIA_TYPE_AUDIO},
+        {"mp3_stereo.mp3", AVMEDIA_TYPE_AUDIO},
+};
+
+struct DemuxedStream {
+    AVCodecParameters *parameters = nullptr;
+    std::vector<AVPacket *> packets;
+
+    ~DemuxedStream() {
+        for (AVPacket *packet: packets) {
+            av_packet_free(&packet);
+        }
+        avcodec_parameters_free(&parameters);
+    }
+};
+
+struct BenchmarkResult {
+    int64_t frames = 0;
+    double seconds = 0;
+    int64_t allocations = 0;
+};
+
+/**
+ * Reads every packet of the first stream of the given type into memory, so that demuxing stays
+ * out of the measurement.
+ */
+static bool demuxStream(const std::string &path, AVMediaType type, DemuxedStream &stream) {
+    AVFormatContext *formatContext = nullptr;
+    if (avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) < 0) {
+        return false;
+    }
+    int index = avformat_find_stream_info(formatContext, nullptr) >= 0
+                ? av_find_best_stream(formatContext, type, -1, -1, nullptr, 0) : -1;
+    if (index >= 0) {
+        stream.parameters = avcodec_parameters_alloc();
+        avcodec_parameters_copy(stream.parameters, formatContext->streams[index]->codecpar);
+        AVPacket *packet = av_packet_alloc();
+        while (av_read_frame(formatContext, packet) >= 0) {
+            if (packet->stream_index == index) {
+                stream.packets.push_back(av_packet_clone(packet));
+            }
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+    }
+    avformat_close_input(&formatContext);
+    return index >= 0 && !stream.packets.empty();
+}
+
+/**
+ * Opens a decoder the way ffmpegInitialize does, from the codec and its extradata only.
+ */
+static AVCodecContext *openContext(const AVCodecParameters *parameters, int threads) {
+    const AVCodec *codec = avcodec_find_decoder(parameters->codec_id);
+    AVCodecContext *context = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!context) {
+        return nullptr;
+    }
+    if (parameters->extradata_size > 0) {
+        context->extradata = (uint8_t *) av_mallocz(parameters->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        memcpy(context->extradata, parameters->extradata, parameters->extradata_size);
+        context->extradata_size = parameters->extradata_size;
+    }
+    if (parameters->codec_type == AVMEDIA_TYPE_VIDEO) {
+        context->thread_count = threads;
+    } else {
+        context->request_sample_fmt = AV_SAMPLE_FMT_S16;
+    }
+    context->err_recognition = AV_EF_IGNORE_ERR;
+    if (avcodec_open2(context, codec, nullptr) < 0) {
+        releaseContext(context);
+        return nullptr;
+    }
+    return context;
+}
+
+/**
+ * State of the video output path: the output buffer ffmpegReceiveFrame copies into, and the
+ * scaler and window buffer of ffmpegRenderFrame.
+ */
+struct VideoOutput {
+    std::vector<uint8_t> outputBuffer;
+    std::vector<uint8_t> window;
+    SwsContext *swsContext = nullptr;
+    int width = 0;
+    int height = 0;
+
+    ~VideoOutput() {
+        sws_freeContext(swsContext);
+    }
+
+    bool render(AVCodecContext *context, const AVFrame *frame) {
+        int uvHeight = (frame->height + 1) / 2;
+        size_t yLength = (size_t) frame->linesize[0] * frame->height;
+        size_t uvLength = (size_t) frame->linesize[1] * uvHeight;
+        if (outputBuffer.size() < yLength + 2 * uvLength) {
+            outputBuffer.resize(yLength + 2 * uvLength);
+        }
+        copyYuvFrame(frame, outputBuffer.data());
+
+        int windowStride = ALIGN(frame->width, 32);
+        if (!swsContext || width != frame->width || height != frame->height) {
+            sws_freeContext(swsContext);
+            swsContext = sws_getContext(frame->width, frame->height, context->pix_fmt,
+                                        frame->width, frame->height, AV_PIX_FMT_YUV420P,
+                                        SWS_BILINEAR, nullptr, nullptr, nullptr);
+            width = frame->width;
+            height = frame->height;
+            window.resize((size_t) windowStride * height +
+                          (size_t) 2 * ALIGN(windowStride / 2, 16) * ((height + 1) / 2));
+        }
+        if (!swsContext) {
+            return false;
+        }
+        uint8_t *src[3] = {outputBuffer.data(), outputBuffer.data() + yLength,
+                           outputBuffer.data() + yLength + uvLength};
+        int srcStride[3] = {frame->linesize[0], frame->linesize[1], frame->linesize[2]};
+        convertToYv12(swsContext, src, srcStride, frame->height, window.data(), windowStride, height);
+        return true;
+    }
+};
+
+static bool receiveVideoFrames(AVCodecContext *context, AVFrame *frame, VideoOutput &output,
+                               int64_t &frames) {
+    int result;
+    while ((result = avcodec_receive_frame(context, frame)) == 0) {
+        bool rendered = output.render(context, frame);
+        av_frame_unref(frame);
+        if (!rendered) {
+            return false;
+        }
+        frames++;
+    }
+    return result == AVERROR(EAGAIN) || result == AVERROR_EOF;
+}
+
+/**
+ * Decodes and renders every packet once, then drains and flushes the decoder.
+ */
+static bool decodeVideoPass(AVCodecContext *context, const DemuxedStream &stream, AVFrame *frame,
+                            VideoOutput &output, int64_t &frames) {
+    for (size_t i = 0; i <= stream.packets.size(); i++) {
+        AVPacket *packet = i < stream.packets.size() ? stream.packets[i] : nullptr;
+        int result;
+        while ((result = sendVideoPacket(context, packet)) == VIDEO_DECODER_ERROR_READ_FRAME) {
+            if (!receiveVideoFrames(context, frame, output, frames)) {
+                return false;
+            }
+        }
+        if (result != VIDEO_DECODER_SUCCESS || !receiveVideoFrames(context, frame, output, frames)) {
+            return false;
+        }
+    }
+    avcodec_flush_buffers(context);
+    return true;
+}
+
+static bool decodeAudioPass(AVCodecContext *context, const DemuxedStream &stream,
+                            std::vector<uint8_t> &outputBuffer, int64_t &frames) {
+    GrowOutputBuffer growBuffer = [&outputBuffer](int requiredSize) {
+        outputBuffer.resize(requiredSize);
+        return outputBuffer.data();
+    };
+    for (AVPacket *packet: stream.packets) {
+        if (decodePacket(context, packet, outputBuffer.data(), (int) outputBuffer.size(), growBuffer,
+                         nullptr) < 0) {
+            return false;
+        }
+        frames++;
+    }
+    avcodec_flush_buffers(context);
+    return true;
+}
+
+static bool runBenchmark(AVCodecContext *context, const DemuxedStream &stream, double seconds,
+                         BenchmarkResult &result) {
+    AVFrame *frame = av_frame_alloc();
+    VideoOutput videoOutput;
+    std::vector<uint8_t> audioOutput(64 * 1024);
+    bool video = stream.parameters->codec_type == AVMEDIA_TYPE_VIDEO;
+    auto pass = [&](int64_t &frames) {
+        return video ? decodeVideoPass(context, stream, frame, videoOutput, frames)
+                     : decodeAudioPass(context, stream, audioOutput, frames);
+    };
+
+    int64_t warmUpFrames = 0;
+    bool success = pass(warmUpFrames);
+    int64_t allocationsBefore = benchmark_allocations();
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    while (success && (result.frames == 0 || std::chrono::steady_clock::now() < deadline)) {
+        success = pass(result.frames);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.allocations = benchmark_allocations() - allocationsBefore;
+    av_frame_free(&frame);
+    return success && result.frames > 0;
+}
+
+int main(int argc, char **argv) {
+    std::string clipsDir = argc > 1 ? argv[1] : TEST_CLIPS_DIR;
+    int threads = argc > 2 ? atoi(argv[2]) : (int) std::thread::hardware_concurrency();
+    double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+    av_log_set_level(AV_LOG_ERROR);
+
+    printf("%-16s %-12s %8s %10s %12s %13s %12s\n",
+           "clip", "decoder", "frames", "frames/s", "ns/frame", "allocs/frame", "peak RSS MiB");
+    bool failed = false;
+    for (const BenchmarkClip &clip: CLIPS) {
+        std::string path = clipsDir + "/" + clip.name;
+        if (access(path.c_str(), R_OK) != 0) {
+            printf("%-16s skipped, not generated\n", clip.name);
+            continue;
+        }
+        DemuxedStream stream;
+        if (!demuxStream(path, clip.type, stream)) {
+            printf("%-16s failed to demux\n", clip.name);
+            failed = true;
+            continue;
+        }
+
+        // The packets stay resident, so the peak measured from here is the decoder's.
+        benchmark_reset_peak_rss();
+        AVCodecContext *context = openContext(stream.parameters, threads);
+        if (!context) {
+            printf("%-16s no decoder\n", clip.name);
+            failed = true;
+            continue;
+        }
+        BenchmarkResult result;
+        bool success = runBenchmark(context, stream, seconds, result);
+        const char *decoderName = context->codec->name;
+        if (success) {
+            printf("%-16s %-12s %8lld %10.1f %12.0f %13.2f %12.1f\n", clip.name, decoderName,
+                   (long long) result.frames, result.frames / result.seconds,
+                   result.seconds * 1e9 / result.frames,
+                   result.allocations >= 0 ? (double) result.allocations / result.frames : -1.0,
+                   benchmark_peak_rss_bytes() / (1024.0 * 1024.0));
+        } else {
+            printf("%-16s %-12s failed to decode\n", clip.name, decoderName);
+            failed = true;
+        }
+        releaseContext(context);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,247 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "ffcore.h"
+#include "test_clips.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/adler32.h>
+#include <libavutil/cpu.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+/*
+ * Decode speed of the decoders the JNI libraries are built with, measured with
+ * measureDecodeFrameRate like FfmpegDecoderBenchmark does on device, and the output of the
+ * decoders the extension prefers against the ones it passes over.
+ */
+
+static const int64_t MEASURE_BUDGET_US = 1000000;
+
+/**
+ * The packets of the video stream of a clip, in memory.
+ */
+struct ClipPackets {
+    AVCodecParameters *parameters = nullptr;
+    std::vector<AVPacket *> packets;
+
+    ~ClipPackets() {
+        for (AVPacket *packet: packets) {
+            av_packet_free(&packet);
+        }
+        avcodec_parameters_free(&parameters);
+    }
+};
+
+static bool readVideoPackets(const std::string &path, ClipPackets &clip) {
+    AVFormatContext *formatContext = nullptr;
+    if (avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) < 0) {
+        return false;
+    }
+    int index = avformat_find_stream_info(formatContext, nullptr) >= 0
+                ? av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0) : -1;
+    if (index >= 0) {
+        clip.parameters = avcodec_parameters_alloc();
+        avcodec_parameters_copy(clip.parameters, formatContext->streams[index]->codecpar);
+        AVPacket *packet = av_packet_alloc();
+        while (av_read_frame(formatContext, packet) >= 0) {
+            if (packet->stream_index == index) {
+                clip.packets.push_back(av_packet_clone(packet));
+            }
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+    }
+    avformat_close_input(&formatContext);
+    return index >= 0 && !clip.packets.empty();
+}
+
+/**
+ * Opens the decoder called [codecName] the way openVideoContext does, from the extradata only.
+ */
+static AVCodecContext *openVideoDecoder(const char *codecName, const AVCodecParameters *parameters,
+                                        int threads) {
+    const AVCodec *codec = avcodec_find_decoder_by_name(codecName);
+    AVCodecContext *context = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!context) {
+        return nullptr;
+    }
+    if (parameters->extradata_size > 0) {
+        context->extradata = (uint8_t *) av_mallocz(parameters->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        memcpy(context->extradata, parameters->extradata, parameters->extradata_size);
+        context->extradata_size = parameters->extradata_size;
+    }
+    context->thread_count = threads;
+    context->err_recognition = AV_EF_IGNORE_ERR;
+    if (avcodec_open2(context, codec, nullptr) < 0) {
+        releaseContext(context);
+        return nullptr;
+    }
+    return context;
+}
+
+/**
+ * Frames per second of [codecName] on [clip], or a negative value if it failed.
+ */
+static double measureFrameRate(const char *codecName, const ClipPackets &clip, int threads) {
+    AVCodecContext *context = openVideoDecoder(codecName, clip.parameters, threads);
+    if (!context) {
+        return -1;
+    }
+    double frameRate = measureDecodeFrameRate(context, clip.packets.data(), (int) clip.packets.size(),
+                                              MEASURE_BUDGET_US);
+    releaseContext(context);
+    return frameRate;
+}
+
+/**
+ * Frames per second of [codecName] on [clip] on one thread with the CPU features in [cpuFlags].
+ * Decoders pick their SIMD functions when they are opened, so the flags are forced around that.
+ */
+static double measureFrameRateWithCpuFlags(const char *codecName, const ClipPackets &clip, int cpuFlags) {
+    av_force_cpu_flags(cpuFlags);
+    double frameRate = measureFrameRate(codecName, clip, 1);
+    av_force_cpu_flags(-1);
+    return frameRate;
+}
+
+struct SimdCase {
+    const char *clip;
+    const char *codecName;
+    // Lower bound of the speedup of the SIMD functions over plain C. Both are around 2x on a
+    // desktop x86_64 CPU, including the frame copy that costs the same either way.
+    double minSpeedup;
+};
+
+class SimdSpeedupTest : public testing::TestWithParam<SimdCase> {
+};
+
+TEST_P(SimdSpeedupTest, SimdDecodesFasterThanC) {
+    const SimdCase &simdCase = GetParam();
+    REQUIRE_CLIP(path, simdCase.clip);
+    if (!avcodec_find_decoder_by_name(simdCase.codecName)) {
+        GTEST_SKIP() << "FFmpeg has no " << simdCase.codecName << " decoder";
+    }
+    if (av_get_cpu_flags() == 0) {
+        GTEST_SKIP() << "FFmpeg was built without SIMD for this CPU";
+    }
+    ClipPackets clip;
+    ASSERT_TRUE(readVideoPackets(path, clip));
+
+    double simd = measureFrameRateWithCpuFlags(simdCase.codecName, clip, -1);
+    double plainC = measureFrameRateWithCpuFlags(simdCase.codecName, clip, 0);
+    ASSERT_GT(simd, 0);
+    ASSERT_GT(plainC, 0);
+    printf("%s %s: %.1f fps with SIMD, %.1f fps in C, %.2fx\n", simdCase.clip, simdCase.codecName,
+           simd, plainC, simd / plainC);
+    EXPECT_GT(simd / plainC, simdCase.minSpeedup);
+}
+
+INSTANTIATE_TEST_SUITE_P(Clips, SimdSpeedupTest, testing::Values(
+        SimdCase{"h264_1080p.mkv", "h264", 1.3},
+        SimdCase{"vp9_1080p.webm", "vp9", 1.3}));
+
+/**
+ * Adler-32 of the planes of [frame].
+ */
+static uint32_t frameChecksum(const AVFrame *frame) {
+    auto format = (AVPixelFormat) frame->format;
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(format);
+    uint32_t checksum = 1;
+    for (int plane = 0; plane < av_pix_fmt_count_planes(format); plane++) {
+        int rowBytes = av_image_get_linesize(format, frame->width, plane);
+        bool chroma = plane == 1 || plane == 2;
+        int rows = chroma ? AV_CEIL_RSHIFT(frame->height, descriptor->log2_chroma_h) : frame->height;
+        for (int row = 0; row < rows; row++) {
+            checksum = av_adler32_update(checksum, frame->data[plane] + (ptrdiff_t) row * frame->linesize[plane],
+                                         rowBytes);
+        }
+    }
+    return checksum;
+}
+
+static bool receiveChecksums(AVCodecContext *context, AVFrame *frame, std::vector<uint32_t> &checksums) {
+    int result;
+    while ((result = avcodec_receive_frame(context, frame)) == 0) {
+        checksums.push_back(frameChecksum(frame));
+        av_frame_unref(frame);
+    }
+    return result == AVERROR(EAGAIN) || result == AVERROR_EOF;
+}
+
+/**
+ * Checksums of every frame [codecName] decodes from [clip], in output order, or an empty vector
+ * if decoding failed.
+ */
+static std::vector<uint32_t> decodeChecksums(const char *codecName, const ClipPackets &clip, int threads) {
+    std::vector<uint32_t> checksums;
+    AVCodecContext *context = openVideoDecoder(codecName, clip.parameters, threads);
+    AVFrame *frame = av_frame_alloc();
+    bool failed = !context || !frame;
+    // The final null packet drains the decoder.
+    for (size_t i = 0; i <= clip.packets.size() && !failed; i++) {
+        AVPacket *packet = i < clip.packets.size() ? clip.packets[i] : nullptr;
+        int result = 0;
+        while (!failed && (result = avcodec_send_packet(context, packet)) == AVERROR(EAGAIN)) {
+            failed = !receiveChecksums(context, frame, checksums);
+        }
+        failed = failed || result < 0 || !receiveChecksums(context, frame, checksums);
+    }
+    av_frame_free(&frame);
+    if (context) {
+        releaseContext(context);
+    }
+    return failed ? std::vector<uint32_t>() : checksums;
+}
+
+struct DecoderPair {
+    const char *clip;
+    // The decoder the FFmpeg extension prefers, and the one it is preferred over.
+    const char *codecName;
+    const char *referenceCodecName;
+    // Lower bound of the speed of codecName relative to referenceCodecName.
+    double minSpeedup;
+};
+
+class DecoderComparisonTest : public testing::TestWithParam<DecoderPair> {
+};
+
+TEST_P(DecoderComparisonTest, DecodesTheSameFramesAtLeastAsFast) {
+    const DecoderPair &pair = GetParam();
+    REQUIRE_CLIP(path, pair.clip);
+    for (const char *codecName: {pair.codecName, pair.referenceCodecName}) {
+        if (!avcodec_find_decoder_by_name(codecName)) {
+            GTEST_SKIP() << "FFmpeg has no " << codecName << " decoder";
+        }
+    }
+    ClipPackets clip;
+    ASSERT_TRUE(readVideoPackets(path, clip));
+    // As many threads as FfmpegVideoRenderer gives a decoder on a typical phone.
+    int threads = (int) std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+
+    // Both decoders are bit-exact implementations of the same format.
+    std::vector<uint32_t> checksums = decodeChecksums(pair.codecName, clip, threads);
+    ASSERT_FALSE(checksums.empty());
+    EXPECT_EQ(checksums, decodeChecksums(pair.referenceCodecName, clip, threads));
+
+    double frameRate = measureFrameRate(pair.codecName, clip, threads);
+    double referenceFrameRate = measureFrameRate(pair.referenceCodecName, clip, threads);
+    ASSERT_GT(frameRate, 0);
+    ASSERT_GT(referenceFrameRate, 0);
+    printf("%s on %d threads: %s %.1f fps, %s %.1f fps, %.2fx\n", pair.clip, threads, pair.codecName,
+           frameRate, pair.referenceCodecName, referenceFrameRate, frameRate / referenceFrameRate);
+    EXPECT_GT(frameRate / referenceFrameRate, pair.minSpeedup);
+}
+
+INSTANTIATE_TEST_SUITE_P(Clips, DecoderComparisonTest, testing::Values(
+        // dav1d is about 2.5x faster than libaom on one x86_64 core.
+        DecoderPair{"av1_1080p.mkv", "libdav1d", "libaom-av1", 1.5},
+        // FFmpeg's vp9 is about 1.1x faster than libvpx on one core, and pulls ahead with frame
+        // threading on more.
+        DecoderPair{"vp9_1080p.webm", "vp9", "libvpx-vp9", 0.9},
+        DecoderPair{"vp9_2160p.webm", "vp9", "libvpx-vp9", 0.9}));
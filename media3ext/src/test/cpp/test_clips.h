@@ -0,0 +1,23 @@
+#ifndef NEXTPLAYER_TEST_CLIPS_H
+#define NEXTPLAYER_TEST_CLIPS_H
+
+#include <string>
+#include <unistd.h>
+
+/**
+ * Path of a clip written by ffmpeg/test_clips.sh, or an empty string if it was not generated.
+ */
+inline std::string testClip(const char *name) {
+    std::string path = std::string(TEST_CLIPS_DIR) + "/" + name;
+    return access(path.c_str(), R_OK) == 0 ? path : std::string();
+}
+
+/**
+ * Declares [path] as the path of the clip [name], or skips the test when the clip is missing
+ * because the ffmpeg program that generated the corpus lacks its encoder.
+ */
+#define REQUIRE_CLIP(path, name)                                                  \
+    std::string path = testClip(name);                                            \
+    if (path.empty()) GTEST_SKIP() << "No clip " << (name) << " in " TEST_CLIPS_DIR
+
+#endif //NEXTPLAYER_TEST_CLIPS_H
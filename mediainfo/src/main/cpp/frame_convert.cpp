@@ -0,0 +1,31 @@
+#include "frame_convert.h"
+#include "trace.h"
+
+bool frame_convert_to_rgba(SwsContext **swsContext,
+                           const AVFrame *frame,
+                           uint8_t *pixels,
+                           int width,
+                           int height,
+                           int stride) {
+    TraceSection trace("mediainfo.scale");
+    // Returns the same scaler as long as the frame format and sizes do not change.
+    *swsContext = sws_getCachedContext(*swsContext,
+                                       frame->width,
+                                       frame->height,
+                                       static_cast<AVPixelFormat>(frame->format),
+                                       width,
+                                       height,
+                                       AV_PIX_FMT_RGBA,
+                                       SWS_BILINEAR,
+                                       nullptr,
+                                       nullptr,
+                                       nullptr);
+    if (!*swsContext) {
+        return false;
+    }
+
+    uint8_t *data[4] = {pixels};
+    int linesize[4] = {stride};
+    sws_scale(*swsContext, frame->data, frame->linesize, 0, frame->height, data, linesize);
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef NEXTPLAYER_FRAME_CONVERT_H
+#define NEXTPLAYER_FRAME_CONVERT_H
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+/**
+ * Scales a decoded frame into a width x height RGBA region starting at [pixels].
+ *
+ * @param swsContext scaler to reuse, created or replaced as needed; free it with sws_freeContext
+ * @param stride bytes per row of the destination, which may be wider than the region
+ * @return false if no scaler could be created for the frame's format
+ */
+bool frame_convert_to_rgba(SwsContext **swsContext,
+                           const AVFrame *frame,
+                           uint8_t *pixels,
+                           int width,
+                           int height,
+                           int stride);
+
+#endif //NEXTPLAYER_FRAME_CONVERT_H
@@ -41,30 +41,10 @@ bool frame_extractor_load_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle,
     AndroidBitmap_getInfo(env, jBitmap, &bitmapMetricInfo);
 
     auto *frameLoaderContext = frame_loader_context_from_handle(jFrameLoaderContextHandle);
-
-    auto pixelFormat = static_cast<AVPixelFormat>(frameLoaderContext->parameters->format);
-    if (pixelFormat == AV_PIX_FMT_NONE) {
-        // With pipe protocol some files fail to provide pixel format info.
-        // In this case we can't establish neither scaling nor even a frame extracting.
+    if (!frame_loader_context_open(frameLoaderContext)) {
         return false;
     }
 
-    SwsContext *scalingContext =
-            sws_getContext(
-                    // srcW
-                    frameLoaderContext->parameters->width,
-                    // srcH
-                    frameLoaderContext->parameters->height,
-                    // srcFormat
-                    pixelFormat,
-                    // dstW
-                    bitmapMetricInfo.width,
-                    // dstH
-                    bitmapMetricInfo.height,
-                    // dstFormat
-                    AV_PIX_FMT_RGBA,
-                    SWS_BICUBIC, nullptr, nullptr, nullptr);
-
     AVStream *avVideoStream = frameLoaderContext->avFormatContext->streams[frameLoaderContext->videoStreamIndex];
 
     int64_t videoDuration = avVideoStream->duration;
@@ -106,6 +86,27 @@ bool frame_extractor_load_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle,
         resultValue = read_frame(frameLoaderContext, packet, frame, videoCodecContext);
     }
 
+    // The pixel format is taken from the decoded frame, as the stream parameters may not carry it
+    // when stream info probing was skipped.
+    SwsContext *scalingContext = nullptr;
+    if (resultValue) {
+        scalingContext = sws_getContext(
+                // srcW
+                frame->width,
+                // srcH
+                frame->height,
+                // srcFormat
+                static_cast<AVPixelFormat>(frame->format),
+                // dstW
+                bitmapMetricInfo.width,
+                // dstH
+                bitmapMetricInfo.height,
+                // dstFormat
+                AV_PIX_FMT_RGBA,
+                SWS_BICUBIC, nullptr, nullptr, nullptr);
+        resultValue = scalingContext != nullptr;
+    }
+
     if (resultValue) {
         AVFrame *frameForDrawing = av_frame_alloc();
         void *bitmapBuffer;
@@ -127,7 +128,7 @@ bool frame_extractor_load_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle,
                 frame->data,
                 frame->linesize,
                 0,
-                frameLoaderContext->parameters->height,
+                frame->height,
                 frameForDrawing->data,
                 frameForDrawing->linesize);
 
@@ -147,13 +148,7 @@ bool frame_extractor_load_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle,
 
 jobject frame_extractor_get_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle, int64_t time_millis) {
     auto *frameLoaderContext = frame_loader_context_from_handle(jFrameLoaderContextHandle);
-    if (!frameLoaderContext || !frameLoaderContext->avFormatContext ||
-        !frameLoaderContext->parameters) {
-        return nullptr;
-    }
-
-    auto pixelFormat = static_cast<AVPixelFormat>(frameLoaderContext->parameters->format);
-    if (pixelFormat == AV_PIX_FMT_NONE) {
+    if (!frameLoaderContext || !frame_loader_context_open(frameLoaderContext)) {
         return nullptr;
     }
 
@@ -180,15 +175,6 @@ jobject frame_extractor_get_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle
     jobject jBitmap = env->CallStaticObjectMethod(bitmapClass, createBitmapMethod, bitmapWidth,
                                                   bitmapHeight, argb8888Obj);
 
-    SwsContext *scalingContext = sws_getContext(
-            srcW, srcH, pixelFormat,
-            bitmapWidth, bitmapHeight, AV_PIX_FMT_RGBA,
-            SWS_BICUBIC, nullptr, nullptr, nullptr);
-
-    if (!scalingContext) {
-        return nullptr;
-    }
-
     int64_t videoDuration = avVideoStream->duration;
     if (videoDuration == LONG_LONG_MIN && avVideoStream->time_base.den != 0) {
         videoDuration = av_rescale_q(frameLoaderContext->avFormatContext->duration, AV_TIME_BASE_Q,
@@ -204,7 +190,6 @@ jobject frame_extractor_get_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle
     AVPacket *packet = av_packet_alloc();
     AVFrame *frame = av_frame_alloc();
     if (!packet || !frame) {
-        sws_freeContext(scalingContext);
         av_packet_free(&packet);
         av_frame_free(&frame);
         return nullptr;
@@ -214,7 +199,6 @@ jobject frame_extractor_get_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle
     if (!videoCodecContext ||
         avcodec_parameters_to_context(videoCodecContext, frameLoaderContext->parameters) < 0 ||
         avcodec_open2(videoCodecContext, frameLoaderContext->avVideoCodec, nullptr) < 0) {
-        sws_freeContext(scalingContext);
         av_packet_free(&packet);
         av_frame_free(&frame);
         avcodec_free_context(&videoCodecContext);
@@ -236,6 +220,15 @@ jobject frame_extractor_get_frame(JNIEnv *env, int64_t jFrameLoaderContextHandle
         resultValue = read_frame(frameLoaderContext, packet, frame, videoCodecContext);
     }
 
+    SwsContext *scalingContext = nullptr;
+    if (resultValue) {
+        scalingContext = sws_getContext(
+                frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                bitmapWidth, bitmapHeight, AV_PIX_FMT_RGBA,
+                SWS_BICUBIC, nullptr, nullptr, nullptr);
+        resultValue = scalingContext != nullptr;
+    }
+
     if (resultValue) {
         void *bitmapBuffer;
         if (AndroidBitmap_lockPixels(env, jBitmap, &bitmapBuffer) < 0) {
@@ -1,4 +1,8 @@
+#include <string.h>
+#include <unistd.h>
 #include "frame_loader_context.h"
+#include "log.h"
+#include "media_io.h"
 
 FrameLoaderContext *frame_loader_context_from_handle(int64_t handle) {
     return reinterpret_cast<FrameLoaderContext *>(handle);
@@ -8,10 +12,110 @@ int64_t frame_loader_context_to_handle(FrameLoaderContext *frameLoaderContext) {
     return reinterpret_cast<int64_t>(frameLoaderContext);
 }
 
+FrameLoaderContext *frame_loader_context_create(AVFormatContext *avFormatContext, int videoStreamIndex) {
+    AVCodecParameters *parameters = avFormatContext->streams[videoStreamIndex]->codecpar;
+    auto *decoder = avcodec_find_decoder(parameters->codec_id);
+    if (decoder == nullptr) {
+        return nullptr;
+    }
+
+    auto *frameLoaderContext = (FrameLoaderContext *) malloc(sizeof(FrameLoaderContext));
+    frameLoaderContext->avFormatContext = avFormatContext;
+    frameLoaderContext->parameters = parameters;
+    frameLoaderContext->avVideoCodec = decoder;
+    frameLoaderContext->videoStreamIndex = videoStreamIndex;
+    frameLoaderContext->source = nullptr;
+    frameLoaderContext->fd = -1;
+    return frameLoaderContext;
+}
+
+FrameLoaderContext *frame_loader_context_create_deferred(const char *source, int fd, int videoStreamIndex,
+                                                         const char *codecName) {
+    const AVCodecDescriptor *descriptor = codecName ? avcodec_descriptor_get_by_name(codecName) : nullptr;
+    if (descriptor == nullptr || avcodec_find_decoder(descriptor->id) == nullptr) {
+        return nullptr;
+    }
+
+    int ownedFd = -1;
+    if (fd >= 0) {
+        ownedFd = dup(fd);
+        if (ownedFd < 0) {
+            LOGE("Could not duplicate file descriptor %d", fd);
+            return nullptr;
+        }
+    }
+
+    auto *frameLoaderContext = (FrameLoaderContext *) malloc(sizeof(FrameLoaderContext));
+    frameLoaderContext->avFormatContext = nullptr;
+    frameLoaderContext->parameters = nullptr;
+    frameLoaderContext->avVideoCodec = nullptr;
+    frameLoaderContext->videoStreamIndex = videoStreamIndex;
+    frameLoaderContext->source = strdup(source);
+    frameLoaderContext->fd = ownedFd;
+    return frameLoaderContext;
+}
+
+bool frame_loader_context_open(FrameLoaderContext *frameLoaderContext) {
+    if (frameLoaderContext->avFormatContext != nullptr) {
+        return true;
+    }
+    const char *source = frameLoaderContext->source;
+    if (source == nullptr) {
+        return false;
+    }
+
+    // Both functions free the context on failure.
+    AVFormatContext *avFormatContext = nullptr;
+    AVIOContext *io = frameLoaderContext->fd >= 0 ? media_io_create_fd(frameLoaderContext->fd)
+                                                  : media_io_create_for_source(source, MEDIA_IO_ACCESS_RANDOM);
+    int result;
+    if (io) {
+        result = media_io_open_input(&avFormatContext, io, source);
+    } else if (frameLoaderContext->fd >= 0) {
+        result = AVERROR(ENOMEM);
+    } else {
+        result = avformat_open_input(&avFormatContext, source, nullptr, nullptr);
+    }
+    if (result < 0) {
+        LOGE("ERROR Could not open file %s - %s", source, av_err2str(result));
+        return false;
+    }
+
+    // The cached record was built from the same unchanged file, so the stream keeps its index.
+    // Stream info is only probed when the header alone does not describe the stream.
+    int index = frameLoaderContext->videoStreamIndex;
+    bool described = index < (int) avFormatContext->nb_streams &&
+                     avFormatContext->streams[index]->codecpar->width > 0;
+    if (!described && avformat_find_stream_info(avFormatContext, nullptr) < 0) {
+        LOGE("ERROR Could not get the stream info");
+        media_io_close_input(&avFormatContext);
+        return false;
+    }
+
+    AVCodecParameters *parameters = index < (int) avFormatContext->nb_streams
+                                    ? avFormatContext->streams[index]->codecpar : nullptr;
+    const AVCodec *decoder = parameters && parameters->codec_type == AVMEDIA_TYPE_VIDEO
+                             ? avcodec_find_decoder(parameters->codec_id) : nullptr;
+    if (decoder == nullptr) {
+        LOGE("ERROR No decodable video stream at index %d in %s", index, source);
+        media_io_close_input(&avFormatContext);
+        return false;
+    }
+
+    frameLoaderContext->avFormatContext = avFormatContext;
+    frameLoaderContext->parameters = parameters;
+    frameLoaderContext->avVideoCodec = decoder;
+    return true;
+}
+
 void frame_loader_context_free(int64_t handle) {
     auto *frameLoaderContext = frame_loader_context_from_handle(handle);
     auto *avFormatContext = frameLoaderContext->avFormatContext;
 
-    avformat_close_input(&avFormatContext);
+    media_io_close_input(&avFormatContext);
+    if (frameLoaderContext->fd >= 0) {
+        close(frameLoaderContext->fd);
+    }
+    free(frameLoaderContext->source);
     free(frameLoaderContext);
-}
\ No newline at end of file
+}
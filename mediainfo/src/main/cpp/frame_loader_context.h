@@ -14,7 +14,7 @@ extern "C" {
  * Aggregates necessary pointers to FFmpeg structs.
  */
 struct FrameLoaderContext {
-    // Root FFmpeg object for the given media.
+    // Root FFmpeg object for the given media, or nullptr until a deferred context is opened.
     AVFormatContext *avFormatContext;
     // Parameters of a video stream.
     AVCodecParameters *parameters;
@@ -22,8 +22,39 @@ struct FrameLoaderContext {
     const AVCodec *avVideoCodec;
     // And index of a video stream in the avFormatContext.
     int videoStreamIndex;
+    // Source of a deferred context: a path or URL, or the name of [fd]. Owned by the context.
+    char *source;
+    // Duplicated descriptor of a deferred context, or -1. Owned by the context.
+    int fd;
 };
 
+/**
+ * Creates a FrameLoaderContext that takes ownership of an open [avFormatContext].
+ *
+ * @return the context or nullptr if the video stream at [videoStreamIndex] cannot be decoded
+ */
+FrameLoaderContext *frame_loader_context_create(AVFormatContext *avFormatContext, int videoStreamIndex);
+
+/**
+ * Creates a FrameLoaderContext for media info served from the cache. The source is only opened
+ * by frame_loader_context_open, when a frame is first requested.
+ *
+ * @param source path or URL to open, or the name of [fd]
+ * @param fd descriptor to read the media from, or -1 to open [source]; it is duplicated, so the
+ * caller keeps ownership
+ * @param codecName name of the video stream's codec, used to check that it can be decoded
+ * @return the context or nullptr if the codec cannot be decoded
+ */
+FrameLoaderContext *frame_loader_context_create_deferred(const char *source, int fd, int videoStreamIndex,
+                                                         const char *codecName);
+
+/**
+ * Opens the source of a deferred context if it is not open yet.
+ *
+ * @return true if the context has an open input with a decodable video stream
+ */
+bool frame_loader_context_open(FrameLoaderContext *frameLoaderContext);
+
 /**
  * Function that converts a pointer to FrameLoaderContext from a int64_t handle.
  *
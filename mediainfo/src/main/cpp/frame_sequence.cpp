@@ -0,0 +1,173 @@
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include <jni.h>
+#include <vector>
+#include "frame_convert.h"
+#include "log.h"
+#include "trace.h"
+#include "utils.h"
+#include "frame_sequence.h"
+
+/**
+ * Decodes the next frame of the video stream, draining the decoder at the end of the input.
+ */
+static int receive_next_frame(AVFormatContext *formatContext,
+                              int streamIndex,
+                              AVCodecContext *codecContext,
+                              AVPacket *packet,
+                              AVFrame *frame) {
+    while (true) {
+        int result = avcodec_receive_frame(codecContext, frame);
+        if (result != AVERROR(EAGAIN)) {
+            return result;
+        }
+
+        if (av_read_frame(formatContext, packet) < 0) {
+            // Flushing makes the decoder return the frames it still holds, then AVERROR_EOF.
+            avcodec_send_packet(codecContext, nullptr);
+            continue;
+        }
+        if (packet->stream_index == streamIndex) {
+            result = avcodec_send_packet(codecContext, packet);
+        }
+        av_packet_unref(packet);
+        if (result < 0 && result != AVERROR(EAGAIN)) {
+            return result;
+        }
+    }
+}
+
+int frame_sequence_extract(MediaThumbnailRetrieverContext *context,
+                           const FrameSequenceSpec &spec,
+                           uint8_t *const *buffers,
+                           int bufferCount,
+                           FrameSequenceCallback callback,
+                           void *opaque) {
+    TraceSection trace("mediainfo.frameSequence");
+    AVCodecContext *codecContext = media_thumbnail_retriever_create_decoder(context);
+    if (!codecContext) {
+        return 0;
+    }
+
+    AVFormatContext *formatContext = context->formatContext;
+    int streamIndex = context->videoStreamIndex;
+    AVRational timeBase = formatContext->streams[streamIndex]->time_base;
+    // Positions are relative to the start of the stream, which is not 0 in e.g. MPEG-TS.
+    int64_t streamStart = formatContext->streams[streamIndex]->start_time;
+    if (streamStart == AV_NOPTS_VALUE) {
+        streamStart = 0;
+    }
+    int64_t startTimestamp = streamStart + av_rescale_q(spec.startUs, AV_TIME_BASE_Q, timeBase);
+    int64_t endUs = spec.startUs + spec.durationUs;
+    double frameDurationUs = AV_TIME_BASE / spec.frameRate;
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    SwsContext *swsContext = nullptr;
+    int delivered = 0;
+
+    if (packet && frame &&
+        av_seek_frame(formatContext, streamIndex, startTimestamp, AVSEEK_FLAG_BACKWARD) >= 0) {
+        avcodec_flush_buffers(codecContext);
+
+        int slot = 0;
+        while (receive_next_frame(formatContext, streamIndex, codecContext, packet, frame) >= 0) {
+            int64_t timestamp = frame->best_effort_timestamp;
+            if (timestamp == AV_NOPTS_VALUE) {
+                av_frame_unref(frame);
+                continue;
+            }
+            int64_t timeUs = av_rescale_q(timestamp - streamStart, timeBase, AV_TIME_BASE_Q);
+            if (timeUs >= endUs) {
+                break;
+            }
+
+            // Frames are dropped until the next slot of the target rate is due.
+            auto dueUs = static_cast<int64_t>(spec.startUs + slot * frameDurationUs);
+            if (timeUs < dueUs) {
+                av_frame_unref(frame);
+                continue;
+            }
+            while (static_cast<int64_t>(spec.startUs + (slot + 1) * frameDurationUs) <= timeUs) {
+                slot++;
+            }
+            slot++;
+
+            // One scaler serves the whole range, as every frame has the stream's format.
+            int bufferIndex = delivered % bufferCount;
+            if (!frame_convert_to_rgba(&swsContext, frame, buffers[bufferIndex],
+                                       spec.width, spec.height, spec.width * 4)) {
+                break;
+            }
+            av_frame_unref(frame);
+
+            delivered++;
+            if (!callback(opaque, bufferIndex, timeUs)) {
+                break;
+            }
+        }
+    }
+
+    sws_freeContext(swsContext);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecContext);
+    return delivered;
+}
+
+struct JniFrameSequenceCallback {
+    JNIEnv *env;
+    jobject callback;
+};
+
+static bool call_frame_sequence_callback(void *opaque, int bufferIndex, int64_t timeUs) {
+    auto *jniCallback = static_cast<JniFrameSequenceCallback *>(opaque);
+    JNIEnv *env = jniCallback->env;
+    jboolean proceed = env->CallBooleanMethod(jniCallback->callback,
+                                              fields.FrameSequenceCallback.onFrameID,
+                                              (jint) bufferIndex,
+                                              (jlong) timeUs);
+    // A pending exception is rethrown to the caller once extraction returns.
+    return !env->ExceptionCheck() && proceed;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeExtractFrameSequence(
+        JNIEnv *env,
+        jobject thiz,
+        jlong handle,
+        jlong start_us,
+        jlong duration_us,
+        jdouble frame_rate,
+        jint width,
+        jint height,
+        jobjectArray buffers,
+        jobject callback) {
+    auto *context = reinterpret_cast<MediaThumbnailRetrieverContext *>(handle);
+    if (!context || !context->formatContext || context->videoStreamIndex < 0) {
+        return 0;
+    }
+
+    jsize bufferCount = env->GetArrayLength(buffers);
+    int64_t frameSize = static_cast<int64_t>(width) * height * 4;
+    std::vector<uint8_t *> pixels(bufferCount);
+    for (jsize i = 0; i < bufferCount; i++) {
+        jobject buffer = env->GetObjectArrayElement(buffers, i);
+        pixels[i] = static_cast<uint8_t *>(env->GetDirectBufferAddress(buffer));
+        jlong capacity = env->GetDirectBufferCapacity(buffer);
+        env->DeleteLocalRef(buffer);
+        if (!pixels[i] || capacity < frameSize) {
+            LOGE("Frame buffer %d is not direct or smaller than %lld bytes", i, (long long) frameSize);
+            return 0;
+        }
+    }
+
+    FrameSequenceSpec spec{start_us, duration_us, frame_rate, width, height};
+    JniFrameSequenceCallback jniCallback{env, callback};
+    return frame_sequence_extract(context, spec, pixels.data(), bufferCount,
+                                  call_frame_sequence_callback, &jniCallback);
+}
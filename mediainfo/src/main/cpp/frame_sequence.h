@@ -0,0 +1,40 @@
+#ifndef NEXTPLAYER_FRAME_SEQUENCE_H
+#define NEXTPLAYER_FRAME_SEQUENCE_H
+
+#include <cstdint>
+#include "media_thumbnail_retriever.h"
+
+/**
+ * A time range of the video to sample at a fixed rate and size.
+ */
+struct FrameSequenceSpec {
+    int64_t startUs;
+    int64_t durationUs;
+    double frameRate;
+    int width;
+    int height;
+};
+
+/**
+ * Receives each frame right after it is written into buffers[bufferIndex].
+ *
+ * @return false to stop the extraction
+ */
+typedef bool (*FrameSequenceCallback)(void *opaque, int bufferIndex, int64_t timeUs);
+
+/**
+ * Decodes the range of [spec] once and writes every frame due at the target rate, scaled to
+ * width x height RGBA, into [buffers] in turn. A buffer is overwritten [bufferCount] frames later,
+ * so a consumer may hold up to bufferCount - 1 frames while the next one is decoded.
+ *
+ * @param buffers ring of bufferCount buffers of at least width * height * 4 bytes each
+ * @return the number of frames delivered
+ */
+int frame_sequence_extract(MediaThumbnailRetrieverContext *context,
+                           const FrameSequenceSpec &spec,
+                           uint8_t *const *buffers,
+                           int bufferCount,
+                           FrameSequenceCallback callback,
+                           void *opaque);
+
+#endif //NEXTPLAYER_FRAME_SEQUENCE_H
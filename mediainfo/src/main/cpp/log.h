@@ -3,7 +3,7 @@
 
 #define LOG_TAG  "NextPlayerJNI"
 
-#ifndef NDEBUG
+#if !defined(NDEBUG) && defined(__ANDROID__)
 
 #include <android/log.h>
 
@@ -12,6 +12,16 @@
 # define LOGI(...)  __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 # define LOGW(...)  __android_log_print(ANDROID_LOG_WARNING, LOG_TAG, __VA_ARGS__)
 # define LOGE(...)  __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#elif !defined(NDEBUG)
+
+// Host builds have no logcat; warnings and errors go to stderr.
+#include <cstdio>
+
+# define LOGV(...)  (void)0
+# define LOGD(...)  (void)0
+# define LOGI(...)  (void)0
+# define LOGW(...)  ((void)fprintf(stderr, LOG_TAG ": " __VA_ARGS__), (void)fputc('\n', stderr))
+# define LOGE(...)  ((void)fprintf(stderr, LOG_TAG ": " __VA_ARGS__), (void)fputc('\n', stderr))
 #else
 # define LOGV(...)  (void)0
 # define LOGD(...)  (void)0
@@ -20,5 +30,19 @@
 # define LOGE(...)  (void)0
 #endif
 
+#if !defined(__ANDROID__) && !defined(__clang__)
+// GCC, which host builds may use, rejects the compound literal behind av_err2str in C++. A
+// temporary array lives until the end of the full expression all the same.
+#include <array>
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+#undef av_err2str
+#define av_err2str(errnum) \
+    av_make_error_string(std::array<char, AV_ERROR_MAX_STRING_SIZE>().data(), AV_ERROR_MAX_STRING_SIZE, errnum)
+#endif
+
 
 #endif //NEXTPLAYER_LOG_H
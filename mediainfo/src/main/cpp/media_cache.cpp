@@ -0,0 +1,634 @@
+#include <jni.h>
+#include <android/bitmap.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "log.h"
+#include "media_cache.h"
+#include "media_thumbnail_retriever.h"
+
+/*
+ * File layout: a CacheFileHeader followed by records, each a RecordHeader and its payload.
+ * Records are only ever appended; a later record with the same key shadows earlier ones.
+ * The in-memory index is rebuilt on open by walking the record headers, and a torn record
+ * at the tail (e.g. after a crash mid-write) is truncated away.
+ *
+ * Several caches, in this or another process, may share a file. Appends and index rebuilds
+ * hold an exclusive flock on it, and an append first indexes the records others added since.
+ *
+ * Compaction rewrites the live records into a new file and renames it over the old one, on open
+ * and when an append would grow the file past its size limit. Handles that still have the old
+ * file open notice the rename the next time they take the lock and switch to the new file.
+ */
+
+static const uint32_t CACHE_FILE_MAGIC = 0x434d4c4e; // "NLMC"
+static const uint32_t CACHE_FILE_VERSION = 1;
+static const uint32_t RECORD_MAGIC = 0x52434c4e; // "NLCR"
+static const uint32_t RECORD_FLAG_DEFLATED = 1;
+
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t device;
+    uint64_t inode;
+    int64_t size;
+    int64_t mtimeNs;
+    int64_t timeUs;
+    int32_t width;
+    int32_t height;
+    // Payload bytes stored in the file.
+    uint32_t storedSize;
+    // Payload bytes once inflated.
+    uint32_t rawSize;
+    uint32_t flags;
+    // crc32 of the stored payload.
+    uint32_t checksum;
+};
+
+static_assert(sizeof(RecordHeader) == 72, "RecordHeader layout is part of the file format");
+
+struct IndexKey {
+    MediaCacheKey file;
+    uint32_t type;
+    int64_t timeUs;
+    int32_t width;
+    int32_t height;
+
+    bool operator==(const IndexKey &other) const {
+        return file.device == other.file.device && file.inode == other.file.inode &&
+               file.size == other.file.size && file.mtimeNs == other.file.mtimeNs &&
+               type == other.type && timeUs == other.timeUs &&
+               width == other.width && height == other.height;
+    }
+};
+
+struct IndexKeyHash {
+    size_t operator()(const IndexKey &key) const {
+        uint64_t hash = 1469598103934665603ULL;
+        auto mix = [&hash](uint64_t value) {
+            hash ^= value;
+            hash *= 1099511628211ULL;
+        };
+        mix(key.file.device);
+        mix(key.file.inode);
+        mix(static_cast<uint64_t>(key.file.size));
+        mix(static_cast<uint64_t>(key.file.mtimeNs));
+        mix(key.type);
+        mix(static_cast<uint64_t>(key.timeUs));
+        mix((static_cast<uint64_t>(key.width) << 32) | static_cast<uint32_t>(key.height));
+        return static_cast<size_t>(hash);
+    }
+};
+
+struct IndexEntry {
+    // Offset of the payload, right after the record header.
+    uint64_t offset;
+    uint32_t storedSize;
+    uint32_t rawSize;
+    uint32_t flags;
+    uint32_t checksum;
+};
+
+struct MediaCache {
+    int fd;
+    // Path of the file, to notice when another handle replaced it by compacting it.
+    std::string path;
+    // Size the file is kept under by compaction, or 0 for no limit.
+    uint64_t maxSize;
+    std::mutex mutex;
+    // Bytes of valid data in the file; new records are written here.
+    uint64_t fileSize;
+    const uint8_t *mapping;
+    uint64_t mappedSize;
+    std::unordered_map<IndexKey, IndexEntry, IndexKeyHash> index;
+};
+
+MediaCache *media_cache_from_handle(int64_t handle) {
+    return reinterpret_cast<MediaCache *>(handle);
+}
+
+static void fill_key(const struct stat &st, MediaCacheKey *key) {
+    key->device = st.st_dev;
+    key->inode = st.st_ino;
+    key->size = st.st_size;
+    key->mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+bool media_cache_key_from_path(const char *path, MediaCacheKey *key) {
+    struct stat st{};
+    if (!path || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    fill_key(st, key);
+    return true;
+}
+
+bool media_cache_key_from_fd(int fd, MediaCacheKey *key) {
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    fill_key(st, key);
+    return true;
+}
+
+static void unmap(MediaCache *cache) {
+    if (cache->mapping) {
+        munmap(const_cast<uint8_t *>(cache->mapping), cache->mappedSize);
+        cache->mapping = nullptr;
+        cache->mappedSize = 0;
+    }
+}
+
+static bool remap(MediaCache *cache) {
+    unmap(cache);
+    if (cache->fileSize == 0) {
+        return true;
+    }
+    void *mapping = mmap(nullptr, cache->fileSize, PROT_READ, MAP_SHARED, cache->fd, 0);
+    if (mapping == MAP_FAILED) {
+        LOGE("Could not map media cache: %s", strerror(errno));
+        return false;
+    }
+    cache->mapping = static_cast<const uint8_t *>(mapping);
+    cache->mappedSize = cache->fileSize;
+    return true;
+}
+
+static bool write_fully(int fd, const void *data, size_t size, uint64_t offset) {
+    auto *bytes = static_cast<const uint8_t *>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+/**
+ * Starts the file over if it is not a cache file of this version. Must hold the file lock.
+ */
+static bool check_header(int fd) {
+    CacheFileHeader header{};
+    if (pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+        header.magic == CACHE_FILE_MAGIC && header.version == CACHE_FILE_VERSION) {
+        return true;
+    }
+    header = CacheFileHeader{CACHE_FILE_MAGIC, CACHE_FILE_VERSION, 0};
+    return ftruncate(fd, 0) == 0 && write_fully(fd, &header, sizeof(header), 0);
+}
+
+/**
+ * Takes the file lock. If another handle replaced the file by compacting it meanwhile, the cache
+ * switches to the file now at its path, and its records have to be indexed again from the start.
+ */
+static bool lock_current_file(MediaCache *cache) {
+    while (true) {
+        while (flock(cache->fd, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+
+        struct stat opened{};
+        struct stat current{};
+        if (fstat(cache->fd, &opened) != 0) {
+            flock(cache->fd, LOCK_UN);
+            return false;
+        }
+        if (stat(cache->path.c_str(), &current) == 0 &&
+            current.st_dev == opened.st_dev && current.st_ino == opened.st_ino) {
+            return true;
+        }
+
+        int fd = open(cache->path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            LOGE("Could not reopen media cache %s: %s", cache->path.c_str(), strerror(errno));
+            flock(cache->fd, LOCK_UN);
+            return false;
+        }
+        // Closing the replaced file also releases its lock.
+        close(cache->fd);
+        cache->fd = fd;
+        unmap(cache);
+        cache->index.clear();
+        cache->fileSize = sizeof(CacheFileHeader);
+    }
+}
+
+/**
+ * Holds an exclusive flock on the current cache file for as long as it is in scope.
+ */
+class FileLock {
+public:
+    explicit FileLock(MediaCache *cache) : cache(cache), locked(lock_current_file(cache)) {
+    }
+
+    ~FileLock() {
+        if (locked) {
+            flock(cache->fd, LOCK_UN);
+        }
+    }
+
+    bool isLocked() const {
+        return locked;
+    }
+
+private:
+    MediaCache *cache;
+    bool locked;
+};
+
+/**
+ * Size compaction shrinks the file to, leaving room for appends before the limit is reached again.
+ */
+static uint64_t compaction_budget(const MediaCache *cache) {
+    return cache->maxSize > 0 ? cache->maxSize / 4 * 3 : UINT64_MAX;
+}
+
+/**
+ * Indexes the records from [offset] to the end of the mapping. Must hold the file lock.
+ */
+static void build_index(MediaCache *cache, uint64_t offset) {
+    while (offset + sizeof(RecordHeader) <= cache->fileSize) {
+        RecordHeader header{};
+        memcpy(&header, cache->mapping + offset, sizeof(header));
+        uint64_t end = offset + sizeof(header) + header.storedSize;
+        if (header.magic != RECORD_MAGIC || end > cache->fileSize) {
+            break;
+        }
+
+        IndexKey key{{header.device, header.inode, header.size, header.mtimeNs},
+                     header.type, header.timeUs, header.width, header.height};
+        cache->index[key] = IndexEntry{offset + sizeof(header), header.storedSize, header.rawSize,
+                                       header.flags, header.checksum};
+        offset = end;
+    }
+
+    if (offset != cache->fileSize) {
+        LOGW("Dropping %llu trailing bytes of the media cache",
+             (unsigned long long) (cache->fileSize - offset));
+        if (ftruncate(cache->fd, static_cast<off_t>(offset)) == 0) {
+            cache->fileSize = offset;
+        }
+    }
+}
+
+/**
+ * Rewrites the live records into a new file that replaces the cache file. Shadowed records are
+ * dropped, and so are the oldest live records once the new file would exceed [budget] bytes.
+ * Must hold the file lock; the new file is locked before it becomes visible at the cache path.
+ */
+static bool compact(MediaCache *cache, uint64_t budget) {
+    if (cache->mappedSize < cache->fileSize && !remap(cache)) {
+        return false;
+    }
+
+    std::vector<std::pair<IndexKey, IndexEntry>> records(cache->index.begin(), cache->index.end());
+    // Newest first, so that the oldest records are the ones left out.
+    std::sort(records.begin(), records.end(), [](const auto &a, const auto &b) {
+        return a.second.offset > b.second.offset;
+    });
+    uint64_t size = sizeof(CacheFileHeader);
+    size_t kept = 0;
+    while (kept < records.size() && size + sizeof(RecordHeader) + records[kept].second.storedSize <= budget) {
+        size += sizeof(RecordHeader) + records[kept].second.storedSize;
+        kept++;
+    }
+    records.resize(kept);
+    std::reverse(records.begin(), records.end());
+
+    std::string compactPath = cache->path + ".compact";
+    int fd = open(compactPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOGE("Could not create %s: %s", compactPath.c_str(), strerror(errno));
+        return false;
+    }
+    flock(fd, LOCK_EX);
+
+    CacheFileHeader header{CACHE_FILE_MAGIC, CACHE_FILE_VERSION, 0};
+    bool written = write_fully(fd, &header, sizeof(header), 0);
+    uint64_t offset = sizeof(header);
+    std::unordered_map<IndexKey, IndexEntry, IndexKeyHash> index;
+    for (size_t pos = 0; written && pos < records.size(); pos++) {
+        IndexEntry entry = records[pos].second;
+        // The record header is copied as is; it does not depend on where the record is stored.
+        size_t recordSize = sizeof(RecordHeader) + entry.storedSize;
+        written = write_fully(fd, cache->mapping + entry.offset - sizeof(RecordHeader), recordSize, offset);
+        entry.offset = offset + sizeof(RecordHeader);
+        index[records[pos].first] = entry;
+        offset += recordSize;
+    }
+
+    if (!written || fdatasync(fd) != 0 || rename(compactPath.c_str(), cache->path.c_str()) != 0) {
+        LOGE("Could not compact media cache %s: %s", cache->path.c_str(), strerror(errno));
+        unlink(compactPath.c_str());
+        close(fd);
+        return false;
+    }
+    LOGD("Compacted media cache from %llu to %llu bytes",
+         (unsigned long long) cache->fileSize, (unsigned long long) offset);
+
+    // Closing the replaced file releases its lock; handles waiting on it then switch to this one.
+    close(cache->fd);
+    cache->fd = fd;
+    cache->fileSize = offset;
+    cache->index.swap(index);
+    return remap(cache);
+}
+
+MediaCache *media_cache_open(const char *path, uint64_t maxSize) {
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOGE("Could not open media cache %s: %s", path, strerror(errno));
+        return nullptr;
+    }
+
+    auto *cache = new MediaCache();
+    cache->fd = fd;
+    cache->path = path;
+    cache->maxSize = maxSize;
+    cache->mapping = nullptr;
+    cache->mappedSize = 0;
+
+    FileLock fileLock(cache);
+    struct stat st{};
+    if (!fileLock.isLocked() || !check_header(cache->fd) || fstat(cache->fd, &st) != 0) {
+        LOGE("Could not initialize media cache %s", path);
+        media_cache_close(cache);
+        return nullptr;
+    }
+    cache->fileSize = st.st_size;
+
+    if (!remap(cache)) {
+        media_cache_close(cache);
+        return nullptr;
+    }
+    build_index(cache, sizeof(CacheFileHeader));
+
+    // Compacted when over the limit, or when records shadowed by newer ones take up most of it.
+    uint64_t liveSize = sizeof(CacheFileHeader);
+    for (const auto &entry: cache->index) {
+        liveSize += sizeof(RecordHeader) + entry.second.storedSize;
+    }
+    bool overLimit = cache->maxSize > 0 && cache->fileSize > cache->maxSize;
+    if (overLimit || liveSize < cache->fileSize / 2) {
+        compact(cache, compaction_budget(cache));
+    }
+    return cache;
+}
+
+void media_cache_close(MediaCache *cache) {
+    if (!cache) {
+        return;
+    }
+    if (cache->mapping) {
+        munmap(const_cast<uint8_t *>(cache->mapping), cache->mappedSize);
+    }
+    if (cache->fd >= 0) {
+        close(cache->fd);
+    }
+    delete cache;
+}
+
+bool media_cache_get(MediaCache *cache, const MediaCacheKey &key, MediaCacheEntryType type,
+                     int64_t timeUs, int width, int height, std::vector<uint8_t> &out) {
+    if (!cache) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    auto it = cache->index.find(IndexKey{key, static_cast<uint32_t>(type), timeUs, width, height});
+    if (it == cache->index.end()) {
+        return false;
+    }
+    const IndexEntry &entry = it->second;
+
+    // Records appended since the last lookup are not covered by the current mapping yet.
+    if (entry.offset + entry.storedSize > cache->mappedSize && !remap(cache)) {
+        return false;
+    }
+
+    const uint8_t *payload = cache->mapping + entry.offset;
+    if (crc32(0L, payload, entry.storedSize) != entry.checksum) {
+        LOGW("Media cache entry at %llu is corrupt", (unsigned long long) entry.offset);
+        cache->index.erase(it);
+        return false;
+    }
+
+    if ((entry.flags & RECORD_FLAG_DEFLATED) == 0) {
+        out.assign(payload, payload + entry.storedSize);
+        return true;
+    }
+
+    out.resize(entry.rawSize);
+    uLongf inflatedSize = entry.rawSize;
+    if (uncompress(out.data(), &inflatedSize, payload, entry.storedSize) != Z_OK ||
+        inflatedSize != entry.rawSize) {
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+bool media_cache_put(MediaCache *cache, const MediaCacheKey &key, MediaCacheEntryType type,
+                     int64_t timeUs, int width, int height, const uint8_t *data, size_t size) {
+    if (!cache || size > UINT32_MAX) {
+        return false;
+    }
+
+    const uint8_t *payload = data;
+    size_t payloadSize = size;
+    uint32_t flags = 0;
+
+    std::vector<uint8_t> deflated;
+    if (type == MEDIA_CACHE_ENTRY_THUMBNAIL) {
+        uLongf deflatedSize = compressBound(size);
+        deflated.resize(deflatedSize);
+        if (compress2(deflated.data(), &deflatedSize, data, size, Z_BEST_SPEED) == Z_OK &&
+            deflatedSize < size) {
+            payload = deflated.data();
+            payloadSize = deflatedSize;
+            flags |= RECORD_FLAG_DEFLATED;
+        }
+    }
+
+    RecordHeader header{};
+    header.magic = RECORD_MAGIC;
+    header.type = type;
+    header.device = key.device;
+    header.inode = key.inode;
+    header.size = key.size;
+    header.mtimeNs = key.mtimeNs;
+    header.timeUs = timeUs;
+    header.width = width;
+    header.height = height;
+    header.storedSize = static_cast<uint32_t>(payloadSize);
+    header.rawSize = static_cast<uint32_t>(size);
+    header.flags = flags;
+    header.checksum = crc32(0L, payload, payloadSize);
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    FileLock fileLock(cache);
+    if (!fileLock.isLocked()) {
+        return false;
+    }
+
+    // Pick up records appended through other handles to the file, so they are not overwritten.
+    struct stat st{};
+    if (fstat(cache->fd, &st) != 0) {
+        return false;
+    }
+    if (static_cast<uint64_t>(st.st_size) > cache->fileSize) {
+        uint64_t indexed = cache->fileSize;
+        cache->fileSize = st.st_size;
+        if (!remap(cache)) {
+            return false;
+        }
+        build_index(cache, indexed);
+    }
+
+    uint64_t recordSize = sizeof(header) + payloadSize;
+    if (cache->maxSize > 0 && cache->fileSize + recordSize > cache->maxSize &&
+        (!compact(cache, compaction_budget(cache)) || cache->fileSize + recordSize > cache->maxSize)) {
+        return false;
+    }
+
+    uint64_t offset = cache->fileSize;
+    if (!write_fully(cache->fd, &header, sizeof(header), offset) ||
+        !write_fully(cache->fd, payload, payloadSize, offset + sizeof(header))) {
+        LOGE("Could not append to media cache: %s", strerror(errno));
+        ftruncate(cache->fd, static_cast<off_t>(offset));
+        return false;
+    }
+    cache->fileSize = offset + recordSize;
+
+    cache->index[IndexKey{key, static_cast<uint32_t>(type), timeUs, width, height}] =
+            IndexEntry{offset + sizeof(header), header.storedSize, header.rawSize, flags, header.checksum};
+    return true;
+}
+
+// Cached thumbnails start with width, height and rotation, followed by packed RGBA rows.
+static const size_t THUMBNAIL_PAYLOAD_HEADER_SIZE = 3 * sizeof(int32_t);
+
+static bool bitmap_to_cache_payload(JNIEnv *env, jobject bitmap, int rotationDegrees,
+                                    std::vector<uint8_t> &payload) {
+    AndroidBitmapInfo info;
+    void *pixels = nullptr;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0 ||
+        AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0 || !pixels) {
+        return false;
+    }
+
+    int32_t header[3] = {(int32_t) info.width, (int32_t) info.height, rotationDegrees};
+    size_t rowSize = info.width * 4;
+    payload.resize(THUMBNAIL_PAYLOAD_HEADER_SIZE + rowSize * info.height);
+    memcpy(payload.data(), header, sizeof(header));
+    for (uint32_t y = 0; y < info.height; y++) {
+        memcpy(payload.data() + THUMBNAIL_PAYLOAD_HEADER_SIZE + y * rowSize,
+               static_cast<uint8_t *>(pixels) + y * info.stride,
+               rowSize);
+    }
+
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return true;
+}
+
+static jobject bitmap_from_cache_payload(JNIEnv *env, const std::vector<uint8_t> &payload,
+                                         int *rotationDegrees) {
+    if (payload.size() < THUMBNAIL_PAYLOAD_HEADER_SIZE) {
+        return nullptr;
+    }
+    int32_t header[3];
+    memcpy(header, payload.data(), sizeof(header));
+    int width = header[0];
+    int height = header[1];
+    size_t rowSize = (size_t) width * 4;
+    if (width <= 0 || height <= 0 ||
+        payload.size() != THUMBNAIL_PAYLOAD_HEADER_SIZE + rowSize * height) {
+        return nullptr;
+    }
+
+    jobject bitmap = media_thumbnail_retriever_create_bitmap(env, width, height);
+    if (!bitmap) {
+        return nullptr;
+    }
+
+    AndroidBitmapInfo info;
+    void *pixels = nullptr;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0 ||
+        AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0 || !pixels) {
+        env->DeleteLocalRef(bitmap);
+        return nullptr;
+    }
+    for (int y = 0; y < height; y++) {
+        memcpy(static_cast<uint8_t *>(pixels) + y * info.stride,
+               payload.data() + THUMBNAIL_PAYLOAD_HEADER_SIZE + y * rowSize,
+               rowSize);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+
+    *rotationDegrees = header[2];
+    return bitmap;
+}
+
+jobject media_cache_get_thumbnail(JNIEnv *env, MediaCache *cache, const MediaCacheKey &key,
+                                  int64_t timeUs, int width, int height, int *rotationDegrees) {
+    std::vector<uint8_t> payload;
+    if (!media_cache_get(cache, key, MEDIA_CACHE_ENTRY_THUMBNAIL, timeUs, width, height, payload)) {
+        return nullptr;
+    }
+    return bitmap_from_cache_payload(env, payload, rotationDegrees);
+}
+
+bool media_cache_put_thumbnail(JNIEnv *env, MediaCache *cache, const MediaCacheKey &key,
+                               int64_t timeUs, int width, int height, jobject bitmap, int rotationDegrees) {
+    std::vector<uint8_t> payload;
+    if (!cache || !bitmap_to_cache_payload(env, bitmap, rotationDegrees, payload)) {
+        return false;
+    }
+    return media_cache_put(cache, key, MEDIA_CACHE_ENTRY_THUMBNAIL, timeUs, width, height,
+                           payload.data(), payload.size());
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaCache_nativeOpen(JNIEnv *env,
+                                                                    jclass clazz,
+                                                                    jstring file_path,
+                                                                    jlong max_size) {
+    const char *path = env->GetStringUTFChars(file_path, nullptr);
+    MediaCache *cache = media_cache_open(path, max_size > 0 ? static_cast<uint64_t>(max_size) : 0);
+    env->ReleaseStringUTFChars(file_path, path);
+    return reinterpret_cast<jlong>(cache);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaCache_nativeClose(JNIEnv *env,
+                                                                     jclass clazz,
+                                                                     jlong handle) {
+    media_cache_close(media_cache_from_handle(handle));
+}
@@ -0,0 +1,102 @@
+#ifndef NEXTPLAYER_MEDIA_CACHE_H
+#define NEXTPLAYER_MEDIA_CACHE_H
+
+#include <jni.h>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Identity of a file on disk. A file whose size or modification time changes gets a new key,
+ * so stale entries are simply never looked up again.
+ */
+struct MediaCacheKey {
+    uint64_t device;
+    uint64_t inode;
+    int64_t size;
+    int64_t mtimeNs;
+};
+
+enum MediaCacheEntryType {
+    // Serialized MediaInfoRecord, see media_info_record.h.
+    MEDIA_CACHE_ENTRY_MEDIA_INFO = 1,
+    // A thumbnail: width, height and rotation as int32 followed by tightly packed RGBA pixels.
+    MEDIA_CACHE_ENTRY_THUMBNAIL = 2,
+};
+
+/**
+ * Append-only, memory-mapped store of media info and thumbnails for unchanged files.
+ * All functions are thread safe, and the file may be opened by several caches or processes.
+ */
+struct MediaCache;
+
+/**
+ * Converts a handle stored in the JVM part back to a MediaCache pointer. 0 maps to nullptr.
+ */
+MediaCache *media_cache_from_handle(int64_t handle);
+
+/**
+ * Fills [key] from the file at [path].
+ *
+ * @return false if the path is not a local regular file
+ */
+bool media_cache_key_from_path(const char *path, MediaCacheKey *key);
+
+/**
+ * Fills [key] from an open file descriptor.
+ *
+ * @return false if the descriptor does not refer to a regular file
+ */
+bool media_cache_key_from_fd(int fd, MediaCacheKey *key);
+
+/**
+ * Opens or creates the cache file at [path] and indexes its entries. The file is compacted if it
+ * is over [maxSize] or mostly holds entries that were replaced since.
+ *
+ * @param maxSize size the file is kept under, dropping the oldest entries; 0 for no limit
+ * @return the cache or nullptr if the file could not be opened
+ */
+MediaCache *media_cache_open(const char *path, uint64_t maxSize);
+
+/**
+ * Unmaps and closes the cache.
+ */
+void media_cache_close(MediaCache *cache);
+
+/**
+ * Looks up an entry and copies its uncompressed payload to [out].
+ *
+ * @param timeUs position of a thumbnail, or a tag telling apart variants of other entry types
+ * @param width requested thumbnail width, 0 for other entry types
+ * @param height requested thumbnail height, 0 for other entry types
+ * @return true on a hit
+ */
+bool media_cache_get(MediaCache *cache, const MediaCacheKey &key, MediaCacheEntryType type,
+                     int64_t timeUs, int width, int height, std::vector<uint8_t> &out);
+
+/**
+ * Appends an entry, replacing any earlier entry with the same key. Thumbnails are deflated.
+ * The file is compacted first if the entry would take it over its size limit.
+ *
+ * @return true if the entry was written
+ */
+bool media_cache_put(MediaCache *cache, const MediaCacheKey &key, MediaCacheEntryType type,
+                     int64_t timeUs, int width, int height, const uint8_t *data, size_t size);
+
+/**
+ * Looks up a thumbnail and copies it into a new Bitmap.
+ *
+ * @param rotationDegrees receives the rotation of the video the thumbnail was taken from
+ * @return a local reference to the Bitmap, or nullptr on a miss
+ */
+jobject media_cache_get_thumbnail(JNIEnv *env, MediaCache *cache, const MediaCacheKey &key,
+                                  int64_t timeUs, int width, int height, int *rotationDegrees);
+
+/**
+ * Stores the pixels of [bitmap] as a thumbnail entry.
+ *
+ * @return true if the entry was written
+ */
+bool media_cache_put_thumbnail(JNIEnv *env, MediaCache *cache, const MediaCacheKey &key,
+                               int64_t timeUs, int width, int height, jobject bitmap, int rotationDegrees);
+
+#endif //NEXTPLAYER_MEDIA_CACHE_H
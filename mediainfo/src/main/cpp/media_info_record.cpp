@@ -0,0 +1,426 @@
+#include <cstring>
+#include <cstdlib>
+#include "media_info_record.h"
+
+extern "C" {
+#include <libavcodec/codec_desc.h>
+#include <libavutil/display.h>
+#include <libavutil/dovi_meta.h>
+#include <libavutil/mastering_display_metadata.h>
+#include <libavutil/pixdesc.h>
+}
+
+static const char *get_string(AVDictionary *metadata, const char *key) {
+    AVDictionaryEntry *tag = av_dict_get(metadata, key, nullptr, 0);
+    return tag != nullptr ? tag->value : nullptr;
+}
+
+static const char *get_codec_name(AVCodecID codecId) {
+    auto codecDescriptor = avcodec_descriptor_get(codecId);
+    return codecDescriptor != nullptr ? codecDescriptor->long_name : "Unknown Codec";
+}
+
+static int get_rotation(AVStream *stream) {
+    int rotation = 0;
+    AVDictionaryEntry *rotateTag = av_dict_get(stream->metadata, "rotate", nullptr, 0);
+    if (rotateTag && *rotateTag->value) {
+        rotation = atoi(rotateTag->value);
+        rotation %= 360;
+        if (rotation < 0) rotation += 360;
+    }
+    uint8_t *displaymatrix = av_stream_get_side_data(stream,
+                                                     AV_PKT_DATA_DISPLAYMATRIX,
+                                                     nullptr);
+    if (displaymatrix) {
+        double theta = av_display_rotation_get((int32_t *) displaymatrix);
+        rotation = (int) (-theta) % 360;
+        if (rotation < 0) rotation += 360;
+    }
+    return rotation;
+}
+
+static double q2d_or_zero(AVRational value) {
+    return value.den != 0 ? av_q2d(value) : 0.0;
+}
+
+static void collect_hdr_metadata(AVStream *stream, VideoStreamRecord &video) {
+    auto *masteringDisplay = reinterpret_cast<AVMasteringDisplayMetadata *>(
+            av_stream_get_side_data(stream, AV_PKT_DATA_MASTERING_DISPLAY_METADATA, nullptr));
+    video.hasMasteringDisplay = masteringDisplay != nullptr &&
+                                (masteringDisplay->has_primaries || masteringDisplay->has_luminance);
+    if (video.hasMasteringDisplay) {
+        if (masteringDisplay->has_primaries) {
+            for (int i = 0; i < 3; i++) {
+                video.masteringDisplay[i * 2] = q2d_or_zero(masteringDisplay->display_primaries[i][0]);
+                video.masteringDisplay[i * 2 + 1] = q2d_or_zero(masteringDisplay->display_primaries[i][1]);
+            }
+            video.masteringDisplay[6] = q2d_or_zero(masteringDisplay->white_point[0]);
+            video.masteringDisplay[7] = q2d_or_zero(masteringDisplay->white_point[1]);
+        }
+        if (masteringDisplay->has_luminance) {
+            video.masteringDisplay[8] = q2d_or_zero(masteringDisplay->min_luminance);
+            video.masteringDisplay[9] = q2d_or_zero(masteringDisplay->max_luminance);
+        }
+    }
+
+    auto *contentLight = reinterpret_cast<AVContentLightMetadata *>(
+            av_stream_get_side_data(stream, AV_PKT_DATA_CONTENT_LIGHT_LEVEL, nullptr));
+    if (contentLight) {
+        video.maxContentLightLevel = static_cast<int>(contentLight->MaxCLL);
+        video.maxFrameAverageLightLevel = static_cast<int>(contentLight->MaxFALL);
+    }
+
+    auto *doviConfig = reinterpret_cast<AVDOVIDecoderConfigurationRecord *>(
+            av_stream_get_side_data(stream, AV_PKT_DATA_DOVI_CONF, nullptr));
+    video.dolbyVisionProfile = doviConfig ? doviConfig->dv_profile : -1;
+}
+
+static void collect_video_stream(AVFormatContext *avFormatContext, int index, MediaInfoRecord &record) {
+    AVStream *stream = avFormatContext->streams[index];
+    AVCodecParameters *parameters = stream->codecpar;
+
+    AVRational guessedFrameRate = av_guess_frame_rate(avFormatContext, stream, nullptr);
+
+    VideoStreamRecord video{};
+    video.index = index;
+    video.title.set(get_string(stream->metadata, "title"));
+    video.codecName.set(get_codec_name(parameters->codec_id));
+    video.language.set(get_string(stream->metadata, "language"));
+    video.disposition = stream->disposition;
+    video.bitRate = parameters->bit_rate;
+    video.frameRate = guessedFrameRate.den == 0 ? 0.0 : guessedFrameRate.num / (double) guessedFrameRate.den;
+    video.width = parameters->width;
+    video.height = parameters->height;
+    video.rotation = get_rotation(stream);
+    video.profile = parameters->profile;
+    video.profileName.set(avcodec_profile_name(parameters->codec_id, parameters->profile));
+    video.level = parameters->level;
+
+    auto pixelFormat = static_cast<AVPixelFormat>(parameters->format);
+    const AVPixFmtDescriptor *pixelFormatDescriptor = av_pix_fmt_desc_get(pixelFormat);
+    video.pixelFormat.set(pixelFormatDescriptor ? pixelFormatDescriptor->name : nullptr);
+    video.bitDepth = parameters->bits_per_raw_sample;
+    if (video.bitDepth <= 0 && pixelFormatDescriptor) {
+        video.bitDepth = pixelFormatDescriptor->comp[0].depth;
+    }
+
+    video.colorRange = parameters->color_range;
+    video.colorPrimaries = parameters->color_primaries;
+    video.colorTransfer = parameters->color_trc;
+    video.colorSpace = parameters->color_space;
+    collect_hdr_metadata(stream, video);
+    record.videoStreams.push_back(video);
+}
+
+static void collect_audio_stream(AVFormatContext *avFormatContext, int index, MediaInfoRecord &record) {
+    AVStream *stream = avFormatContext->streams[index];
+    AVCodecParameters *parameters = stream->codecpar;
+
+    char chLayoutDescription[128];
+    av_channel_layout_describe(&parameters->ch_layout, chLayoutDescription,
+                               sizeof(chLayoutDescription));
+
+    AudioStreamRecord audio{};
+    audio.index = index;
+    audio.title.set(get_string(stream->metadata, "title"));
+    audio.codecName.set(get_codec_name(parameters->codec_id));
+    audio.language.set(get_string(stream->metadata, "language"));
+    audio.disposition = stream->disposition;
+    audio.bitRate = parameters->bit_rate;
+    audio.sampleFormat.set(av_get_sample_fmt_name(static_cast<AVSampleFormat>(parameters->format)));
+    audio.sampleRate = parameters->sample_rate;
+    audio.channels = parameters->ch_layout.nb_channels;
+    audio.channelLayout.set(chLayoutDescription);
+    record.audioStreams.push_back(audio);
+}
+
+static void collect_subtitle_stream(AVFormatContext *avFormatContext, int index, MediaInfoRecord &record) {
+    AVStream *stream = avFormatContext->streams[index];
+
+    SubtitleStreamRecord subtitle{};
+    subtitle.index = index;
+    subtitle.title.set(get_string(stream->metadata, "title"));
+    subtitle.codecName.set(get_codec_name(stream->codecpar->codec_id));
+    subtitle.language.set(get_string(stream->metadata, "language"));
+    subtitle.disposition = stream->disposition;
+    record.subtitleStreams.push_back(subtitle);
+}
+
+void media_info_record_collect(AVFormatContext *avFormatContext, MediaInfoRecord &record) {
+    record.formatName.set(avFormatContext->iformat->long_name);
+    record.durationMs = (int64_t) (avFormatContext->duration * av_q2d(AV_TIME_BASE_Q) * 1000.0);
+
+    for (int pos = 0; pos < avFormatContext->nb_streams; pos++) {
+        switch (avFormatContext->streams[pos]->codecpar->codec_type) {
+            case AVMEDIA_TYPE_VIDEO:
+                collect_video_stream(avFormatContext, pos, record);
+                break;
+            case AVMEDIA_TYPE_AUDIO:
+                collect_audio_stream(avFormatContext, pos, record);
+                break;
+            case AVMEDIA_TYPE_SUBTITLE:
+                collect_subtitle_stream(avFormatContext, pos, record);
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (int pos = 0; pos < avFormatContext->nb_chapters; pos++) {
+        AVChapter *chapter = avFormatContext->chapters[pos];
+        double time_base = av_q2d(chapter->time_base);
+
+        ChapterRecord chapterRecord{};
+        chapterRecord.index = pos;
+        chapterRecord.title.set(get_string(chapter->metadata, "title"));
+        chapterRecord.startMs = (int64_t) (chapter->start * time_base * 1000.0);
+        chapterRecord.endMs = (int64_t) (chapter->end * time_base * 1000.0);
+        record.chapters.push_back(chapterRecord);
+    }
+}
+
+/*
+ * Binary layout: every value is little endian (the native order of all supported ABIs).
+ * Strings are a 32-bit length followed by UTF-8 bytes, with length 0xFFFFFFFF for null.
+ * Lists are a 32-bit count followed by their elements.
+ */
+
+static const uint32_t NULL_STRING_LENGTH = UINT32_MAX;
+
+struct ByteWriter {
+    std::vector<uint8_t> &out;
+
+    void put(const void *value, size_t size) {
+        auto *bytes = static_cast<const uint8_t *>(value);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    void putInt(int32_t value) { put(&value, sizeof(value)); }
+
+    void putLong(int64_t value) { put(&value, sizeof(value)); }
+
+    void putDouble(double value) { put(&value, sizeof(value)); }
+
+    void putString(const NullableString &value) {
+        if (value.isNull) {
+            uint32_t length = NULL_STRING_LENGTH;
+            put(&length, sizeof(length));
+            return;
+        }
+        auto length = static_cast<uint32_t>(value.value.size());
+        put(&length, sizeof(length));
+        put(value.value.data(), length);
+    }
+};
+
+struct ByteReader {
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    bool failed;
+
+    bool get(void *value, size_t length) {
+        if (failed || size - position < length) {
+            failed = true;
+            return false;
+        }
+        memcpy(value, data + position, length);
+        position += length;
+        return true;
+    }
+
+    int32_t getInt() {
+        int32_t value = 0;
+        get(&value, sizeof(value));
+        return value;
+    }
+
+    int64_t getLong() {
+        int64_t value = 0;
+        get(&value, sizeof(value));
+        return value;
+    }
+
+    double getDouble() {
+        double value = 0;
+        get(&value, sizeof(value));
+        return value;
+    }
+
+    void getString(NullableString &value) {
+        uint32_t length = 0;
+        if (!get(&length, sizeof(length))) {
+            return;
+        }
+        if (length == NULL_STRING_LENGTH) {
+            value.set(nullptr);
+            return;
+        }
+        if (size - position < length) {
+            failed = true;
+            return;
+        }
+        value.isNull = false;
+        value.value.assign(reinterpret_cast<const char *>(data + position), length);
+        position += length;
+    }
+
+    // Reads a list length, rejecting counts that cannot possibly fit in the remaining bytes.
+    uint32_t getCount() {
+        uint32_t count = 0;
+        get(&count, sizeof(count));
+        if (count > size - position) {
+            failed = true;
+            return 0;
+        }
+        return count;
+    }
+};
+
+void media_info_record_serialize(const MediaInfoRecord &record, std::vector<uint8_t> &out) {
+    ByteWriter writer{out};
+    writer.putInt(MEDIA_INFO_RECORD_VERSION);
+    writer.putString(record.formatName);
+    writer.putLong(record.durationMs);
+
+    writer.putInt(static_cast<int32_t>(record.videoStreams.size()));
+    for (const auto &video: record.videoStreams) {
+        writer.putInt(video.index);
+        writer.putString(video.title);
+        writer.putString(video.codecName);
+        writer.putString(video.language);
+        writer.putInt(video.disposition);
+        writer.putLong(video.bitRate);
+        writer.putDouble(video.frameRate);
+        writer.putInt(video.width);
+        writer.putInt(video.height);
+        writer.putInt(video.rotation);
+        writer.putInt(video.profile);
+        writer.putString(video.profileName);
+        writer.putInt(video.level);
+        writer.putInt(video.bitDepth);
+        writer.putString(video.pixelFormat);
+        writer.putInt(video.colorRange);
+        writer.putInt(video.colorPrimaries);
+        writer.putInt(video.colorTransfer);
+        writer.putInt(video.colorSpace);
+        writer.putInt(video.hasMasteringDisplay ? 1 : 0);
+        if (video.hasMasteringDisplay) {
+            for (double value: video.masteringDisplay) {
+                writer.putDouble(value);
+            }
+        }
+        writer.putInt(video.maxContentLightLevel);
+        writer.putInt(video.maxFrameAverageLightLevel);
+        writer.putInt(video.dolbyVisionProfile);
+    }
+
+    writer.putInt(static_cast<int32_t>(record.audioStreams.size()));
+    for (const auto &audio: record.audioStreams) {
+        writer.putInt(audio.index);
+        writer.putString(audio.title);
+        writer.putString(audio.codecName);
+        writer.putString(audio.language);
+        writer.putInt(audio.disposition);
+        writer.putLong(audio.bitRate);
+        writer.putString(audio.sampleFormat);
+        writer.putInt(audio.sampleRate);
+        writer.putInt(audio.channels);
+        writer.putString(audio.channelLayout);
+    }
+
+    writer.putInt(static_cast<int32_t>(record.subtitleStreams.size()));
+    for (const auto &subtitle: record.subtitleStreams) {
+        writer.putInt(subtitle.index);
+        writer.putString(subtitle.title);
+        writer.putString(subtitle.codecName);
+        writer.putString(subtitle.language);
+        writer.putInt(subtitle.disposition);
+    }
+
+    writer.putInt(static_cast<int32_t>(record.chapters.size()));
+    for (const auto &chapter: record.chapters) {
+        writer.putInt(chapter.index);
+        writer.putString(chapter.title);
+        writer.putLong(chapter.startMs);
+        writer.putLong(chapter.endMs);
+    }
+}
+
+bool media_info_record_deserialize(const uint8_t *data, size_t size, MediaInfoRecord &record) {
+    ByteReader reader{data, size, 0, false};
+    if (reader.getInt() != MEDIA_INFO_RECORD_VERSION) {
+        return false;
+    }
+    reader.getString(record.formatName);
+    record.durationMs = reader.getLong();
+
+    for (uint32_t i = reader.getCount(); i > 0 && !reader.failed; i--) {
+        VideoStreamRecord video{};
+        video.index = reader.getInt();
+        reader.getString(video.title);
+        reader.getString(video.codecName);
+        reader.getString(video.language);
+        video.disposition = reader.getInt();
+        video.bitRate = reader.getLong();
+        video.frameRate = reader.getDouble();
+        video.width = reader.getInt();
+        video.height = reader.getInt();
+        video.rotation = reader.getInt();
+        video.profile = reader.getInt();
+        reader.getString(video.profileName);
+        video.level = reader.getInt();
+        video.bitDepth = reader.getInt();
+        reader.getString(video.pixelFormat);
+        video.colorRange = reader.getInt();
+        video.colorPrimaries = reader.getInt();
+        video.colorTransfer = reader.getInt();
+        video.colorSpace = reader.getInt();
+        video.hasMasteringDisplay = reader.getInt() != 0;
+        if (video.hasMasteringDisplay) {
+            for (double &value: video.masteringDisplay) {
+                value = reader.getDouble();
+            }
+        }
+        video.maxContentLightLevel = reader.getInt();
+        video.maxFrameAverageLightLevel = reader.getInt();
+        video.dolbyVisionProfile = reader.getInt();
+        record.videoStreams.push_back(video);
+    }
+
+    for (uint32_t i = reader.getCount(); i > 0 && !reader.failed; i--) {
+        AudioStreamRecord audio{};
+        audio.index = reader.getInt();
+        reader.getString(audio.title);
+        reader.getString(audio.codecName);
+        reader.getString(audio.language);
+        audio.disposition = reader.getInt();
+        audio.bitRate = reader.getLong();
+        reader.getString(audio.sampleFormat);
+        audio.sampleRate = reader.getInt();
+        audio.channels = reader.getInt();
+        reader.getString(audio.channelLayout);
+        record.audioStreams.push_back(audio);
+    }
+
+    for (uint32_t i = reader.getCount(); i > 0 && !reader.failed; i--) {
+        SubtitleStreamRecord subtitle{};
+        subtitle.index = reader.getInt();
+        reader.getString(subtitle.title);
+        reader.getString(subtitle.codecName);
+        reader.getString(subtitle.language);
+        subtitle.disposition = reader.getInt();
+        record.subtitleStreams.push_back(subtitle);
+    }
+
+    for (uint32_t i = reader.getCount(); i > 0 && !reader.failed; i--) {
+        ChapterRecord chapter{};
+        chapter.index = reader.getInt();
+        reader.getString(chapter.title);
+        chapter.startMs = reader.getLong();
+        chapter.endMs = reader.getLong();
+        record.chapters.push_back(chapter);
+    }
+
+    return !reader.failed;
+}
@@ -0,0 +1,128 @@
+#ifndef NEXTPLAYER_MEDIA_INFO_RECORD_H
+#define NEXTPLAYER_MEDIA_INFO_RECORD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/**
+ * Version of the binary layout written by media_info_record_serialize().
+ * Bump it whenever a field is added, removed or reordered, together with the decoder in
+ * MediaInfoScanner on the JVM side.
+ */
+#define MEDIA_INFO_RECORD_VERSION 2
+
+/**
+ * A string that remembers whether it was null on the FFmpeg side.
+ */
+struct NullableString {
+    bool isNull = true;
+    std::string value;
+
+    void set(const char *str) {
+        isNull = str == nullptr;
+        value = str ? str : "";
+    }
+
+    const char *c_str() const {
+        return isNull ? nullptr : value.c_str();
+    }
+};
+
+struct VideoStreamRecord {
+    int index;
+    NullableString title;
+    NullableString codecName;
+    NullableString language;
+    int disposition;
+    int64_t bitRate;
+    double frameRate;
+    int width;
+    int height;
+    int rotation;
+    // FF_PROFILE_UNKNOWN / FF_LEVEL_UNKNOWN if not known.
+    int profile;
+    NullableString profileName;
+    int level;
+    // Bits per sample of the first component, or 0 if not known.
+    int bitDepth;
+    NullableString pixelFormat;
+    // AVColorRange, AVColorPrimaries, AVColorTransferCharacteristic and AVColorSpace values,
+    // which match the ISO/IEC 23091-2 code points except for the range.
+    int colorRange;
+    int colorPrimaries;
+    int colorTransfer;
+    int colorSpace;
+    // SMPTE ST 2086 mastering display: CIE 1931 xy of red, green, blue and the white point,
+    // then min and max luminance in cd/m2.
+    bool hasMasteringDisplay;
+    double masteringDisplay[10];
+    // CTA-861.3 content light level in cd/m2, 0 if not known.
+    int maxContentLightLevel;
+    int maxFrameAverageLightLevel;
+    // Dolby Vision profile from the decoder configuration record, or -1.
+    int dolbyVisionProfile;
+};
+
+struct AudioStreamRecord {
+    int index;
+    NullableString title;
+    NullableString codecName;
+    NullableString language;
+    int disposition;
+    int64_t bitRate;
+    NullableString sampleFormat;
+    int sampleRate;
+    int channels;
+    NullableString channelLayout;
+};
+
+struct SubtitleStreamRecord {
+    int index;
+    NullableString title;
+    NullableString codecName;
+    NullableString language;
+    int disposition;
+};
+
+struct ChapterRecord {
+    int index;
+    NullableString title;
+    int64_t startMs;
+    int64_t endMs;
+};
+
+/**
+ * Everything MediaInfoBuilder learns about a file, detached from the AVFormatContext it came from.
+ */
+struct MediaInfoRecord {
+    NullableString formatName;
+    int64_t durationMs;
+    std::vector<VideoStreamRecord> videoStreams;
+    std::vector<AudioStreamRecord> audioStreams;
+    std::vector<SubtitleStreamRecord> subtitleStreams;
+    std::vector<ChapterRecord> chapters;
+};
+
+/**
+ * Fills [record] from an opened and probed format context.
+ */
+void media_info_record_collect(AVFormatContext *avFormatContext, MediaInfoRecord &record);
+
+/**
+ * Appends the compact binary form of [record] to [out].
+ */
+void media_info_record_serialize(const MediaInfoRecord &record, std::vector<uint8_t> &out);
+
+/**
+ * Parses a record written by media_info_record_serialize().
+ *
+ * @return false if the data is truncated or was written with another layout version
+ */
+bool media_info_record_deserialize(const uint8_t *data, size_t size, MediaInfoRecord &record);
+
+#endif //NEXTPLAYER_MEDIA_INFO_RECORD_H
@@ -0,0 +1,315 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include "log.h"
+#include "media_io.h"
+
+// Set from MediaIO.useMemoryMapping on the JVM side.
+static std::atomic<bool> memoryMappingEnabled(false);
+
+// Large enough that demuxers parsing big headers (MP4 moov, MKV cues) need only a few reads,
+// small enough that a seek does not pull in much data that is thrown away.
+static const int FD_IO_BUFFER_SIZE = 128 * 1024;
+
+struct FdIO {
+    MediaIO base;
+    int fd;
+    bool seekable;
+    // Offset of the next read, as pread does not move the file offset.
+    int64_t position;
+};
+
+static void fd_io_release(MediaIO *io) {
+    auto *fdIO = reinterpret_cast<FdIO *>(io);
+    close(fdIO->fd);
+    delete fdIO;
+}
+
+static int fd_io_read(void *opaque, uint8_t *buffer, int size) {
+    auto *fdIO = static_cast<FdIO *>(opaque);
+    ssize_t result;
+    do {
+        result = fdIO->seekable
+                 ? pread(fdIO->fd, buffer, size, static_cast<off_t>(fdIO->position))
+                 : read(fdIO->fd, buffer, size);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        return AVERROR(errno);
+    }
+    if (result == 0) {
+        return AVERROR_EOF;
+    }
+    fdIO->position += result;
+    return static_cast<int>(result);
+}
+
+static int64_t fd_io_seek(void *opaque, int64_t offset, int whence) {
+    auto *fdIO = static_cast<FdIO *>(opaque);
+    if (!fdIO->seekable) {
+        return AVERROR(ESPIPE);
+    }
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        // Files reached through SAF may still be growing, so the size is not cached.
+        struct stat st{};
+        if (fstat(fdIO->fd, &st) != 0) {
+            return AVERROR(errno);
+        }
+        if (whence == AVSEEK_SIZE) {
+            return st.st_size;
+        }
+        offset += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        offset += fdIO->position;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+
+    if (offset < 0) {
+        return AVERROR(EINVAL);
+    }
+    fdIO->position = offset;
+    return offset;
+}
+
+AVIOContext *media_io_create_fd(int fd) {
+    int ownFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (ownFd < 0) {
+        LOGE("Could not duplicate file descriptor %d", fd);
+        return nullptr;
+    }
+
+    auto *fdIO = new FdIO();
+    fdIO->base.release = fd_io_release;
+    fdIO->base.advise = nullptr;
+    fdIO->fd = ownFd;
+    fdIO->position = lseek(ownFd, 0, SEEK_CUR);
+    fdIO->seekable = fdIO->position >= 0;
+    if (!fdIO->seekable) {
+        fdIO->position = 0;
+    }
+
+    auto *buffer = static_cast<unsigned char *>(av_malloc(FD_IO_BUFFER_SIZE));
+    AVIOContext *io = buffer ? avio_alloc_context(buffer, FD_IO_BUFFER_SIZE, 0, fdIO,
+                                                  fd_io_read, nullptr, fd_io_seek)
+                             : nullptr;
+    if (!io) {
+        av_free(buffer);
+        fd_io_release(&fdIO->base);
+        return nullptr;
+    }
+    io->seekable = fdIO->seekable ? AVIO_SEEKABLE_NORMAL : 0;
+    return io;
+}
+
+// Reads are plain copies out of the mapping, so a small buffer only costs a few extra calls.
+static const int MMAP_IO_BUFFER_SIZE = 32 * 1024;
+
+struct MmapIO {
+    MediaIO base;
+    uint8_t *data;
+    int64_t size;
+    int64_t position;
+};
+
+static void mmap_io_release(MediaIO *io) {
+    auto *mmapIO = reinterpret_cast<MmapIO *>(io);
+    munmap(mmapIO->data, static_cast<size_t>(mmapIO->size));
+    delete mmapIO;
+}
+
+static void mmap_io_advise(MediaIO *io, MediaIOAccess access) {
+    auto *mmapIO = reinterpret_cast<MmapIO *>(io);
+    int advice = access == MEDIA_IO_ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM;
+    if (madvise(mmapIO->data, static_cast<size_t>(mmapIO->size), advice) != 0) {
+        LOGW("madvise failed: %s", strerror(errno));
+    }
+}
+
+static int mmap_io_read(void *opaque, uint8_t *buffer, int size) {
+    auto *mmapIO = static_cast<MmapIO *>(opaque);
+    if (mmapIO->position >= mmapIO->size) {
+        return AVERROR_EOF;
+    }
+    int64_t count = std::min<int64_t>(size, mmapIO->size - mmapIO->position);
+    memcpy(buffer, mmapIO->data + mmapIO->position, static_cast<size_t>(count));
+    mmapIO->position += count;
+    return static_cast<int>(count);
+}
+
+static int64_t mmap_io_seek(void *opaque, int64_t offset, int whence) {
+    auto *mmapIO = static_cast<MmapIO *>(opaque);
+    whence &= ~AVSEEK_FORCE;
+    switch (whence) {
+        case AVSEEK_SIZE:
+            return mmapIO->size;
+        case SEEK_SET:
+            break;
+        case SEEK_CUR:
+            offset += mmapIO->position;
+            break;
+        case SEEK_END:
+            offset += mmapIO->size;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (offset < 0) {
+        return AVERROR(EINVAL);
+    }
+    // Positions past the end are allowed and simply read as EOF.
+    mmapIO->position = offset;
+    return offset;
+}
+
+/**
+ * Checks whether only this app can modify the file, so that it cannot be truncated while it is
+ * mapped: touching a page past the new end would raise SIGBUS and take the process down.
+ *
+ * Only ext4 and f2fs, the filesystems of the app's internal storage, qualify. Shared storage is
+ * reached through FUSE or sdcardfs and removable cards use FAT or exFAT; other apps and the media
+ * provider write files there whatever owner and mode they report.
+ */
+static bool is_app_private(int fd, const struct stat &st) {
+    if (st.st_uid != geteuid() || (st.st_mode & S_IWOTH) ||
+        ((st.st_mode & S_IWGRP) && st.st_gid != getegid())) {
+        return false;
+    }
+    struct statfs fs{};
+    if (fstatfs(fd, &fs) != 0) {
+        return false;
+    }
+    auto type = static_cast<uint32_t>(fs.f_type);
+    return type == EXT4_SUPER_MAGIC || type == F2FS_SUPER_MAGIC;
+}
+
+AVIOContext *media_io_create_mmap(const char *path, MediaIOAccess access) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && !is_app_private(fd, st)) {
+        AVIOContext *io = media_io_create_fd(fd);
+        close(fd);
+        return io;
+    }
+
+    void *data = MAP_FAILED;
+    // Empty files cannot be mapped, and 32-bit processes may lack the address space for large
+    // ones; both are left to the file protocol.
+    if (S_ISREG(st.st_mode) && st.st_size > 0 && static_cast<uint64_t>(st.st_size) <= SIZE_MAX) {
+        data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto *mmapIO = new MmapIO();
+    mmapIO->base.release = mmap_io_release;
+    mmapIO->base.advise = mmap_io_advise;
+    mmapIO->data = static_cast<uint8_t *>(data);
+    mmapIO->size = st.st_size;
+    mmapIO->position = 0;
+    mmap_io_advise(&mmapIO->base, access);
+
+    auto *buffer = static_cast<unsigned char *>(av_malloc(MMAP_IO_BUFFER_SIZE));
+    AVIOContext *io = buffer ? avio_alloc_context(buffer, MMAP_IO_BUFFER_SIZE, 0, mmapIO,
+                                                  mmap_io_read, nullptr, mmap_io_seek)
+                             : nullptr;
+    if (!io) {
+        av_free(buffer);
+        mmap_io_release(&mmapIO->base);
+        return nullptr;
+    }
+    return io;
+}
+
+AVIOContext *media_io_create_for_source(const char *source, MediaIOAccess access) {
+    if (!source) {
+        return nullptr;
+    }
+    if (strncmp(source, "http://", 7) == 0 || strncmp(source, "https://", 8) == 0) {
+        return media_io_create_network(source);
+    }
+    // Only absolute local paths are mapped; other URLs keep going through their protocols.
+    if (source[0] != '/' || !memoryMappingEnabled.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return media_io_create_mmap(source, access);
+}
+
+void media_io_advise(AVFormatContext *formatContext, MediaIOAccess access) {
+    if (!formatContext || !(formatContext->flags & AVFMT_FLAG_CUSTOM_IO) || !formatContext->pb) {
+        return;
+    }
+    auto *mediaIO = static_cast<MediaIO *>(formatContext->pb->opaque);
+    if (mediaIO && mediaIO->advise) {
+        mediaIO->advise(mediaIO, access);
+    }
+}
+
+void media_io_free(AVIOContext **io) {
+    if (!io || !*io) {
+        return;
+    }
+    auto *mediaIO = static_cast<MediaIO *>((*io)->opaque);
+    // The buffer may have been reallocated by FFmpeg, so free the current one.
+    av_freep(&(*io)->buffer);
+    avio_context_free(io);
+    if (mediaIO) {
+        mediaIO->release(mediaIO);
+    }
+}
+
+int media_io_open_input(AVFormatContext **formatContext, AVIOContext *io, const char *name) {
+    if (!io) {
+        avformat_free_context(*formatContext);
+        *formatContext = nullptr;
+        return AVERROR(ENOMEM);
+    }
+    if (!*formatContext && !(*formatContext = avformat_alloc_context())) {
+        media_io_free(&io);
+        return AVERROR(ENOMEM);
+    }
+
+    (*formatContext)->pb = io;
+    (*formatContext)->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // avformat_open_input frees the format context on failure, but never a custom io.
+    int result = avformat_open_input(formatContext, name, nullptr, nullptr);
+    if (result < 0) {
+        media_io_free(&io);
+    }
+    return result;
+}
+
+void media_io_close_input(AVFormatContext **formatContext) {
+    if (!formatContext || !*formatContext) {
+        return;
+    }
+    AVIOContext *io = ((*formatContext)->flags & AVFMT_FLAG_CUSTOM_IO) ? (*formatContext)->pb : nullptr;
+    avformat_close_input(formatContext);
+    media_io_free(&io);
+}
+
+void media_io_set_memory_mapping_enabled(bool enabled) {
+    memoryMappingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool media_io_is_memory_mapping_enabled() {
+    return memoryMappingEnabled.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,103 @@
+#ifndef NEXTPLAYER_MEDIA_IO_H
+#define NEXTPLAYER_MEDIA_IO_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/**
+ * How an input is about to be read, passed on to backends that can tune read-ahead.
+ */
+enum MediaIOAccess {
+    // Reading mostly forward, e.g. while probing.
+    MEDIA_IO_ACCESS_SEQUENTIAL,
+    // Seeking around, e.g. while extracting frames.
+    MEDIA_IO_ACCESS_RANDOM,
+};
+
+/**
+ * Common head of the opaque state of every custom AVIOContext created here, so that
+ * media_io_free can release any of them without knowing the backend.
+ */
+struct MediaIO {
+    // Releases the backend state, including the struct itself.
+    void (*release)(MediaIO *io);
+    // Applies an access hint, or nullptr if the backend ignores hints.
+    void (*advise)(MediaIO *io, MediaIOAccess access);
+};
+
+/**
+ * Creates an AVIOContext that reads a file descriptor with pread and supports full seeking,
+ * including AVSEEK_SIZE. Descriptors that cannot seek (pipes, sockets) fall back to plain
+ * sequential reads.
+ *
+ * The descriptor is duplicated, so the caller keeps ownership of [fd].
+ *
+ * @return the context or nullptr on failure
+ */
+AVIOContext *media_io_create_fd(int fd);
+
+/**
+ * Creates an AVIOContext that reads a local file through a read-only memory mapping, so data is
+ * copied straight from the page cache instead of going through read syscalls.
+ *
+ * Only files on internal storage that no other app can write are mapped, as truncating a mapped
+ * file raises SIGBUS on the next read. Other files are read with pread like media_io_create_fd.
+ *
+ * @return the context or nullptr if the file could not be opened or mapped
+ */
+AVIOContext *media_io_create_mmap(const char *path, MediaIOAccess access);
+
+/**
+ * Creates an AVIOContext over a network URL that fetches aligned blocks, keeps recently read
+ * blocks in memory and prefetches the next block in the background, so that the repeated seeks
+ * of frame extraction rarely cost another range request.
+ *
+ * @return the context or nullptr if the URL could not be opened or does not support seeking
+ */
+AVIOContext *media_io_create_network(const char *url);
+
+/**
+ * Picks a custom io for [source] according to the global settings.
+ *
+ * @return an AVIOContext, or nullptr if [source] should be opened through FFmpeg's own protocols
+ */
+AVIOContext *media_io_create_for_source(const char *source, MediaIOAccess access);
+
+/**
+ * Enables or disables memory mapping of local files in media_io_create_for_source. Off by
+ * default.
+ */
+void media_io_set_memory_mapping_enabled(bool enabled);
+
+bool media_io_is_memory_mapping_enabled();
+
+/**
+ * Passes an access hint to the custom io of [formatContext]. Does nothing for other inputs.
+ */
+void media_io_advise(AVFormatContext *formatContext, MediaIOAccess access);
+
+/**
+ * Frees an AVIOContext created by one of the media_io_create_* functions and sets it to nullptr.
+ */
+void media_io_free(AVIOContext **io);
+
+/**
+ * Opens [formatContext] on top of a custom [io]. [formatContext] may point to a context
+ * preallocated with avformat_alloc_context to pass options, or to nullptr.
+ *
+ * The io is owned by the format context afterwards and released by media_io_close_input, and it
+ * is freed here on failure.
+ *
+ * @param name name of the input, used in logs and to guess the format from its extension
+ * @return 0 on success or a negative AVERROR
+ */
+int media_io_open_input(AVFormatContext **formatContext, AVIOContext *io, const char *name);
+
+/**
+ * Closes an input opened with avformat_open_input or media_io_open_input, releasing its
+ * custom io if it has one.
+ */
+void media_io_close_input(AVFormatContext **formatContext);
+
+#endif //NEXTPLAYER_MEDIA_IO_H
@@ -0,0 +1,17 @@
+#include <jni.h>
+#include "media_io.h"
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaIO_nativeSetMemoryMappingEnabled(JNIEnv *env,
+                                                                                   jclass clazz,
+                                                                                   jboolean enabled) {
+    media_io_set_memory_mapping_enabled(enabled);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaIO_nativeIsMemoryMappingEnabled(JNIEnv *env,
+                                                                                  jclass clazz) {
+    return media_io_is_memory_mapping_enabled();
+}
@@ -0,0 +1,90 @@
+#include "log.h"
+#include "media_io.h"
+#include "media_probe.h"
+#include "trace.h"
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+bool media_probe_has_complete_header(AVFormatContext *avFormatContext) {
+    if ((avFormatContext->ctx_flags & AVFMTCTX_NOHEADER) || avFormatContext->nb_streams == 0) {
+        return false;
+    }
+    for (unsigned int pos = 0; pos < avFormatContext->nb_streams; pos++) {
+        AVCodecParameters *parameters = avFormatContext->streams[pos]->codecpar;
+        switch (parameters->codec_type) {
+            case AVMEDIA_TYPE_VIDEO:
+                if (parameters->codec_id == AV_CODEC_ID_NONE ||
+                    parameters->width <= 0 || parameters->height <= 0) {
+                    return false;
+                }
+                break;
+            case AVMEDIA_TYPE_AUDIO:
+                if (parameters->codec_id == AV_CODEC_ID_NONE ||
+                    parameters->sample_rate <= 0 || parameters->ch_layout.nb_channels <= 0) {
+                    return false;
+                }
+                break;
+            case AVMEDIA_TYPE_SUBTITLE:
+                if (parameters->codec_id == AV_CODEC_ID_NONE) {
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+AVFormatContext *media_probe_open(const char *uri, int fd, const ProbeOptions &options) {
+    TraceSection trace("mediainfo.probe");
+    int64_t startTime = av_gettime_relative();
+
+    AVIOContext *io = fd >= 0 ? media_io_create_fd(fd)
+                              : media_io_create_for_source(uri, MEDIA_IO_ACCESS_SEQUENTIAL);
+    if (fd >= 0 && !io) {
+        return nullptr;
+    }
+
+    AVFormatContext *avFormatContext = avformat_alloc_context();
+    if (!avFormatContext) {
+        media_io_free(&io);
+        return nullptr;
+    }
+    // FFmpeg rejects a probesize below 32 bytes.
+    if (options.probeSize >= 32) {
+        avFormatContext->probesize = options.probeSize;
+    }
+    if (options.maxAnalyzeDurationUs > 0) {
+        avFormatContext->max_analyze_duration = options.maxAnalyzeDurationUs;
+    }
+    if (options.fpsProbeSize > 0) {
+        avFormatContext->fps_probe_size = options.fpsProbeSize;
+    }
+
+    // Both functions free the context on failure.
+    int result = io ? media_io_open_input(&avFormatContext, io, uri)
+                    : avformat_open_input(&avFormatContext, uri, nullptr, nullptr);
+    if (result < 0) {
+        LOGE("ERROR Could not open file %s - %s", uri, av_err2str(result));
+        return nullptr;
+    }
+
+    bool skipStreamInfo = options.skipStreamInfoWhenHeaderComplete &&
+                          media_probe_has_complete_header(avFormatContext);
+    if (!skipStreamInfo && avformat_find_stream_info(avFormatContext, nullptr) < 0) {
+        media_io_close_input(&avFormatContext);
+        LOGE("ERROR Could not get the stream info");
+        return nullptr;
+    }
+
+    LOGD("Probed %s in %.2f ms, read %lld bytes%s",
+         uri,
+         (av_gettime_relative() - startTime) / 1000.0,
+         avFormatContext->pb ? (long long) avFormatContext->pb->bytes_read : 0LL,
+         skipStreamInfo ? " (stream info skipped)" : "");
+    return avFormatContext;
+}
+
@@ -0,0 +1,40 @@
+#ifndef NEXTPLAYER_MEDIA_PROBE_H
+#define NEXTPLAYER_MEDIA_PROBE_H
+
+#include <cstdint>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/**
+ * Limits applied to probing a media source. Zero or negative values keep FFmpeg's defaults.
+ */
+struct ProbeOptions {
+    // Maximum number of bytes read to detect the format and the streams' codec parameters.
+    int64_t probeSize;
+    // Maximum duration of the input analyzed by avformat_find_stream_info, in microseconds.
+    int64_t maxAnalyzeDurationUs;
+    // Maximum number of frames used to guess a stream's frame rate.
+    int fpsProbeSize;
+    // Skip avformat_find_stream_info when the container header already describes every stream.
+    bool skipStreamInfoWhenHeaderComplete;
+};
+
+/**
+ * Checks whether the demuxer filled in everything reported about the streams while reading the
+ * header (e.g. an MP4 moov box or MKV tracks), so that decoding packets would add nothing.
+ * Fields only known after decoding, like the sample format of some audio codecs, may stay unset.
+ */
+bool media_probe_has_complete_header(AVFormatContext *avFormatContext);
+
+/**
+ * Opens and probes a media source.
+ *
+ * @param fd descriptor to read the media from, or -1 to open [uri]; [uri] is then only used as the
+ * input's name
+ * @return the probed input, to be closed with media_io_close_input, or nullptr on failure
+ */
+AVFormatContext *media_probe_open(const char *uri, int fd, const ProbeOptions &options);
+
+#endif //NEXTPLAYER_MEDIA_PROBE_H
@@ -3,19 +3,17 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/display.h>
-#include <libavutil/imgutils.h>
 }
 
 #include <android/bitmap.h>
 #include <jni.h>
 #include <cstdio>
 #include <cstdlib>
-
-struct MediaThumbnailRetrieverContext {
-    AVFormatContext *formatContext;
-    int videoStreamIndex;
-    int rotationDegrees;
-};
+#include <vector>
+#include "frame_convert.h"
+#include "media_io.h"
+#include "media_thumbnail_retriever.h"
+#include "trace.h"
 
 static MediaThumbnailRetrieverContext *context_from_handle(jlong handle) {
     return reinterpret_cast<MediaThumbnailRetrieverContext *>(handle);
@@ -53,7 +51,9 @@ static int read_rotation_degrees(AVStream *stream) {
     return rotation;
 }
 
-static jobject create_bitmap(JNIEnv *env, int width, int height) {
+jobject media_thumbnail_retriever_create_bitmap(JNIEnv *env, int width, int height) {
+    // Thumbnail service workers stay attached to the JVM for their whole lifetime, so every local
+    // reference created here is released explicitly instead of when a JNI call returns.
     jclass bitmapClass = env->FindClass("android/graphics/Bitmap");
     if (!bitmapClass) {
         return nullptr;
@@ -61,39 +61,48 @@ static jobject create_bitmap(JNIEnv *env, int width, int height) {
 
     jclass bitmapConfigClass = env->FindClass("android/graphics/Bitmap$Config");
     if (!bitmapConfigClass) {
+        env->DeleteLocalRef(bitmapClass);
         return nullptr;
     }
 
+    jobject bitmap = nullptr;
     jfieldID argb8888Field = env->GetStaticFieldID(
             bitmapConfigClass,
             "ARGB_8888",
             "Landroid/graphics/Bitmap$Config;");
-    if (!argb8888Field) {
-        return nullptr;
-    }
-
-    jobject argb8888Obj = env->GetStaticObjectField(bitmapConfigClass, argb8888Field);
-    if (!argb8888Obj) {
-        return nullptr;
-    }
-
-    jmethodID createBitmapMethod = env->GetStaticMethodID(
-            bitmapClass,
-            "createBitmap",
-            "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
-    if (!createBitmapMethod) {
-        return nullptr;
+    jobject argb8888Obj = argb8888Field ? env->GetStaticObjectField(bitmapConfigClass, argb8888Field) : nullptr;
+    if (argb8888Obj) {
+        jmethodID createBitmapMethod = env->GetStaticMethodID(
+                bitmapClass,
+                "createBitmap",
+                "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
+        if (createBitmapMethod) {
+            bitmap = env->CallStaticObjectMethod(bitmapClass, createBitmapMethod, width, height, argb8888Obj);
+        }
+        env->DeleteLocalRef(argb8888Obj);
     }
 
-    return env->CallStaticObjectMethod(bitmapClass, createBitmapMethod, width, height, argb8888Obj);
+    env->DeleteLocalRef(bitmapConfigClass);
+    env->DeleteLocalRef(bitmapClass);
+    return bitmap;
 }
 
-static jobject frame_to_bitmap(JNIEnv *env, const AVFrame *frame) {
+jobject media_thumbnail_retriever_frame_to_bitmap(JNIEnv *env, const AVFrame *frame, int width, int height) {
     if (!frame || frame->width <= 0 || frame->height <= 0) {
         return nullptr;
     }
 
-    jobject bitmap = create_bitmap(env, frame->width, frame->height);
+    // Keep the frame's aspect ratio when only one of the dimensions is requested.
+    if (width <= 0 && height <= 0) {
+        width = frame->width;
+        height = frame->height;
+    } else if (width <= 0) {
+        width = FFMAX(1, static_cast<int>(av_rescale(height, frame->width, frame->height)));
+    } else if (height <= 0) {
+        height = FFMAX(1, static_cast<int>(av_rescale(width, frame->height, frame->width)));
+    }
+
+    jobject bitmap = media_thumbnail_retriever_create_bitmap(env, width, height);
     if (!bitmap) {
         return nullptr;
     }
@@ -110,58 +119,22 @@ static jobject frame_to_bitmap(JNIEnv *env, const AVFrame *frame) {
         return nullptr;
     }
 
-    SwsContext *swsContext = sws_getContext(
-            frame->width,
-            frame->height,
-            static_cast<AVPixelFormat>(frame->format),
-            bitmapInfo.width,
-            bitmapInfo.height,
-            AV_PIX_FMT_RGBA,
-            SWS_BILINEAR,
-            nullptr,
-            nullptr,
-            nullptr);
-
-    if (!swsContext) {
-        AndroidBitmap_unlockPixels(env, bitmap);
-        env->DeleteLocalRef(bitmap);
-        return nullptr;
-    }
+    SwsContext *swsContext = nullptr;
+    bool converted = frame_convert_to_rgba(&swsContext, frame, static_cast<uint8_t *>(bitmapPixels),
+                                           static_cast<int>(bitmapInfo.width),
+                                           static_cast<int>(bitmapInfo.height),
+                                           static_cast<int>(bitmapInfo.stride));
+    sws_freeContext(swsContext);
+    AndroidBitmap_unlockPixels(env, bitmap);
 
-    AVFrame *outputFrame = av_frame_alloc();
-    if (!outputFrame) {
-        sws_freeContext(swsContext);
-        AndroidBitmap_unlockPixels(env, bitmap);
+    if (!converted) {
         env->DeleteLocalRef(bitmap);
         return nullptr;
     }
-
-    av_image_fill_arrays(
-            outputFrame->data,
-            outputFrame->linesize,
-            static_cast<uint8_t *>(bitmapPixels),
-            AV_PIX_FMT_RGBA,
-            bitmapInfo.width,
-            bitmapInfo.height,
-            1);
-
-    sws_scale(
-            swsContext,
-            frame->data,
-            frame->linesize,
-            0,
-            frame->height,
-            outputFrame->data,
-            outputFrame->linesize);
-
-    av_frame_free(&outputFrame);
-    sws_freeContext(swsContext);
-    AndroidBitmap_unlockPixels(env, bitmap);
-
     return bitmap;
 }
 
-static AVCodecContext *create_decoder_context(MediaThumbnailRetrieverContext *context) {
+AVCodecContext *media_thumbnail_retriever_create_decoder(MediaThumbnailRetrieverContext *context) {
     if (!context || !context->formatContext || context->videoStreamIndex < 0) {
         return nullptr;
     }
@@ -181,8 +154,18 @@ static AVCodecContext *create_decoder_context(MediaThumbnailRetrieverContext *co
         return nullptr;
     }
 
-    if (avcodec_parameters_to_context(codecContext, videoStream->codecpar) < 0 ||
-            avcodec_open2(codecContext, decoder, nullptr) < 0) {
+    if (avcodec_parameters_to_context(codecContext, videoStream->codecpar) < 0) {
+        avcodec_free_context(&codecContext);
+        return nullptr;
+    }
+
+    if (context->codecThreads > 0) {
+        codecContext->thread_count = context->codecThreads;
+        // Only one frame is needed, so frame threading would just add decode latency.
+        codecContext->thread_type = FF_THREAD_SLICE;
+    }
+
+    if (avcodec_open2(codecContext, decoder, nullptr) < 0) {
         avcodec_free_context(&codecContext);
         return nullptr;
     }
@@ -225,95 +208,175 @@ static bool decode_next_frame(MediaThumbnailRetrieverContext *context,
     return false;
 }
 
-static jobject decode_frame_at_time(JNIEnv *env, MediaThumbnailRetrieverContext *context, int64_t timeUs) {
-    AVCodecContext *codecContext = create_decoder_context(context);
+/**
+ * Decodes forward until a frame at or after [timestamp] comes out, dropping the ones before it.
+ */
+static bool decode_frame_at_or_after(MediaThumbnailRetrieverContext *context,
+        AVCodecContext *codecContext,
+        AVPacket *packet,
+        AVFrame *frame,
+        int64_t timestamp) {
+    while (decode_next_frame(context, codecContext, packet, frame)) {
+        int64_t frameTimestamp = frame->best_effort_timestamp;
+        if (frameTimestamp == AV_NOPTS_VALUE || frameTimestamp >= timestamp) {
+            return true;
+        }
+        av_frame_unref(frame);
+    }
+    return false;
+}
+
+bool media_thumbnail_retriever_decode_frame_at_time(MediaThumbnailRetrieverContext *context,
+                                                    int64_t timeUs,
+                                                    AVFrame *frame) {
+    TraceSection trace("mediainfo.decodeFrameAtTime");
+    AVCodecContext *codecContext = media_thumbnail_retriever_create_decoder(context);
     if (!codecContext) {
-        return nullptr;
+        return false;
     }
 
     AVStream *videoStream = context->formatContext->streams[context->videoStreamIndex];
     int64_t targetTimestamp = av_rescale_q(timeUs, AV_TIME_BASE_Q, videoStream->time_base);
-    int seekResult = av_seek_frame(context->formatContext, context->videoStreamIndex, targetTimestamp, AVSEEK_FLAG_BACKWARD);
-    if (seekResult < 0) {
+
+    // With an index, seek to the exact keyframe instead of trusting the demuxer's own index.
+    int64_t keyframeTimestamp = AV_NOPTS_VALUE;
+    bool seeked;
+    if (context->packetIndex) {
+        size_t entry = packet_index_find_entry(context->packetIndex, targetTimestamp);
+        seeked = packet_index_seek_to_entry(context->packetIndex, context->formatContext, entry, &keyframeTimestamp);
+    } else {
+        seeked = av_seek_frame(context->formatContext, context->videoStreamIndex, targetTimestamp, AVSEEK_FLAG_BACKWARD) >= 0;
+    }
+    if (!seeked) {
         // Failed to seek to the requested timestamp; clean up and return null.
         avcodec_free_context(&codecContext);
-        return nullptr;
+        return false;
     }
     avcodec_flush_buffers(codecContext);
 
     AVPacket *packet = av_packet_alloc();
-    AVFrame *frame = av_frame_alloc();
-    if (!packet || !frame) {
-        av_packet_free(&packet);
-        av_frame_free(&frame);
+    if (!packet) {
         avcodec_free_context(&codecContext);
-        return nullptr;
+        return false;
     }
 
-    jobject result = nullptr;
-    if (decode_next_frame(context, codecContext, packet, frame)) {
-        result = frame_to_bitmap(env, frame);
-    }
+    bool result = keyframeTimestamp != AV_NOPTS_VALUE
+            ? decode_frame_at_or_after(context, codecContext, packet, frame, keyframeTimestamp)
+            : decode_next_frame(context, codecContext, packet, frame);
 
     av_packet_free(&packet);
-    av_frame_free(&frame);
     avcodec_free_context(&codecContext);
 
     return result;
 }
 
-static jobject decode_frame_at_index(JNIEnv *env, MediaThumbnailRetrieverContext *context, int frameIndex) {
-    AVCodecContext *codecContext = create_decoder_context(context);
-    if (!codecContext) {
+static jobject decode_frame_at_time(JNIEnv *env, MediaThumbnailRetrieverContext *context, int64_t timeUs) {
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
         return nullptr;
     }
 
+    jobject result = nullptr;
+    if (media_thumbnail_retriever_decode_frame_at_time(context, timeUs, frame)) {
+        result = media_thumbnail_retriever_frame_to_bitmap(env, frame, 0, 0);
+    }
+
+    av_frame_free(&frame);
+
+    return result;
+}
+
+/**
+ * Decodes every frame from the start of the stream up to [frameIndex], for inputs without an index.
+ */
+static bool decode_frame_by_counting(MediaThumbnailRetrieverContext *context,
+        AVCodecContext *codecContext,
+        AVPacket *packet,
+        AVFrame *frame,
+        int frameIndex) {
     int seekResult = av_seek_frame(context->formatContext, context->videoStreamIndex, 0, AVSEEK_FLAG_BACKWARD);
     if (seekResult < 0) {
-        avcodec_free_context(&codecContext);
-        return nullptr;
+        return false;
     }
     avcodec_flush_buffers(codecContext);
 
-    AVPacket *packet = av_packet_alloc();
-    AVFrame *frame = av_frame_alloc();
-    if (!packet || !frame) {
-        av_packet_free(&packet);
-        av_frame_free(&frame);
-        avcodec_free_context(&codecContext);
-        return nullptr;
-    }
-
     int decodedFrameCount = 0;
-    jobject result = nullptr;
-
     while (decode_next_frame(context, codecContext, packet, frame)) {
         if (decodedFrameCount == frameIndex) {
-            result = frame_to_bitmap(env, frame);
-            break;
+            return true;
         }
         decodedFrameCount++;
         av_frame_unref(frame);
     }
+    return false;
+}
+
+bool media_thumbnail_retriever_decode_frame_at_index(MediaThumbnailRetrieverContext *context,
+                                                     int frameIndex,
+                                                     AVFrame *frame) {
+    TraceSection trace("mediainfo.decodeFrameAtIndex");
+    PacketIndex *index = context->packetIndex;
+    if (index && static_cast<size_t>(frameIndex) >= index->entries.size()) {
+        return false;
+    }
+
+    AVCodecContext *codecContext = media_thumbnail_retriever_create_decoder(context);
+    if (!codecContext) {
+        return false;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        avcodec_free_context(&codecContext);
+        return false;
+    }
+
+    bool result;
+    if (index) {
+        int64_t keyframeTimestamp;
+        result = packet_index_seek_to_entry(index, context->formatContext, frameIndex, &keyframeTimestamp);
+        if (result) {
+            avcodec_flush_buffers(codecContext);
+            result = decode_frame_at_or_after(context, codecContext, packet, frame,
+                                              index->entries[frameIndex].timestamp);
+        }
+    } else {
+        result = decode_frame_by_counting(context, codecContext, packet, frame, frameIndex);
+    }
 
     av_packet_free(&packet);
-    av_frame_free(&frame);
     avcodec_free_context(&codecContext);
 
     return result;
 }
 
-static jlong create_context_from_source(const char *source) {
-    AVFormatContext *formatContext = nullptr;
-    if (!source || avformat_open_input(&formatContext, source, nullptr, nullptr) < 0) {
-        return 0;
+static jobject decode_frame_at_index(JNIEnv *env, MediaThumbnailRetrieverContext *context, int frameIndex) {
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        return nullptr;
     }
 
-    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
-        avformat_close_input(&formatContext);
-        return 0;
+    jobject result = nullptr;
+    if (media_thumbnail_retriever_decode_frame_at_index(context, frameIndex, frame)) {
+        result = media_thumbnail_retriever_frame_to_bitmap(env, frame, 0, 0);
     }
 
+    av_frame_free(&frame);
+
+    return result;
+}
+
+void media_thumbnail_retriever_set_packet_index(MediaThumbnailRetrieverContext *context, PacketIndex *index) {
+    packet_index_free(context->packetIndex);
+    context->packetIndex = index;
+    if (index) {
+        packet_index_apply(index, context->formatContext);
+    }
+}
+
+void media_thumbnail_retriever_init(MediaThumbnailRetrieverContext *context,
+                                    AVFormatContext *formatContext,
+                                    int codecThreads) {
     int videoStreamIndex = -1;
     for (unsigned int i = 0; i < formatContext->nb_streams; ++i) {
         AVStream *stream = formatContext->streams[i];
@@ -334,20 +397,77 @@ static jlong create_context_from_source(const char *source) {
         videoStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
     }
 
-    auto *context = reinterpret_cast<MediaThumbnailRetrieverContext *>(malloc(sizeof(MediaThumbnailRetrieverContext)));
-    if (!context) {
-        avformat_close_input(&formatContext);
-        return 0;
-    }
-
     context->formatContext = formatContext;
     context->videoStreamIndex = videoStreamIndex;
     context->rotationDegrees = (videoStreamIndex >= 0)
             ? read_rotation_degrees(formatContext->streams[videoStreamIndex])
             : 0;
-    return handle_from_context(context);
+    context->codecThreads = codecThreads;
+    context->packetIndex = nullptr;
+}
+
+/**
+ * Probes an opened input and wraps it in a context, taking ownership of [formatContext].
+ */
+static MediaThumbnailRetrieverContext *create_context(AVFormatContext *formatContext, int codecThreads) {
+    TraceSection trace("mediainfo.probe");
+    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+        media_io_close_input(&formatContext);
+        return nullptr;
+    }
+    // Probing is done; thumbnails only seek.
+    media_io_advise(formatContext, MEDIA_IO_ACCESS_RANDOM);
+
+    auto *context = reinterpret_cast<MediaThumbnailRetrieverContext *>(malloc(sizeof(MediaThumbnailRetrieverContext)));
+    if (!context) {
+        media_io_close_input(&formatContext);
+        return nullptr;
+    }
+
+    media_thumbnail_retriever_init(context, formatContext, codecThreads);
+    return context;
+}
+
+MediaThumbnailRetrieverContext *media_thumbnail_retriever_create(const char *source, int codecThreads) {
+    if (!source) {
+        return nullptr;
+    }
+
+    AVFormatContext *formatContext = nullptr;
+    AVIOContext *io = media_io_create_for_source(source, MEDIA_IO_ACCESS_SEQUENTIAL);
+    int result = io ? media_io_open_input(&formatContext, io, source)
+                    : avformat_open_input(&formatContext, source, nullptr, nullptr);
+    if (result < 0) {
+        return nullptr;
+    }
+    return create_context(formatContext, codecThreads);
+}
+
+MediaThumbnailRetrieverContext *media_thumbnail_retriever_create_from_fd(int fd, int codecThreads) {
+    char name[32];
+    snprintf(name, sizeof(name), "fd:%d", fd);
+
+    AVFormatContext *formatContext = nullptr;
+    if (media_io_open_input(&formatContext, media_io_create_fd(fd), name) < 0) {
+        return nullptr;
+    }
+    return create_context(formatContext, codecThreads);
 }
 
+void media_thumbnail_retriever_free(MediaThumbnailRetrieverContext *context) {
+    if (!context) {
+        return;
+    }
+
+    packet_index_free(context->packetIndex);
+    if (context->formatContext) {
+        media_io_close_input(&context->formatContext);
+    }
+
+    free(context);
+}
+
+
 extern "C"
 JNIEXPORT jlong JNICALL
 Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeCreateFromPath(
@@ -355,7 +475,7 @@ Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeCrea
         jobject thiz,
         jstring file_path) {
     const char *source = env->GetStringUTFChars(file_path, nullptr);
-    jlong handle = create_context_from_source(source);
+    jlong handle = handle_from_context(media_thumbnail_retriever_create(source, 0));
     env->ReleaseStringUTFChars(file_path, source);
     return handle;
 }
@@ -366,9 +486,7 @@ Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeCrea
         JNIEnv *env,
         jobject thiz,
         jint file_descriptor) {
-    char fdPath[64];
-    snprintf(fdPath, sizeof(fdPath), "/proc/self/fd/%d", file_descriptor);
-    return create_context_from_source(fdPath);
+    return handle_from_context(media_thumbnail_retriever_create_from_fd(file_descriptor, 0));
 }
 
 extern "C"
@@ -438,6 +556,75 @@ Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeGetF
     return decode_frame_at_index(env, context, frame_index);
 }
 
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeBuildIndex(
+        JNIEnv *env,
+        jobject thiz,
+        jlong handle) {
+    auto *context = context_from_handle(handle);
+    if (!context || !context->formatContext || context->videoStreamIndex < 0) {
+        return false;
+    }
+
+    PacketIndex *index = packet_index_build(context->formatContext, context->videoStreamIndex);
+    if (!index) {
+        return false;
+    }
+    media_thumbnail_retriever_set_packet_index(context, index);
+    return true;
+}
+
+extern "C"
+JNIEXPORT jbyteArray JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeExportIndex(
+        JNIEnv *env,
+        jobject thiz,
+        jlong handle) {
+    auto *context = context_from_handle(handle);
+    if (!context || !context->packetIndex) {
+        return nullptr;
+    }
+
+    std::vector<uint8_t> data;
+    packet_index_serialize(context->packetIndex, data);
+
+    jbyteArray result = env->NewByteArray(static_cast<jsize>(data.size()));
+    if (!result) {
+        return nullptr;
+    }
+    env->SetByteArrayRegion(result, 0, static_cast<jsize>(data.size()), reinterpret_cast<const jbyte *>(data.data()));
+    return result;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeImportIndex(
+        JNIEnv *env,
+        jobject thiz,
+        jlong handle,
+        jbyteArray data) {
+    auto *context = context_from_handle(handle);
+    if (!context || !context->formatContext || context->videoStreamIndex < 0) {
+        return false;
+    }
+
+    jsize size = env->GetArrayLength(data);
+    jbyte *bytes = env->GetByteArrayElements(data, nullptr);
+    if (!bytes) {
+        return false;
+    }
+    PacketIndex *index = packet_index_deserialize(reinterpret_cast<const uint8_t *>(bytes), size,
+                                                  context->formatContext, context->videoStreamIndex);
+    env->ReleaseByteArrayElements(data, bytes, JNI_ABORT);
+
+    if (!index) {
+        return false;
+    }
+    media_thumbnail_retriever_set_packet_index(context, index);
+    return true;
+}
+
 extern "C"
 JNIEXPORT jint JNICALL
 Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeGetRotationDegrees(
@@ -457,14 +644,5 @@ Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeRele
         JNIEnv *env,
         jobject thiz,
         jlong handle) {
-    auto *context = context_from_handle(handle);
-    if (!context) {
-        return;
-    }
-
-    if (context->formatContext) {
-        avformat_close_input(&context->formatContext);
-    }
-
-    free(context);
+    media_thumbnail_retriever_free(context_from_handle(handle));
 }
@@ -0,0 +1,104 @@
+#ifndef NEXTPLAYER_MEDIA_THUMBNAIL_RETRIEVER_H
+#define NEXTPLAYER_MEDIA_THUMBNAIL_RETRIEVER_H
+
+#include <jni.h>
+#include "packet_index.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+/**
+ * Native state behind a MediaThumbnailRetriever handle or a single thumbnail service job.
+ */
+struct MediaThumbnailRetrieverContext {
+    // Root FFmpeg object for the opened media.
+    AVFormatContext *formatContext;
+    // Index of the video stream used for thumbnails, or -1 if there is none.
+    int videoStreamIndex;
+    // Rotation of the video stream in degrees, normalized to [0, 360).
+    int rotationDegrees;
+    // Number of threads to open the video decoder with, or 0 to keep FFmpeg's default.
+    int codecThreads;
+    // Packet index of the video stream, or nullptr until one is built or imported.
+    PacketIndex *packetIndex;
+};
+
+/**
+ * Opens and probes the given source and picks the video stream to extract thumbnails from.
+ *
+ * @param source a path or URL that FFmpeg can open
+ * @param codecThreads number of decoder threads, or 0 to keep FFmpeg's default
+ * @return a newly allocated context or nullptr on failure
+ */
+MediaThumbnailRetrieverContext *media_thumbnail_retriever_create(const char *source, int codecThreads);
+
+/**
+ * Same as media_thumbnail_retriever_create, but reads an open file descriptor with random access.
+ * The descriptor is duplicated, so the caller keeps ownership of [fd].
+ */
+MediaThumbnailRetrieverContext *media_thumbnail_retriever_create_from_fd(int fd, int codecThreads);
+
+/**
+ * Fills [context] for an input that is already open and probed, picking the video stream to
+ * extract thumbnails from. The context borrows [formatContext]; do not pass it to
+ * media_thumbnail_retriever_free.
+ */
+void media_thumbnail_retriever_init(MediaThumbnailRetrieverContext *context,
+                                    AVFormatContext *formatContext,
+                                    int codecThreads);
+
+/**
+ * Opens a decoder for the selected video stream, with the context's thread settings.
+ *
+ * @return a new codec context to free with avcodec_free_context, or nullptr on failure
+ */
+AVCodecContext *media_thumbnail_retriever_create_decoder(MediaThumbnailRetrieverContext *context);
+
+/**
+ * Seeks to [timeUs] and decodes the first video frame that follows into [frame].
+ *
+ * @return true if a frame was decoded
+ */
+bool media_thumbnail_retriever_decode_frame_at_time(MediaThumbnailRetrieverContext *context,
+                                                    int64_t timeUs,
+                                                    AVFrame *frame);
+
+/**
+ * Decodes the [frameIndex]-th frame in presentation order into [frame]. Seeks straight to the
+ * preceding keyframe when the context has a packet index, otherwise decodes from the start.
+ *
+ * @return true if a frame was decoded
+ */
+bool media_thumbnail_retriever_decode_frame_at_index(MediaThumbnailRetrieverContext *context,
+                                                     int frameIndex,
+                                                     AVFrame *frame);
+
+/**
+ * Replaces the packet index of [context], taking ownership of [index].
+ */
+void media_thumbnail_retriever_set_packet_index(MediaThumbnailRetrieverContext *context, PacketIndex *index);
+
+/**
+ * Creates a new ARGB_8888 Bitmap.
+ *
+ * @return a local reference to the Bitmap or nullptr on failure
+ */
+jobject media_thumbnail_retriever_create_bitmap(JNIEnv *env, int width, int height);
+
+/**
+ * Converts a decoded frame into a new ARGB_8888 Bitmap.
+ *
+ * @param width width of the bitmap, or 0 to derive it from [height] and the frame's aspect ratio
+ * @param height height of the bitmap, or 0 to derive it from [width] and the frame's aspect ratio
+ * @return a local reference to the Bitmap or nullptr on failure
+ */
+jobject media_thumbnail_retriever_frame_to_bitmap(JNIEnv *env, const AVFrame *frame, int width, int height);
+
+/**
+ * Closes the media and frees the context.
+ */
+void media_thumbnail_retriever_free(MediaThumbnailRetrieverContext *context);
+
+#endif //NEXTPLAYER_MEDIA_THUMBNAIL_RETRIEVER_H
@@ -1,255 +1,529 @@
 #include <jni.h>
 #include <stdio.h>
+#include <string.h>
 #include "utils.h"
 #include "log.h"
 #include "frame_loader_context.h"
+#include "media_cache.h"
+#include "media_info_record.h"
+#include "media_io.h"
+#include "media_probe.h"
+#include "media_thumbnail_retriever.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
-#include <libavcodec/codec_desc.h>
-#include <libavutil/display.h>
 }
 
-static char *get_string(AVDictionary *metadata, const char *key) {
-    char *result = nullptr;
-    AVDictionaryEntry *tag = av_dict_get(metadata, key, nullptr, 0);
-    if (tag != nullptr) {
-        result = tag->value;
-    }
-    return result;
-}
-
-static char *get_title(AVDictionary *metadata) {
-    return get_string(metadata, "title");
-}
-
-static char *get_language(AVDictionary *metadata) {
-    return get_string(metadata, "language");
-}
+/**
+ * A thumbnail to extract from the input that was opened to build the media info.
+ */
+struct ThumbnailRequest {
+    // Position of the frame in microseconds, or -1 for a third of the duration.
+    int64_t timeUs;
+    // Size of the thumbnail; 0 derives the dimension from the other one and the aspect ratio.
+    int width;
+    int height;
+};
 
 static void onError(JNIEnv *env, jobject jMediaInfoBuilder) {
     utils_call_instance_method_void(env, jMediaInfoBuilder, fields.MediaInfoBuilder.onErrorID);
 }
 
-void onMediaInfoFound(JNIEnv *env, jobject jMediaInfoBuilder, AVFormatContext *avFormatContext) {
-    const char *fileFormatName = avFormatContext->iformat->long_name;
-
-    long duration_ms = (long) (avFormatContext->duration * av_q2d(AV_TIME_BASE_Q) * 1000.0);
-    jstring jFileFormatName = env->NewStringUTF(fileFormatName);
+void onMediaInfoFound(JNIEnv *env, jobject jMediaInfoBuilder, const MediaInfoRecord &record) {
+    jstring jFileFormatName = env->NewStringUTF(record.formatName.c_str());
 
     utils_call_instance_method_void(env,
                                     jMediaInfoBuilder,
                                     fields.MediaInfoBuilder.onMediaInfoFoundID,
                                     jFileFormatName,
-                                    duration_ms);
-}
-
-void onVideoStreamFound(JNIEnv *env, jobject jMediaInfoBuilder, AVFormatContext *avFormatContext,
-                        int index) {
-    AVStream *stream = avFormatContext->streams[index];
-    AVCodecParameters *parameters = stream->codecpar;
-
-    auto codecDescriptor = avcodec_descriptor_get(parameters->codec_id);
-
-    int64_t frameLoaderContextHandle = -1;
-    auto *decoder = avcodec_find_decoder(parameters->codec_id);
-    if (decoder != nullptr) {
-        auto *frameLoaderContext = (FrameLoaderContext *) malloc(sizeof(FrameLoaderContext));;
-        frameLoaderContext->avFormatContext = avFormatContext;
-        frameLoaderContext->parameters = parameters;
-        frameLoaderContext->avVideoCodec = decoder;
-        frameLoaderContext->videoStreamIndex = index;
-        frameLoaderContextHandle = frame_loader_context_to_handle(frameLoaderContext);
-    }
-
-
-    AVRational guessedFrameRate = av_guess_frame_rate(avFormatContext,
-                                                      avFormatContext->streams[index],
-                                                      nullptr);
+                                    (jlong) record.durationMs);
 
-    double resultFrameRate =
-            guessedFrameRate.den == 0 ? 0.0 : guessedFrameRate.num / (double) guessedFrameRate.den;
-
-    jstring jTitle = env->NewStringUTF(get_title(stream->metadata));
-    jstring jCodecName;
-    if (codecDescriptor != nullptr) {
-        jCodecName = env->NewStringUTF(codecDescriptor->long_name);
-    } else {
-        jCodecName = env->NewStringUTF("Unknown Codec");
-    }
-    jstring jLanguage = env->NewStringUTF(get_language(stream->metadata));
+    env->DeleteLocalRef(jFileFormatName);
+}
 
-    int rotation = 0;
-    AVDictionaryEntry *rotateTag = av_dict_get(stream->metadata, "rotate", nullptr, 0);
-    if (rotateTag && *rotateTag->value) {
-        rotation = atoi(rotateTag->value);
-        rotation %= 360;
-        if (rotation < 0) rotation += 360;
-    }
-    uint8_t *displaymatrix = av_stream_get_side_data(stream,
-                                                     AV_PKT_DATA_DISPLAYMATRIX,
-                                                     nullptr);
-    if (displaymatrix) {
-        double theta = av_display_rotation_get((int32_t *) displaymatrix);
-        rotation = (int) (-theta) % 360;
-        if (rotation < 0) rotation += 360;
+void onVideoStreamFound(JNIEnv *env, jobject jMediaInfoBuilder, const VideoStreamRecord &video,
+                        int64_t frameLoaderContextHandle) {
+    jstring jTitle = env->NewStringUTF(video.title.c_str());
+    jstring jCodecName = env->NewStringUTF(video.codecName.c_str());
+    jstring jLanguage = env->NewStringUTF(video.language.c_str());
+    jstring jProfileName = env->NewStringUTF(video.profileName.c_str());
+    jstring jPixelFormat = env->NewStringUTF(video.pixelFormat.c_str());
+
+    jdoubleArray jMasteringDisplay = nullptr;
+    if (video.hasMasteringDisplay) {
+        jsize length = sizeof(video.masteringDisplay) / sizeof(video.masteringDisplay[0]);
+        jMasteringDisplay = env->NewDoubleArray(length);
+        if (jMasteringDisplay) {
+            env->SetDoubleArrayRegion(jMasteringDisplay, 0, length, video.masteringDisplay);
+        }
     }
 
     utils_call_instance_method_void(env,
                                     jMediaInfoBuilder,
                                     fields.MediaInfoBuilder.onVideoStreamFoundID,
-                                    index,
+                                    video.index,
                                     jTitle,
                                     jCodecName,
                                     jLanguage,
-                                    stream->disposition,
-                                    parameters->bit_rate,
-                                    resultFrameRate,
-                                    parameters->width,
-                                    parameters->height,
-                                    rotation,
-                                    frameLoaderContextHandle);
-}
-
-void onAudioStreamFound(JNIEnv *env, jobject jMediaInfoBuilder, AVFormatContext *avFormatContext,
-                        int index) {
-    AVStream *stream = avFormatContext->streams[index];
-    AVCodecParameters *parameters = stream->codecpar;
-
-    auto codecDescriptor = avcodec_descriptor_get(parameters->codec_id);
-
-    auto avSampleFormat = static_cast<AVSampleFormat>(parameters->format);
-    auto jSampleFormat = env->NewStringUTF(av_get_sample_fmt_name(avSampleFormat));
-    char chLayoutDescription[128];
-    av_channel_layout_describe(&parameters->ch_layout, chLayoutDescription,
-                               sizeof(chLayoutDescription));
-
-    jstring jTitle = env->NewStringUTF(get_title(stream->metadata));
-    jstring jCodecName;
-    if (codecDescriptor != nullptr) {
-        jCodecName = env->NewStringUTF(codecDescriptor->long_name);
-    } else {
-        jCodecName = env->NewStringUTF("Unknown Codec");
-    }
-    jstring jLanguage = env->NewStringUTF(get_language(stream->metadata));
-    jstring jChannelLayout = env->NewStringUTF(chLayoutDescription);
+                                    video.disposition,
+                                    (jlong) video.bitRate,
+                                    video.frameRate,
+                                    video.width,
+                                    video.height,
+                                    video.rotation,
+                                    (jlong) frameLoaderContextHandle,
+                                    video.profile,
+                                    jProfileName,
+                                    video.level,
+                                    video.bitDepth,
+                                    jPixelFormat,
+                                    video.colorRange,
+                                    video.colorPrimaries,
+                                    video.colorTransfer,
+                                    video.colorSpace,
+                                    jMasteringDisplay,
+                                    video.maxContentLightLevel,
+                                    video.maxFrameAverageLightLevel,
+                                    video.dolbyVisionProfile);
+
+    env->DeleteLocalRef(jTitle);
+    env->DeleteLocalRef(jCodecName);
+    env->DeleteLocalRef(jLanguage);
+    env->DeleteLocalRef(jProfileName);
+    env->DeleteLocalRef(jPixelFormat);
+    env->DeleteLocalRef(jMasteringDisplay);
+}
+
+void onAudioStreamFound(JNIEnv *env, jobject jMediaInfoBuilder, const AudioStreamRecord &audio) {
+    jstring jTitle = env->NewStringUTF(audio.title.c_str());
+    jstring jCodecName = env->NewStringUTF(audio.codecName.c_str());
+    jstring jLanguage = env->NewStringUTF(audio.language.c_str());
+    jstring jSampleFormat = env->NewStringUTF(audio.sampleFormat.c_str());
+    jstring jChannelLayout = env->NewStringUTF(audio.channelLayout.c_str());
 
     utils_call_instance_method_void(env,
                                     jMediaInfoBuilder,
                                     fields.MediaInfoBuilder.onAudioStreamFoundID,
-                                    index,
+                                    audio.index,
                                     jTitle,
                                     jCodecName,
                                     jLanguage,
-                                    stream->disposition,
-                                    parameters->bit_rate,
+                                    audio.disposition,
+                                    (jlong) audio.bitRate,
                                     jSampleFormat,
-                                    parameters->sample_rate,
-                                    parameters->ch_layout.nb_channels,
+                                    audio.sampleRate,
+                                    audio.channels,
                                     jChannelLayout);
-}
 
-void onSubtitleStreamFound(JNIEnv *env, jobject jMediaInfoBuilder, AVFormatContext *avFormatContext,
-                           int index) {
-    AVStream *stream = avFormatContext->streams[index];
-    AVCodecParameters *parameters = stream->codecpar;
-
-    auto codecDescriptor = avcodec_descriptor_get(parameters->codec_id);
+    env->DeleteLocalRef(jTitle);
+    env->DeleteLocalRef(jCodecName);
+    env->DeleteLocalRef(jLanguage);
+    env->DeleteLocalRef(jSampleFormat);
+    env->DeleteLocalRef(jChannelLayout);
+}
 
-    jstring jTitle = env->NewStringUTF(get_title(stream->metadata));
-    jstring jCodecName;
-    if (codecDescriptor != nullptr) {
-        jCodecName = env->NewStringUTF(codecDescriptor->long_name);
-    } else {
-        jCodecName = env->NewStringUTF("Unknown Codec");
-    }
-    jstring jLanguage = env->NewStringUTF(get_language(stream->metadata));
+void onSubtitleStreamFound(JNIEnv *env, jobject jMediaInfoBuilder, const SubtitleStreamRecord &subtitle) {
+    jstring jTitle = env->NewStringUTF(subtitle.title.c_str());
+    jstring jCodecName = env->NewStringUTF(subtitle.codecName.c_str());
+    jstring jLanguage = env->NewStringUTF(subtitle.language.c_str());
 
     utils_call_instance_method_void(env,
                                     jMediaInfoBuilder,
                                     fields.MediaInfoBuilder.onSubtitleStreamFoundID,
-                                    index,
+                                    subtitle.index,
                                     jTitle,
                                     jCodecName,
                                     jLanguage,
-                                    stream->disposition);
+                                    subtitle.disposition);
+
+    env->DeleteLocalRef(jTitle);
+    env->DeleteLocalRef(jCodecName);
+    env->DeleteLocalRef(jLanguage);
 }
 
-void onChapterFound(JNIEnv *env, jobject jMediaInfoBuilder, AVFormatContext *avFormatContext,
-                    int index) {
-    AVChapter *chapter = avFormatContext->chapters[index];
+void onThumbnailFound(JNIEnv *env, jobject jMediaInfoBuilder, jobject bitmap, int rotationDegrees) {
+    utils_call_instance_method_void(env,
+                                    jMediaInfoBuilder,
+                                    fields.MediaInfoBuilder.onThumbnailFoundID,
+                                    bitmap,
+                                    rotationDegrees);
+}
 
-    jstring jTitle = env->NewStringUTF(get_title(chapter->metadata));
-    double time_base = av_q2d(chapter->time_base);
-    long start_ms = (long) (chapter->start * time_base * 1000.0);
-    long end_ms = (long) (chapter->end * time_base * 1000.0);
+void onChapterFound(JNIEnv *env, jobject jMediaInfoBuilder, const ChapterRecord &chapter) {
+    jstring jTitle = env->NewStringUTF(chapter.title.c_str());
 
     utils_call_instance_method_void(env,
                                     jMediaInfoBuilder,
                                     fields.MediaInfoBuilder.onChapterFoundID,
-                                    index,
+                                    chapter.index,
                                     jTitle,
-                                    start_ms,
-                                    end_ms);
+                                    (jlong) chapter.startMs,
+                                    (jlong) chapter.endMs);
+
+    env->DeleteLocalRef(jTitle);
 }
 
-void media_info_build(JNIEnv *env, jobject jMediaInfoBuilder, const char *uri) {
-    AVFormatContext *avFormatContext = nullptr;
-    if (int result = avformat_open_input(&avFormatContext, uri, nullptr, nullptr)) {
-        LOGE("ERROR Could not open file %s - %s", uri, av_err2str(result));
-        onError(env, jMediaInfoBuilder);
+/**
+ * Decodes the requested thumbnail from an input that is already open and probed.
+ *
+ * @return a local reference to the Bitmap or nullptr if there is no decodable video stream
+ */
+static jobject extract_thumbnail(JNIEnv *env, AVFormatContext *avFormatContext,
+                                 const ThumbnailRequest &request, int *rotationDegrees) {
+    MediaThumbnailRetrieverContext context;
+    media_thumbnail_retriever_init(&context, avFormatContext, 0);
+    if (context.videoStreamIndex < 0) {
+        return nullptr;
+    }
+    media_io_advise(avFormatContext, MEDIA_IO_ACCESS_RANDOM);
+
+    int64_t timeUs = request.timeUs;
+    if (timeUs < 0) {
+        timeUs = avFormatContext->duration > 0 ? avFormatContext->duration / 3 : 0;
+    }
+
+    jobject bitmap = nullptr;
+    AVFrame *frame = av_frame_alloc();
+    if (frame && media_thumbnail_retriever_decode_frame_at_time(&context, timeUs, frame)) {
+        bitmap = media_thumbnail_retriever_frame_to_bitmap(env, frame, request.width, request.height);
+        *rotationDegrees = context.rotationDegrees;
+    }
+    av_frame_free(&frame);
+    return bitmap;
+}
+
+/**
+ * Where a frame loader opens the media of a record that was served from the cache.
+ */
+struct DeferredSource {
+    // Path or URL, or the name of [fd].
+    const char *uri;
+    // Descriptor to read the media from, or -1 to open [uri].
+    int fd;
+};
+
+/**
+ * Reports [record] to the builder. When [avFormatContext] is given, it is either handed over to
+ * the frame loader of the first video stream, if [frameLoader] is set, or closed. Without it, the
+ * frame loader opens [deferredSource] on first use.
+ */
+static void emit_media_info(JNIEnv *env, jobject jMediaInfoBuilder, const MediaInfoRecord &record,
+                            AVFormatContext *avFormatContext, bool frameLoader,
+                            const DeferredSource *deferredSource) {
+    onMediaInfoFound(env, jMediaInfoBuilder, record);
+
+    FrameLoaderContext *frameLoaderContext = nullptr;
+    for (size_t pos = 0; pos < record.videoStreams.size(); pos++) {
+        const VideoStreamRecord &video = record.videoStreams[pos];
+        // MediaInfoBuilder only keeps the first video stream, so only it gets a frame loader.
+        int64_t handle = -1;
+        if (pos == 0 && frameLoader) {
+            if (avFormatContext != nullptr) {
+                frameLoaderContext = frame_loader_context_create(avFormatContext, video.index);
+                // From here on the input is only used to seek to frames.
+                media_io_advise(avFormatContext, MEDIA_IO_ACCESS_RANDOM);
+            } else if (deferredSource != nullptr) {
+                frameLoaderContext = frame_loader_context_create_deferred(
+                        deferredSource->uri, deferredSource->fd, video.index, video.codecName.c_str());
+            }
+            if (frameLoaderContext != nullptr) {
+                handle = frame_loader_context_to_handle(frameLoaderContext);
+            }
+        }
+        onVideoStreamFound(env, jMediaInfoBuilder, video, handle);
+    }
+    for (const auto &audio: record.audioStreams) {
+        onAudioStreamFound(env, jMediaInfoBuilder, audio);
+    }
+    for (const auto &subtitle: record.subtitleStreams) {
+        onSubtitleStreamFound(env, jMediaInfoBuilder, subtitle);
+    }
+    for (const auto &chapter: record.chapters) {
+        onChapterFound(env, jMediaInfoBuilder, chapter);
+    }
+
+    if (avFormatContext != nullptr && frameLoaderContext == nullptr) {
+        media_io_close_input(&avFormatContext);
+    }
+}
+
+/**
+ * Tags the media info cache entries with the probe options they were built with, so that a reduced
+ * probe is never replayed to a caller that asked for a full one. The tag is stored in the entry's
+ * timeUs field, which media info entries do not otherwise use; 0 stands for FFmpeg's default
+ * probing.
+ */
+static int64_t probe_options_cache_tag(const ProbeOptions &options) {
+    // Normalized like media_probe_open applies them, so equivalent options share entries.
+    uint64_t values[] = {
+            static_cast<uint64_t>(options.probeSize >= 32 ? options.probeSize : 0),
+            static_cast<uint64_t>(options.maxAnalyzeDurationUs > 0 ? options.maxAnalyzeDurationUs : 0),
+            static_cast<uint64_t>(options.fpsProbeSize > 0 ? options.fpsProbeSize : 0),
+            static_cast<uint64_t>(options.skipStreamInfoWhenHeaderComplete),
+    };
+    bool reduced = false;
+    uint64_t hash = 1469598103934665603ULL;
+    for (uint64_t value: values) {
+        reduced |= value != 0;
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    }
+    if (!reduced) {
+        return 0;
+    }
+    return hash != 0 ? static_cast<int64_t>(hash) : 1;
+}
+
+/**
+ * Looks up the media info probed with [options]. A full probe describes the file at least as well
+ * as a reduced one, so it also answers reduced requests.
+ */
+static bool media_info_cache_get(MediaCache *cache, const MediaCacheKey &key, const ProbeOptions &options,
+                                 std::vector<uint8_t> &payload) {
+    int64_t tag = probe_options_cache_tag(options);
+    return media_cache_get(cache, key, MEDIA_CACHE_ENTRY_MEDIA_INFO, tag, 0, 0, payload) ||
+           (tag != 0 && media_cache_get(cache, key, MEDIA_CACHE_ENTRY_MEDIA_INFO, 0, 0, 0, payload));
+}
+
+static void media_info_cache_put(MediaCache *cache, const MediaCacheKey &key, const ProbeOptions &options,
+                                 const std::vector<uint8_t> &payload) {
+    media_cache_put(cache, key, MEDIA_CACHE_ENTRY_MEDIA_INFO, probe_options_cache_tag(options), 0, 0,
+                    payload.data(), payload.size());
+}
+
+/**
+ * Replays the media info of an unchanged file, and the thumbnail if one is requested, from the
+ * cache without opening it.
+ *
+ * @param frameLoader whether a frame loader is requested; it opens [source] when it is first used
+ * @return true if everything that was asked for is cached
+ */
+static bool media_info_build_from_cache(JNIEnv *env, jobject jMediaInfoBuilder, MediaCache *cache,
+                                        const MediaCacheKey &key, const ProbeOptions &options,
+                                        const ThumbnailRequest *thumbnail, bool frameLoader,
+                                        const DeferredSource &source) {
+    std::vector<uint8_t> payload;
+    if (!media_info_cache_get(cache, key, options, payload)) {
+        return false;
+    }
+
+    MediaInfoRecord record;
+    if (!media_info_record_deserialize(payload.data(), payload.size(), record)) {
+        return false;
+    }
+    jobject bitmap = nullptr;
+    int rotationDegrees = 0;
+    if (thumbnail != nullptr) {
+        bitmap = media_cache_get_thumbnail(env, cache, key, thumbnail->timeUs, thumbnail->width,
+                                           thumbnail->height, &rotationDegrees);
+        if (!bitmap) {
+            return false;
+        }
+    }
+
+    emit_media_info(env, jMediaInfoBuilder, record, nullptr, frameLoader, &source);
+    if (bitmap) {
+        onThumbnailFound(env, jMediaInfoBuilder, bitmap, rotationDegrees);
+        env->DeleteLocalRef(bitmap);
+    }
+    return true;
+}
+
+
+/**
+ * Probes [uri] and reports what was found to the builder.
+ *
+ * @param fd descriptor to read the media from, or -1 to open [uri]
+ * @param thumbnail optional thumbnail to extract from the same input once the streams are reported
+ * @param frameLoader whether to hand the input over to a frame loader for the first video stream
+ * @param cache optional cache to read from and write to
+ * @param cacheKey identity of the file, or nullptr if it cannot be cached
+ */
+void media_info_build(JNIEnv *env, jobject jMediaInfoBuilder, const char *uri, int fd,
+                      const ProbeOptions &options, const ThumbnailRequest *thumbnail, bool frameLoader,
+                      MediaCache *cache, const MediaCacheKey *cacheKey) {
+    bool cacheable = cache != nullptr && cacheKey != nullptr;
+    if (cacheable && media_info_build_from_cache(env, jMediaInfoBuilder, cache, *cacheKey, options, thumbnail,
+                                                 frameLoader, DeferredSource{uri, fd})) {
         return;
     }
 
-    if (avformat_find_stream_info(avFormatContext, nullptr) < 0) {
-        avformat_free_context(avFormatContext);
-        LOGE("ERROR Could not get the stream info");
+    AVFormatContext *avFormatContext = media_probe_open(uri, fd, options);
+    if (!avFormatContext) {
         onError(env, jMediaInfoBuilder);
         return;
     }
 
-    onMediaInfoFound(env, jMediaInfoBuilder, avFormatContext);
-
-    for (int pos = 0; pos < avFormatContext->nb_streams; pos++) {
-        AVCodecParameters *parameters = avFormatContext->streams[pos]->codecpar;
-        AVMediaType type = parameters->codec_type;
-        switch (type) {
-            case AVMEDIA_TYPE_VIDEO:
-                onVideoStreamFound(env, jMediaInfoBuilder, avFormatContext, pos);
-                break;
-            case AVMEDIA_TYPE_AUDIO:
-                onAudioStreamFound(env, jMediaInfoBuilder, avFormatContext, pos);
-                break;
-            case AVMEDIA_TYPE_SUBTITLE:
-                onSubtitleStreamFound(env, jMediaInfoBuilder, avFormatContext, pos);
-                break;
+    MediaInfoRecord record;
+    media_info_record_collect(avFormatContext, record);
+
+    if (cacheable) {
+        std::vector<uint8_t> payload;
+        media_info_record_serialize(record, payload);
+        media_info_cache_put(cache, *cacheKey, options, payload);
+    }
+
+    // Decoded before the streams are reported, as the format context may be closed afterwards.
+    jobject bitmap = nullptr;
+    int rotationDegrees = 0;
+    if (thumbnail != nullptr) {
+        bitmap = extract_thumbnail(env, avFormatContext, *thumbnail, &rotationDegrees);
+        if (bitmap && cacheable) {
+            media_cache_put_thumbnail(env, cache, *cacheKey, thumbnail->timeUs, thumbnail->width,
+                                      thumbnail->height, bitmap, rotationDegrees);
         }
     }
 
-    for (int pos = 0; pos < avFormatContext->nb_chapters; pos++) {
-        onChapterFound(env, jMediaInfoBuilder, avFormatContext, pos);
+    emit_media_info(env, jMediaInfoBuilder, record, avFormatContext, frameLoader, nullptr);
+    if (bitmap) {
+        onThumbnailFound(env, jMediaInfoBuilder, bitmap, rotationDegrees);
+        env->DeleteLocalRef(bitmap);
     }
 }
 
+/*
+ * Batch layout, little endian like the record itself, mirrored by MediaInfoScanner:
+ * a header of version, number of entries and the size needed by the first path that did not
+ * fit (0 if none), followed by one entry per path: the record size, or -1 if the path could not
+ * be probed, and the serialized MediaInfoRecord.
+ */
+#define MEDIA_INFO_BATCH_VERSION 1
+static const size_t MEDIA_INFO_BATCH_HEADER_SIZE = 3 * sizeof(int32_t);
+
+/**
+ * Gets the serialized record of a local file from the cache, or probes it without any JNI calls.
+ */
+static bool media_info_collect_payload(const char *path, const ProbeOptions &options, MediaCache *cache,
+                                       std::vector<uint8_t> &payload) {
+    MediaCacheKey key{};
+    bool cacheable = cache != nullptr && media_cache_key_from_path(path, &key);
+    int32_t version = 0;
+    if (cacheable && media_info_cache_get(cache, key, options, payload) &&
+        payload.size() >= sizeof(version)) {
+        memcpy(&version, payload.data(), sizeof(version));
+        // The payload is passed on as is, so it must be in the layout the decoder expects.
+        if (version == MEDIA_INFO_RECORD_VERSION) {
+            return true;
+        }
+    }
+
+    AVFormatContext *avFormatContext = media_probe_open(path, -1, options);
+    if (!avFormatContext) {
+        return false;
+    }
+    MediaInfoRecord record;
+    media_info_record_collect(avFormatContext, record);
+    media_io_close_input(&avFormatContext);
+
+    payload.clear();
+    media_info_record_serialize(record, payload);
+    if (cacheable) {
+        media_info_cache_put(cache, key, options, payload);
+    }
+    return true;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaInfoScanner_nativeScan(JNIEnv *env,
+                                                                          jclass clazz,
+                                                                          jobjectArray file_paths,
+                                                                          jint offset,
+                                                                          jobject buffer,
+                                                                          jlong probe_size,
+                                                                          jlong max_analyze_duration_us,
+                                                                          jint fps_probe_size,
+                                                                          jboolean skip_stream_info,
+                                                                          jlong cache_handle) {
+    auto *out = static_cast<uint8_t *>(env->GetDirectBufferAddress(buffer));
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!out || capacity < (jlong) MEDIA_INFO_BATCH_HEADER_SIZE) {
+        return -1;
+    }
+
+    ProbeOptions options{probe_size, max_analyze_duration_us, fps_probe_size, (bool) skip_stream_info};
+    MediaCache *cache = media_cache_from_handle(cache_handle);
+
+    int32_t header[3] = {MEDIA_INFO_BATCH_VERSION, 0, 0};
+    size_t position = MEDIA_INFO_BATCH_HEADER_SIZE;
+    std::vector<uint8_t> payload;
+
+    jsize count = env->GetArrayLength(file_paths);
+    for (jsize i = offset; i < count; i++) {
+        auto jFilePath = (jstring) env->GetObjectArrayElement(file_paths, i);
+        const char *cFilePath = env->GetStringUTFChars(jFilePath, nullptr);
+        bool found = media_info_collect_payload(cFilePath, options, cache, payload);
+        env->ReleaseStringUTFChars(jFilePath, cFilePath);
+        env->DeleteLocalRef(jFilePath);
+
+        int32_t size = found ? static_cast<int32_t>(payload.size()) : -1;
+        size_t entrySize = sizeof(size) + (found ? payload.size() : 0);
+        if (position + entrySize > (size_t) capacity) {
+            header[2] = static_cast<int32_t>(MEDIA_INFO_BATCH_HEADER_SIZE + entrySize);
+            break;
+        }
+
+        memcpy(out + position, &size, sizeof(size));
+        if (found) {
+            memcpy(out + position + sizeof(size), payload.data(), payload.size());
+        }
+        position += entrySize;
+        header[1]++;
+    }
+
+    memcpy(out, header, sizeof(header));
+    return header[1];
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_io_github_anilbeesetti_nextlib_mediainfo_MediaInfoBuilder_nativeCreateFromFD(JNIEnv *env,
                                                                                   jobject thiz,
-                                                                                  jint file_descriptor) {
-    char pipe[32];
-    sprintf(pipe, "pipe:%d", file_descriptor);
-
-    media_info_build(env, thiz, pipe);
+                                                                                  jint file_descriptor,
+                                                                                  jlong probe_size,
+                                                                                  jlong max_analyze_duration_us,
+                                                                                  jint fps_probe_size,
+                                                                                  jboolean skip_stream_info,
+                                                                                  jboolean with_thumbnail,
+                                                                                  jlong thumbnail_time_us,
+                                                                                  jint thumbnail_width,
+                                                                                  jint thumbnail_height,
+                                                                                  jboolean with_frame_loader,
+                                                                                  jlong cache_handle) {
+    char name[32];
+    snprintf(name, sizeof(name), "fd:%d", file_descriptor);
+
+    ProbeOptions options{probe_size, max_analyze_duration_us, fps_probe_size, (bool) skip_stream_info};
+    ThumbnailRequest thumbnail{thumbnail_time_us, thumbnail_width, thumbnail_height};
+    MediaCacheKey key{};
+    bool hasKey = media_cache_key_from_fd(file_descriptor, &key);
+    media_info_build(env, thiz, name, file_descriptor, options, with_thumbnail ? &thumbnail : nullptr,
+                     with_frame_loader, media_cache_from_handle(cache_handle), hasKey ? &key : nullptr);
 }
 
 extern "C"
 JNIEXPORT void JNICALL
 Java_io_github_anilbeesetti_nextlib_mediainfo_MediaInfoBuilder_nativeCreateFromPath(JNIEnv *env,
                                                                                     jobject thiz,
-                                                                                    jstring jFilePath) {
+                                                                                    jstring jFilePath,
+                                                                                    jlong probe_size,
+                                                                                    jlong max_analyze_duration_us,
+                                                                                    jint fps_probe_size,
+                                                                                    jboolean skip_stream_info,
+                                                                                    jboolean with_thumbnail,
+                                                                                    jlong thumbnail_time_us,
+                                                                                    jint thumbnail_width,
+                                                                                    jint thumbnail_height,
+                                                                                    jboolean with_frame_loader,
+                                                                                    jlong cache_handle) {
     const char *cFilePath = env->GetStringUTFChars(jFilePath, nullptr);
 
-    media_info_build(env, thiz, cFilePath);
+    ProbeOptions options{probe_size, max_analyze_duration_us, fps_probe_size, (bool) skip_stream_info};
+    ThumbnailRequest thumbnail{thumbnail_time_us, thumbnail_width, thumbnail_height};
+    MediaCacheKey key{};
+    bool hasKey = media_cache_key_from_path(cFilePath, &key);
+    media_info_build(env, thiz, cFilePath, -1, options, with_thumbnail ? &thumbnail : nullptr,
+                     with_frame_loader, media_cache_from_handle(cache_handle), hasKey ? &key : nullptr);
 
     env->ReleaseStringUTFChars(jFilePath, cFilePath);
-}
\ No newline at end of file
+}
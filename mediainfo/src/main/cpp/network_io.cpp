@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "log.h"
+#include "media_io.h"
+
+/*
+ * A read-through block cache over FFmpeg's network protocols.
+ *
+ * The remote resource is fetched in aligned blocks, so every request to the server starts at a
+ * block boundary and the connection keeps streaming as long as blocks are read in order. A block
+ * that lies a short distance ahead of the connection is reached by reading the blocks in between
+ * into the cache rather than by opening a new range request. While the demuxer consumes one
+ * block, a background thread fetches the next one. Seeking back to a recently read position,
+ * which frame extraction does constantly, is served from memory.
+ */
+
+static const int64_t NETWORK_IO_BLOCK_SIZE = 256 * 1024;
+// 8 MiB of cached blocks per input.
+static const size_t NETWORK_IO_MAX_BLOCKS = 32;
+// Gaps up to this size are read through instead of seeking, which would cost a round trip.
+static const int64_t NETWORK_IO_MAX_READ_THROUGH = 4 * NETWORK_IO_BLOCK_SIZE;
+static const int NETWORK_IO_BUFFER_SIZE = 64 * 1024;
+// A server that sends nothing for this long fails the read instead of stalling the demuxer.
+static const char *NETWORK_IO_TIMEOUT_US = "15000000";
+
+struct NetworkBlock {
+    int64_t index;
+    // Shorter than a full block only for the last block of the resource.
+    std::vector<uint8_t> data;
+};
+
+struct NetworkIO {
+    MediaIO base;
+    // Guards every field below. [inner] is only used by the thread that set [fetching], which
+    // transfers data without holding the mutex, or with the mutex held while nobody is fetching.
+    std::mutex mutex;
+    std::condition_variable condition;
+    AVIOContext *inner;
+    // Whether a thread owns the connection to fetch blocks.
+    bool fetching;
+    // Size of the resource, or -1 while unknown.
+    int64_t size;
+    // Position of the next read by the demuxer.
+    int64_t position;
+    // Most recently used first.
+    std::list<NetworkBlock> blocks;
+    // Block the prefetcher should fetch next, or -1.
+    int64_t prefetchIndex;
+    // Also read without the mutex by the interrupt callback of [inner].
+    std::atomic<bool> stopped;
+    std::thread prefetcher;
+    // Statistics, logged on release.
+    int64_t hits;
+    int64_t misses;
+    int64_t rangeRequests;
+};
+
+static NetworkBlock *find_block(NetworkIO *io, int64_t index) {
+    for (auto it = io->blocks.begin(); it != io->blocks.end(); ++it) {
+        if (it->index == index) {
+            io->blocks.splice(io->blocks.begin(), io->blocks, it);
+            return &io->blocks.front();
+        }
+    }
+    return nullptr;
+}
+
+static bool has_block(NetworkIO *io, int64_t index) {
+    return std::any_of(io->blocks.begin(), io->blocks.end(), [index](const NetworkBlock &block) {
+        return block.index == index;
+    });
+}
+
+/**
+ * Adds a fetched block to the cache unless it is cached already. Must be called with the mutex held.
+ */
+static void store_block(NetworkIO *io, NetworkBlock &&block) {
+    if (static_cast<int64_t>(block.data.size()) < NETWORK_IO_BLOCK_SIZE && io->size < 0) {
+        io->size = block.index * NETWORK_IO_BLOCK_SIZE + static_cast<int64_t>(block.data.size());
+    }
+    if (has_block(io, block.index)) {
+        return;
+    }
+    io->blocks.push_front(std::move(block));
+    if (io->blocks.size() > NETWORK_IO_MAX_BLOCKS) {
+        io->blocks.pop_back();
+    }
+}
+
+/**
+ * Reads the block at the connection's current position into [blocks]. Called without the mutex.
+ *
+ * @return false if the read failed. A block cut short by an error is dropped, as only a block cut
+ * short by the end of the resource tells its size.
+ */
+static bool read_next_block(AVIOContext *inner, std::vector<NetworkBlock> &blocks) {
+    int64_t start = avio_tell(inner);
+    NetworkBlock block{start / NETWORK_IO_BLOCK_SIZE, std::vector<uint8_t>(NETWORK_IO_BLOCK_SIZE)};
+
+    // avio_read returns what it got before an error, and the error flag sticks to the context
+    // until cleared, so it is reset to only see errors of this read.
+    inner->error = 0;
+    int count = avio_read(inner, block.data.data(), NETWORK_IO_BLOCK_SIZE);
+    if (count < NETWORK_IO_BLOCK_SIZE && !(avio_feof(inner) && inner->error == 0)) {
+        int error = inner->error != 0 ? inner->error : (count < 0 ? count : AVERROR(EIO));
+        LOGE("Network read failed at %lld after %d bytes: %s",
+             (long long) (start + std::max(count, 0)), std::max(count, 0), av_err2str(error));
+        return false;
+    }
+    block.data.resize(std::max(count, 0));
+    blocks.push_back(std::move(block));
+    return true;
+}
+
+/**
+ * Fetches a block, waiting first for a fetch that is already in flight, which may bring it in.
+ * [lock] is released while data is transferred, so cached blocks stay readable meanwhile.
+ *
+ * @return the block, with [lock] held again, or nullptr on failure
+ */
+static NetworkBlock *fetch_block(NetworkIO *io, int64_t index, std::unique_lock<std::mutex> &lock) {
+    io->condition.wait(lock, [io] {
+        return io->stopped || !io->fetching;
+    });
+    if (io->stopped) {
+        return nullptr;
+    }
+    if (NetworkBlock *block = find_block(io, index)) {
+        return block;
+    }
+    io->fetching = true;
+    lock.unlock();
+
+    int64_t start = index * NETWORK_IO_BLOCK_SIZE;
+    int64_t connectionPosition = avio_tell(io->inner);
+    std::vector<NetworkBlock> fetched;
+    bool seeked = false;
+    bool success = true;
+
+    // A failed read can leave the connection in the middle of a block; it must seek back to a
+    // block boundary then.
+    bool aligned = connectionPosition % NETWORK_IO_BLOCK_SIZE == 0;
+    if (aligned && start > connectionPosition && start - connectionPosition <= NETWORK_IO_MAX_READ_THROUGH) {
+        // Reading the blocks in between, even cached ones, keeps the connection going.
+        while (success && avio_tell(io->inner) < start) {
+            // A short block means the resource ends before [start].
+            success = read_next_block(io->inner, fetched) &&
+                      static_cast<int64_t>(fetched.back().data.size()) == NETWORK_IO_BLOCK_SIZE;
+        }
+    } else if (start != connectionPosition) {
+        success = seeked = avio_seek(io->inner, start, SEEK_SET) >= 0;
+    }
+    success = success && read_next_block(io->inner, fetched);
+
+    lock.lock();
+    io->fetching = false;
+    if (seeked) {
+        io->rangeRequests++;
+    }
+    for (auto &block: fetched) {
+        store_block(io, std::move(block));
+    }
+    io->condition.notify_all();
+    return success ? find_block(io, index) : nullptr;
+}
+
+static void prefetch_loop(NetworkIO *io) {
+    std::unique_lock<std::mutex> lock(io->mutex);
+    while (true) {
+        io->condition.wait(lock, [io] {
+            return io->stopped || io->prefetchIndex >= 0;
+        });
+        if (io->stopped) {
+            break;
+        }
+        int64_t index = io->prefetchIndex;
+        io->prefetchIndex = -1;
+        if (!has_block(io, index)) {
+            fetch_block(io, index, lock);
+        }
+    }
+}
+
+static int network_io_read(void *opaque, uint8_t *buffer, int size) {
+    auto *io = static_cast<NetworkIO *>(opaque);
+    std::unique_lock<std::mutex> lock(io->mutex);
+
+    if (io->size >= 0 && io->position >= io->size) {
+        return AVERROR_EOF;
+    }
+
+    int64_t index = io->position / NETWORK_IO_BLOCK_SIZE;
+    NetworkBlock *block = find_block(io, index);
+    if (block) {
+        io->hits++;
+    } else {
+        io->misses++;
+        block = fetch_block(io, index, lock);
+        if (!block) {
+            return io->size >= 0 && io->position >= io->size ? AVERROR_EOF : AVERROR(EIO);
+        }
+    }
+
+    int64_t offset = io->position - index * NETWORK_IO_BLOCK_SIZE;
+    if (offset >= static_cast<int64_t>(block->data.size())) {
+        return AVERROR_EOF;
+    }
+    int count = static_cast<int>(std::min<int64_t>(size, block->data.size() - offset));
+    memcpy(buffer, block->data.data() + offset, count);
+    io->position += count;
+
+    int64_t nextIndex = index + 1;
+    if ((io->size < 0 || nextIndex * NETWORK_IO_BLOCK_SIZE < io->size) && !has_block(io, nextIndex)) {
+        io->prefetchIndex = nextIndex;
+        lock.unlock();
+        io->condition.notify_all();
+    }
+    return count;
+}
+
+static int64_t network_io_seek(void *opaque, int64_t offset, int whence) {
+    auto *io = static_cast<NetworkIO *>(opaque);
+    std::unique_lock<std::mutex> lock(io->mutex);
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        // The connection may be busy with a fetch, which may also find out the size.
+        io->condition.wait(lock, [io] {
+            return io->stopped || !io->fetching;
+        });
+        if (io->size < 0) {
+            int64_t size = avio_size(io->inner);
+            if (size < 0) {
+                return size;
+            }
+            io->size = size;
+        }
+        if (whence == AVSEEK_SIZE) {
+            return io->size;
+        }
+        offset += io->size;
+    } else if (whence == SEEK_CUR) {
+        offset += io->position;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+
+    if (offset < 0) {
+        return AVERROR(EINVAL);
+    }
+    // Nothing is fetched until the next read.
+    io->position = offset;
+    return offset;
+}
+
+static int network_io_interrupted(void *opaque) {
+    return static_cast<NetworkIO *>(opaque)->stopped.load();
+}
+
+static void network_io_release(MediaIO *mediaIO) {
+    auto *io = reinterpret_cast<NetworkIO *>(mediaIO);
+    {
+        std::lock_guard<std::mutex> lock(io->mutex);
+        // Also aborts a fetch in flight through the interrupt callback.
+        io->stopped = true;
+    }
+    io->condition.notify_all();
+    io->prefetcher.join();
+
+    LOGD("Network input closed: %lld block hits, %lld misses, %lld range requests",
+         (long long) io->hits, (long long) io->misses, (long long) io->rangeRequests);
+
+    avio_closep(&io->inner);
+    delete io;
+}
+
+AVIOContext *media_io_create_network(const char *url) {
+    auto *io = new NetworkIO();
+    io->base.release = network_io_release;
+    io->base.advise = nullptr;
+    io->stopped = false;
+
+    AVIOInterruptCB interruptCallback{network_io_interrupted, io};
+    AVDictionary *options = nullptr;
+    av_dict_set(&options, "timeout", NETWORK_IO_TIMEOUT_US, 0);
+    AVIOContext *inner = nullptr;
+    int result = avio_open2(&inner, url, AVIO_FLAG_READ, &interruptCallback, &options);
+    av_dict_free(&options);
+    if (result < 0) {
+        LOGE("Could not open %s - %s", url, av_err2str(result));
+        delete io;
+        return nullptr;
+    }
+    if (!(inner->seekable & AVIO_SEEKABLE_NORMAL)) {
+        // Without range requests there is nothing to cache; FFmpeg's own io streams just as well.
+        avio_closep(&inner);
+        delete io;
+        return nullptr;
+    }
+
+    io->inner = inner;
+    io->fetching = false;
+    io->size = -1;
+    io->position = 0;
+    io->prefetchIndex = -1;
+    io->hits = 0;
+    io->misses = 0;
+    // Opening the connection is the first request.
+    io->rangeRequests = 1;
+    io->prefetcher = std::thread(prefetch_loop, io);
+
+    auto *buffer = static_cast<unsigned char *>(av_malloc(NETWORK_IO_BUFFER_SIZE));
+    AVIOContext *context = buffer ? avio_alloc_context(buffer, NETWORK_IO_BUFFER_SIZE, 0, io,
+                                                       network_io_read, nullptr, network_io_seek)
+                                  : nullptr;
+    if (!context) {
+        av_free(buffer);
+        network_io_release(&io->base);
+        return nullptr;
+    }
+    return context;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstring>
+#include "log.h"
+#include "packet_index.h"
+#include "trace.h"
+
+static const uint32_t PACKET_INDEX_MAGIC = 0x49504c4e; // "NLPI"
+static const uint32_t PACKET_INDEX_VERSION = 1;
+
+/*
+ * Binary layout, little endian: magic, version, stream index, time base numerator and
+ * denominator, entry count and keyframe count as 32-bit values, then the entries as pairs of
+ * 64-bit timestamp and position, then the keyframe positions as 32-bit values.
+ */
+struct PacketIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t streamIndex;
+    int32_t timeBaseNum;
+    int32_t timeBaseDen;
+    uint32_t entryCount;
+    uint32_t keyframeCount;
+};
+
+PacketIndex *packet_index_build(AVFormatContext *formatContext, int streamIndex) {
+    TraceSection trace("mediainfo.buildIndex");
+    AVStream *stream = formatContext->streams[streamIndex];
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        return nullptr;
+    }
+
+    struct Packet {
+        PacketIndexEntry entry;
+        bool keyframe;
+    };
+    std::vector<Packet> packets;
+    bool timestamped = true;
+
+    while (av_read_frame(formatContext, packet) >= 0) {
+        if (packet->stream_index == streamIndex) {
+            int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            timestamped &= timestamp != AV_NOPTS_VALUE;
+            packets.push_back({{timestamp, packet->pos}, (packet->flags & AV_PKT_FLAG_KEY) != 0});
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    av_seek_frame(formatContext, streamIndex, stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0,
+                  AVSEEK_FLAG_BACKWARD);
+
+    if (!timestamped || packets.empty() || packets.size() > UINT32_MAX) {
+        LOGW("Stream %d cannot be indexed", streamIndex);
+        return nullptr;
+    }
+
+    // Packets arrive in decoding order; reordered frames (B-frames) need presentation order.
+    std::stable_sort(packets.begin(), packets.end(), [](const Packet &a, const Packet &b) {
+        return a.entry.timestamp < b.entry.timestamp;
+    });
+
+    auto *index = new PacketIndex();
+    index->streamIndex = streamIndex;
+    index->timeBase = stream->time_base;
+    index->entries.reserve(packets.size());
+    for (const auto &item: packets) {
+        if (item.keyframe) {
+            index->keyframes.push_back(static_cast<uint32_t>(index->entries.size()));
+        }
+        index->entries.push_back(item.entry);
+    }
+    LOGD("Indexed %zu packets and %zu keyframes of stream %d",
+         index->entries.size(), index->keyframes.size(), streamIndex);
+    return index;
+}
+
+void packet_index_serialize(const PacketIndex *index, std::vector<uint8_t> &out) {
+    PacketIndexHeader header{PACKET_INDEX_MAGIC, PACKET_INDEX_VERSION, index->streamIndex,
+                             index->timeBase.num, index->timeBase.den,
+                             static_cast<uint32_t>(index->entries.size()),
+                             static_cast<uint32_t>(index->keyframes.size())};
+    size_t entriesSize = index->entries.size() * sizeof(PacketIndexEntry);
+    size_t keyframesSize = index->keyframes.size() * sizeof(uint32_t);
+
+    size_t offset = out.size();
+    out.resize(offset + sizeof(header) + entriesSize + keyframesSize);
+    memcpy(out.data() + offset, &header, sizeof(header));
+    memcpy(out.data() + offset + sizeof(header), index->entries.data(), entriesSize);
+    memcpy(out.data() + offset + sizeof(header) + entriesSize, index->keyframes.data(), keyframesSize);
+}
+
+PacketIndex *packet_index_deserialize(const uint8_t *data, size_t size, AVFormatContext *formatContext,
+                                      int streamIndex) {
+    PacketIndexHeader header{};
+    if (size < sizeof(header)) {
+        return nullptr;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    AVRational timeBase = formatContext->streams[streamIndex]->time_base;
+    uint64_t expectedSize = sizeof(header) +
+                            (uint64_t) header.entryCount * sizeof(PacketIndexEntry) +
+                            (uint64_t) header.keyframeCount * sizeof(uint32_t);
+    if (header.magic != PACKET_INDEX_MAGIC || header.version != PACKET_INDEX_VERSION ||
+        header.streamIndex != streamIndex ||
+        header.timeBaseNum != timeBase.num || header.timeBaseDen != timeBase.den ||
+        header.entryCount == 0 || size != expectedSize) {
+        return nullptr;
+    }
+
+    auto *index = new PacketIndex();
+    index->streamIndex = streamIndex;
+    index->timeBase = timeBase;
+    index->entries.resize(header.entryCount);
+    index->keyframes.resize(header.keyframeCount);
+    memcpy(index->entries.data(), data + sizeof(header), header.entryCount * sizeof(PacketIndexEntry));
+    memcpy(index->keyframes.data(), data + sizeof(header) + header.entryCount * sizeof(PacketIndexEntry),
+           header.keyframeCount * sizeof(uint32_t));
+
+    for (size_t i = 0; i < index->keyframes.size(); i++) {
+        bool ascending = i == 0 || index->keyframes[i - 1] < index->keyframes[i];
+        if (!ascending || index->keyframes[i] >= header.entryCount) {
+            packet_index_free(index);
+            return nullptr;
+        }
+    }
+    return index;
+}
+
+void packet_index_apply(const PacketIndex *index, AVFormatContext *formatContext) {
+    // Demuxers with their own index (MP4 sample tables, MKV cues) keep it: for some of them the
+    // stream's index entries are their sample table and must not be touched.
+    if (!(formatContext->iformat->flags & AVFMT_GENERIC_INDEX)) {
+        return;
+    }
+    AVStream *stream = formatContext->streams[index->streamIndex];
+    for (uint32_t keyframe: index->keyframes) {
+        const PacketIndexEntry &entry = index->entries[keyframe];
+        if (entry.position >= 0) {
+            av_add_index_entry(stream, entry.position, entry.timestamp, 0, 0, AVINDEX_KEYFRAME);
+        }
+    }
+}
+
+size_t packet_index_find_entry(const PacketIndex *index, int64_t timestamp) {
+    auto it = std::upper_bound(index->entries.begin(), index->entries.end(), timestamp,
+                               [](int64_t value, const PacketIndexEntry &entry) {
+                                   return value < entry.timestamp;
+                               });
+    return it == index->entries.begin() ? 0 : static_cast<size_t>(it - index->entries.begin() - 1);
+}
+
+/**
+ * Seeks to the byte position of [keyframe] and checks that the first packet of the stream read
+ * from there is that keyframe, as demuxers that resynchronize after a byte seek may land on a
+ * later packet. The input is left at the keyframe again on success.
+ */
+static bool seek_to_position(const PacketIndex *index, AVFormatContext *formatContext,
+                             const PacketIndexEntry &keyframe) {
+    if (keyframe.position < 0 || (formatContext->iformat->flags & AVFMT_NO_BYTE_SEEK) ||
+        av_seek_frame(formatContext, index->streamIndex, keyframe.position, AVSEEK_FLAG_BYTE) < 0) {
+        return false;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        return false;
+    }
+    bool landed = false;
+    while (av_read_frame(formatContext, packet) >= 0) {
+        bool found = packet->stream_index == index->streamIndex;
+        if (found) {
+            int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            landed = timestamp == keyframe.timestamp;
+        }
+        av_packet_unref(packet);
+        if (found) {
+            break;
+        }
+    }
+    av_packet_free(&packet);
+
+    // The checked packet has been consumed; going back to it only moves the read position.
+    return landed && av_seek_frame(formatContext, index->streamIndex, keyframe.position, AVSEEK_FLAG_BYTE) >= 0;
+}
+
+bool packet_index_seek_to_entry(const PacketIndex *index, AVFormatContext *formatContext, size_t entry,
+                                int64_t *keyframeTimestamp) {
+    if (entry >= index->entries.size()) {
+        return false;
+    }
+
+    auto it = std::upper_bound(index->keyframes.begin(), index->keyframes.end(), entry);
+    // Without a keyframe before the entry, decoding has to start from the first packet.
+    size_t keyframe = it == index->keyframes.begin() ? 0 : *(it - 1);
+    *keyframeTimestamp = index->entries[keyframe].timestamp;
+
+    // The recorded position reaches the keyframe directly, without relying on the demuxer's own
+    // index; a timestamp seek is only the fallback when the position cannot be used.
+    return seek_to_position(index, formatContext, index->entries[keyframe]) ||
+           av_seek_frame(formatContext, index->streamIndex, *keyframeTimestamp, AVSEEK_FLAG_BACKWARD) >= 0;
+}
+
+void packet_index_free(PacketIndex *index) {
+    delete index;
+}
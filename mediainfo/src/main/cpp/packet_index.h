@@ -0,0 +1,74 @@
+#ifndef NEXTPLAYER_PACKET_INDEX_H
+#define NEXTPLAYER_PACKET_INDEX_H
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+struct PacketIndexEntry {
+    // Presentation timestamp in the stream's time base, or the decoding timestamp if unset.
+    int64_t timestamp;
+    // Byte position of the packet in the input, or -1 if unknown.
+    int64_t position;
+};
+
+/**
+ * Every packet of one stream, found by reading the input once without decoding.
+ */
+struct PacketIndex {
+    int streamIndex;
+    AVRational timeBase;
+    // One entry per packet, in presentation order, so entry N is the N-th displayed frame.
+    std::vector<PacketIndexEntry> entries;
+    // Positions in [entries] of the keyframes, ascending.
+    std::vector<uint32_t> keyframes;
+};
+
+/**
+ * Reads every packet of [streamIndex] and rewinds the input afterwards.
+ *
+ * @return a new index, or nullptr if the stream has no usable timestamps
+ */
+PacketIndex *packet_index_build(AVFormatContext *formatContext, int streamIndex);
+
+/**
+ * Appends the compact binary form of [index] to [out].
+ */
+void packet_index_serialize(const PacketIndex *index, std::vector<uint8_t> &out);
+
+/**
+ * Parses an index written by packet_index_serialize for the same stream of the same input.
+ *
+ * @return a new index, or nullptr if the data is invalid or does not match the stream
+ */
+PacketIndex *packet_index_deserialize(const uint8_t *data, size_t size, AVFormatContext *formatContext,
+                                      int streamIndex);
+
+/**
+ * Makes the keyframes known to demuxers that seek through a generic index built while reading
+ * (raw elementary streams and the like), so that they can jump straight to any keyframe.
+ */
+void packet_index_apply(const PacketIndex *index, AVFormatContext *formatContext);
+
+/**
+ * @return the position in [entries] of the last packet with a timestamp at or before [timestamp],
+ * or 0 if there is none
+ */
+size_t packet_index_find_entry(const PacketIndex *index, int64_t timestamp);
+
+/**
+ * Seeks the input to the last keyframe at or before entry [entry], by its recorded byte position
+ * when the demuxer lands exactly on it from there, or by its timestamp otherwise.
+ *
+ * @param keyframeTimestamp receives the timestamp of that keyframe
+ * @return true on success
+ */
+bool packet_index_seek_to_entry(const PacketIndex *index, AVFormatContext *formatContext, size_t entry,
+                                int64_t *keyframeTimestamp);
+
+void packet_index_free(PacketIndex *index);
+
+#endif //NEXTPLAYER_PACKET_INDEX_H
@@ -0,0 +1,204 @@
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include <android/bitmap.h>
+#include <jni.h>
+#include <vector>
+#include "frame_convert.h"
+#include "log.h"
+#include "storyboard.h"
+#include "trace.h"
+
+// Beyond this distance to the next tile, seeking is cheaper than reading every packet in between.
+static const int64_t STORYBOARD_SEEK_GAP_US = 10 * AV_TIME_BASE;
+
+int storyboard_tile_height(MediaThumbnailRetrieverContext *context, const StoryboardSpec &spec) {
+    if (spec.tileHeight > 0) {
+        return spec.tileHeight;
+    }
+
+    AVCodecParameters *codecpar = context->formatContext->streams[context->videoStreamIndex]->codecpar;
+    if (codecpar->width <= 0 || codecpar->height <= 0) {
+        return 0;
+    }
+
+    AVRational sampleAspectRatio = codecpar->sample_aspect_ratio;
+    if (sampleAspectRatio.num <= 0 || sampleAspectRatio.den <= 0) {
+        sampleAspectRatio = {1, 1};
+    }
+    int64_t displayWidth = av_rescale(codecpar->width, sampleAspectRatio.num, sampleAspectRatio.den);
+    return FFMAX(1, static_cast<int>(av_rescale(spec.tileWidth, codecpar->height, FFMAX(1, displayWidth))));
+}
+
+/**
+ * Decodes a single keyframe packet. Draining right after it makes decoders that hold frames back
+ * for reordering return it immediately.
+ */
+static bool decode_keyframe(AVCodecContext *codecContext, const AVPacket *packet, AVFrame *frame) {
+    av_frame_unref(frame);
+    bool decoded = avcodec_send_packet(codecContext, packet) >= 0 &&
+                   avcodec_send_packet(codecContext, nullptr) >= 0 &&
+                   avcodec_receive_frame(codecContext, frame) >= 0;
+    avcodec_flush_buffers(codecContext);
+    return decoded;
+}
+
+int storyboard_render(MediaThumbnailRetrieverContext *context,
+                      const StoryboardSpec &spec,
+                      uint8_t *pixels,
+                      int stride,
+                      int64_t *timestampsUs) {
+    TraceSection trace("mediainfo.storyboard");
+    int tileCount = spec.columns * spec.rows;
+    for (int i = 0; i < tileCount; i++) {
+        timestampsUs[i] = -1;
+    }
+
+    int tileHeight = storyboard_tile_height(context, spec);
+    AVCodecContext *codecContext = media_thumbnail_retriever_create_decoder(context);
+    if (!codecContext || tileHeight <= 0) {
+        avcodec_free_context(&codecContext);
+        return 0;
+    }
+
+    AVFormatContext *formatContext = context->formatContext;
+    int streamIndex = context->videoStreamIndex;
+    AVRational timeBase = formatContext->streams[streamIndex]->time_base;
+    int64_t startTimestamp = formatContext->streams[streamIndex]->start_time;
+    if (startTimestamp == AV_NOPTS_VALUE) {
+        startTimestamp = 0;
+    }
+    int64_t endTimestamp = formatContext->duration != AV_NOPTS_VALUE
+            ? startTimestamp + av_rescale_q(formatContext->duration, AV_TIME_BASE_Q, timeBase)
+            : INT64_MAX;
+    int64_t seekGap = av_rescale_q(STORYBOARD_SEEK_GAP_US, AV_TIME_BASE_Q, timeBase);
+    auto tileTimestamp = [&](int tile) {
+        return startTimestamp + av_rescale_q(tile * spec.intervalUs, AV_TIME_BASE_Q, timeBase);
+    };
+
+    AVPacket *packet = av_packet_alloc();
+    AVPacket *heldPacket = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    SwsContext *swsContext = nullptr;
+    int drawn = 0;
+
+    if (packet && heldPacket && frame &&
+        av_seek_frame(formatContext, streamIndex, startTimestamp, AVSEEK_FLAG_BACKWARD) >= 0) {
+        int tile = 0;
+        int seekedTile = -1;
+        // Latest keyframe packet read so far, which belongs to every tile before the next one.
+        int64_t heldTimestamp = AV_NOPTS_VALUE;
+        bool heldDecoded = false;
+
+        while (tile < tileCount) {
+            bool eof = av_read_frame(formatContext, packet) < 0;
+            int64_t timestamp = AV_NOPTS_VALUE;
+            if (!eof) {
+                timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+                if (packet->stream_index != streamIndex || !(packet->flags & AV_PKT_FLAG_KEY) ||
+                    timestamp == AV_NOPTS_VALUE) {
+                    av_packet_unref(packet);
+                    continue;
+                }
+            }
+
+            while (heldTimestamp != AV_NOPTS_VALUE && tile < tileCount &&
+                   (eof ? tileTimestamp(tile) < endTimestamp : timestamp > tileTimestamp(tile))) {
+                if (!heldDecoded) {
+                    heldDecoded = decode_keyframe(codecContext, heldPacket, frame);
+                }
+                uint8_t *tilePixels = pixels + static_cast<size_t>((tile / spec.columns) * tileHeight) * stride +
+                                      static_cast<size_t>((tile % spec.columns) * spec.tileWidth) * 4;
+                if (heldDecoded && frame_convert_to_rgba(&swsContext, frame, tilePixels,
+                                                         spec.tileWidth, tileHeight, stride)) {
+                    timestampsUs[tile] = av_rescale_q(heldTimestamp - startTimestamp, timeBase, AV_TIME_BASE_Q);
+                    drawn++;
+                }
+                tile++;
+            }
+            if (eof) {
+                break;
+            }
+
+            if (heldTimestamp == AV_NOPTS_VALUE || timestamp >= heldTimestamp) {
+                av_packet_unref(heldPacket);
+                av_packet_move_ref(heldPacket, packet);
+                heldTimestamp = timestamp;
+                heldDecoded = false;
+            } else {
+                av_packet_unref(packet);
+            }
+
+            if (tile < tileCount && tile != seekedTile && tileTimestamp(tile) - timestamp > seekGap) {
+                // Seek at most once per tile, so a demuxer that lands too early cannot loop.
+                seekedTile = tile;
+                av_seek_frame(formatContext, streamIndex, tileTimestamp(tile), AVSEEK_FLAG_BACKWARD);
+            }
+        }
+    }
+
+    LOGD("Drew %d of %d storyboard tiles", drawn, tileCount);
+
+    sws_freeContext(swsContext);
+    av_frame_free(&frame);
+    av_packet_free(&heldPacket);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecContext);
+    return drawn;
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailRetriever_nativeGetStoryboard(
+        JNIEnv *env,
+        jobject thiz,
+        jlong handle,
+        jlong interval_us,
+        jint tile_width,
+        jint tile_height,
+        jint columns,
+        jint rows,
+        jlongArray timestamps_us) {
+    auto *context = reinterpret_cast<MediaThumbnailRetrieverContext *>(handle);
+    if (!context || !context->formatContext || context->videoStreamIndex < 0) {
+        return nullptr;
+    }
+
+    StoryboardSpec spec{interval_us, tile_width, tile_height, columns, rows};
+    int tileHeight = storyboard_tile_height(context, spec);
+    int64_t atlasWidth = static_cast<int64_t>(spec.tileWidth) * spec.columns;
+    int64_t atlasHeight = static_cast<int64_t>(tileHeight) * spec.rows;
+    if (tileHeight <= 0 || atlasWidth * atlasHeight * 4 > INT32_MAX) {
+        return nullptr;
+    }
+
+    // The whole atlas is the only allocation; every tile is scaled straight into its pixels.
+    jobject bitmap = media_thumbnail_retriever_create_bitmap(env, static_cast<int>(atlasWidth),
+                                                             static_cast<int>(atlasHeight));
+    if (!bitmap) {
+        return nullptr;
+    }
+
+    AndroidBitmapInfo bitmapInfo;
+    void *bitmapPixels = nullptr;
+    if (AndroidBitmap_getInfo(env, bitmap, &bitmapInfo) < 0 ||
+        AndroidBitmap_lockPixels(env, bitmap, &bitmapPixels) < 0 || !bitmapPixels) {
+        env->DeleteLocalRef(bitmap);
+        return nullptr;
+    }
+
+    std::vector<int64_t> timestamps(spec.columns * spec.rows);
+    int drawn = storyboard_render(context, spec, static_cast<uint8_t *>(bitmapPixels),
+                                  static_cast<int>(bitmapInfo.stride), timestamps.data());
+    AndroidBitmap_unlockPixels(env, bitmap);
+
+    if (drawn == 0) {
+        env->DeleteLocalRef(bitmap);
+        return nullptr;
+    }
+    env->SetLongArrayRegion(timestamps_us, 0, static_cast<jsize>(timestamps.size()),
+                            reinterpret_cast<const jlong *>(timestamps.data()));
+    return bitmap;
+}
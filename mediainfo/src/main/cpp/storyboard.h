@@ -0,0 +1,41 @@
+#ifndef NEXTPLAYER_STORYBOARD_H
+#define NEXTPLAYER_STORYBOARD_H
+
+#include <cstdint>
+#include "media_thumbnail_retriever.h"
+
+/**
+ * Layout of a storyboard: a grid of equally sized tiles, one every [intervalUs].
+ */
+struct StoryboardSpec {
+    int64_t intervalUs;
+    int tileWidth;
+    // Height of a tile, or 0 to derive it from [tileWidth] and the video aspect ratio.
+    int tileHeight;
+    int columns;
+    int rows;
+};
+
+/**
+ * @return the tile height [spec] resolves to for the video of [context], or 0 if unknown
+ */
+int storyboard_tile_height(MediaThumbnailRetrieverContext *context, const StoryboardSpec &spec);
+
+/**
+ * Draws the storyboard into an RGBA atlas in a single forward pass over the video.
+ *
+ * Tile i, in row-major order, shows the last keyframe at or before i * intervalUs from the start
+ * of the video. Only keyframes are decoded, each scaled straight into its place in the atlas.
+ *
+ * @param pixels atlas of columns * tileWidth by rows * tileHeight pixels, [stride] bytes per row
+ * @param timestampsUs receives, for each tile, the time of the frame drawn in it from the start of
+ * the video, or -1 if nothing was drawn
+ * @return the number of tiles drawn
+ */
+int storyboard_render(MediaThumbnailRetrieverContext *context,
+                      const StoryboardSpec &spec,
+                      uint8_t *pixels,
+                      int stride,
+                      int64_t *timestampsUs);
+
+#endif //NEXTPLAYER_STORYBOARD_H
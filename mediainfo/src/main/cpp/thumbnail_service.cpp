@@ -0,0 +1,285 @@
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+#include <jni.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "log.h"
+#include "utils.h"
+#include "media_cache.h"
+#include "media_thumbnail_retriever.h"
+#include "trace.h"
+
+/**
+ * A single thumbnail request waiting in the service queue.
+ */
+struct ThumbnailJob {
+    int64_t requestId;
+    // Path or URL to open. Empty when the job reads from [fd].
+    std::string source;
+    // Duplicated file descriptor owned by the job, or -1.
+    int fd;
+    int64_t timeUs;
+    int width;
+    int height;
+};
+
+/**
+ * A bounded pool of native workers that extract thumbnails off the caller's thread.
+ *
+ * Workers and decoder threads are sized together so that the total number of threads
+ * decoding at any moment never exceeds the number of cores.
+ */
+struct ThumbnailService {
+    // Global reference to the owning MediaThumbnailService.
+    jobject callback;
+    std::vector<std::thread> workers;
+    std::deque<ThumbnailJob> queue;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopped;
+    int codecThreads;
+    // Optional cache shared with the JVM side; must outlive the service.
+    MediaCache *cache;
+    // Set when the service was released from a result callback. The worker that ran the callback
+    // could not be joined and frees the service itself once it leaves its loop.
+    bool freedByWorker;
+};
+
+static ThumbnailService *service_from_handle(jlong handle) {
+    return reinterpret_cast<ThumbnailService *>(handle);
+}
+
+static jlong handle_from_service(ThumbnailService *service) {
+    return reinterpret_cast<jlong>(service);
+}
+
+static void free_service(JNIEnv *env, ThumbnailService *service) {
+    env->DeleteGlobalRef(service->callback);
+    delete service;
+}
+
+static void close_job(ThumbnailJob &job) {
+    if (job.fd >= 0) {
+        close(job.fd);
+        job.fd = -1;
+    }
+}
+
+static void run_job(JNIEnv *env, ThumbnailService *service, ThumbnailJob &job) {
+    TraceSection trace("mediainfo.thumbnailJob");
+    jobject bitmap = nullptr;
+    int rotationDegrees = 0;
+
+    MediaCacheKey cacheKey{};
+    bool cacheable = service->cache != nullptr &&
+                     (job.fd >= 0 ? media_cache_key_from_fd(job.fd, &cacheKey)
+                                  : media_cache_key_from_path(job.source.c_str(), &cacheKey));
+    if (cacheable) {
+        bitmap = media_cache_get_thumbnail(env, service->cache, cacheKey, job.timeUs, job.width, job.height,
+                                           &rotationDegrees);
+    }
+
+    if (!bitmap) {
+        MediaThumbnailRetrieverContext *context =
+                job.fd >= 0 ? media_thumbnail_retriever_create_from_fd(job.fd, service->codecThreads)
+                            : media_thumbnail_retriever_create(job.source.c_str(), service->codecThreads);
+        if (context && context->videoStreamIndex >= 0) {
+            rotationDegrees = context->rotationDegrees;
+
+            AVFrame *frame = av_frame_alloc();
+            if (frame && media_thumbnail_retriever_decode_frame_at_time(context, job.timeUs, frame)) {
+                bitmap = media_thumbnail_retriever_frame_to_bitmap(env, frame, job.width, job.height);
+            }
+            av_frame_free(&frame);
+        } else {
+            LOGE("Could not open media for thumbnail request %lld", (long long) job.requestId);
+        }
+        media_thumbnail_retriever_free(context);
+
+        if (bitmap && cacheable) {
+            media_cache_put_thumbnail(env, service->cache, cacheKey, job.timeUs, job.width, job.height,
+                                      bitmap, rotationDegrees);
+        }
+    }
+    close_job(job);
+
+    utils_call_instance_method_void(env,
+                                    service->callback,
+                                    fields.MediaThumbnailService.onThumbnailResultID,
+                                    (jlong) job.requestId,
+                                    bitmap,
+                                    rotationDegrees);
+    if (env->ExceptionCheck()) {
+        // A throwing callback must not take the worker down with it.
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+    if (bitmap) {
+        env->DeleteLocalRef(bitmap);
+    }
+}
+
+static void worker_loop(ThumbnailService *service) {
+    JNIEnv *env = utils_attach_current_thread("NextThumbnailWorker");
+    if (!env) {
+        LOGE("Could not attach thumbnail worker to the JVM");
+        return;
+    }
+
+    while (true) {
+        ThumbnailJob job;
+        {
+            std::unique_lock<std::mutex> lock(service->mutex);
+            service->condition.wait(lock, [service] {
+                return service->stopped || !service->queue.empty();
+            });
+            if (service->stopped) {
+                break;
+            }
+            job = std::move(service->queue.front());
+            service->queue.pop_front();
+            trace_counter("mediainfo.thumbnailQueue", (int64_t) service->queue.size());
+        }
+        run_job(env, service, job);
+    }
+
+    // Only this thread can have set the flag, from inside its own callback.
+    if (service->freedByWorker) {
+        free_service(env, service);
+    }
+    utils_detach_current_thread();
+}
+
+static bool submit_job(ThumbnailService *service, ThumbnailJob job) {
+    {
+        std::lock_guard<std::mutex> lock(service->mutex);
+        if (service->stopped) {
+            close_job(job);
+            return false;
+        }
+        service->queue.push_back(std::move(job));
+        trace_counter("mediainfo.thumbnailQueue", (int64_t) service->queue.size());
+    }
+    service->condition.notify_one();
+    return true;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailService_nativeCreate(JNIEnv *env,
+                                                                                 jobject thiz,
+                                                                                 jint worker_count,
+                                                                                 jlong cache_handle) {
+    int cores = std::max(1, (int) std::thread::hardware_concurrency());
+    int workers = worker_count > 0 ? std::min((int) worker_count, cores) : cores;
+
+    auto *service = new ThumbnailService();
+    service->callback = env->NewGlobalRef(thiz);
+    service->stopped = false;
+    service->freedByWorker = false;
+    // Split the cores between workers so that workers * codecThreads <= cores.
+    service->codecThreads = std::max(1, cores / workers);
+    service->cache = media_cache_from_handle(cache_handle);
+
+    for (int i = 0; i < workers; i++) {
+        service->workers.emplace_back(worker_loop, service);
+    }
+    return handle_from_service(service);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailService_nativeSubmitPath(JNIEnv *env,
+                                                                                     jobject thiz,
+                                                                                     jlong handle,
+                                                                                     jlong request_id,
+                                                                                     jstring file_path,
+                                                                                     jlong time_us,
+                                                                                     jint width,
+                                                                                     jint height) {
+    auto *service = service_from_handle(handle);
+    if (!service) {
+        return false;
+    }
+
+    const char *source = env->GetStringUTFChars(file_path, nullptr);
+    ThumbnailJob job{request_id, source, -1, time_us, width, height};
+    env->ReleaseStringUTFChars(file_path, source);
+
+    return submit_job(service, std::move(job));
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailService_nativeSubmitFD(JNIEnv *env,
+                                                                                   jobject thiz,
+                                                                                   jlong handle,
+                                                                                   jlong request_id,
+                                                                                   jint file_descriptor,
+                                                                                   jlong time_us,
+                                                                                   jint width,
+                                                                                   jint height) {
+    auto *service = service_from_handle(handle);
+    if (!service) {
+        return false;
+    }
+
+    // The caller may close its descriptor as soon as this returns.
+    int fd = dup(file_descriptor);
+    if (fd < 0) {
+        LOGE("Could not duplicate file descriptor %d", file_descriptor);
+        return false;
+    }
+
+    return submit_job(service, ThumbnailJob{request_id, std::string(), fd, time_us, width, height});
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_github_anilbeesetti_nextlib_mediainfo_MediaThumbnailService_nativeRelease(JNIEnv *env,
+                                                                                  jobject thiz,
+                                                                                  jlong handle) {
+    auto *service = service_from_handle(handle);
+    if (!service) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(service->mutex);
+        service->stopped = true;
+        for (auto &job: service->queue) {
+            close_job(job);
+        }
+        service->queue.clear();
+        trace_counter("mediainfo.thumbnailQueue", 0);
+    }
+    service->condition.notify_all();
+
+    // A callback that closes the service runs on one of the workers, which cannot join itself.
+    // That worker is detached instead and frees the service after the callback returns.
+    std::thread::id current = std::this_thread::get_id();
+    bool calledFromWorker = false;
+    for (auto &worker: service->workers) {
+        if (worker.get_id() == current) {
+            worker.detach();
+            calledFromWorker = true;
+        } else {
+            worker.join();
+        }
+    }
+
+    if (calledFromWorker) {
+        service->freedByWorker = true;
+        return;
+    }
+    free_service(env, service);
+}
@@ -0,0 +1,57 @@
+#ifndef NEXTPLAYER_TRACE_H
+#define NEXTPLAYER_TRACE_H
+
+#include <cstdint>
+
+/*
+ * Perfetto markers for probing and thumbnail work. They are only compiled in when CMake runs
+ * with -DNEXTLIB_TRACE=ON on Android; host builds always get the empty versions.
+ */
+
+#if defined(NEXTLIB_TRACE) && defined(__ANDROID__)
+#define MEDIAINFO_TRACE_ENABLED 1
+#include <android/trace.h>
+#include <dlfcn.h>
+#endif
+
+/**
+ * Scoped trace section. [name] must be a string literal or otherwise outlive the section.
+ */
+class TraceSection {
+public:
+    explicit TraceSection(const char *name) {
+#ifdef MEDIAINFO_TRACE_ENABLED
+        ATrace_beginSection(name);
+#else
+        (void) name;
+#endif
+    }
+
+    ~TraceSection() {
+#ifdef MEDIAINFO_TRACE_ENABLED
+        ATrace_endSection();
+#endif
+    }
+
+    TraceSection(const TraceSection &) = delete;
+    TraceSection &operator=(const TraceSection &) = delete;
+};
+
+/**
+ * Publishes [value] on the counter track [name]. Counters exist since API 29, so this is a no-op
+ * on older devices.
+ */
+inline void trace_counter(const char *name, int64_t value) {
+#ifdef MEDIAINFO_TRACE_ENABLED
+    using SetCounter = void (*)(const char *, int64_t);
+    static const auto set_counter = reinterpret_cast<SetCounter>(dlsym(RTLD_DEFAULT, "ATrace_setCounter"));
+    if (set_counter && ATrace_isEnabled()) {
+        set_counter(name, value);
+    }
+#else
+    (void) name;
+    (void) value;
+#endif
+}
+
+#endif //NEXTPLAYER_TRACE_H
@@ -14,6 +14,23 @@ JNIEnv *utils_get_env() {
     return env;
 }
 
+JNIEnv *utils_attach_current_thread(const char *name) {
+    JavaVMAttachArgs args;
+    args.version = JNI_VERSION_1_6;
+    args.name = name;
+    args.group = nullptr;
+
+    JNIEnv *env;
+    if (javaVM->AttachCurrentThread(&env, &args) != JNI_OK) {
+        return nullptr;
+    }
+    return env;
+}
+
+void utils_detach_current_thread() {
+    javaVM->DetachCurrentThread();
+}
+
 int utils_fields_init(JavaVM *vm) {
     javaVM = vm;
 
@@ -61,7 +78,9 @@ int utils_fields_init(JavaVM *vm) {
     GET_ID(GetMethodID,
            fields.MediaInfoBuilder.onVideoStreamFoundID,
            fields.MediaInfoBuilder.clazz,
-           "onVideoStreamFound", "(ILjava/lang/String;Ljava/lang/String;Ljava/lang/String;IJDIIIJ)V"
+           "onVideoStreamFound",
+           "(ILjava/lang/String;Ljava/lang/String;Ljava/lang/String;IJDIIIJ"
+           "ILjava/lang/String;IILjava/lang/String;IIII[DIII)V"
     );
 
     GET_ID(GetMethodID,
@@ -83,6 +102,30 @@ int utils_fields_init(JavaVM *vm) {
            "onChapterFound", "(ILjava/lang/String;JJ)V"
     );
 
+    GET_ID(GetMethodID,
+           fields.MediaInfoBuilder.onThumbnailFoundID,
+           fields.MediaInfoBuilder.clazz,
+           "onThumbnailFound", "(Landroid/graphics/Bitmap;I)V"
+    );
+
+    GET_CLASS(fields.MediaThumbnailService.clazz,
+              "io/github/anilbeesetti/nextlib/mediainfo/MediaThumbnailService", true);
+
+    GET_ID(GetMethodID,
+           fields.MediaThumbnailService.onThumbnailResultID,
+           fields.MediaThumbnailService.clazz,
+           "onThumbnailResult", "(JLandroid/graphics/Bitmap;I)V"
+    );
+
+    GET_CLASS(fields.FrameSequenceCallback.clazz,
+              "io/github/anilbeesetti/nextlib/mediainfo/MediaThumbnailRetriever$FrameSequenceCallback", true);
+
+    GET_ID(GetMethodID,
+           fields.FrameSequenceCallback.onFrameID,
+           fields.FrameSequenceCallback.clazz,
+           "onFrame", "(IJ)Z"
+    );
+
     return 0;
 }
 
@@ -93,6 +136,8 @@ void utils_fields_free(JavaVM *vm) {
     }
 
     env->DeleteGlobalRef(fields.MediaInfoBuilder.clazz);
+    env->DeleteGlobalRef(fields.MediaThumbnailService.clazz);
+    env->DeleteGlobalRef(fields.FrameSequenceCallback.clazz);
 
     javaVM = nullptr;
 }
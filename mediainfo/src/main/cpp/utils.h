@@ -22,6 +22,18 @@ void utils_fields_free(JavaVM *vm);
  */
 JNIEnv *utils_get_env();
 
+/**
+ * Attaches the calling native thread to the JVM and returns its JNIEnv.
+ *
+ * @param name name of the thread as seen by the JVM
+ */
+JNIEnv *utils_attach_current_thread(const char *name);
+
+/**
+ * Detaches the calling native thread from the JVM.
+ */
+void utils_detach_current_thread();
+
 /**
  * Helper function for calling an instance void methods of Java objects with arbitrary arguments.
  *
@@ -40,8 +52,17 @@ struct fields {
         jmethodID onAudioStreamFoundID;
         jmethodID onSubtitleStreamFoundID;
         jmethodID onChapterFoundID;
+        jmethodID onThumbnailFoundID;
         jmethodID onErrorID;
     } MediaInfoBuilder;
+    struct {
+        jclass clazz;
+        jmethodID onThumbnailResultID;
+    } MediaThumbnailService;
+    struct {
+        jclass clazz;
+        jmethodID onFrameID;
+    } FrameSequenceCallback;
 };
 
 extern struct fields fields;
@@ -0,0 +1,9 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+/**
+ * CTA-861.3 content light level, in cd/m2.
+ */
+data class ContentLightLevel(
+    val maxContentLightLevel: Int,
+    val maxFrameAverageLightLevel: Int
+)
@@ -0,0 +1,18 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+/**
+ * SMPTE ST 2086 mastering display color volume. Chromaticities are CIE 1931 xy coordinates and
+ * luminances are in cd/m2. Values the stream does not signal are 0.
+ */
+data class MasteringDisplayMetadata(
+    val redX: Double,
+    val redY: Double,
+    val greenX: Double,
+    val greenY: Double,
+    val blueX: Double,
+    val blueY: Double,
+    val whitePointX: Double,
+    val whitePointY: Double,
+    val minLuminance: Double,
+    val maxLuminance: Double
+)
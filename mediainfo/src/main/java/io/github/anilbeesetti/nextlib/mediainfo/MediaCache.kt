@@ -0,0 +1,62 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+import androidx.annotation.Keep
+import java.io.Closeable
+import java.io.File
+
+/**
+ * A persistent cache of media info and thumbnails, keyed by file identity (device, inode, size and
+ * modification time). Scanning an unchanged local file again is served from the cache without
+ * opening or demuxing it.
+ *
+ * Entries live in a single append-only, memory-mapped [file]. Sources without a stable identity,
+ * such as network URLs, are never cached.
+ *
+ * The file is rewritten without replaced entries when it is opened, and without the oldest
+ * entries whenever it would grow past [maxSizeBytes].
+ *
+ * @param maxSizeBytes size the file is kept under, or 0 for no limit.
+ */
+class MediaCache @JvmOverloads constructor(
+    file: File,
+    maxSizeBytes: Long = DEFAULT_MAX_SIZE_BYTES
+) : Closeable {
+
+    init {
+        require(maxSizeBytes >= 0) { "maxSizeBytes must be >= 0" }
+    }
+
+    internal var nativeHandle: Long = nativeOpen(file.absolutePath, maxSizeBytes)
+        private set
+
+    init {
+        require(nativeHandle != 0L) { "Unable to open media cache at ${file.absolutePath}." }
+    }
+
+    /**
+     * Closes the cache. Builders and services using it must not be used afterwards.
+     */
+    override fun close() {
+        if (nativeHandle != 0L) {
+            nativeClose(nativeHandle)
+            nativeHandle = 0L
+        }
+    }
+
+    companion object {
+        /** Default size limit of the cache file, enough for a few hundred thumbnails. */
+        const val DEFAULT_MAX_SIZE_BYTES = 64L * 1024 * 1024
+
+        init {
+            NativeLibrary.load()
+        }
+
+        @Keep
+        @JvmStatic
+        private external fun nativeOpen(filePath: String, maxSizeBytes: Long): Long
+
+        @Keep
+        @JvmStatic
+        private external fun nativeClose(handle: Long)
+    }
+}
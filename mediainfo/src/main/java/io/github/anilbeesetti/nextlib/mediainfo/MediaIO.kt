@@ -0,0 +1,37 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+import androidx.annotation.Keep
+
+/**
+ * Process-wide settings for how the native side reads media.
+ */
+object MediaIO {
+
+    init {
+        NativeLibrary.load()
+    }
+
+    /**
+     * Read local files through a read-only memory mapping instead of FFmpeg's file protocol.
+     * Applies to [MediaInfoBuilder], [MediaThumbnailRetriever] and [MediaThumbnailService] for
+     * absolute file paths; files that cannot be mapped fall back to the file protocol.
+     *
+     * Only files in the app's internal storage that no other app can write are mapped, since a
+     * mapped file truncated by someone else crashes the process on the next read. Files on shared
+     * storage or removable cards are read with pread instead.
+     *
+     * Disabled by default.
+     */
+    @JvmStatic
+    var useMemoryMapping: Boolean
+        get() = nativeIsMemoryMappingEnabled()
+        set(value) = nativeSetMemoryMappingEnabled(value)
+
+    @Keep
+    @JvmStatic
+    private external fun nativeSetMemoryMappingEnabled(enabled: Boolean)
+
+    @Keep
+    @JvmStatic
+    private external fun nativeIsMemoryMappingEnabled(): Boolean
+}
@@ -9,7 +9,12 @@ data class MediaInfo(
     val audioStreams: List<AudioStream>,
     val subtitleStreams: List<SubtitleStream>,
     val chapters: List<Chapter>,
-    private val frameLoaderContext: Long?
+    private val frameLoaderContext: Long?,
+    /**
+     * Thumbnail extracted while building this media info, if one was requested with
+     * [MediaInfoBuilder.withThumbnail] and the media has a decodable video stream.
+     */
+    val thumbnail: Bitmap? = null
 ) {
 
     private var frameLoader = frameLoaderContext?.let { FrameLoader(frameLoaderContext) }
@@ -47,9 +52,3 @@ data class MediaInfo(
         frameLoader = null
     }
 }
-
-private fun Bitmap.rotate(degrees: Int): Bitmap {
-    val matrix = android.graphics.Matrix()
-    matrix.postRotate(degrees.toFloat())
-    return Bitmap.createBitmap(this, 0, 0, width, height, matrix, true)
-}
\ No newline at end of file
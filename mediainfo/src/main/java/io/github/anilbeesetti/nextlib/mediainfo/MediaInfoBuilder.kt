@@ -1,13 +1,24 @@
 package io.github.anilbeesetti.nextlib.mediainfo
 
 import android.content.Context
+import android.graphics.Bitmap
 import android.net.Uri
 import android.os.ParcelFileDescriptor
 import android.util.Log
 import androidx.annotation.Keep
 import java.io.FileNotFoundException
 
-class MediaInfoBuilder {
+/**
+ * Builds [MediaInfo] for a media source.
+ *
+ * @param cache optional cache that lets unchanged local files skip demuxing entirely. The frame
+ * loader of a cached [MediaInfo] opens the file when it loads its first frame.
+ * @param probeOptions limits on how much of the source is read to discover its streams.
+ */
+class MediaInfoBuilder @JvmOverloads constructor(
+    private val cache: MediaCache? = null,
+    private val probeOptions: ProbeOptions = ProbeOptions.DEFAULT
+) {
 
     private var hasError: Boolean = false
 
@@ -18,14 +29,72 @@ class MediaInfoBuilder {
     private val audioStreams = mutableListOf<AudioStream>()
     private val subtitleStreams = mutableListOf<SubtitleStream>()
     private val chapters = mutableListOf<Chapter>()
+    private var thumbnail: Bitmap? = null
 
+    private var extractThumbnail: Boolean = false
+    private var thumbnailTimeUs: Long = -1
+    private var thumbnailWidth: Int = 0
+    private var thumbnailHeight: Int = 0
+
+    private var loadFrames: Boolean = true
+
+    /**
+     * Also extracts a thumbnail into [MediaInfo.thumbnail], reusing the input that is opened and
+     * probed for the media info instead of opening it a second time. Must be called before [from].
+     *
+     * @param timeUs position of the frame in microseconds, or -1 for a third of the duration.
+     * @param width width of the thumbnail, or 0 to derive it from [height] and the video aspect ratio.
+     * @param height height of the thumbnail, or 0 to derive it from [width] and the video aspect ratio.
+     */
+    @JvmOverloads
+    fun withThumbnail(timeUs: Long = -1, width: Int = 0, height: Int = 0) = apply {
+        require(timeUs >= -1) { "timeUs must be >= 0, or -1" }
+        require(width >= 0 && height >= 0) { "width and height must be >= 0" }
+        extractThumbnail = true
+        thumbnailTimeUs = timeUs
+        thumbnailWidth = width
+        thumbnailHeight = height
+    }
+
+    /**
+     * Sets whether the built [MediaInfo] can load frames of its video stream, which keeps the input
+     * open until [MediaInfo.release]. Turn it off when only the media info is needed, so that the
+     * input is closed right away. Must be called before [from].
+     */
+    fun withFrameLoader(enabled: Boolean) = apply {
+        loadFrames = enabled
+    }
 
     fun from(filePath: String) = apply {
-        nativeCreateFromPath(filePath)
+        nativeCreateFromPath(
+            filePath,
+            probeOptions.probeSize,
+            probeOptions.maxAnalyzeDurationUs,
+            probeOptions.fpsProbeSize,
+            probeOptions.skipStreamInfoWhenHeaderComplete,
+            extractThumbnail,
+            thumbnailTimeUs,
+            thumbnailWidth,
+            thumbnailHeight,
+            loadFrames,
+            cache?.nativeHandle ?: 0L
+        )
     }
 
     fun from(descriptor: ParcelFileDescriptor) = apply {
-        nativeCreateFromFD(descriptor.fd)
+        nativeCreateFromFD(
+            descriptor.fd,
+            probeOptions.probeSize,
+            probeOptions.maxAnalyzeDurationUs,
+            probeOptions.fpsProbeSize,
+            probeOptions.skipStreamInfoWhenHeaderComplete,
+            extractThumbnail,
+            thumbnailTimeUs,
+            thumbnailWidth,
+            thumbnailHeight,
+            loadFrames,
+            cache?.nativeHandle ?: 0L
+        )
     }
 
     fun from(context: Context, uri: Uri) = apply {
@@ -58,7 +127,8 @@ class MediaInfoBuilder {
                 audioStreams,
                 subtitleStreams,
                 chapters,
-                frameLoaderContextHandle
+                frameLoaderContextHandle,
+                thumbnail
             )
         } else null
     }
@@ -99,7 +169,20 @@ class MediaInfoBuilder {
         frameWidth: Int,
         frameHeight: Int,
         rotation: Int,
-        frameLoaderContext: Long
+        frameLoaderContext: Long,
+        profile: Int,
+        profileName: String?,
+        level: Int,
+        bitDepth: Int,
+        pixelFormat: String?,
+        colorRange: Int,
+        colorPrimaries: Int,
+        colorTransfer: Int,
+        colorSpace: Int,
+        masteringDisplay: DoubleArray?,
+        maxContentLightLevel: Int,
+        maxFrameAverageLightLevel: Int,
+        dolbyVisionProfile: Int
     ) {
         if (videoStream == null) {
             videoStream = VideoStream(
@@ -112,7 +195,16 @@ class MediaInfoBuilder {
                 frameRate = frameRate,
                 frameWidth = frameWidth,
                 frameHeight = frameHeight,
-                rotation = rotation
+                rotation = rotation,
+                profile = profileOrNull(profile),
+                profileName = profileName,
+                level = levelOrNull(level),
+                bitDepth = bitDepthOrNull(bitDepth),
+                pixelFormat = pixelFormat,
+                colorInfo = VideoColorInfo(colorRange, colorPrimaries, colorTransfer, colorSpace),
+                masteringDisplayMetadata = masteringDisplayOf(masteringDisplay),
+                contentLightLevel = contentLightLevelOf(maxContentLightLevel, maxFrameAverageLightLevel),
+                dolbyVisionProfile = dolbyVisionProfileOrNull(dolbyVisionProfile)
             )
             if (frameLoaderContext != -1L) {
                 frameLoaderContextHandle = frameLoaderContext
@@ -191,15 +283,44 @@ class MediaInfoBuilder {
         )
     }
 
+    /* Used from JNI */
     @Keep
-    private external fun nativeCreateFromFD(fileDescriptor: Int)
+    @SuppressWarnings("UnusedPrivateMember")
+    private fun onThumbnailFound(bitmap: Bitmap, rotationDegrees: Int) {
+        thumbnail = bitmap.rotate(rotationDegrees)
+    }
 
     @Keep
-    private external fun nativeCreateFromPath(filePath: String)
+    private external fun nativeCreateFromFD(
+        fileDescriptor: Int,
+        probeSize: Long,
+        maxAnalyzeDurationUs: Long,
+        fpsProbeSize: Int,
+        skipStreamInfo: Boolean,
+        extractThumbnail: Boolean,
+        thumbnailTimeUs: Long,
+        thumbnailWidth: Int,
+        thumbnailHeight: Int,
+        withFrameLoader: Boolean,
+        cacheHandle: Long
+    )
+
+    @Keep
+    private external fun nativeCreateFromPath(
+        filePath: String,
+        probeSize: Long,
+        maxAnalyzeDurationUs: Long,
+        fpsProbeSize: Int,
+        skipStreamInfo: Boolean,
+        extractThumbnail: Boolean,
+        thumbnailTimeUs: Long,
+        thumbnailWidth: Int,
+        thumbnailHeight: Int,
+        withFrameLoader: Boolean,
+        cacheHandle: Long
+    )
 
     init {
-        System.loadLibrary("mediainfo")
+        NativeLibrary.load()
     }
 }
-
-
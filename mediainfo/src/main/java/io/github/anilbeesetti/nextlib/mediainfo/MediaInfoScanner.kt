@@ -0,0 +1,174 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+import androidx.annotation.Keep
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Builds [MediaInfo] for many local files with one JNI call per batch instead of one call per
+ * file, stream and chapter. Results are packed natively into a direct buffer and decoded here in
+ * a single pass.
+ *
+ * Media info returned by the scanner does not support frame loading. A scanner is not thread safe.
+ *
+ * @param cache optional cache that lets unchanged files skip demuxing entirely.
+ * @param probeOptions limits on how much of each file is read to discover its streams.
+ * @param initialBufferSize initial size of the result buffer; it grows when a file does not fit.
+ */
+class MediaInfoScanner @JvmOverloads constructor(
+    private val cache: MediaCache? = null,
+    private val probeOptions: ProbeOptions = ProbeOptions.FAST,
+    initialBufferSize: Int = DEFAULT_BUFFER_SIZE
+) {
+
+    private var buffer: ByteBuffer = allocate(initialBufferSize)
+
+    /**
+     * Returns the media info of each file in [filePaths], in the same order, or null for files that
+     * could not be probed.
+     */
+    fun scan(filePaths: List<String>): List<MediaInfo?> {
+        val paths = filePaths.toTypedArray()
+        val results = ArrayList<MediaInfo?>(paths.size)
+        while (results.size < paths.size) {
+            val count = nativeScan(
+                paths,
+                results.size,
+                buffer,
+                probeOptions.probeSize,
+                probeOptions.maxAnalyzeDurationUs,
+                probeOptions.fpsProbeSize,
+                probeOptions.skipStreamInfoWhenHeaderComplete,
+                cache?.nativeHandle ?: 0L
+            )
+            check(count >= 0) { "Unable to scan media files." }
+
+            buffer.clear()
+            check(buffer.int == BATCH_VERSION) { "Unsupported media info batch version." }
+            val entryCount = buffer.int
+            val requiredSize = buffer.int
+            repeat(entryCount) {
+                val size = buffer.int
+                results.add(if (size >= 0) decodeRecord(buffer) else null)
+            }
+
+            if (entryCount == 0) {
+                // The next file alone does not fit, so it is probed again with a larger buffer.
+                buffer = allocate(maxOf(requiredSize, buffer.capacity() * 2))
+            }
+        }
+        return results
+    }
+
+    companion object {
+        private const val DEFAULT_BUFFER_SIZE = 256 * 1024
+
+        // Must match MEDIA_INFO_BATCH_VERSION and MEDIA_INFO_RECORD_VERSION on the native side.
+        private const val BATCH_VERSION = 1
+        private const val RECORD_VERSION = 2
+
+        private const val NULL_STRING_LENGTH = -1
+
+        init {
+            NativeLibrary.load()
+        }
+
+        private fun allocate(size: Int): ByteBuffer {
+            return ByteBuffer.allocateDirect(size).order(ByteOrder.LITTLE_ENDIAN)
+        }
+
+        /**
+         * Decodes one record in the layout written by media_info_record_serialize.
+         */
+        private fun decodeRecord(buffer: ByteBuffer): MediaInfo {
+            check(buffer.int == RECORD_VERSION) { "Unsupported media info record version." }
+            val format = buffer.string().orEmpty()
+            val duration = buffer.long
+
+            val videoStreams = List(buffer.int) {
+                VideoStream(
+                    index = buffer.int,
+                    title = buffer.string(),
+                    codecName = buffer.string().orEmpty(),
+                    language = buffer.string(),
+                    disposition = buffer.int,
+                    bitRate = buffer.long,
+                    frameRate = buffer.double,
+                    frameWidth = buffer.int,
+                    frameHeight = buffer.int,
+                    rotation = buffer.int,
+                    profile = profileOrNull(buffer.int),
+                    profileName = buffer.string(),
+                    level = levelOrNull(buffer.int),
+                    bitDepth = bitDepthOrNull(buffer.int),
+                    pixelFormat = buffer.string(),
+                    colorInfo = VideoColorInfo(buffer.int, buffer.int, buffer.int, buffer.int),
+                    masteringDisplayMetadata = masteringDisplayOf(
+                        if (buffer.int != 0) DoubleArray(10) { buffer.double } else null
+                    ),
+                    contentLightLevel = contentLightLevelOf(buffer.int, buffer.int),
+                    dolbyVisionProfile = dolbyVisionProfileOrNull(buffer.int)
+                )
+            }
+            val audioStreams = List(buffer.int) {
+                AudioStream(
+                    index = buffer.int,
+                    title = buffer.string(),
+                    codecName = buffer.string().orEmpty(),
+                    language = buffer.string(),
+                    disposition = buffer.int,
+                    bitRate = buffer.long,
+                    sampleFormat = buffer.string(),
+                    sampleRate = buffer.int,
+                    channels = buffer.int,
+                    channelLayout = buffer.string()
+                )
+            }
+            val subtitleStreams = List(buffer.int) {
+                SubtitleStream(
+                    index = buffer.int,
+                    title = buffer.string(),
+                    codecName = buffer.string().orEmpty(),
+                    language = buffer.string(),
+                    disposition = buffer.int
+                )
+            }
+            val chapters = List(buffer.int) {
+                val index = buffer.int
+                val title = buffer.string()
+                Chapter(index = index, start = buffer.long, end = buffer.long, title = title)
+            }
+
+            return MediaInfo(
+                format,
+                duration,
+                videoStreams.firstOrNull(),
+                audioStreams,
+                subtitleStreams,
+                chapters,
+                null
+            )
+        }
+
+        private fun ByteBuffer.string(): String? {
+            val length = int
+            if (length == NULL_STRING_LENGTH) return null
+            val bytes = ByteArray(length)
+            get(bytes)
+            return String(bytes, Charsets.UTF_8)
+        }
+
+        @Keep
+        @JvmStatic
+        private external fun nativeScan(
+            filePaths: Array<String>,
+            offset: Int,
+            buffer: ByteBuffer,
+            probeSize: Long,
+            maxAnalyzeDurationUs: Long,
+            fpsProbeSize: Int,
+            skipStreamInfo: Boolean,
+            cacheHandle: Long
+        ): Int
+    }
+}
@@ -2,12 +2,12 @@ package io.github.anilbeesetti.nextlib.mediainfo
 
 import android.content.Context
 import android.graphics.Bitmap
-import android.graphics.Matrix
 import android.net.Uri
 import android.os.ParcelFileDescriptor
 import androidx.annotation.Keep
 import java.io.FileNotFoundException
 import java.io.Closeable
+import java.nio.ByteBuffer
 
 /**
  * A lightweight retriever for artwork and thumbnails.
@@ -18,6 +18,18 @@ class MediaThumbnailRetriever : Closeable {
 
     private var nativeHandle: Long = 0L
 
+    @Keep
+    fun interface FrameSequenceCallback {
+        /**
+         * Called on the extracting thread as soon as a frame has been written into
+         * `buffers[bufferIndex]`.
+         *
+         * @param timeUs presentation time of the frame in microseconds, from the start of the stream.
+         * @return false to stop the extraction.
+         */
+        fun onFrame(bufferIndex: Int, timeUs: Long): Boolean
+    }
+
     fun setDataSource(filePath: String) {
         reset()
         nativeHandle = nativeCreateFromPath(filePath)
@@ -66,7 +78,9 @@ class MediaThumbnailRetriever : Closeable {
     }
 
     /**
-     * Returns a decoded frame by zero-based [frameIndex].
+     * Returns a decoded frame by zero-based [frameIndex] in presentation order.
+     *
+     * Without an index this decodes every frame before [frameIndex]; see [buildIndex].
      */
     fun getFrameAtIndex(frameIndex: Int): Bitmap? {
         require(frameIndex >= 0) { "frameIndex must be >= 0" }
@@ -75,6 +89,96 @@ class MediaThumbnailRetriever : Closeable {
         return bitmap.rotate(nativeGetRotationDegrees(handle))
     }
 
+    /**
+     * Decodes [durationUs] microseconds of video from [startUs] in a single pass, for animated
+     * previews, and passes on one frame every 1 / [frameRate] seconds.
+     *
+     * Frames are scaled to [width] x [height] RGBA_8888 pixels and written into [buffers] in turn,
+     * so `buffers[i]` is overwritten `buffers.size` frames later. Consumers that hand frames to
+     * another thread, such as the UI, may hold up to `buffers.size - 1` of them at a time.
+     *
+     * @param buffers direct buffers of at least `width * height * 4` bytes each.
+     * @return the number of frames delivered to [callback].
+     */
+    fun extractFrameSequence(
+        startUs: Long,
+        durationUs: Long,
+        frameRate: Double,
+        width: Int,
+        height: Int,
+        buffers: Array<ByteBuffer>,
+        callback: FrameSequenceCallback
+    ): Int {
+        require(startUs >= 0 && durationUs > 0) { "startUs must be >= 0 and durationUs > 0" }
+        require(frameRate > 0) { "frameRate must be > 0" }
+        require(width > 0 && height > 0) { "width and height must be > 0" }
+        require(buffers.isNotEmpty()) { "buffers must not be empty" }
+        require(buffers.all { it.isDirect && it.capacity() >= width * height * 4 }) {
+            "buffers must be direct and hold at least width * height * 4 bytes"
+        }
+        return nativeExtractFrameSequence(requireHandle(), startUs, durationUs, frameRate, width, height, buffers, callback)
+    }
+
+    /**
+     * Draws a storyboard of [columns] x [rows] tiles into a single bitmap, one tile every
+     * [intervalUs] microseconds.
+     *
+     * The video is read once from start to end and only keyframes are decoded, so each tile shows
+     * the last keyframe at or before its time.
+     *
+     * @param tileHeight height of a tile, or 0 to derive it from [tileWidth] and the video aspect ratio.
+     * @return the storyboard, or null if no tile could be drawn
+     */
+    fun getStoryboard(intervalUs: Long, tileWidth: Int, tileHeight: Int = 0, columns: Int, rows: Int): Storyboard? {
+        require(intervalUs > 0) { "intervalUs must be > 0" }
+        require(tileWidth > 0 && tileHeight >= 0) { "tileWidth must be > 0 and tileHeight >= 0" }
+        require(columns > 0 && rows > 0) { "columns and rows must be > 0" }
+        val handle = requireHandle()
+        val timestampsUs = LongArray(columns * rows)
+        val bitmap = nativeGetStoryboard(handle, intervalUs, tileWidth, tileHeight, columns, rows, timestampsUs)
+            ?: return null
+        return Storyboard(
+            bitmap = bitmap,
+            tileWidth = tileWidth,
+            tileHeight = bitmap.height / rows,
+            columns = columns,
+            rows = rows,
+            timestampsUs = timestampsUs,
+            rotationDegrees = nativeGetRotationDegrees(handle)
+        )
+    }
+
+    /**
+     * Reads every video packet once, without decoding, and keeps their timestamps, byte positions
+     * and keyframe flags. Afterwards [getFrameAtIndex] and [getFrameAtTime] seek straight to the
+     * right keyframe, even in raw elementary streams or files with a broken seek index.
+     *
+     * This reads the whole input, so prefer [importIndex] with an index saved by [exportIndex]
+     * when the same file is opened again.
+     *
+     * @return false if the video stream has no usable timestamps
+     */
+    fun buildIndex(): Boolean {
+        return nativeBuildIndex(requireHandle())
+    }
+
+    /**
+     * Returns the index built by [buildIndex] or loaded by [importIndex] in a compact binary form,
+     * or null if there is none.
+     */
+    fun exportIndex(): ByteArray? {
+        return nativeExportIndex(requireHandle())
+    }
+
+    /**
+     * Loads an index previously returned by [exportIndex] for the same file.
+     *
+     * @return false if [data] is invalid or was built for another stream layout
+     */
+    fun importIndex(data: ByteArray): Boolean {
+        return nativeImportIndex(requireHandle(), data)
+    }
+
     override fun close() {
         reset()
     }
@@ -97,7 +201,7 @@ class MediaThumbnailRetriever : Closeable {
 
     companion object {
         init {
-            System.loadLibrary("mediainfo")
+            NativeLibrary.load()
         }
 
         @Keep
@@ -120,6 +224,43 @@ class MediaThumbnailRetriever : Closeable {
         @JvmStatic
         private external fun nativeGetFrameAtIndex(handle: Long, frameIndex: Int): Bitmap?
 
+        @Keep
+        @JvmStatic
+        private external fun nativeExtractFrameSequence(
+            handle: Long,
+            startUs: Long,
+            durationUs: Long,
+            frameRate: Double,
+            width: Int,
+            height: Int,
+            buffers: Array<ByteBuffer>,
+            callback: FrameSequenceCallback
+        ): Int
+
+        @Keep
+        @JvmStatic
+        private external fun nativeGetStoryboard(
+            handle: Long,
+            intervalUs: Long,
+            tileWidth: Int,
+            tileHeight: Int,
+            columns: Int,
+            rows: Int,
+            timestampsUs: LongArray
+        ): Bitmap?
+
+        @Keep
+        @JvmStatic
+        private external fun nativeBuildIndex(handle: Long): Boolean
+
+        @Keep
+        @JvmStatic
+        private external fun nativeExportIndex(handle: Long): ByteArray?
+
+        @Keep
+        @JvmStatic
+        private external fun nativeImportIndex(handle: Long, data: ByteArray): Boolean
+
         @Keep
         @JvmStatic
         private external fun nativeGetRotationDegrees(handle: Long): Int
@@ -129,9 +270,3 @@ class MediaThumbnailRetriever : Closeable {
         private external fun nativeRelease(handle: Long)
     }
 }
-
-private fun Bitmap.rotate(degrees: Int): Bitmap {
-    if (degrees % 360 == 0) return this
-    val matrix = Matrix().apply { postRotate(degrees.toFloat()) }
-    return Bitmap.createBitmap(this, 0, 0, width, height, matrix, true)
-}
@@ -0,0 +1,174 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+import android.content.Context
+import android.graphics.Bitmap
+import android.net.Uri
+import android.os.ParcelFileDescriptor
+import androidx.annotation.Keep
+import java.io.Closeable
+import java.io.FileNotFoundException
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.atomic.AtomicLong
+
+/**
+ * Extracts thumbnails for many files in parallel on a bounded pool of native workers.
+ *
+ * Each worker opens its own media source, so requests never block each other. Decoder threads are
+ * split between workers so that the pool as a whole does not oversubscribe the CPU.
+ *
+ * Callbacks are invoked on a native worker thread. [close] may be called from a callback; the worker
+ * running it then finishes the release after the callback returns.
+ *
+ * @param workerCount maximum number of files processed at the same time, capped at the core count.
+ * @param cache optional cache for thumbnails of unchanged local files. It must stay open until this
+ * service is closed.
+ */
+class MediaThumbnailService @JvmOverloads constructor(
+    workerCount: Int = Runtime.getRuntime().availableProcessors(),
+    cache: MediaCache? = null
+) : Closeable {
+
+    fun interface Callback {
+        /**
+         * Called once per request with the extracted thumbnail, or null if extraction failed.
+         */
+        fun onThumbnailResult(requestId: Long, bitmap: Bitmap?)
+    }
+
+    private val nextRequestId = AtomicLong()
+    private val callbacks = ConcurrentHashMap<Long, Callback>()
+
+    // Guards nativeHandle so that close() cannot free the service while a submit is using it.
+    private val handleLock = Any()
+    private var nativeHandle: Long = nativeCreate(workerCount, cache?.nativeHandle ?: 0L)
+
+    /**
+     * Queues a thumbnail request for [filePath].
+     *
+     * @param timeUs position of the frame in microseconds.
+     * @param width width of the thumbnail, or 0 to derive it from [height] and the video aspect ratio.
+     * @param height height of the thumbnail, or 0 to derive it from [width] and the video aspect ratio.
+     * @return id of the request passed back to [callback].
+     */
+    fun submit(filePath: String, timeUs: Long, width: Int = 0, height: Int = 0, callback: Callback): Long {
+        val requestId = register(timeUs, width, height, callback)
+        val queued = synchronized(handleLock) {
+            nativeSubmitPath(requireHandle(requestId), requestId, filePath, timeUs, width, height)
+        }
+        if (!queued) {
+            callbacks.remove(requestId)
+            error("Unable to queue thumbnail request.")
+        }
+        return requestId
+    }
+
+    /**
+     * Queues a thumbnail request for [descriptor]. The descriptor is duplicated, so it can be closed
+     * as soon as this returns.
+     */
+    fun submit(descriptor: ParcelFileDescriptor, timeUs: Long, width: Int = 0, height: Int = 0, callback: Callback): Long {
+        val requestId = register(timeUs, width, height, callback)
+        val queued = synchronized(handleLock) {
+            nativeSubmitFD(requireHandle(requestId), requestId, descriptor.fd, timeUs, width, height)
+        }
+        if (!queued) {
+            callbacks.remove(requestId)
+            error("Unable to queue thumbnail request.")
+        }
+        return requestId
+    }
+
+    fun submit(context: Context, uri: Uri, timeUs: Long, width: Int = 0, height: Int = 0, callback: Callback): Long {
+        return when {
+            uri.scheme?.lowercase()?.startsWith("http") == true -> submit(uri.toString(), timeUs, width, height, callback)
+            else -> {
+                val path = PathUtil.getPath(context, uri)
+                if (path != null) {
+                    submit(path, timeUs, width, height, callback)
+                } else {
+                    try {
+                        context.contentResolver.openFileDescriptor(uri, "r")?.use { descriptor ->
+                            submit(descriptor, timeUs, width, height, callback)
+                        } ?: error("Unable to open media source from uri.")
+                    } catch (e: FileNotFoundException) {
+                        throw IllegalArgumentException("Unable to open media source from uri.", e)
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Stops the workers. Requests that have not started yet are dropped without a callback.
+     *
+     * Blocks until the other workers have finished their current request. When called from a
+     * callback, it does not wait for the worker running that callback.
+     */
+    override fun close() {
+        // The handle is detached under the lock, so no submit can be using it any more, but released
+        // outside of it: joining the workers must not wait on a callback that is blocked in submit.
+        val handle = synchronized(handleLock) {
+            nativeHandle.also { nativeHandle = 0L }
+        }
+        if (handle != 0L) {
+            nativeRelease(handle)
+        }
+        callbacks.clear()
+    }
+
+    private fun register(timeUs: Long, width: Int, height: Int, callback: Callback): Long {
+        require(timeUs >= 0) { "timeUs must be >= 0" }
+        require(width >= 0 && height >= 0) { "width and height must be >= 0" }
+        val requestId = nextRequestId.incrementAndGet()
+        callbacks[requestId] = callback
+        return requestId
+    }
+
+    private fun requireHandle(requestId: Long): Long {
+        if (nativeHandle == 0L) {
+            callbacks.remove(requestId)
+            error("MediaThumbnailService is closed.")
+        }
+        return nativeHandle
+    }
+
+    /* Used from JNI */
+    @Keep
+    @SuppressWarnings("UnusedPrivateMember")
+    private fun onThumbnailResult(requestId: Long, bitmap: Bitmap?, rotationDegrees: Int) {
+        val callback = callbacks.remove(requestId) ?: return
+        callback.onThumbnailResult(requestId, bitmap?.rotate(rotationDegrees))
+    }
+
+    @Keep
+    private external fun nativeCreate(workerCount: Int, cacheHandle: Long): Long
+
+    @Keep
+    private external fun nativeSubmitPath(
+        handle: Long,
+        requestId: Long,
+        filePath: String,
+        timeUs: Long,
+        width: Int,
+        height: Int
+    ): Boolean
+
+    @Keep
+    private external fun nativeSubmitFD(
+        handle: Long,
+        requestId: Long,
+        fileDescriptor: Int,
+        timeUs: Long,
+        width: Int,
+        height: Int
+    ): Boolean
+
+    @Keep
+    private external fun nativeRelease(handle: Long)
+
+    companion object {
+        init {
+            NativeLibrary.load()
+        }
+    }
+}
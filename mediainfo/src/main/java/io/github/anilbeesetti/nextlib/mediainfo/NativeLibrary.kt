@@ -0,0 +1,13 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+/**
+ * Loads libmediainfo.so once for every class with native methods.
+ */
+internal object NativeLibrary {
+
+    init {
+        System.loadLibrary("mediainfo")
+    }
+
+    fun load() = Unit
+}
@@ -0,0 +1,46 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+/**
+ * Bounds how much of a media source is read and decoded to discover its streams.
+ *
+ * @param probeSize maximum number of bytes read while probing, or 0 for FFmpeg's default (5 MB).
+ * @param maxAnalyzeDurationUs maximum duration of the input analyzed to fill in codec parameters,
+ * in microseconds, or 0 for FFmpeg's default.
+ * @param fpsProbeSize maximum number of frames used to guess the frame rate, or 0 for FFmpeg's
+ * default.
+ * @param skipStreamInfoWhenHeaderComplete skip decoding packets when the container header already
+ * describes every stream (e.g. MP4 moov, MKV tracks). Properties that are only known after decoding,
+ * such as the audio sample format of some codecs, may then be missing.
+ */
+data class ProbeOptions(
+    val probeSize: Long = 0,
+    val maxAnalyzeDurationUs: Long = 0,
+    val fpsProbeSize: Int = 0,
+    val skipStreamInfoWhenHeaderComplete: Boolean = false
+) {
+    init {
+        require(probeSize >= 0 && maxAnalyzeDurationUs >= 0 && fpsProbeSize >= 0) {
+            "Probe limits must be >= 0"
+        }
+    }
+
+    companion object {
+        /**
+         * FFmpeg's default probing.
+         */
+        @JvmField
+        val DEFAULT = ProbeOptions()
+
+        /**
+         * Bounded probing for scanning large libraries, where listing streams should cost little
+         * more than reading the container header.
+         */
+        @JvmField
+        val FAST = ProbeOptions(
+            probeSize = 512 * 1024,
+            maxAnalyzeDurationUs = 500_000,
+            fpsProbeSize = 3,
+            skipStreamInfoWhenHeaderComplete = true
+        )
+    }
+}
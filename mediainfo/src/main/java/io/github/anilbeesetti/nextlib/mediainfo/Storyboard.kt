@@ -0,0 +1,25 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+import android.graphics.Bitmap
+
+/**
+ * A grid of video thumbnails packed into a single atlas, as used for WebVTT storyboards.
+ *
+ * Tiles are laid out in row-major order. Tile `i` starts at
+ * `((i % columns) * tileWidth, (i / columns) * tileHeight)` in [bitmap].
+ *
+ * Tiles are not rotated; apply [rotationDegrees] to each tile when displaying them.
+ */
+class Storyboard(
+    val bitmap: Bitmap,
+    val tileWidth: Int,
+    val tileHeight: Int,
+    val columns: Int,
+    val rows: Int,
+    /**
+     * For each tile, the time in microseconds from the start of the video of the frame drawn in it,
+     * or -1 if the tile is empty because it lies past the end of the video.
+     */
+    val timestampsUs: LongArray,
+    val rotationDegrees: Int
+)
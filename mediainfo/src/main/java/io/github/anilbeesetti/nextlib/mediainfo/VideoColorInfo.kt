@@ -0,0 +1,15 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+/**
+ * Color description of a video stream as signalled by the container or bitstream.
+ *
+ * [primaries], [transfer] and [matrixCoefficients] are ISO/IEC 23091-2 code points (2 means
+ * unspecified), e.g. [transfer] 16 is SMPTE ST 2084 (PQ) and 18 is ARIB STD-B67 (HLG).
+ * [range] is 1 for limited and 2 for full range, 0 if unspecified.
+ */
+data class VideoColorInfo(
+    val range: Int = 0,
+    val primaries: Int = 2,
+    val transfer: Int = 2,
+    val matrixCoefficients: Int = 2
+)
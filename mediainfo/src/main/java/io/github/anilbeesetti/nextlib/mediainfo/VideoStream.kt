@@ -11,4 +11,18 @@ data class VideoStream(
     val frameWidth: Int,
     val frameHeight: Int,
     val rotation: Int,
+    /** Codec profile as defined by FFmpeg (FF_PROFILE_*), or null if not known. */
+    val profile: Int? = null,
+    val profileName: String? = null,
+    /** Codec level as defined by FFmpeg, or null if not known. */
+    val level: Int? = null,
+    /** Bits per sample of the luma component, or null if not known. */
+    val bitDepth: Int? = null,
+    /** FFmpeg pixel format name, e.g. "yuv420p10le", or null if not known. */
+    val pixelFormat: String? = null,
+    val colorInfo: VideoColorInfo = VideoColorInfo(),
+    val masteringDisplayMetadata: MasteringDisplayMetadata? = null,
+    val contentLightLevel: ContentLightLevel? = null,
+    /** Dolby Vision profile, or null if the stream carries no Dolby Vision configuration. */
+    val dolbyVisionProfile: Int? = null,
 )
\ No newline at end of file
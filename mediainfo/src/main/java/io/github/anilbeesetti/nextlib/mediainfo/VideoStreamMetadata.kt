@@ -0,0 +1,33 @@
+package io.github.anilbeesetti.nextlib.mediainfo
+
+// FF_PROFILE_UNKNOWN and FF_LEVEL_UNKNOWN.
+private const val UNKNOWN_PROFILE_OR_LEVEL = -99
+
+internal fun profileOrNull(profile: Int): Int? = profile.takeIf { it != UNKNOWN_PROFILE_OR_LEVEL }
+
+internal fun levelOrNull(level: Int): Int? = level.takeIf { it != UNKNOWN_PROFILE_OR_LEVEL }
+
+internal fun bitDepthOrNull(bitDepth: Int): Int? = bitDepth.takeIf { it > 0 }
+
+internal fun masteringDisplayOf(values: DoubleArray?): MasteringDisplayMetadata? {
+    if (values == null || values.size < 10) return null
+    return MasteringDisplayMetadata(
+        redX = values[0],
+        redY = values[1],
+        greenX = values[2],
+        greenY = values[3],
+        blueX = values[4],
+        blueY = values[5],
+        whitePointX = values[6],
+        whitePointY = values[7],
+        minLuminance = values[8],
+        maxLuminance = values[9]
+    )
+}
+
+internal fun contentLightLevelOf(maxContentLightLevel: Int, maxFrameAverageLightLevel: Int): ContentLightLevel? {
+    if (maxContentLightLevel <= 0 && maxFrameAverageLightLevel <= 0) return null
+    return ContentLightLevel(maxContentLightLevel, maxFrameAverageLightLevel)
+}
+
+internal fun dolbyVisionProfileOrNull(profile: Int): Int? = profile.takeIf { it >= 0 }
@@ -0,0 +1,227 @@
+#ifndef NEXTPLAYER_LOOPBACK_HTTP_SERVER_H
+#define NEXTPLAYER_LOOPBACK_HTTP_SERVER_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A minimal HTTP/1.1 server on 127.0.0.1 that serves one resource, standing in for a media
+ * server in tests. It answers GET requests with byte ranges of the form "bytes=<start>-" and
+ * "bytes=<start>-<end>", counts the requests it receives, and can cut a response short to
+ * simulate a dropped connection.
+ */
+class LoopbackHttpServer {
+public:
+    /**
+     * Starts serving [body] on an ephemeral port.
+     *
+     * @param acceptRanges whether ranges are supported; otherwise every request gets the whole body
+     */
+    explicit LoopbackHttpServer(std::vector<uint8_t> body, bool acceptRanges = true)
+            : body(std::move(body)), acceptRanges(acceptRanges) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (listenFd < 0 ||
+            bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            listen(listenFd, 16) != 0 ||
+            getsockname(listenFd, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+            perror("LoopbackHttpServer");
+            return;
+        }
+        port = ntohs(address.sin_port);
+        acceptThread = std::thread(&LoopbackHttpServer::accept_loop, this);
+    }
+
+    ~LoopbackHttpServer() {
+        stopped = true;
+        // Wakes up accept and every connection blocked in recv or send.
+        shutdown(listenFd, SHUT_RDWR);
+        if (acceptThread.joinable()) {
+            acceptThread.join();
+        }
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int fd: connectionFds) {
+                shutdown(fd, SHUT_RDWR);
+            }
+            threads.swap(connectionThreads);
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        close(listenFd);
+    }
+
+    LoopbackHttpServer(const LoopbackHttpServer &) = delete;
+    LoopbackHttpServer &operator=(const LoopbackHttpServer &) = delete;
+
+    bool isRunning() const {
+        return port != 0;
+    }
+
+    std::string url(const std::string &path) const {
+        return "http://127.0.0.1:" + std::to_string(port) + "/" + path;
+    }
+
+    int requests() const {
+        return requestCount.load();
+    }
+
+    /**
+     * Makes the next response end the connection after [bytes] bytes of its body, while its
+     * headers still announce the full length.
+     */
+    void dropNextResponseAfter(int64_t bytes) {
+        dropAfter = bytes;
+    }
+
+private:
+    const std::vector<uint8_t> body;
+    const bool acceptRanges;
+    int listenFd = -1;
+    uint16_t port = 0;
+    std::atomic<bool> stopped{false};
+    std::atomic<int> requestCount{0};
+    std::atomic<int64_t> dropAfter{-1};
+    std::thread acceptThread;
+    std::mutex mutex;
+    std::vector<int> connectionFds;
+    std::vector<std::thread> connectionThreads;
+
+    void accept_loop() {
+        while (!stopped) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                break;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopped) {
+                close(fd);
+                break;
+            }
+            connectionFds.push_back(fd);
+            connectionThreads.emplace_back(&LoopbackHttpServer::serve, this, fd);
+        }
+    }
+
+    static bool send_all(int fd, const void *data, size_t size) {
+        auto *bytes = static_cast<const uint8_t *>(data);
+        while (size > 0) {
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    /**
+     * Parses the start and the inclusive end of a Range header in [request], if it has one.
+     */
+    static bool parse_range(std::string request, int64_t &start, int64_t &end) {
+        std::transform(request.begin(), request.end(), request.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        size_t header = request.find("\r\nrange:");
+        if (header == std::string::npos) {
+            return false;
+        }
+        long long first = -1;
+        long long last = -1;
+        if (sscanf(request.c_str() + header + 8, " bytes=%lld-%lld", &first, &last) < 1) {
+            return false;
+        }
+        start = first;
+        if (last >= 0) {
+            end = std::min<int64_t>(end, last);
+        }
+        return true;
+    }
+
+    bool respond(int fd, const std::string &request) {
+        requestCount++;
+        auto size = static_cast<int64_t>(body.size());
+        int64_t start = 0;
+        int64_t end = size - 1;
+        bool ranged = acceptRanges && parse_range(request, start, end);
+        if (ranged && start >= size) {
+            std::string headers = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" +
+                                  std::to_string(size) + "\r\nContent-Length: 0\r\n\r\n";
+            return send_all(fd, headers.data(), headers.size());
+        }
+
+        int64_t length = end - start + 1;
+        std::string headers = ranged ? "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " +
+                                       std::to_string(start) + "-" + std::to_string(end) + "/" +
+                                       std::to_string(size) + "\r\n"
+                                     : "HTTP/1.1 200 OK\r\n";
+        if (acceptRanges) {
+            headers += "Accept-Ranges: bytes\r\n";
+        }
+        headers += "Content-Type: application/octet-stream\r\nContent-Length: " +
+                   std::to_string(length) + "\r\n\r\n";
+        if (!send_all(fd, headers.data(), headers.size())) {
+            return false;
+        }
+
+        int64_t drop = dropAfter.exchange(-1);
+        if (drop >= 0 && drop < length) {
+            send_all(fd, body.data() + start, static_cast<size_t>(drop));
+            return false;
+        }
+        return send_all(fd, body.data() + start, static_cast<size_t>(length));
+    }
+
+    void serve(int fd) {
+        std::string pending;
+        char buffer[4096];
+        while (!stopped) {
+            size_t headerEnd = pending.find("\r\n\r\n");
+            if (headerEnd != std::string::npos) {
+                std::string request = pending.substr(0, headerEnd + 2);
+                pending.erase(0, headerEnd + 4);
+                if (!respond(fd, request)) {
+                    break;
+                }
+                continue;
+            }
+            ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                break;
+            }
+            pending.append(buffer, static_cast<size_t>(count));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        connectionFds.erase(std::find(connectionFds.begin(), connectionFds.end(), fd));
+        close(fd);
+    }
+};
+
+#endif //NEXTPLAYER_LOOPBACK_HTTP_SERVER_H
@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "media_io.h"
+#include "test_clips.h"
+
+/*
+ * Read syscalls and wall time of demuxing local files through FFmpeg's file protocol, the
+ * pread backend and the memory-mapped backend.
+ */
+
+enum class Backend {
+    FILE_PROTOCOL,
+    FD,
+    MMAP,
+};
+
+struct ReadStats {
+    bool opened = false;
+    int64_t packets = 0;
+    int64_t packetBytes = 0;
+    int64_t syscalls = 0;
+    double milliseconds = 0;
+};
+
+// Read syscalls of this process so far; /proc/self/io counts read, pread and their vector forms.
+static int64_t read_syscalls() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    int64_t value;
+    while (io >> key >> value) {
+        if (key == "syscr:") {
+            return value;
+        }
+    }
+    return -1;
+}
+
+static AVFormatContext *open_input(Backend backend, const std::string &path, MediaIOAccess access) {
+    AVFormatContext *avFormatContext = nullptr;
+    if (backend == Backend::FILE_PROTOCOL) {
+        return avformat_open_input(&avFormatContext, path.c_str(), nullptr, nullptr) == 0
+               ? avFormatContext : nullptr;
+    }
+
+    AVIOContext *io;
+    if (backend == Backend::FD) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        io = fd >= 0 ? media_io_create_fd(fd) : nullptr;
+        if (fd >= 0) {
+            close(fd);
+        }
+    } else {
+        io = media_io_create_mmap(path.c_str(), access);
+    }
+    return media_io_open_input(&avFormatContext, io, path.c_str()) == 0 ? avFormatContext : nullptr;
+}
+
+// Only the mapped backend takes access hints, the pread one it falls back to does not.
+static bool is_mapped(AVFormatContext *avFormatContext) {
+    auto *mediaIO = static_cast<MediaIO *>(avFormatContext->pb->opaque);
+    return mediaIO && mediaIO->advise;
+}
+
+static bool mmap_applies(const std::string &path) {
+    AVFormatContext *avFormatContext = open_input(Backend::MMAP, path, MEDIA_IO_ACCESS_SEQUENTIAL);
+    bool mapped = avFormatContext && is_mapped(avFormatContext);
+    media_io_close_input(&avFormatContext);
+    return mapped;
+}
+
+/**
+ * Opens [path] and reads its packets, either all of them or, for [seeks] > 0, one after each of
+ * [seeks] seeks spread over the duration, the way thumbnails are extracted.
+ */
+static ReadStats read_packets(Backend backend, const std::string &path, int seeks) {
+    ReadStats stats;
+    int64_t syscallsBefore = read_syscalls();
+    auto start = std::chrono::steady_clock::now();
+
+    AVFormatContext *avFormatContext = open_input(
+            backend, path, seeks > 0 ? MEDIA_IO_ACCESS_RANDOM : MEDIA_IO_ACCESS_SEQUENTIAL);
+    if (!avFormatContext) {
+        return stats;
+    }
+    stats.opened = true;
+    AVPacket *packet = av_packet_alloc();
+    if (seeks == 0) {
+        while (av_read_frame(avFormatContext, packet) >= 0) {
+            stats.packets++;
+            stats.packetBytes += packet->size;
+            av_packet_unref(packet);
+        }
+    } else {
+        for (int seek = 0; seek < seeks; seek++) {
+            int64_t timestamp = avFormatContext->duration / seeks * seek;
+            if (av_seek_frame(avFormatContext, -1, timestamp, AVSEEK_FLAG_BACKWARD) >= 0 &&
+                av_read_frame(avFormatContext, packet) >= 0) {
+                stats.packets++;
+                stats.packetBytes += packet->size;
+                av_packet_unref(packet);
+            }
+        }
+    }
+    av_packet_free(&packet);
+    media_io_close_input(&avFormatContext);
+
+    stats.milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    stats.syscalls = read_syscalls() - syscallsBefore;
+    return stats;
+}
+
+static void print_stats(const char *name, const ReadStats &file, const ReadStats &fd, const ReadStats &mapped) {
+    printf("%-20s file %6lld syscalls %7.2f ms, fd %6lld syscalls %7.2f ms, mmap %6lld syscalls %7.2f ms\n",
+           name, (long long) file.syscalls, file.milliseconds, (long long) fd.syscalls, fd.milliseconds,
+           (long long) mapped.syscalls, mapped.milliseconds);
+}
+
+class MediaIOTest : public testing::TestWithParam<const char *> {
+protected:
+    void SetUp() override {
+        ASSERT_GE(read_syscalls(), 0) << "No /proc/self/io";
+    }
+};
+
+TEST_P(MediaIOTest, MappedReadsNeedNoSyscallsAndReturnTheSamePackets) {
+    REQUIRE_CLIP(path, GetParam());
+    if (!mmap_applies(path)) {
+        GTEST_SKIP() << "The clips are not on ext4 or f2fs, so they are read with pread";
+    }
+
+    // Once to warm the page cache, so every backend reads from memory.
+    read_packets(Backend::FILE_PROTOCOL, path, 0);
+    ReadStats file = read_packets(Backend::FILE_PROTOCOL, path, 0);
+    ReadStats fd = read_packets(Backend::FD, path, 0);
+    ReadStats mapped = read_packets(Backend::MMAP, path, 0);
+    ASSERT_TRUE(file.opened && fd.opened && mapped.opened);
+    print_stats(GetParam(), file, fd, mapped);
+    RecordProperty("file_syscalls", std::to_string(file.syscalls));
+    RecordProperty("mmap_syscalls", std::to_string(mapped.syscalls));
+
+    EXPECT_GT(file.packets, 0);
+    EXPECT_EQ(fd.packets, file.packets);
+    EXPECT_EQ(fd.packetBytes, file.packetBytes);
+    EXPECT_EQ(mapped.packets, file.packets);
+    EXPECT_EQ(mapped.packetBytes, file.packetBytes);
+    EXPECT_LT(mapped.syscalls, fd.syscalls);
+}
+
+TEST_P(MediaIOTest, MappedSeeksNeedNoSyscalls) {
+    REQUIRE_CLIP(path, GetParam());
+    if (!mmap_applies(path)) {
+        GTEST_SKIP() << "The clips are not on ext4 or f2fs, so they are read with pread";
+    }
+
+    read_packets(Backend::FILE_PROTOCOL, path, 0);
+    ReadStats file = read_packets(Backend::FILE_PROTOCOL, path, 20);
+    ReadStats fd = read_packets(Backend::FD, path, 20);
+    ReadStats mapped = read_packets(Backend::MMAP, path, 20);
+    ASSERT_TRUE(file.opened && fd.opened && mapped.opened);
+    print_stats(GetParam(), file, fd, mapped);
+
+    EXPECT_EQ(fd.packetBytes, file.packetBytes);
+    EXPECT_EQ(mapped.packetBytes, file.packetBytes);
+    EXPECT_LT(mapped.syscalls, file.syscalls);
+}
+
+INSTANTIATE_TEST_SUITE_P(Clips, MediaIOTest,
+                         testing::Values("h264_720p.mp4", "h264_1080p.mkv", "h264_360p_long.mkv"),
+                         [](const testing::TestParamInfo<const char *> &info) {
+                             std::string name = info.param;
+                             std::replace(name.begin(), name.end(), '.', '_');
+                             return name;
+                         });
+
+TEST(MediaIOMappingTest, FilesOthersCanWriteAreNotMapped) {
+    REQUIRE_CLIP(source, "h264_720p.mp4");
+    if (!mmap_applies(source)) {
+        GTEST_SKIP() << "The clips are not on ext4 or f2fs, so they are read with pread";
+    }
+
+    std::string path = source + ".shared";
+    {
+        std::ifstream in(source, std::ios::binary);
+        std::ofstream out(path, std::ios::binary);
+        out << in.rdbuf();
+    }
+    ASSERT_EQ(chmod(path.c_str(), 0666), 0);
+
+    AVFormatContext *avFormatContext = open_input(Backend::MMAP, path, MEDIA_IO_ACCESS_SEQUENTIAL);
+    ASSERT_NE(avFormatContext, nullptr);
+    EXPECT_FALSE(is_mapped(avFormatContext));
+    media_io_close_input(&avFormatContext);
+    unlink(path.c_str());
+}
+
+TEST(MediaIOMappingTest, SourcesAreOnlyMappedWhenEnabled) {
+    REQUIRE_CLIP(path, "h264_720p.mp4");
+
+    media_io_set_memory_mapping_enabled(false);
+    EXPECT_EQ(media_io_create_for_source(path.c_str(), MEDIA_IO_ACCESS_SEQUENTIAL), nullptr);
+
+    media_io_set_memory_mapping_enabled(true);
+    AVIOContext *io = media_io_create_for_source(path.c_str(), MEDIA_IO_ACCESS_SEQUENTIAL);
+    EXPECT_NE(io, nullptr);
+    media_io_free(&io);
+    // Relative paths and other URLs keep going through FFmpeg's protocols.
+    EXPECT_EQ(media_io_create_for_source("clip.mp4", MEDIA_IO_ACCESS_SEQUENTIAL), nullptr);
+    EXPECT_EQ(media_io_create_for_source(("file:" + path).c_str(), MEDIA_IO_ACCESS_SEQUENTIAL), nullptr);
+    media_io_set_memory_mapping_enabled(false);
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "media_io.h"
+#include "media_probe.h"
+#include "test_clips.h"
+
+/*
+ * Bytes read and time spent per probe, with FFmpeg's default limits and with the limits
+ * MediaInfoScanner uses (ProbeOptions.FAST on the JVM side).
+ */
+
+static const ProbeOptions DEFAULT_OPTIONS{0, 0, 0, false};
+static const ProbeOptions FAST_OPTIONS{512 * 1024, 500000, 3, true};
+
+// Reads may run past the probe size by the io buffer of media_io_create_fd and the packet that
+// crosses the limit.
+static const int64_t PROBE_SIZE_SLACK = 2 * 128 * 1024;
+
+// Probes are repeated and the fastest one is kept, so that the first one warming the page cache
+// does not count.
+static const int PROBE_RUNS = 3;
+
+struct StreamSummary {
+    AVMediaType type;
+    AVCodecID codecId;
+    int width;
+    int height;
+    int sampleRate;
+
+    bool operator==(const StreamSummary &other) const {
+        return type == other.type && codecId == other.codecId && width == other.width &&
+               height == other.height && sampleRate == other.sampleRate;
+    }
+};
+
+struct ProbeResult {
+    bool opened = false;
+    int64_t bytesRead = 0;
+    double milliseconds = 0;
+    bool completeHeader = false;
+    std::vector<StreamSummary> streams;
+};
+
+static ProbeResult probe_once(const std::string &path, const ProbeOptions &options) {
+    ProbeResult result;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return result;
+    }
+    auto start = std::chrono::steady_clock::now();
+    AVFormatContext *avFormatContext = media_probe_open(path.c_str(), fd, options);
+    result.milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    close(fd);
+    if (!avFormatContext) {
+        return result;
+    }
+
+    result.opened = true;
+    result.bytesRead = avFormatContext->pb->bytes_read;
+    result.completeHeader = media_probe_has_complete_header(avFormatContext);
+    for (unsigned int pos = 0; pos < avFormatContext->nb_streams; pos++) {
+        AVCodecParameters *parameters = avFormatContext->streams[pos]->codecpar;
+        result.streams.push_back({parameters->codec_type, parameters->codec_id, parameters->width,
+                                  parameters->height, parameters->sample_rate});
+    }
+    media_io_close_input(&avFormatContext);
+    return result;
+}
+
+static ProbeResult probe(const std::string &path, const ProbeOptions &options) {
+    ProbeResult best = probe_once(path, options);
+    for (int run = 1; run < PROBE_RUNS && best.opened; run++) {
+        best.milliseconds = std::min(best.milliseconds, probe_once(path, options).milliseconds);
+    }
+    return best;
+}
+
+class MediaProbeTest : public testing::TestWithParam<const char *> {
+};
+
+TEST_P(MediaProbeTest, FastProbeReadsLessAndFindsTheSameStreams) {
+    REQUIRE_CLIP(path, GetParam());
+
+    ProbeResult full = probe(path, DEFAULT_OPTIONS);
+    ProbeResult fast = probe(path, FAST_OPTIONS);
+    ASSERT_TRUE(full.opened);
+    ASSERT_TRUE(fast.opened);
+
+    printf("%-20s default %9lld bytes %7.2f ms, fast %9lld bytes %7.2f ms%s\n", GetParam(),
+           (long long) full.bytesRead, full.milliseconds, (long long) fast.bytesRead, fast.milliseconds,
+           fast.completeHeader ? " (stream info skipped)" : "");
+    RecordProperty("default_bytes", std::to_string(full.bytesRead));
+    RecordProperty("default_us", std::to_string((long long) (full.milliseconds * 1000)));
+    RecordProperty("fast_bytes", std::to_string(fast.bytesRead));
+    RecordProperty("fast_us", std::to_string((long long) (fast.milliseconds * 1000)));
+
+    EXPECT_LE(fast.bytesRead, full.bytesRead);
+    EXPECT_LE(fast.bytesRead, FAST_OPTIONS.probeSize + PROBE_SIZE_SLACK);
+    EXPECT_EQ(fast.streams, full.streams);
+}
+
+INSTANTIATE_TEST_SUITE_P(Clips, MediaProbeTest,
+                         testing::Values("h264_720p.mp4", "h264_1080p.mkv", "mpeg2_720p.ts",
+                                         "h264_360p_long.mkv"),
+                         [](const testing::TestParamInfo<const char *> &info) {
+                             std::string name = info.param;
+                             std::replace(name.begin(), name.end(), '.', '_');
+                             return name;
+                         });
+
+TEST(MediaProbeHeaderTest, HeadersOfMp4AndMatroskaAreComplete) {
+    REQUIRE_CLIP(mp4, "h264_720p.mp4");
+    REQUIRE_CLIP(mkv, "h264_1080p.mkv");
+
+    EXPECT_TRUE(probe_once(mp4, FAST_OPTIONS).completeHeader);
+    EXPECT_TRUE(probe_once(mkv, FAST_OPTIONS).completeHeader);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "loopback_http_server.h"
+#include "media_io.h"
+
+/*
+ * The caching network io against a local HTTP server: data must match the resource whatever the
+ * access pattern, seeks within fetched blocks must not cost requests, and a dropped connection
+ * must fail the read rather than leave a short block in the cache.
+ */
+
+// Mirrors NETWORK_IO_BLOCK_SIZE.
+static const int64_t BLOCK_SIZE = 256 * 1024;
+
+static std::vector<uint8_t> make_resource(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+    }
+    return data;
+}
+
+class NetworkIOTest : public testing::Test {
+protected:
+    // Not a multiple of the block size, so the last block is short.
+    const std::vector<uint8_t> resource = make_resource(24 * BLOCK_SIZE + 123);
+    LoopbackHttpServer server{resource};
+    AVIOContext *io = nullptr;
+
+    void SetUp() override {
+        ASSERT_TRUE(server.isRunning());
+        if (!avio_find_protocol_name("http://127.0.0.1/")) {
+            GTEST_SKIP() << "FFmpeg has no http protocol";
+        }
+    }
+
+    void TearDown() override {
+        media_io_free(&io);
+    }
+
+    void open() {
+        io = media_io_create_network(server.url("clip.mp4").c_str());
+        ASSERT_NE(io, nullptr);
+    }
+
+    // Reads [size] bytes at [position] and checks them against the resource.
+    void expect_read(int64_t position, int size) {
+        ASSERT_EQ(avio_seek(io, position, SEEK_SET), position);
+        std::vector<uint8_t> buffer(size);
+        int expected = static_cast<int>(std::min<int64_t>(size, resource.size() - position));
+        ASSERT_EQ(avio_read(io, buffer.data(), size), expected) << "at " << position;
+        ASSERT_EQ(memcmp(buffer.data(), resource.data() + position, expected), 0) << "at " << position;
+    }
+};
+
+TEST_F(NetworkIOTest, RandomReadsMatchTheResource) {
+    open();
+    EXPECT_EQ(avio_size(io), static_cast<int64_t>(resource.size()));
+
+    std::mt19937 random(7);
+    for (int read = 0; read < 300; read++) {
+        int64_t position = random() % resource.size();
+        expect_read(position, 1 + static_cast<int>(random() % (3 * BLOCK_SIZE)));
+    }
+    // Through the short last block up to the end.
+    expect_read(static_cast<int64_t>(resource.size()) - 1000, 4096);
+    std::vector<uint8_t> buffer(16);
+    EXPECT_EQ(avio_read(io, buffer.data(), buffer.size()), AVERROR_EOF);
+    printf("%d requests for 300 random reads\n", server.requests());
+}
+
+TEST_F(NetworkIOTest, SeeksWithinFetchedBlocksCostNoRequests) {
+    open();
+    // Opening the input is the first request, and reading on keeps that connection going.
+    expect_read(0, 4 * BLOCK_SIZE);
+    EXPECT_EQ(server.requests(), 1);
+
+    // Frame extraction seeks back and forth over what it has read.
+    std::mt19937 random(11);
+    for (int seek = 0; seek < 200; seek++) {
+        expect_read(random() % (4 * BLOCK_SIZE - 4096), 4096);
+    }
+    EXPECT_EQ(server.requests(), 1);
+
+    // A short skip ahead is read through on the same connection.
+    expect_read(6 * BLOCK_SIZE + 100, 4096);
+    EXPECT_EQ(server.requests(), 1);
+
+    // A long one costs one range request, or two if it races the prefetch of the next block.
+    expect_read(20 * BLOCK_SIZE, 4096);
+    EXPECT_GE(server.requests(), 2);
+    EXPECT_LE(server.requests(), 3);
+    printf("%d requests\n", server.requests());
+}
+
+TEST_F(NetworkIOTest, DroppedConnectionFailsTheReadAndIsRecovered) {
+    // The response to opening the input ends in the middle of the first block.
+    server.dropNextResponseAfter(BLOCK_SIZE / 3);
+    open();
+
+    std::vector<uint8_t> buffer(4096);
+    EXPECT_LT(avio_read(io, buffer.data(), buffer.size()), 0);
+    // The cut did not pass for the end of the resource.
+    EXPECT_EQ(avio_size(io), static_cast<int64_t>(resource.size()));
+
+    // The block is fetched again rather than served short from the cache.
+    expect_read(0, 2 * BLOCK_SIZE);
+    EXPECT_EQ(server.requests(), 2);
+}
+
+TEST(NetworkIOServerTest, ServersWithoutRangesAreLeftToFFmpeg) {
+    LoopbackHttpServer server(make_resource(BLOCK_SIZE), false);
+    ASSERT_TRUE(server.isRunning());
+    if (!avio_find_protocol_name("http://127.0.0.1/")) {
+        GTEST_SKIP() << "FFmpeg has no http protocol";
+    }
+
+    EXPECT_EQ(media_io_create_network(server.url("clip.mp4").c_str()), nullptr);
+}
@@ -0,0 +1,227 @@
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "benchmark_stats.h"
+#include "frame_convert.h"
+#include "media_io.h"
+#include "media_probe.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+/*
+ * Thumbnail benchmark of the mediainfo cores on the clips generated by ffmpeg/test_clips.sh.
+ *
+ * Every frame of a clip is decoded and converted to RGBA in two ways:
+ * - "bitmap", at full size with a scaler created per frame, like
+ *   media_thumbnail_retriever_frame_to_bitmap() for getFrameAtTime
+ * - "tile", 320 pixels wide with one scaler for the whole clip, like a storyboard or a frame
+ *   sequence
+ * Each clip is decoded over and over for the given time, after one warm-up pass.
+ *
+ * Usage: mediainfo_benchmark [clips dir] [seconds per clip and mode]
+ */
+
+static const char *const CLIPS[] = {
+        "h264_720p.mp4",
+        "h264_1080p.mkv",
+        "hevc_1080p.mp4",
+        "vp9_1080p.webm",
+        "av1_1080p.mkv",
+        "mpeg2_720p.ts",
+};
+
+static const int TILE_WIDTH = 320;
+
+struct video_packets {
+    AVCodecParameters *parameters = nullptr;
+    std::vector<AVPacket *> packets;
+
+    ~video_packets() {
+        for (AVPacket *packet: packets) {
+            av_packet_free(&packet);
+        }
+        avcodec_parameters_free(&parameters);
+    }
+};
+
+struct benchmark_result {
+    int64_t frames = 0;
+    double seconds = 0;
+    int64_t allocations = 0;
+};
+
+/**
+ * Reads the packets of the first video stream into memory, so that demuxing stays out of the
+ * measurement.
+ */
+static bool read_video_packets(const std::string &path, video_packets &video) {
+    ProbeOptions options{0, 0, 0, false};
+    AVFormatContext *avFormatContext = media_probe_open(path.c_str(), -1, options);
+    if (!avFormatContext) {
+        return false;
+    }
+    int index = av_find_best_stream(avFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (index >= 0) {
+        video.parameters = avcodec_parameters_alloc();
+        avcodec_parameters_copy(video.parameters, avFormatContext->streams[index]->codecpar);
+        AVPacket *packet = av_packet_alloc();
+        while (av_read_frame(avFormatContext, packet) >= 0) {
+            if (packet->stream_index == index) {
+                video.packets.push_back(av_packet_clone(packet));
+            }
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+    }
+    media_io_close_input(&avFormatContext);
+    return index >= 0 && !video.packets.empty();
+}
+
+/**
+ * Opens a decoder the way frame extraction does.
+ */
+static AVCodecContext *open_decoder(const AVCodecParameters *parameters) {
+    const AVCodec *decoder = avcodec_find_decoder(parameters->codec_id);
+    AVCodecContext *codecContext = decoder ? avcodec_alloc_context3(decoder) : nullptr;
+    if (!codecContext) {
+        return nullptr;
+    }
+    if (avcodec_parameters_to_context(codecContext, parameters) < 0 ||
+        avcodec_open2(codecContext, decoder, nullptr) < 0) {
+        avcodec_free_context(&codecContext);
+    }
+    return codecContext;
+}
+
+struct rgba_output {
+    bool tile;
+    std::vector<uint8_t> pixels;
+    SwsContext *swsContext = nullptr;
+
+    ~rgba_output() {
+        sws_freeContext(swsContext);
+    }
+
+    bool convert(const AVFrame *frame) {
+        int width = tile ? TILE_WIDTH : frame->width;
+        int height = tile ? FFMAX(1, static_cast<int>(av_rescale(TILE_WIDTH, frame->height, frame->width)))
+                          : frame->height;
+        size_t size = static_cast<size_t>(width) * height * 4;
+        if (pixels.size() < size) {
+            pixels.resize(size);
+        }
+        if (!tile) {
+            // A bitmap gets a scaler of its own.
+            sws_freeContext(swsContext);
+            swsContext = nullptr;
+        }
+        return frame_convert_to_rgba(&swsContext, frame, pixels.data(), width, height, width * 4);
+    }
+};
+
+static bool receive_frames(AVCodecContext *codecContext, AVFrame *frame, rgba_output &output,
+                           int64_t &frames) {
+    int result;
+    while ((result = avcodec_receive_frame(codecContext, frame)) == 0) {
+        bool converted = output.convert(frame);
+        av_frame_unref(frame);
+        if (!converted) {
+            return false;
+        }
+        frames++;
+    }
+    return result == AVERROR(EAGAIN) || result == AVERROR_EOF;
+}
+
+/**
+ * Decodes and converts every packet once, then drains and flushes the decoder.
+ */
+static bool decode_pass(AVCodecContext *codecContext, const video_packets &video, AVFrame *frame,
+                        rgba_output &output, int64_t &frames) {
+    for (size_t i = 0; i <= video.packets.size(); i++) {
+        AVPacket *packet = i < video.packets.size() ? video.packets[i] : nullptr;
+        int result;
+        while ((result = avcodec_send_packet(codecContext, packet)) == AVERROR(EAGAIN)) {
+            if (!receive_frames(codecContext, frame, output, frames)) {
+                return false;
+            }
+        }
+        if (result < 0 || !receive_frames(codecContext, frame, output, frames)) {
+            return false;
+        }
+    }
+    avcodec_flush_buffers(codecContext);
+    return true;
+}
+
+static bool run_benchmark(AVCodecContext *codecContext, const video_packets &video, bool tile,
+                          double seconds, benchmark_result &result) {
+    AVFrame *frame = av_frame_alloc();
+    rgba_output output{tile};
+
+    int64_t warmUpFrames = 0;
+    bool success = decode_pass(codecContext, video, frame, output, warmUpFrames);
+    int64_t allocationsBefore = benchmark_allocations();
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    while (success && (result.frames == 0 || std::chrono::steady_clock::now() < deadline)) {
+        success = decode_pass(codecContext, video, frame, output, result.frames);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.allocations = benchmark_allocations() - allocationsBefore;
+    av_frame_free(&frame);
+    return success && result.frames > 0;
+}
+
+int main(int argc, char **argv) {
+    std::string clipsDir = argc > 1 ? argv[1] : TEST_CLIPS_DIR;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    av_log_set_level(AV_LOG_ERROR);
+
+    printf("%-16s %-6s %-12s %8s %10s %12s %13s %12s\n",
+           "clip", "mode", "decoder", "frames", "frames/s", "ns/frame", "allocs/frame", "peak RSS MiB");
+    bool failed = false;
+    for (const char *clip: CLIPS) {
+        std::string path = clipsDir + "/" + clip;
+        if (access(path.c_str(), R_OK) != 0) {
+            printf("%-16s skipped, not generated\n", clip);
+            continue;
+        }
+        video_packets video;
+        if (!read_video_packets(path, video)) {
+            printf("%-16s failed to demux\n", clip);
+            failed = true;
+            continue;
+        }
+
+        for (bool tile: {false, true}) {
+            const char *mode = tile ? "tile" : "bitmap";
+            // The packets stay resident, so the peak measured from here is the decoder's.
+            benchmark_reset_peak_rss();
+            AVCodecContext *codecContext = open_decoder(video.parameters);
+            if (!codecContext) {
+                printf("%-16s %-6s no decoder\n", clip, mode);
+                failed = true;
+                break;
+            }
+            benchmark_result result;
+            if (run_benchmark(codecContext, video, tile, seconds, result)) {
+                printf("%-16s %-6s %-12s %8lld %10.1f %12.0f %13.2f %12.1f\n", clip, mode,
+                       codecContext->codec->name, (long long) result.frames, result.frames / result.seconds,
+                       result.seconds * 1e9 / result.frames,
+                       result.allocations >= 0 ? static_cast<double>(result.allocations) / result.frames : -1.0,
+                       benchmark_peak_rss_bytes() / (1024.0 * 1024.0));
+            } else {
+                printf("%-16s %-6s %-12s failed to decode\n", clip, mode, codecContext->codec->name);
+                failed = true;
+            }
+            avcodec_free_context(&codecContext);
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}